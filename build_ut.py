@@ -81,7 +81,8 @@ def main ():
 
     # Rialto Component Tests & Paths
     # {Component Name : {Test Suite, Test Path}}
-    suitesToRun = {"ocdm" : {"suite" : "RialtoOcdmUnitTests", "path" : "/tests/ut/"}}
+    suitesToRun = {"ocdm" : {"suite" : "RialtoOcdmUnitTests", "path" : "/tests/ut/"},
+                   "ocdm-allocations" : {"suite" : "RialtoOcdmAllocationTests", "path" : "/tests/ut/"}}
 
     # Clean if required
     if args['clean'] == True:
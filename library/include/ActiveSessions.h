@@ -22,34 +22,65 @@
 
 #include "ICdmBackend.h"
 #include "IMessageDispatcher.h"
+#include "LockProfiler.h"
 #include "OpenCDMSession.h"
 #include <MediaCommon.h>
+#include <array>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <opencdm/open_cdm.h>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+class OpenCDMSessionPrivate;
+
 class ActiveSessions
 {
 public:
     static ActiveSessions &instance();
 
-    OpenCDMSession *create(const std::shared_ptr<ICdmBackend> &cdm,
+    /**
+     * With session sharing enabled, a session created with the key system, license type and init data of a live
+     * session whose license request has been generated shares that session's key session instead of creating its
+     * own - see SharedSession. The shared session is counted once for every session sharing it.
+     */
+    OpenCDMSession *create(const std::string &keySystem, const std::shared_ptr<ICdmBackend> &cdm,
                            const std::shared_ptr<IMessageDispatcher> &messageDispatcher, const LicenseType &sessionType,
                            OpenCDMSessionCallbacks *callbacks, void *context, const std::string &initDataType,
-                           const std::vector<uint8_t> &initData);
-    OpenCDMSession *get(const std::vector<uint8_t> &keyId);
+                           std::vector<uint8_t> initData);
+    OpenCDMSession *get(const uint8_t keyId[], uint8_t length);
     void remove(OpenCDMSession *session);
+    std::vector<std::pair<const OpenCDMSession *, uint64_t>> getDecryptCalls();
+
+    /**
+     * Whether sessions with the same init data share a key session, for sessions created afterwards. Initialised from
+     * RIALTO_SHARED_SESSIONS (disabled when not set).
+     */
+    static void setSessionSharingEnabled(bool isEnabled);
+    static bool isSessionSharingEnabled();
 
 private:
+    // Size and two independent hashes of the init data, the bytes are compared by attachSession on a match
+    using InitDataDigest = std::array<uint64_t, 3>;
+    using SharedSessionKey = std::tuple<std::string, LicenseType, std::string, InitDataDigest>;
+
     ActiveSessions() = default;
     ~ActiveSessions() = default;
 
+    OpenCDMSession *createShared(const std::shared_ptr<ICdmBackend> &cdm,
+                                 const std::shared_ptr<IMessageDispatcher> &messageDispatcher,
+                                 const LicenseType &sessionType, OpenCDMSessionCallbacks *callbacks, void *context,
+                                 const std::string &keySystem, const std::string &initDataType,
+                                 std::vector<uint8_t> initData);
+
 private:
-    std::mutex m_mutex;
+    ProfiledMutex m_mutex{"ActiveSessions"};
     std::map<OpenCDMSession *, int> m_activeSessions;
+    std::map<SharedSessionKey, OpenCDMSessionPrivate *> m_sharedSessions;
+    std::map<OpenCDMSession *, OpenCDMSessionPrivate *> m_sharedSessionHandles;
 };
 
 #endif // ACTIVE_SESSIONS_H_
@@ -0,0 +1,181 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BINARY_LOG_FILE_H_
+#define BINARY_LOG_FILE_H_
+
+#include "BinaryLogFormat.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+/**
+ * Static text that the binary log may store by address, created with RIALTO_LOG_LITERAL.
+ */
+struct LogLiteral
+{
+    const char *text;
+};
+
+inline std::ostream &operator<<(std::ostream &stream, const LogLiteral &literal)
+{
+    return stream << literal.text;
+}
+
+/**
+ * Collects the arguments of a single log statement in binary form.
+ *
+ * Static text (the RIALTO_LOG_FMT format, LogLiteral) is not copied - only its address is used to build the
+ * format ID, so the same call site always maps to the same format ID. Dynamic values, including character arrays
+ * that are not marked as literals, are stored raw and expanded by the decoder.
+ */
+class BinaryLogRecord
+{
+public:
+    template <typename T> void add(const T &value)
+    {
+        using Type = std::decay_t<T>;
+        if constexpr (std::is_same_v<Type, LogLiteral>)
+        {
+            addLiteral(value.text);
+        }
+        else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>)
+        {
+            addString(value, strnlen(value, std::extent_v<T>));
+        }
+        else if constexpr (std::is_same_v<Type, const char *> || std::is_same_v<Type, char *>)
+        {
+            addString(value ? value : "(null)", value ? std::char_traits<char>::length(value) : 6);
+        }
+        else if constexpr (std::is_same_v<Type, std::string>)
+        {
+            addString(value.data(), value.size());
+        }
+        else if constexpr (std::is_same_v<Type, char>)
+        {
+            addString(&value, 1);
+        }
+        else if constexpr (std::is_enum_v<Type>)
+        {
+            add(static_cast<std::underlying_type_t<Type>>(value));
+        }
+        else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>)
+        {
+            const int64_t arg{value};
+            addArg(binarylog::kSigned, &arg, sizeof(arg));
+        }
+        else if constexpr (std::is_integral_v<Type>)
+        {
+            const uint64_t arg{value};
+            addArg(binarylog::kUnsigned, &arg, sizeof(arg));
+        }
+        else if constexpr (std::is_floating_point_v<Type>)
+        {
+            const double arg{value};
+            addArg(binarylog::kDouble, &arg, sizeof(arg));
+        }
+        else if constexpr (std::is_pointer_v<Type>)
+        {
+            const uint64_t arg{reinterpret_cast<uintptr_t>(value)};
+            addArg(binarylog::kPointer, &arg, sizeof(arg));
+        }
+        else
+        {
+            std::ostringstream stream;
+            stream << value;
+            const std::string text{stream.str()};
+            addString(text.data(), text.size());
+        }
+    }
+
+    /**
+     * Uses a RIALTO_LOG_FMT format string ("{}" placeholders) as the static text of the record.
+     */
+    void setFormat(const char *format);
+
+    uint64_t formatKey() const { return m_formatKey; }
+    std::string formatTemplate() const;
+    const uint8_t *args() const { return m_args.data(); }
+    size_t argsSize() const { return m_argsSize; }
+    uint8_t argCount() const { return m_argCount; }
+
+private:
+    void addLiteral(const char *text);
+    void addString(const char *text, size_t length);
+    void addArg(binarylog::ArgType type, const void *data, size_t size);
+    bool addPiece(const char *text);
+
+private:
+    static constexpr size_t kMaxPieces{32};
+    static constexpr size_t kMaxArgsSize{binarylog::kMaxRecordSize - sizeof(binarylog::BinaryLogRecordHeader) -
+                                         sizeof(binarylog::LogEntry)};
+
+    const char *m_format{nullptr};
+    std::array<const char *, kMaxPieces> m_pieces{};
+    size_t m_pieceCount{0};
+    std::array<uint8_t, kMaxArgsSize> m_args;
+    size_t m_argsSize{0};
+    uint8_t m_argCount{0};
+    uint64_t m_formatKey{14695981039346656037ULL};
+};
+
+/**
+ * Memory-mapped writer for the binary log format, enabled with RIALTO_LOG_FORMAT=binary together with
+ * RIALTO_LOG_PATH. The file grows in preallocated segments and is trimmed to its used size when closed.
+ */
+class BinaryLogFile
+{
+public:
+    static BinaryLogFile &instance();
+    bool write(const std::string &componentName, uint8_t severity, const BinaryLogRecord &record);
+    bool isEnabled() const;
+    void reset();
+
+private:
+    BinaryLogFile();
+    ~BinaryLogFile();
+
+    void tryOpenFile();
+    void tryCloseFile();
+    bool reserve(size_t size);
+    void appendRecord(binarylog::RecordType type, const void *body, size_t bodySize, const void *extra,
+                      size_t extraSize);
+    bool defineString(const std::string &text, uint32_t &id);
+
+private:
+    std::mutex m_mutex;
+    std::atomic<bool> m_isEnabled;
+    int m_fd;
+    uint8_t *m_mapping;
+    size_t m_mappedSize;
+    size_t m_offset;
+    uint32_t m_nextStringId;
+    std::unordered_map<std::string, uint32_t> m_componentIds;
+    std::unordered_map<uint64_t, uint32_t> m_formatIds;
+};
+
+#endif // BINARY_LOG_FILE_H_
@@ -0,0 +1,96 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BINARYLOG_BINARY_LOG_FORMAT_H_
+#define BINARYLOG_BINARY_LOG_FORMAT_H_
+
+#include <cstdint>
+
+/**
+ * On-disk layout of the binary log written when RIALTO_LOG_FORMAT=binary.
+ *
+ * The file starts with a BinaryLogFileHeader followed by a stream of records. Each record starts with a
+ * BinaryLogRecordHeader. Strings that do not change between calls (format templates and component names) are
+ * written once as kStringDefinition records and referenced by ID afterwards. A record of type kEnd (zero filled,
+ * preallocated space) terminates the stream. All values are stored in host byte order.
+ */
+namespace binarylog
+{
+constexpr char kMagic[8]{'R', 'O', 'C', 'D', 'M', 'B', 'L', 'G'};
+constexpr uint32_t kVersion{1};
+constexpr const char *kFileSuffix{".ocdm.bin"};
+
+// Placeholder used in format templates for each dynamic argument (ASCII unit separator)
+constexpr char kPlaceholder{'\x1f'};
+
+#pragma pack(push, 1)
+
+struct BinaryLogFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+};
+
+enum RecordType : uint16_t
+{
+    kEnd = 0,
+    kStringDefinition = 1,
+    kLogEntry = 2
+};
+
+struct BinaryLogRecordHeader
+{
+    uint16_t type;
+    uint16_t size; // Size of the whole record including this header
+};
+
+// Followed by `length` bytes of text (not null terminated)
+struct StringDefinition
+{
+    uint32_t id;
+    uint16_t length;
+};
+
+// Followed by `argCount` tagged arguments
+struct LogEntry
+{
+    uint64_t timestampNs; // CLOCK_REALTIME
+    uint32_t formatId;
+    uint32_t componentId;
+    uint32_t threadId;
+    uint8_t severity;
+    uint8_t argCount;
+};
+
+enum ArgType : uint8_t
+{
+    kSigned = 1,   // int64_t
+    kUnsigned = 2, // uint64_t
+    kDouble = 3,   // double
+    kPointer = 4,  // uint64_t
+    kString = 5    // uint16_t length followed by the text
+};
+
+#pragma pack(pop)
+
+constexpr uint16_t kMaxRecordSize{1024};
+} // namespace binarylog
+
+#endif // BINARYLOG_BINARY_LOG_FORMAT_H_
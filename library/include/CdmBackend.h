@@ -21,30 +21,88 @@
 #define CDM_BACKEND_H_
 
 #include "ICdmBackend.h"
+#include "LatencyStats.h"
+#include "LockProfiler.h"
 #include "Logger.h"
 #include "MessageDispatcher.h"
+#include "PriorityScheduler.h"
 #include <IControlClient.h>
 #include <IMediaKeys.h>
-#include <condition_variable>
+#include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 class CdmBackend : public ICdmBackend, public firebolt::rialto::IControlClient
 {
 public:
-    CdmBackend(const std::string &keySystem, const std::shared_ptr<firebolt::rialto::IMediaKeysClient> &mediaKeysClient,
+    CdmBackend(const std::string &keySystem, const std::shared_ptr<IMessageDispatcherListener> &mediaKeysClient,
                const std::shared_ptr<firebolt::rialto::IMediaKeysFactory> &mediaKeysFactory);
-    ~CdmBackend() override = default;
+    ~CdmBackend() override;
 
+    /**
+     * Rialto drops MediaKeys and all key sessions when the app leaves RUNNING. On the way back, a restore thread
+     * creates MediaKeys again and re-creates and loads key sessions with a stored persistent license. Their sessions
+     * are given the new key session IDs, the others an invalid ID, through
+     * IMessageDispatcherListener::onKeySessionIdsChanged once the restore has finished. initialize() waits for a
+     * restore in progress.
+     */
     void notifyApplicationState(firebolt::rialto::ApplicationState state) override;
 
     bool initialize(const firebolt::rialto::ApplicationState &initialState) override;
 
     bool selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
     bool containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
-    bool createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, int32_t &keySessionId) override;
+    /**
+     * Number of TEMPORARY, non-LDL key sessions each backend keeps created in advance while Rialto is RUNNING, so
+     * that creating such a session does not wait for Rialto. A background thread refills the pool after a session is
+     * taken from it. Initialised from RIALTO_KEY_SESSION_POOL_SIZE (0, no pool, when not set). Applies to backends
+     * reaching RUNNING afterwards.
+     */
+    static void setKeySessionPoolSize(uint32_t size);
+    static uint32_t getKeySessionPoolSize();
+
+    /**
+     * Blocking form of createKeySessionAsync, kept for callers expecting the session to exist on return. Waits up to
+     * one second for Rialto to reach RUNNING and fails when it does not.
+     */
+    bool createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                          int32_t &keySessionId) override;
+
+    /**
+     * Creates a key session and calls callback with the result, without holding the backend lock. Before Rialto is
+     * RUNNING the request is queued, and the queue is replayed in order when it becomes RUNNING. Returns an ID for
+     * cancelKeySessionCreation. TEMPORARY, non-LDL sessions are taken from the pool when it holds one. The created
+     * session is scheduled with the given priority, queued requests are replayed higher priority first.
+     */
+    uint64_t createKeySessionAsync(firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                                   CreateKeySessionCallback callback) override;
+
+    /**
+     * Calls on a key session wait for their turn on the backend in the order of the session's priority, see
+     * PriorityScheduler. System calls (store, hash, limit and time queries) are FOREGROUND.
+     */
+    void setKeySessionPriority(int32_t keySessionId, SessionPriority priority) override;
+
+    /**
+     * Removes a queued request, its callback is never called. Returns false when the request is not queued any more -
+     * its callback has been or is being called.
+     */
+    bool cancelKeySessionCreation(uint64_t requestId) override;
+
+    /**
+     * Reserves one of the platform's LDL sessions (getLdlSessionsLimit) for an LDL key session about to be created.
+     * When all of them are in use, waits until one is closed - higher priority callers first, in arrival order within
+     * a priority - and fails after timeout (0 waits without a deadline). The reservation turns into the key session on
+     * its creation, or is released when the creation is deferred until Rialto is RUNNING. Admits without waiting when
+     * the limit is not known.
+     */
+    bool admitLdlSession(SessionPriority priority, std::chrono::milliseconds timeout) override;
     bool generateRequest(int32_t keySessionId, firebolt::rialto::InitDataType initDataType,
                          const std::vector<uint8_t> &initData) override;
     bool loadSession(int32_t keySessionId) override;
@@ -62,17 +120,69 @@ public:
     bool getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId) override;
 
 private:
-    bool createMediaKeys();
+    struct KeySessionInfo
+    {
+        firebolt::rialto::KeySessionType sessionType;
+        bool isLDL;
+        bool hasStoredLicense;
+        SessionPriority priority;
+    };
+
+    struct PendingKeySession
+    {
+        uint64_t requestId;
+        firebolt::rialto::KeySessionType sessionType;
+        bool isLDL;
+        SessionPriority priority;
+        CreateKeySessionCallback callback;
+    };
+
+    bool checkStatus(CdmOperation operation, firebolt::rialto::MediaKeyErrorStatus status);
+    std::unique_ptr<firebolt::rialto::IMediaKeys> createMediaKeys();
+    bool executeCreateKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, bool isAdmitted,
+                                 SessionPriority priority, int32_t &keySessionId);
+    void replayPendingKeySessions(ProfiledLock &lock);
+    bool takePooledKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                              int32_t &keySessionId);
+    void refillKeySessionPool();
+    void clearKeySessionPool();
+    void keySessionPoolLoop();
+    bool isLdlSessionAvailable();
+    void eraseKeySession(int32_t keySessionId);
+    void restoreLoop();
+    void restore(ProfiledLock &lock);
+    std::map<int32_t, int32_t> restoreKeySessions();
+    void setPriority(int32_t keySessionId, SessionPriority priority);
+    void setHasStoredLicense(int32_t keySessionId, bool hasStoredLicense);
 
 private:
     Logger m_log;
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
+    ProfiledMutex m_mutex{"CdmBackend"};
+    PriorityScheduler m_scheduler;
     firebolt::rialto::ApplicationState m_appState;
     const std::string m_keySystem;
-    std::shared_ptr<firebolt::rialto::IMediaKeysClient> m_mediaKeysClient;
+    std::shared_ptr<IMessageDispatcherListener> m_mediaKeysClient;
     std::shared_ptr<firebolt::rialto::IMediaKeysFactory> m_mediaKeysFactory;
     std::unique_ptr<firebolt::rialto::IMediaKeys> m_mediaKeys;
+    std::deque<PendingKeySession> m_pendingKeySessions;
+    std::map<int32_t, KeySessionInfo> m_keySessions;
+    uint64_t m_nextRequestId;
+    std::deque<int32_t> m_keySessionPool;
+    ProfiledConditionVariable m_poolCv;
+    std::thread m_poolThread;
+    bool m_isPoolRunning;
+    ProfiledConditionVariable m_restoreCv;
+    std::thread m_restoreThread;
+    bool m_isRestoreRunning;
+    bool m_isRestoreRequested;
+    bool m_isRestoring;
+    uint64_t m_appStateChanges;
+    ProfiledConditionVariable m_ldlCv;
+    std::set<std::pair<SessionPriority, uint64_t>> m_ldlWaiters;
+    uint64_t m_nextLdlWaiter;
+    uint32_t m_ldlReservations;
+    uint32_t m_ldlLimit;
+    bool m_isLdlLimitKnown;
 };
 
 #endif // CDM_BACKEND_H_
@@ -20,10 +20,13 @@
 #ifndef I_CDM_BACKEND_H_
 #define I_CDM_BACKEND_H_
 
+#include "SessionPriority.h"
 #include <ControlCommon.h>
 #include <IMediaKeysClient.h>
 #include <MediaCommon.h>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -31,12 +34,20 @@
 class ICdmBackend
 {
 public:
+    using CreateKeySessionCallback = std::function<void(bool isCreated, int32_t keySessionId)>;
+
     virtual ~ICdmBackend() = default;
 
     virtual bool initialize(const firebolt::rialto::ApplicationState &initialState) = 0;
     virtual bool selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId) = 0;
     virtual bool containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId) = 0;
-    virtual bool createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, int32_t &keySessionId) = 0;
+    virtual bool createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                                  int32_t &keySessionId) = 0;
+    virtual uint64_t createKeySessionAsync(firebolt::rialto::KeySessionType sessionType, bool isLDL,
+                                           SessionPriority priority, CreateKeySessionCallback callback) = 0;
+    virtual void setKeySessionPriority(int32_t keySessionId, SessionPriority priority) = 0;
+    virtual bool cancelKeySessionCreation(uint64_t requestId) = 0;
+    virtual bool admitLdlSession(SessionPriority priority, std::chrono::milliseconds timeout) = 0;
     virtual bool generateRequest(int32_t keySessionId, firebolt::rialto::InitDataType initDataType,
                                  const std::vector<uint8_t> &initData) = 0;
     virtual bool loadSession(int32_t keySessionId) = 0;
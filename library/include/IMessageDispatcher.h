@@ -21,6 +21,8 @@
 #define I_MESSAGE_DISPATCHER_H_
 
 #include <IMediaKeysClient.h>
+#include <cstdint>
+#include <map>
 #include <memory>
 
 class IMessageDispatcherClient
@@ -29,11 +31,26 @@ public:
     virtual ~IMessageDispatcherClient() = default;
 };
 
+/**
+ * Receiver of the Rialto MediaKeys notifications of a key session, which is also told when key sessions are
+ * re-created with new IDs after Rialto resumes.
+ */
+class IMessageDispatcherListener : public firebolt::rialto::IMediaKeysClient
+{
+public:
+    /**
+     * Maps the IDs of the key sessions lost with the previous MediaKeys to their new IDs, or to
+     * firebolt::rialto::kInvalidSessionId when a key session could not be restored. New and old IDs may overlap, so
+     * the whole map is applied at once.
+     */
+    virtual void onKeySessionIdsChanged(const std::map<int32_t, int32_t> &newKeySessionIds) = 0;
+};
+
 class IMessageDispatcher
 {
 public:
     virtual ~IMessageDispatcher() = default;
-    virtual std::unique_ptr<IMessageDispatcherClient> createClient(firebolt::rialto::IMediaKeysClient *client) = 0;
+    virtual std::unique_ptr<IMessageDispatcherClient> createClient(IMessageDispatcherListener *client) = 0;
 };
 
 #endif // I_MESSAGE_DISPATCHER_H_
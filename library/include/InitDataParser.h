@@ -0,0 +1,38 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INIT_DATA_PARSER_H_
+#define INIT_DATA_PARSER_H_
+
+#include <MediaCommon.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Key IDs a license for the given init data is expected to provide, so that a session can be found by key ID before
+ * its license arrives. Understands CENC init data (pssh boxes: the KID list of version 1 boxes, or the Widevine and
+ * PlayReady data of version 0 ones), WebM init data (a single key ID) and PlayReady headers (a PlayReady Object or a
+ * bare WRM header, in UTF-16 or UTF-8). The init data is walked in place, only the key IDs found are copied. Key IDs
+ * are returned in the big-endian (CENC) byte order used by decryptors, once each. Malformed or unknown init data
+ * gives an empty list.
+ */
+std::vector<std::vector<uint8_t>> parseKeyIds(firebolt::rialto::InitDataType initDataType,
+                                              const std::vector<uint8_t> &initData);
+
+#endif // INIT_DATA_PARSER_H_
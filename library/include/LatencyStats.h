@@ -0,0 +1,180 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_STATS_H_
+#define LATENCY_STATS_H_
+
+#include "SessionPriority.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum class CdmOperation : uint32_t
+{
+    SELECT_KEY_ID,
+    CONTAINS_KEY,
+    CREATE_KEY_SESSION,
+    GENERATE_REQUEST,
+    LOAD_SESSION,
+    UPDATE_SESSION,
+    SET_DRM_HEADER,
+    CLOSE_KEY_SESSION,
+    REMOVE_KEY_SESSION,
+    DELETE_DRM_STORE,
+    DELETE_KEY_STORE,
+    GET_DRM_STORE_HASH,
+    GET_KEY_STORE_HASH,
+    GET_LDL_SESSIONS_LIMIT,
+    GET_LAST_DRM_ERROR,
+    GET_DRM_TIME,
+    GET_CDM_KEY_SESSION_ID,
+    COUNT
+};
+
+const char *toString(CdmOperation operation);
+
+/**
+ * Merged view of one or more LatencyHistograms. All values are in nanoseconds.
+ */
+struct LatencySnapshot
+{
+    static constexpr size_t kSubBuckets{4};
+    static constexpr size_t kMaxBits{40};
+    static constexpr size_t kBuckets{(kMaxBits - 1) * kSubBuckets};
+
+    uint64_t count{0};
+    uint64_t totalNs{0};
+    uint64_t maxNs{0};
+    std::array<uint64_t, kBuckets> buckets{};
+
+    /**
+     * Log-linear bucketing: every power of two range is split into kSubBuckets linear buckets, so the relative
+     * error of a bucket is at most 1 / kSubBuckets. Values of 2^kMaxBits ns (~18 min) and above share the last bucket.
+     */
+    static size_t bucketIndex(uint64_t valueNs);
+    static uint64_t bucketUpperBound(size_t index);
+
+    /**
+     * Upper bound of the bucket holding the given fraction (0.0 - 1.0) of the recorded values, capped at maxNs.
+     */
+    uint64_t percentile(double fraction) const;
+};
+
+/**
+ * Histogram written by a single thread. Readers may load the buckets concurrently, so the writer uses relaxed
+ * atomic stores instead of read-modify-write operations.
+ */
+class LatencyHistogram
+{
+public:
+    void record(uint64_t valueNs);
+    void addTo(LatencySnapshot &snapshot) const;
+    void reset();
+
+private:
+    static void increment(std::atomic<uint64_t> &value, uint64_t delta)
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_totalNs{0};
+    std::atomic<uint64_t> m_maxNs{0};
+    std::array<std::atomic<uint64_t>, LatencySnapshot::kBuckets> m_buckets{};
+};
+
+/**
+ * Latency of CdmBackend operations, split into the time spent waiting for the CdmBackend turn and mutex and the time
+ * of the call itself (mostly Rialto IPC). It is kept per operation and per priority of the session the operation was
+ * made for. Every thread records into its own histograms, which are registered here and merged on read. Histograms of
+ * finished threads are folded into a shared set.
+ *
+ * The statistics are written to the log (info level of the "LatencyStats" component) every
+ * RIALTO_LATENCY_STATS_INTERVAL seconds, 60 by default, 0 disables the periodic dump.
+ */
+class LatencyStats
+{
+public:
+    struct ThreadHistograms
+    {
+        std::array<LatencyHistogram, static_cast<size_t>(CdmOperation::COUNT)> lockWait;
+        std::array<LatencyHistogram, static_cast<size_t>(CdmOperation::COUNT)> callTime;
+        std::array<LatencyHistogram, kSessionPriorityCount> priorityLockWait;
+        std::array<LatencyHistogram, kSessionPriorityCount> priorityCallTime;
+    };
+
+    static LatencyStats &instance();
+
+    void record(CdmOperation operation, SessionPriority priority, uint64_t lockWaitNs, uint64_t callTimeNs);
+    void getStats(CdmOperation operation, LatencySnapshot &lockWait, LatencySnapshot &callTime);
+    void getStats(SessionPriority priority, LatencySnapshot &lockWait, LatencySnapshot &callTime);
+    void dumpToLog();
+    void reset();
+
+    void registerThread(ThreadHistograms *histograms);
+    void unregisterThread(ThreadHistograms *histograms);
+
+private:
+    LatencyStats();
+    ~LatencyStats() = default;
+
+    void dumpIfDue(uint64_t nowNs);
+
+private:
+    std::mutex m_mutex;
+    std::vector<ThreadHistograms *> m_threadHistograms;
+    std::array<LatencySnapshot, static_cast<size_t>(CdmOperation::COUNT)> m_finishedLockWait;
+    std::array<LatencySnapshot, static_cast<size_t>(CdmOperation::COUNT)> m_finishedCallTime;
+    std::array<LatencySnapshot, kSessionPriorityCount> m_finishedPriorityLockWait;
+    std::array<LatencySnapshot, kSessionPriorityCount> m_finishedPriorityCallTime;
+    const uint64_t m_dumpIntervalNs;
+    std::atomic<uint64_t> m_nextDumpNs;
+};
+
+/**
+ * Measures one CdmBackend operation. Create it before taking the mutex and call lockAcquired() once the mutex is
+ * held. The latency is recorded when the timer goes out of scope, so it should be declared before the lock.
+ */
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(CdmOperation operation, SessionPriority priority = SessionPriority::FOREGROUND)
+        : m_operation{operation}, m_priority{priority}, m_start{std::chrono::steady_clock::now()},
+          m_lockAcquired{m_start}
+    {
+    }
+    ~LatencyTimer();
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+
+    void lockAcquired() { m_lockAcquired = std::chrono::steady_clock::now(); }
+
+private:
+    const CdmOperation m_operation;
+    const SessionPriority m_priority;
+    const std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_lockAcquired;
+};
+
+#endif // LATENCY_STATS_H_
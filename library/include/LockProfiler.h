@@ -0,0 +1,141 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCK_PROFILER_H_
+#define LOCK_PROFILER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Contention statistics of all mutexes sharing one name, e.g. the mutexes of all OpenCDMSessionPrivate objects.
+ * Times are in nanoseconds. Only acquisitions that had to wait count as contended.
+ */
+class LockProfile
+{
+public:
+    explicit LockProfile(const std::string &name) : m_name{name} {}
+
+    const std::string &name() const { return m_name; }
+    void recordAcquisition(uint64_t waitNs);
+    void recordRelease(uint64_t holdNs);
+
+private:
+    friend class LockProfiler;
+    static void updateMax(std::atomic<uint64_t> &max, uint64_t value);
+
+private:
+    const std::string m_name;
+    std::atomic<uint64_t> m_acquisitions{0};
+    std::atomic<uint64_t> m_contentions{0};
+    std::atomic<uint64_t> m_totalWaitNs{0};
+    std::atomic<uint64_t> m_maxWaitNs{0};
+    std::atomic<uint64_t> m_totalHoldNs{0};
+    std::atomic<uint64_t> m_maxHoldNs{0};
+};
+
+struct LockProfileSnapshot
+{
+    std::string name;
+    uint64_t acquisitions{0};
+    uint64_t contentions{0};
+    uint64_t totalWaitNs{0};
+    uint64_t maxWaitNs{0};
+    uint64_t totalHoldNs{0};
+    uint64_t maxHoldNs{0};
+};
+
+/**
+ * Registry of the lock profiles recorded by ProfiledMutex in builds with RIALTO_ENABLE_LOCK_PROFILING. The profiles
+ * are written at process exit to RIALTO_LOCK_PROFILE_PATH, or to stderr when it is not set, and on demand with
+ * opencdm_ext_dump_lock_profile().
+ */
+class LockProfiler
+{
+public:
+    static LockProfiler &instance();
+    static constexpr bool isEnabled()
+    {
+#ifdef RIALTO_ENABLE_LOCK_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    LockProfile &getProfile(const std::string &name);
+    std::vector<LockProfileSnapshot> getSnapshots();
+    std::string report();
+    bool dump(const char *path);
+    void reset();
+
+private:
+    LockProfiler() = default;
+    ~LockProfiler();
+
+private:
+    std::mutex m_mutex;
+    // Profiles are referenced by the mutexes for their whole lifetime, so they are never removed
+    std::deque<LockProfile> m_profiles;
+};
+
+#ifdef RIALTO_ENABLE_LOCK_PROFILING
+/**
+ * std::mutex recording its wait and hold times into the LockProfile of its name.
+ */
+class ProfiledMutex
+{
+public:
+    explicit ProfiledMutex(const char *name) : m_profile{LockProfiler::instance().getProfile(name)} {}
+    ProfiledMutex(const ProfiledMutex &) = delete;
+    ProfiledMutex &operator=(const ProfiledMutex &) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex m_mutex;
+    LockProfile &m_profile;
+    // Only accessed by the thread holding the mutex
+    uint64_t m_acquiredNs{0};
+};
+
+using ProfiledLock = std::unique_lock<ProfiledMutex>;
+using ProfiledConditionVariable = std::condition_variable_any;
+#else
+/**
+ * Plain std::mutex when lock profiling is not built in.
+ */
+class ProfiledMutex : public std::mutex
+{
+public:
+    explicit ProfiledMutex(const char *) {}
+};
+
+using ProfiledLock = std::unique_lock<std::mutex>;
+using ProfiledConditionVariable = std::condition_variable;
+#endif
+
+#endif // LOCK_PROFILER_H_
@@ -0,0 +1,239 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOGFORMAT_LOG_FORMAT_H_
+#define LOGFORMAT_LOG_FORMAT_H_
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace logformat
+{
+constexpr size_t kInvalidFormat{static_cast<size_t>(-1)};
+
+/**
+ * Counts "{}" placeholders in a format string. "{{" and "}}" are escaped braces. Returns kInvalidFormat for any
+ * other use of braces, so that a bad format string fails to compile when used through RIALTO_LOG_FMT.
+ */
+constexpr size_t countPlaceholders(const char *format)
+{
+    size_t count{0};
+    for (size_t i = 0; format[i] != '\0'; ++i)
+    {
+        if ('{' == format[i])
+        {
+            if ('{' == format[i + 1])
+            {
+                ++i;
+            }
+            else if ('}' == format[i + 1])
+            {
+                ++count;
+                ++i;
+            }
+            else
+            {
+                return kInvalidFormat;
+            }
+        }
+        else if ('}' == format[i])
+        {
+            if ('}' != format[i + 1])
+            {
+                return kInvalidFormat;
+            }
+            ++i;
+        }
+    }
+    return count;
+}
+
+template <typename T> struct AlwaysFalse : std::false_type
+{
+};
+
+/**
+ * Passes character arrays (e.g. __func__) on as C strings, so that the binary log stores them as arguments rather
+ * than as part of the format.
+ */
+template <typename T> const T &asArgument(const T &value)
+{
+    return value;
+}
+
+template <size_t N> const char *asArgument(const char (&value)[N])
+{
+    return value;
+}
+
+/**
+ * Fixed size character buffer living on the stack of the log call. Text that does not fit is truncated and the
+ * line ends with kTruncationMarker.
+ */
+class LogBuffer
+{
+public:
+    static constexpr size_t kCapacity{512};
+    static constexpr std::string_view kTruncationMarker{"..."};
+
+    void append(const char *text, size_t length)
+    {
+        const size_t kSpace{kCapacity - m_size};
+        if (length > kSpace)
+        {
+            length = kSpace;
+            m_isTruncated = true;
+        }
+        std::memcpy(m_data + m_size, text, length);
+        m_size += length;
+    }
+    void append(std::string_view text) { append(text.data(), text.size()); }
+    void append(char character) { append(&character, 1); }
+
+    template <typename T> void appendValue(const T &value)
+    {
+        using Type = std::decay_t<T>;
+        if constexpr (std::is_same_v<Type, bool>)
+        {
+            append(value ? std::string_view{"true"} : std::string_view{"false"});
+        }
+        else if constexpr (std::is_same_v<Type, char>)
+        {
+            append(value);
+        }
+        else if constexpr (std::is_array_v<T>)
+        {
+            append(std::string_view{value});
+        }
+        else if constexpr (std::is_same_v<Type, const char *> || std::is_same_v<Type, char *>)
+        {
+            append(value ? std::string_view{value} : std::string_view{"(null)"});
+        }
+        else if constexpr (std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view>)
+        {
+            append(std::string_view{value});
+        }
+        else if constexpr (std::is_enum_v<Type>)
+        {
+            appendValue(static_cast<std::underlying_type_t<Type>>(value));
+        }
+        else if constexpr (std::is_integral_v<Type>)
+        {
+            char digits[24];
+            const auto kResult{std::to_chars(digits, digits + sizeof(digits), value)};
+            append(digits, static_cast<size_t>(kResult.ptr - digits));
+        }
+        else if constexpr (std::is_floating_point_v<Type>)
+        {
+            appendPrintf("%g", static_cast<double>(value));
+        }
+        else if constexpr (std::is_pointer_v<Type>)
+        {
+            appendPrintf("%p", static_cast<const void *>(value));
+        }
+        else
+        {
+            static_assert(AlwaysFalse<Type>::value, "Type cannot be formatted by RIALTO_LOG_FMT");
+        }
+    }
+
+    std::string_view view()
+    {
+        if (m_isTruncated)
+        {
+            std::memcpy(m_data + kCapacity - kTruncationMarker.size(), kTruncationMarker.data(),
+                        kTruncationMarker.size());
+        }
+        return std::string_view{m_data, m_size};
+    }
+
+    /**
+     * Zero-terminated copy of the text, for sinks taking C strings. Drops the last character when the buffer is
+     * full.
+     */
+    const char *cString()
+    {
+        const std::string_view kView{view()};
+        m_data[kView.size() < kCapacity ? kView.size() : kCapacity - 1] = '\0';
+        return m_data;
+    }
+
+private:
+    template <typename T> void appendPrintf(const char *format, T value)
+    {
+        char text[32];
+        const int kLength{std::snprintf(text, sizeof(text), format, value)};
+        if (kLength > 0)
+        {
+            append(text, std::min(static_cast<size_t>(kLength), sizeof(text) - 1));
+        }
+    }
+
+private:
+    char m_data[kCapacity + 1];
+    size_t m_size{0};
+    bool m_isTruncated{false};
+};
+
+inline void formatTo(LogBuffer &buffer, const char *format)
+{
+    const char *text{format};
+    for (; *format != '\0'; ++format)
+    {
+        if ('{' == *format || '}' == *format)
+        {
+            // Escaped brace - keep one of the pair
+            buffer.append(text, static_cast<size_t>(format - text) + 1);
+            text = ++format + 1;
+        }
+    }
+    buffer.append(text, static_cast<size_t>(format - text));
+}
+
+template <typename T, typename... Args>
+void formatTo(LogBuffer &buffer, const char *format, const T &value, const Args &...args)
+{
+    const char *text{format};
+    for (; *format != '\0'; ++format)
+    {
+        if ('{' == *format && '}' == format[1])
+        {
+            buffer.append(text, static_cast<size_t>(format - text));
+            buffer.appendValue(value);
+            formatTo(buffer, format + 2, args...);
+            return;
+        }
+        if ('{' == *format || '}' == *format)
+        {
+            buffer.append(text, static_cast<size_t>(format - text) + 1);
+            text = ++format + 1;
+        }
+    }
+    buffer.append(text, static_cast<size_t>(format - text));
+}
+} // namespace logformat
+
+#endif // LOGFORMAT_LOG_FORMAT_H_
@@ -20,10 +20,19 @@
 #ifndef LOGGER_H_
 #define LOGGER_H_
 
-#include <fstream>
+#include "BinaryLogFile.h"
+#include "LockProfiler.h"
+#include "LogFormat.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
 enum Severity
 {
@@ -35,11 +44,50 @@ enum Severity
     debug = 5
 };
 
+/**
+ * Log thresholds per component, configured with RIALTO_DEBUG. The variable holds a comma separated list of a global
+ * level and/or "<component>:<level>" overrides, e.g. "2,CdmBackend:5,open_cdm_adapter:1". Every Logger gets a
+ * component ID when it is constructed, so checking whether a message passes is a single array lookup.
+ */
+class LogLevels
+{
+public:
+    static constexpr size_t kMaxComponents{64};
+
+    static LogLevels &instance();
+    uint32_t registerComponent(const std::string &componentName);
+    bool isEnabled(uint32_t componentId, const Severity &severity) const
+    {
+        return static_cast<int>(severity) <= m_levels[componentId].load(std::memory_order_relaxed);
+    }
+    void reload();
+
+private:
+    LogLevels();
+    ~LogLevels() = default;
+
+    int getLevel(const std::string &componentName) const;
+
+private:
+    std::mutex m_mutex;
+    int m_defaultLevel;
+    std::unordered_map<std::string, int> m_configuredLevels;
+    std::unordered_map<std::string, uint32_t> m_componentIds;
+    std::array<std::atomic<int>, kMaxComponents> m_levels;
+};
+
+/**
+ * Text log file (<RIALTO_LOG_PATH>.ocdm). Lines are appended to an in-memory buffer and written in batches by a
+ * writer thread, which also rotates the file once it reaches RIALTO_LOG_MAX_SIZE bytes, keeping at most
+ * RIALTO_LOG_MAX_FILES files (<path>.ocdm, <path>.ocdm.1, ...). Producers never wait for file I/O - if the writer
+ * falls behind, lines are dropped and the number of dropped lines is reported in the log. Error and fatal lines wake
+ * the writer, which writes and syncs them without waiting for the flush interval.
+ */
 class LogFile
 {
 public:
     static LogFile &instance();
-    bool write(const std::string &line);
+    bool write(std::string_view line, const Severity &severity);
     bool isEnabled() const;
     void reset();
 
@@ -49,38 +97,178 @@ private:
 
     void tryOpenFile();
     void tryCloseFile();
+    void writerLoop();
+    void writeToFile(const std::string &data);
+    void writeAll(const char *data, size_t size);
+    void rotate();
 
 private:
-    std::fstream m_file;
-    std::mutex m_mutex;
+    ProfiledMutex m_mutex{"LogFile"};
+    ProfiledConditionVariable m_cv;
+    std::thread m_writerThread;
+    std::atomic<bool> m_isEnabled;
+    bool m_isRunning;
+    std::string m_buffer;
+    uint64_t m_droppedLines;
+    bool m_isFlushRequested;
+
+    // Owned by the writer thread while it is running
+    int m_fd;
+    std::string m_path;
+    uint64_t m_maxFileSize;
+    uint32_t m_maxFiles;
+    uint64_t m_fileSize;
+    std::string m_writeBuffer;
+};
+
+class LogRateLimiter;
+struct RateLimitedSeverity
+{
+    Severity severity;
+    LogRateLimiter &limiter;
+};
+
+/**
+ * Token bucket limiting how often a single call site may log. Up to `burst` messages pass immediately, after that
+ * messages are let through at `messagesPerSecond`. Dropped messages are counted and reported in a summary line once
+ * the bucket refills - before the next message of the call site, or with the next other log line or log file flush
+ * when the call site stays quiet.
+ *
+ * Use through RIALTO_LOG_RATE_LIMITED, which creates one limiter per call site:
+ *     m_log << RIALTO_LOG_RATE_LIMITED(debug) << "Message logged once per buffer";
+ */
+class LogRateLimiter
+{
+public:
+    static constexpr uint32_t kDefaultBurst{5};
+    static constexpr uint32_t kDefaultMessagesPerSecond{1};
+
+    LogRateLimiter(uint32_t burst, uint32_t messagesPerSecond);
+    ~LogRateLimiter();
+    RateLimitedSeverity operator()(const Severity &severity) { return RateLimitedSeverity{severity, *this}; }
+    bool tryAcquire(uint32_t &suppressedMessages);
+    void suppress(const std::string &componentName, const Severity &severity);
+
+    /**
+     * Writes the summary line of every call site that dropped messages and whose bucket has refilled since.
+     */
+    static void reportSuppressedMessages();
+
+private:
+    bool hasToken(int64_t nowNs) const;
+
+private:
+    const int64_t m_emissionIntervalNs;
+    const int64_t m_burstToleranceNs;
+    std::atomic<int64_t> m_theoreticalArrivalNs;
+    std::atomic<uint32_t> m_suppressedMessages;
+
+    // Guarded by the mutex of the pending limiters list
+    std::string m_componentName;
+    Severity m_severity;
+    bool m_isPending;
 };
 
+#define RIALTO_LOG_RATE_LIMITED_WITH(severity, burst, messagesPerSecond)                                               \
+    ([]() -> LogRateLimiter & {                                                                                        \
+        static LogRateLimiter limiter{burst, messagesPerSecond};                                                       \
+        return limiter;                                                                                                \
+    }()(severity))
+
+#define RIALTO_LOG_RATE_LIMITED(severity)                                                                              \
+    RIALTO_LOG_RATE_LIMITED_WITH(severity, LogRateLimiter::kDefaultBurst, LogRateLimiter::kDefaultMessagesPerSecond)
+
 class Logger;
 class Flusher
 {
 public:
-    Flusher(std::stringstream &stream, const std::string &componentName, const Severity &severity);
+    Flusher(std::stringstream &stream, const std::string &componentName, const Severity &severity,
+            bool isSuppressed = false);
     ~Flusher();
 
     template <typename T> Flusher &operator<<(const T &text)
     {
-        m_stream << text;
+        if (m_isSuppressed)
+        {
+            return *this;
+        }
+        if (m_isBinary)
+        {
+            m_record.add(text);
+        }
+        else
+        {
+            m_stream << text;
+        }
         return *this;
     }
 
 private:
     std::stringstream &m_stream;
+    const std::string &m_componentName;
     Severity m_severity;
+    bool m_isSuppressed;
+    bool m_isBinary;
+    BinaryLogRecord m_record;
 };
 
+/**
+ * Marks a string literal as static text of a 'm_log << severity' statement, so that the binary log stores it by
+ * address instead of copying it into every record:
+ *     m_log << info << RIALTO_LOG_LITERAL("Session created, id: ") << sessionId;
+ */
+#define RIALTO_LOG_LITERAL(text) (LogLiteral{"" text ""})
+
+/**
+ * Formats a log line into a stack buffer, without heap allocations. The format string uses "{}" placeholders and
+ * is checked against the number of arguments at compile time. Arguments are not evaluated when the message is
+ * filtered out.
+ *     RIALTO_LOG_FMT(m_log, debug, "Session {} created, status {}", sessionId, status);
+ */
+#define RIALTO_LOG_FMT(logger, severity, format, ...)                                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if ((logger).isEnabled(severity))                                                                              \
+        {                                                                                                              \
+            (logger).log<logformat::countPlaceholders(format)>(severity, format, ##__VA_ARGS__);                       \
+        }                                                                                                              \
+    } while (0)
+
 class Logger
 {
 public:
     explicit Logger(const std::string &componentName);
     Flusher operator<<(const Severity &) const;
+    Flusher operator<<(const RateLimitedSeverity &) const;
+
+    bool isEnabled(const Severity &severity) const { return LogLevels::instance().isEnabled(m_componentId, severity); }
+
+    template <size_t kPlaceholders, typename... Args>
+    void log(const Severity &severity, const char *format, const Args &...args) const
+    {
+        static_assert(kPlaceholders != logformat::kInvalidFormat, "Unmatched brace in log format string");
+        static_assert(kPlaceholders == sizeof...(Args), "Number of {} placeholders does not match arguments");
+        if (BinaryLogFile::instance().isEnabled())
+        {
+            BinaryLogRecord record;
+            record.setFormat(format);
+            (record.add(logformat::asArgument(args)), ...);
+            BinaryLogFile::instance().write(m_componentName, static_cast<uint8_t>(severity), record);
+            return;
+        }
+        logformat::LogBuffer buffer;
+        writePrefix(buffer, severity);
+        logformat::formatTo(buffer, format, args...);
+        writeLine(buffer, severity);
+    }
+
+private:
+    void writePrefix(logformat::LogBuffer &buffer, const Severity &severity) const;
+    void writeLine(logformat::LogBuffer &buffer, const Severity &severity) const;
 
 private:
     const std::string m_componentName;
+    const uint32_t m_componentId;
     mutable std::stringstream m_stream;
 };
 
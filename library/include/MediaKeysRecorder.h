@@ -0,0 +1,119 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_KEYS_RECORDER_H_
+#define MEDIA_KEYS_RECORDER_H_
+
+#include "LatencyStats.h"
+#include "MediaKeysRecordingFormat.h"
+#include <ControlCommon.h>
+#include <MediaCommon.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * Records the Rialto MediaKeys traffic of the process - IMediaKeys calls made by CdmBackend, the notifications
+ * passed through MessageDispatcher and application state changes - with their timing and payload sizes, in the
+ * format described in MediaKeysRecordingFormat.h. Enabled when RIALTO_RECORD_PATH is set, or at runtime with
+ * opencdm_ext_start_recording(). When disabled, a record point costs one relaxed atomic load.
+ *
+ * Records are buffered in memory and written in blocks, so the file is complete only after the recording stopped.
+ */
+class MediaKeysRecorder
+{
+public:
+    static MediaKeysRecorder &instance();
+    bool isEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); }
+
+    bool start(const std::string &path);
+    void stop();
+    void reset();
+
+    void recordCall(CdmOperation operation, int32_t keySessionId, uint64_t startNs, uint64_t durationNs,
+                    int32_t status, uint32_t payloadSize, uint32_t extra);
+    void recordCreateMediaKeys(const std::string &keySystem, uint64_t startNs, uint64_t durationNs, bool isCreated);
+    void recordLicenseRequest(int32_t keySessionId, uint32_t messageSize, uint32_t urlLength);
+    void recordLicenseRenewal(int32_t keySessionId, uint32_t messageSize);
+    void recordKeyStatusesChanged(int32_t keySessionId, const firebolt::rialto::KeyStatusVector &keyStatuses);
+    void recordApplicationState(firebolt::rialto::ApplicationState state);
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+private:
+    MediaKeysRecorder();
+    ~MediaKeysRecorder();
+
+    void addRecord(mediakeysrecording::Record record, const void *data = nullptr);
+    void flush();
+
+private:
+    std::mutex m_mutex;
+    std::atomic<bool> m_isEnabled;
+    int m_fd;
+    uint64_t m_startNs;
+    std::string m_buffer;
+};
+
+/**
+ * Records one IMediaKeys call made in the scope. The call is timed from construction until the status is set.
+ * Does nothing when recording is disabled at construction.
+ *     RecordedCall call{CdmOperation::UPDATE_SESSION, keySessionId, responseData.size()};
+ *     return checkStatus(CdmOperation::UPDATE_SESSION, call.setStatus(m_mediaKeys->updateSession(...)));
+ */
+class RecordedCall
+{
+public:
+    RecordedCall(CdmOperation operation, int32_t keySessionId, size_t payloadSize = 0, uint32_t extra = 0)
+        : m_operation{operation}, m_start{MediaKeysRecorder::instance().isEnabled() ? MediaKeysRecorder::now() : 0},
+          m_keySessionId{keySessionId}, m_payloadSize{static_cast<uint32_t>(payloadSize)}, m_extra{extra}
+    {
+    }
+    RecordedCall(const RecordedCall &) = delete;
+    RecordedCall &operator=(const RecordedCall &) = delete;
+
+    template <typename Status> Status setStatus(Status status)
+    {
+        if (0 != m_start)
+        {
+            MediaKeysRecorder::instance().recordCall(m_operation, m_keySessionId, m_start,
+                                                     MediaKeysRecorder::now() - m_start, static_cast<int32_t>(status),
+                                                     m_payloadSize, m_extra);
+        }
+        return status;
+    }
+
+    void setKeySessionId(int32_t keySessionId) { m_keySessionId = keySessionId; }
+
+private:
+    const CdmOperation m_operation;
+    const uint64_t m_start;
+    int32_t m_keySessionId;
+    const uint32_t m_payloadSize;
+    const uint32_t m_extra;
+};
+
+#endif // MEDIA_KEYS_RECORDER_H_
@@ -0,0 +1,78 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIAKEYSRECORDING_MEDIA_KEYS_RECORDING_FORMAT_H_
+#define MEDIAKEYSRECORDING_MEDIA_KEYS_RECORDING_FORMAT_H_
+
+#include <cstdint>
+
+/**
+ * On-disk layout of the MediaKeys traffic recording written when RIALTO_RECORD_PATH is set.
+ *
+ * The file starts with a RecordingFileHeader followed by a stream of Records, each optionally followed by
+ * `dataSize` bytes of data. Message contents are never stored - license requests, renewals and license responses
+ * are recorded by size only. All values are stored in host byte order.
+ */
+namespace mediakeysrecording
+{
+constexpr char kMagic[8]{'R', 'O', 'C', 'D', 'M', 'R', 'E', 'C'};
+constexpr uint32_t kVersion{1};
+
+#pragma pack(push, 1)
+
+struct RecordingFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+};
+
+enum RecordType : uint16_t
+{
+    kCall = 1,                // IMediaKeys call made by CdmBackend
+    kLicenseRequest = 2,      // IMediaKeysClient::onLicenseRequest
+    kLicenseRenewal = 3,      // IMediaKeysClient::onLicenseRenewal
+    kKeyStatusesChanged = 4,  // IMediaKeysClient::onKeyStatusesChanged, data holds one KeyStatus byte per key
+    kApplicationState = 5,    // IControlClient::notifyApplicationState
+    kCreateMediaKeys = 6      // IMediaKeysFactory::createMediaKeys, data holds the key system
+};
+
+struct Record
+{
+    uint64_t timestampNs; // Time since the start of the recording
+    uint64_t durationNs;  // Duration of the call, 0 for notifications
+    int32_t keySessionId;
+    uint32_t payloadSize; // Size of the message, license or init data passed with the call
+    uint32_t dataSize;    // Size of the data following this record
+    uint16_t type;
+    uint16_t operation; // CdmOperation of kCall records
+    int32_t status;     // MediaKeyErrorStatus, or the result of containsKey / createMediaKeys
+    uint32_t extra;     // Operation specific, see below
+};
+
+#pragma pack(pop)
+
+// Record::extra of createKeySession calls holds the KeySessionType and the LDL flag
+constexpr uint32_t kLdlFlag{0x100};
+
+// Record::extra of generateRequest calls holds the InitDataType, of license requests the length of the URL and of
+// application state records the ApplicationState.
+} // namespace mediakeysrecording
+
+#endif // MEDIAKEYSRECORDING_MEDIA_KEYS_RECORDING_FORMAT_H_
@@ -21,43 +21,46 @@
 #define MESSAGE_DISPATCHER_H_
 
 #include "IMessageDispatcher.h"
+#include "LockProfiler.h"
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
 #include <vector>
 
-class MessageDispatcher : public IMessageDispatcher, public firebolt::rialto::IMediaKeysClient
+class MessageDispatcher : public IMessageDispatcher, public IMessageDispatcherListener
 {
     class MessageDispatcherClient : public IMessageDispatcherClient
     {
     public:
-        MessageDispatcherClient(MessageDispatcher &dispatcher, firebolt::rialto::IMediaKeysClient *client);
+        MessageDispatcherClient(MessageDispatcher &dispatcher, IMessageDispatcherListener *client);
         ~MessageDispatcherClient() override;
 
     private:
         MessageDispatcher &m_dispatcher;
-        firebolt::rialto::IMediaKeysClient *m_client;
+        IMessageDispatcherListener *m_client;
     };
 
 public:
     MessageDispatcher() = default;
     ~MessageDispatcher() override = default;
 
-    std::unique_ptr<IMessageDispatcherClient> createClient(firebolt::rialto::IMediaKeysClient *client) override;
+    std::unique_ptr<IMessageDispatcherClient> createClient(IMessageDispatcherListener *client) override;
 
     void onLicenseRequest(int32_t keySessionId, const std::vector<unsigned char> &licenseRequestMessage,
                           const std::string &url) override;
     void onLicenseRenewal(int32_t keySessionId, const std::vector<unsigned char> &licenseRenewalMessage) override;
     void onKeyStatusesChanged(int32_t keySessionId, const firebolt::rialto::KeyStatusVector &keyStatuses) override;
+    void onKeySessionIdsChanged(const std::map<int32_t, int32_t> &newKeySessionIds) override;
 
 private:
-    void addClient(firebolt::rialto::IMediaKeysClient *client);
-    void removeClient(firebolt::rialto::IMediaKeysClient *client);
+    void addClient(IMessageDispatcherListener *client);
+    void removeClient(IMessageDispatcherListener *client);
 
 private:
-    std::mutex m_mutex;
-    std::set<firebolt::rialto::IMediaKeysClient *> m_clients;
+    ProfiledMutex m_mutex{"MessageDispatcher"};
+    std::set<IMessageDispatcherListener *> m_clients;
 };
 
 #endif // MESSAGE_DISPATCHER_H_
@@ -0,0 +1,114 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "LatencyStats.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class MetricId : uint32_t
+{
+    ACTIVE_SESSIONS,
+    DISPATCHER_CLIENTS,
+    DECRYPT_CALLS,
+    KEY_STATUS_UPDATES,
+    CHALLENGE_WAITS,
+    CHALLENGE_WAIT_TIME_US,
+    CHALLENGE_TIMEOUTS,
+    CHALLENGE_CANCELLATIONS,
+    APP_STATE_TRANSITIONS,
+    PENDING_KEY_SESSIONS,
+    RESTORED_KEY_SESSIONS,
+    LOST_KEY_SESSIONS,
+    POOLED_KEY_SESSIONS,
+    KEY_SESSION_POOL_HITS,
+    KEY_SESSION_POOL_MISSES,
+    LDL_ADMISSION_WAITS,
+    LDL_ADMISSION_TIMEOUTS,
+    SCHEDULER_STARVATION_GRANTS,
+    SHARED_SESSION_ATTACHES,
+    COUNT
+};
+
+struct MetricSample
+{
+    const char *name;
+    const char *help;
+    bool isGauge;
+    std::string labels;
+    uint64_t value;
+};
+
+/**
+ * Process wide counters and gauges describing DRM health. Updates are relaxed atomic additions, so they can be done
+ * on any path, including decryption.
+ *
+ * When RIALTO_METRICS_PATH is set, the metrics are written to that file in Prometheus text exposition format every
+ * RIALTO_METRICS_INTERVAL seconds (10 by default), e.g. for the node exporter textfile collector.
+ */
+class Metrics
+{
+public:
+    static Metrics &instance();
+
+    void add(MetricId id, int64_t delta = 1)
+    {
+        m_values[static_cast<size_t>(id)].fetch_add(delta, std::memory_order_relaxed);
+    }
+    void addIpcFailure(CdmOperation operation)
+    {
+        m_ipcFailures[static_cast<size_t>(operation)].fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t get(MetricId id) const;
+    uint64_t getIpcFailures(CdmOperation operation) const;
+
+    std::vector<MetricSample> collect() const;
+    bool writePrometheus(const std::string &path) const;
+    void reset();
+
+private:
+    Metrics();
+    ~Metrics();
+
+    void startWriter();
+    void stopWriter();
+    void writerLoop();
+
+private:
+    std::array<std::atomic<int64_t>, static_cast<size_t>(MetricId::COUNT)> m_values{};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(CdmOperation::COUNT)> m_ipcFailures{};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_writerThread;
+    bool m_isRunning;
+    std::string m_path;
+    std::chrono::seconds m_interval;
+};
+
+#endif // METRICS_H_
@@ -20,7 +20,10 @@
 #ifndef OPENCDM_SESSION_H_
 #define OPENCDM_SESSION_H_
 
+#include "SessionPriority.h"
 #include <MediaCommon.h>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <opencdm/open_cdm.h>
 #include <stdint.h>
@@ -33,6 +36,17 @@ struct _GstBuffer;
 typedef struct _GstCaps GstCaps;
 typedef struct _GstBuffer GstBuffer;
 
+/**
+ * Memory held by a session for its payloads, in bytes. sessionBytes is the size of the session object itself.
+ */
+struct SessionMemoryUsage
+{
+    size_t sessionBytes{0};
+    size_t initDataBytes{0};
+    size_t challengeBytes{0};
+    size_t keyIdBytes{0};
+};
+
 class OpenCDMSession
 {
 public:
@@ -51,6 +65,9 @@ public:
     virtual bool loadSession() = 0;
     virtual bool updateSession(const std::vector<uint8_t> &license) = 0;
     virtual bool getChallengeData(std::vector<uint8_t> &challengeData) = 0;
+    virtual void cancelChallengeData() = 0;
+    virtual void startSpeculativeRequest() = 0;
+    virtual void setPriority(SessionPriority priority) = 0;
     virtual bool containsKey(const std::vector<uint8_t> &keyId) = 0;
     virtual bool setDrmHeader(const std::vector<uint8_t> &drmHeader) = 0;
     virtual bool selectKeyId(const std::vector<uint8_t> &keyId) = 0;
@@ -59,10 +76,13 @@ public:
     virtual bool addProtectionMeta(GstBuffer *buffer) = 0;
     virtual bool closeSession() = 0;
     virtual bool removeSession() = 0;
-    virtual KeyStatus status(const std::vector<uint8_t> &key) const = 0;
+    virtual KeyStatus status(const uint8_t keyId[], uint8_t length) const = 0;
+    virtual KeyStatus waitForKey(const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout) = 0;
 
     virtual const std::string &getSessionId() const = 0;
     virtual uint32_t getLastDrmError() const = 0;
+    virtual uint64_t getDecryptCalls() const = 0;
+    virtual SessionMemoryUsage getMemoryUsage() = 0;
 };
 
 #endif // OPENCDM_SESSION_H_
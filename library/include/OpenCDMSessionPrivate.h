@@ -21,12 +21,16 @@
 #define OPENCDM_SESSION_PRIVATE_H_
 
 #include "IMediaKeysClient.h"
+#include "LockProfiler.h"
 #include "Logger.h"
 #include "OpenCDMSession.h"
 #include <ICdmBackend.h>
 #include <IMessageDispatcher.h>
 #include <MediaCommon.h>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -39,27 +43,39 @@ struct _GstBuffer;
 typedef struct _GstCaps GstCaps;
 typedef struct _GstBuffer GstBuffer;
 
-class OpenCDMSessionPrivate : public OpenCDMSession, public firebolt::rialto::IMediaKeysClient
+class OpenCDMSessionPrivate : public OpenCDMSession, public IMessageDispatcherListener
 {
 public:
     OpenCDMSessionPrivate(const std::shared_ptr<ICdmBackend> &cdm,
                           const std::shared_ptr<IMessageDispatcher> &messageDispatcher, const LicenseType &sessionType,
                           OpenCDMSessionCallbacks *callbacks, void *context, const std::string &initDataType,
-                          const std::vector<uint8_t> &initData);
+                          std::vector<uint8_t> initData);
     ~OpenCDMSessionPrivate();
 
     void onLicenseRequest(int32_t keySessionId, const std::vector<unsigned char> &licenseRequestMessage,
                           const std::string &url) override;
     void onLicenseRenewal(int32_t keySessionId, const std::vector<unsigned char> &licenseRenewalMessage) override;
     void onKeyStatusesChanged(int32_t keySessionId, const firebolt::rialto::KeyStatusVector &keyStatuses) override;
+    void onKeySessionIdsChanged(const std::map<int32_t, int32_t> &newKeySessionIds) override;
 
     bool initialize() override;
     bool initialize(bool) override;
+    /**
+     * Empty initData generates the request from the init data the session was created with.
+     */
     bool generateRequest(const std::string &initDataType, const std::vector<uint8_t> &initData,
                          const std::vector<uint8_t> &cdmData) override;
     bool loadSession() override;
     bool updateSession(const std::vector<uint8_t> &license) override;
+    /**
+     * The init data and the challenge are kept until the license has been applied or the session is closed, so that
+     * repeated calls return the same challenge without generating another request. Sessions with attached sessions
+     * keep both for them.
+     */
     bool getChallengeData(std::vector<uint8_t> &challengeData) override;
+    void cancelChallengeData() override;
+    void startSpeculativeRequest() override;
+    void setPriority(SessionPriority priority) override;
     bool containsKey(const std::vector<uint8_t> &keyId) override;
     bool setDrmHeader(const std::vector<uint8_t> &drmHeader) override;
     bool selectKeyId(const std::vector<uint8_t> &keyId) override;
@@ -68,33 +84,122 @@ public:
     bool addProtectionMeta(GstBuffer *buffer) override;
     bool closeSession() override;
     bool removeSession() override;
-    KeyStatus status(const std::vector<uint8_t> &key) const override;
+    /**
+     * Key IDs parsed from the init data are reported as StatusPending until the license sets their status, so that
+     * the session is found by key ID (see ActiveSessions::get) as soon as it is constructed.
+     */
+    KeyStatus status(const uint8_t keyId[], uint8_t length) const override;
+    /**
+     * Waits up to timeout for a StatusPending key to get a status from the license, and returns the key's status.
+     * Returns at once for other keys. The wait also ends when the session is closed.
+     */
+    KeyStatus waitForKey(const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout) override;
 
     const std::string &getSessionId() const override;
     uint32_t getLastDrmError() const override;
+    uint64_t getDecryptCalls() const override;
+    SessionMemoryUsage getMemoryUsage() override;
+
+    /**
+     * Time getChallengeData waits for the license request after generating it, for all sessions. Initialised from
+     * RIALTO_CHALLENGE_TIMEOUT_MS (10 s when not set). Zero waits without a deadline.
+     */
+    static void setChallengeTimeout(std::chrono::milliseconds timeout);
+    static std::chrono::milliseconds getChallengeTimeout();
+
+    /**
+     * Whether opencdm_construct_session starts creating the key session and generating the challenge of PlayReady
+     * sessions in the background, rather than leaving both to opencdm_session_get_challenge_data. Initialised from
+     * RIALTO_SPECULATIVE_CHALLENGE (disabled when not set).
+     */
+    static void setSpeculativeChallengeEnabled(bool isEnabled);
+    static bool isSpeculativeChallengeEnabled();
+
+    /**
+     * Sessions sharing this session's key session (see ActiveSessions). An attached session gets the callbacks of this
+     * session, called with the attached session as the session. addAttachedSession always attaches,
+     * attachSession only once a license request has been generated from the same init data, as sessions attached
+     * later rely on it. The init data is kept for the comparison while sessions are attached. Once attached,
+     * notifyAttachedSession passes the current challenge, or the key statuses when the license has been applied
+     * already, to the session's callbacks.
+     */
+    void addAttachedSession(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks, void *context);
+    bool attachSession(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks, void *context,
+                       const std::vector<uint8_t> &initData);
+    void notifyAttachedSession(OpenCDMSession *session);
+    /**
+     * Returns whether other sessions are still attached.
+     */
+    bool detachSession(OpenCDMSession *session);
+    /**
+     * Whether session is the oldest of the attached sessions.
+     */
+    bool isFirstAttachedSession(const OpenCDMSession *session);
+    size_t getAttachedSessionCount();
+    /**
+     * Closes the key session for the given attached session, the key session is closed once the last attached
+     * session is closed.
+     */
+    bool closeSession(OpenCDMSession *session);
+    bool waitForChallenge(std::vector<uint8_t> &challengeData);
+    /**
+     * Clears cancelChallengeData for an attached session asking for the challenge, as getChallengeData does.
+     */
+    void resetChallengeCancellation();
 
 private:
+    struct AttachedSession
+    {
+        OpenCDMSession *session;
+        OpenCDMSessionCallbacks *callbacks;
+        void *context;
+    };
+
+    bool initializeKeySession(bool isLDL);
+    bool createKeySession(bool isLDL, int32_t &keySessionId);
+    bool requestChallenge();
+    void collectSpeculativeRequest();
+    void discardSpeculativeSession();
     void initializeCdmKeySessionId();
-    void updateChallenge(const std::vector<unsigned char> &challenge);
+    void updateChallenge(const std::vector<unsigned char> &challenge, const std::string &url);
+    void addExpectedKeyIds(firebolt::rialto::InitDataType initDataType, const std::vector<uint8_t> &initData);
+    KeyStatus getKeyStatus(const uint8_t keyId[], uint8_t length) const;
+    std::vector<AttachedSession> getAttachedSessions();
+    void countDecrypt();
+    GstBuffer *getPlayreadyKeyId();
 
 private:
     Logger m_log;
-    std::mutex m_mutex;
-    std::condition_variable m_challengeCv;
+    mutable ProfiledMutex m_mutex{"OpenCDMSessionPrivate"};
+    ProfiledConditionVariable m_challengeCv;
+    ProfiledConditionVariable m_keyStatusCv;
     void *m_context;
     std::shared_ptr<ICdmBackend> m_cdmBackend;
     std::shared_ptr<IMessageDispatcher> m_messageDispatcher;
     std::unique_ptr<IMessageDispatcherClient> m_messageDispatcherClient;
-    int32_t m_rialtoSessionId;
+    // Written by the speculative request and key session restore notifications, read once per call
+    std::atomic<int32_t> m_rialtoSessionId;
     std::string m_cdmKeySessionId;
     OpenCDMSessionCallbacks *m_callbacks;
     firebolt::rialto::KeySessionType m_sessionType;
     firebolt::rialto::InitDataType m_initDataType;
     std::vector<uint8_t> m_initData;
     bool m_isInitialized;
+    std::atomic<uint64_t> m_decryptCalls;
     std::vector<uint8_t> m_challengeData;
-    std::vector<uint8_t> m_playreadyKeyId;
+    std::string m_challengeUrl;
+    bool m_hasRequest;
+    std::vector<AttachedSession> m_attachedSessions;
+    bool m_isChallengeCancelled;
+    GstBuffer *m_playreadyKeyId;
+    // Runs initializeKeySession and requestChallenge. Public calls using the key session collect it first, so the
+    // fields these write are only read once the request has completed.
+    std::future<bool> m_speculativeRequest;
+    bool m_isSpeculativeSession;
+    bool m_isRequestGenerated;
+    std::atomic<SessionPriority> m_priority;
     std::map<std::vector<unsigned char>, firebolt::rialto::KeyStatus> m_keyStatuses;
+    std::vector<std::vector<uint8_t>> m_expectedKeyIds;
 
     firebolt::rialto::KeySessionType getRialtoSessionType(const LicenseType licenseType);
     firebolt::rialto::InitDataType getRialtoInitDataType(const std::string &type);
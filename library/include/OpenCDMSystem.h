@@ -39,7 +39,7 @@ struct OpenCDMSystem
     virtual const std::string &metadata() const = 0;
     virtual OpenCDMSession *createSession(const LicenseType licenseType, OpenCDMSessionCallbacks *callbacks,
                                           void *userData, const std::string &initDataType,
-                                          const std::vector<uint8_t> &initData) const = 0;
+                                          std::vector<uint8_t> initData) const = 0;
     virtual bool getDrmTime(uint64_t &drmTime) const = 0;
     virtual bool getLdlSessionsLimit(uint32_t &ldlLimit) const = 0;
     virtual bool getKeyStoreHash(std::vector<unsigned char> &keyStoreHash) const = 0;
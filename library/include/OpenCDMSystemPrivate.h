@@ -45,7 +45,7 @@ public:
     const std::string &keySystem() const;
     const std::string &metadata() const;
     OpenCDMSession *createSession(const LicenseType licenseType, OpenCDMSessionCallbacks *callbacks, void *userData,
-                                  const std::string &initDataType, const std::vector<uint8_t> &initData) const;
+                                  const std::string &initDataType, std::vector<uint8_t> initData) const;
     bool getDrmTime(uint64_t &drmTime) const;
     bool getLdlSessionsLimit(uint32_t &ldlLimit) const;
     bool getKeyStoreHash(std::vector<unsigned char> &keyStoreHash) const;
@@ -0,0 +1,220 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OPEN_CDM_RIALTO_EXT_H_
+#define OPEN_CDM_RIALTO_EXT_H_
+
+#include <opencdm/open_cdm.h>
+#include <stdint.h>
+
+/**
+ * Extensions of the OpenCDM API specific to the Rialto implementation.
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Importance of a session's work, see opencdm_ext_session_set_priority.
+ */
+typedef enum
+{
+    OPENCDM_SESSION_PRIORITY_FOREGROUND = 0,
+    OPENCDM_SESSION_PRIORITY_PREFETCH = 1,
+    OPENCDM_SESSION_PRIORITY_BACKGROUND = 2
+} OpenCDMSessionPriority;
+
+/**
+ * Latency distribution of one CdmBackend operation, in nanoseconds. Percentiles are accurate to within 25%.
+ */
+typedef struct
+{
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t p50Ns;
+    uint64_t p90Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+} OpenCDMLatencyStats;
+
+/**
+ * Returns the name of the index-th measured operation (e.g. "createKeySession"), NULL when index is out of range.
+ */
+// NOLINTNEXTLINE(build/function_format)
+const char *opencdm_ext_get_latency_operation(uint32_t index);
+
+/**
+ * Gets the latency of an operation since the process started, split into the time spent waiting for the backend
+ * lock and the time of the call itself (mostly Rialto IPC). Either output may be NULL.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_get_latency_stats(const char operation[], OpenCDMLatencyStats *callTime,
+                                           OpenCDMLatencyStats *lockWait);
+
+/**
+ * Gets the latency of all operations on sessions of the given priority, with system calls counted as foreground.
+ * The lock wait includes the time spent behind higher priority calls. Either output may be NULL.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_get_priority_latency_stats(OpenCDMSessionPriority priority, OpenCDMLatencyStats *callTime,
+                                                    OpenCDMLatencyStats *lockWait);
+
+/**
+ * Starts writing a Chrome trace-event JSON trace of the session lifecycle to the given file, replacing any trace in
+ * progress. Tracing can also be enabled at startup with RIALTO_TRACE_PATH.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_start_tracing(const char path[]);
+
+/**
+ * Stops tracing and completes the trace file.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_stop_tracing();
+
+/**
+ * One counter or gauge value. name is a Prometheus metric name, e.g. "ocdm_ipc_failures_total", and labels holds its
+ * label set, e.g. method="createKeySession", or is empty.
+ */
+typedef struct
+{
+    const char *name;
+    char labels[64];
+    uint64_t value;
+} OpenCDMMetric;
+
+/**
+ * Gets a snapshot of the runtime metrics. *count holds the capacity of metrics on input and the number of metrics on
+ * output. Returns ERROR_BUFFER_TOO_SMALL, with the required capacity in *count, when the array is too small.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_get_metrics(OpenCDMMetric metrics[], uint32_t *count);
+
+/**
+ * Writes the runtime metrics to a file in Prometheus text exposition format. Metrics can also be written periodically
+ * by setting RIALTO_METRICS_PATH.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_write_metrics(const char path[]);
+
+/**
+ * Starts recording the Rialto MediaKeys traffic (calls, notifications, timing and payload sizes - not their contents)
+ * to the given file, replacing any recording in progress. The recording can be replayed against the fake Rialto
+ * client with RialtoOcdmReplay. Recording can also be enabled at startup with RIALTO_RECORD_PATH.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_start_recording(const char path[]);
+
+/**
+ * Stops recording and writes the remaining records to the file.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_stop_recording();
+
+/**
+ * Writes the acquisition count, wait and hold times of the library mutexes to the given file, or to stderr when path
+ * is NULL. Only available in builds with RIALTO_ENABLE_LOCK_PROFILING, returns ERROR_METHOD_NOT_IMPLEMENTED
+ * otherwise. Profiling builds also write the profile at process exit, to RIALTO_LOCK_PROFILE_PATH or stderr.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_dump_lock_profile(const char path[]);
+
+/**
+ * Sets how long opencdm_session_get_challenge_data waits for Rialto to deliver the license request before failing,
+ * for all sessions. 0 waits without a deadline. The default is 10 s, or RIALTO_CHALLENGE_TIMEOUT_MS when set. A
+ * waiting call can also be ended early with opencdm_session_cancel_challenge_data.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_set_challenge_timeout(uint32_t timeoutMs);
+
+/**
+ * Enables (isEnabled != 0) or disables speculative challenge generation for PlayReady sessions constructed afterwards.
+ * When enabled, opencdm_construct_session starts creating the key session and generating the license request in the
+ * background, and opencdm_session_get_challenge_data collects the result. process_challenge_callback may then be
+ * called before opencdm_session_get_challenge_data. An LDL request replaces the speculatively created session. Also
+ * enabled at startup by setting RIALTO_SPECULATIVE_CHALLENGE.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_set_speculative_challenge(uint32_t isEnabled);
+
+/**
+ * Enables (isEnabled != 0) or disables sharing of key sessions between sessions constructed afterwards. A session
+ * constructed with the key system, license type and init data of a session whose license request has already been
+ * generated then uses that session's key session: it gets the challenge, or the key statuses once the license is
+ * applied, through its own callbacks, and does not generate a request of its own. The key session is closed with the
+ * last session using it. Also enabled by setting RIALTO_SHARED_SESSIONS.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_set_session_sharing(uint32_t isEnabled);
+
+/**
+ * Sets how many TEMPORARY, non-LDL key sessions each key system keeps created in advance, so that constructing a
+ * session does not wait for Rialto to create its key session. Used sessions are replaced in the background and unused
+ * ones are closed with the system. Applies to systems reaching RUNNING afterwards. 0 disables the pool. Also set at
+ * startup with RIALTO_KEY_SESSION_POOL_SIZE.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_set_key_session_pool_size(uint32_t size);
+
+/**
+ * Tags a session as serving the content being played (the default), content prefetched for later or background
+ * work such as license renewal. Calls on the session's key session wait behind calls of higher priority sessions,
+ * though a waiting call is never overtaken more than a few times in a row. When the platform's LDL sessions are all
+ * in use, opencdm_session_get_challenge_data with isLDL waits for one to be closed instead of failing, and higher
+ * priority sessions are given a free LDL session first.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_session_set_priority(struct OpenCDMSession *session, OpenCDMSessionPriority priority);
+
+/**
+ * Waits up to timeoutMs for a key of the session to leave StatusPending and returns its status in status. Key IDs
+ * found in the init data (CENC pssh boxes, WebM key IDs and PlayReady headers) are StatusPending from the moment the
+ * session is constructed, so a decryptor can get the session with opencdm_get_system_session right away and wait
+ * here for the license instead of polling opencdm_session_status. Returns at once for keys in other states, and when
+ * the session is closed.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_session_wait_for_key(struct OpenCDMSession *session, const uint8_t keyId[], uint8_t length,
+                                              uint32_t timeoutMs, KeyStatus *status);
+
+typedef struct
+{
+    uint64_t sessionBytes;
+    uint64_t initDataBytes;
+    uint64_t challengeBytes;
+    uint64_t keyIdBytes;
+} OpenCDMSessionMemoryUsage;
+
+/**
+ * Gets the memory held by a session, in bytes: the session object, its copy of the init data, the last license request
+ * and the key IDs with their statuses. Meant for debugging. The init data and the license request are released once the
+ * license has been applied with opencdm_session_update or the session is closed. Sessions sharing a key session report
+ * the memory of the shared session.
+ */
+// NOLINTNEXTLINE(build/function_format)
+OpenCDMError opencdm_ext_session_get_memory_usage(struct OpenCDMSession *session, OpenCDMSessionMemoryUsage *usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OPEN_CDM_RIALTO_EXT_H_
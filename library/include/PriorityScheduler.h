@@ -0,0 +1,82 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PRIORITY_SCHEDULER_H_
+#define PRIORITY_SCHEDULER_H_
+
+#include "LockProfiler.h"
+#include "SessionPriority.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+/**
+ * Orders CdmBackend operations by the priority of the session they are made for. One operation runs at a time; when
+ * it ends, the turn goes to the waiting operation of the highest priority, the earliest one within a priority. To
+ * prevent starvation, the longest waiting operation is served once kMaxOvertakes later operations have been served
+ * before it in a row.
+ *
+ * Also holds the priority of every key session, operations on unknown key sessions run at FOREGROUND priority.
+ */
+class PriorityScheduler
+{
+public:
+    static constexpr uint32_t kMaxOvertakes{8};
+
+    void acquire(SessionPriority priority);
+    void release();
+    size_t getWaitingCount();
+
+    void setPriority(int32_t keySessionId, SessionPriority priority);
+    SessionPriority getPriority(int32_t keySessionId);
+    void removePriority(int32_t keySessionId);
+
+private:
+    ProfiledMutex m_mutex{"PriorityScheduler"};
+    ProfiledConditionVariable m_cv;
+    std::set<std::pair<SessionPriority, uint64_t>> m_waiters;
+    std::map<int32_t, SessionPriority> m_priorities;
+    uint64_t m_nextTicket{0};
+    uint64_t m_grantedTicket{0};
+    bool m_isBusy{false};
+    uint32_t m_overtakes{0};
+};
+
+/**
+ * Waits for the scheduler's turn, then locks the mutex. Both are released on destruction or by unlock().
+ */
+class ScheduledLock
+{
+public:
+    ScheduledLock(PriorityScheduler &scheduler, SessionPriority priority, ProfiledMutex &mutex);
+    ~ScheduledLock();
+    ScheduledLock(const ScheduledLock &) = delete;
+    ScheduledLock &operator=(const ScheduledLock &) = delete;
+
+    void unlock();
+
+private:
+    PriorityScheduler &m_scheduler;
+    bool m_isScheduled;
+    ProfiledLock m_lock;
+};
+
+#endif // PRIORITY_SCHEDULER_H_
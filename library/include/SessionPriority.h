@@ -0,0 +1,52 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SESSION_PRIORITY_H_
+#define SESSION_PRIORITY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Importance of a session's work, set by the app with opencdm_ext_session_set_priority. Lower values are served first.
+ */
+enum class SessionPriority : uint8_t
+{
+    FOREGROUND,
+    PREFETCH,
+    BACKGROUND
+};
+
+constexpr size_t kSessionPriorityCount{3};
+
+inline const char *toString(SessionPriority priority)
+{
+    switch (priority)
+    {
+    case SessionPriority::FOREGROUND:
+        return "foreground";
+    case SessionPriority::PREFETCH:
+        return "prefetch";
+    case SessionPriority::BACKGROUND:
+        return "background";
+    }
+    return "unknown";
+}
+
+#endif // SESSION_PRIORITY_H_
@@ -0,0 +1,73 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHARED_SESSION_H_
+#define SHARED_SESSION_H_
+
+#include "OpenCDMSession.h"
+#include "OpenCDMSessionPrivate.h"
+#include <string>
+#include <vector>
+
+/**
+ * Session handed out by ActiveSessions when sessions with the same init data share one key session. Every app
+ * session gets its own SharedSession with its own callbacks, all of them forwarding to the OpenCDMSessionPrivate
+ * owning the key session. The first one (the owner) creates the key session and generates the license request, the
+ * ones attached later use the challenge and key statuses of the owner. The license is applied by the owner, or the
+ * oldest session left once it is closed, and removed only by the last session. The key session is closed with the
+ * last of them.
+ */
+class SharedSession : public OpenCDMSession
+{
+public:
+    SharedSession(OpenCDMSessionPrivate &session, bool isOwner);
+    ~SharedSession() override = default;
+
+    bool initialize() override;
+    bool initialize(bool isLDL) override;
+    bool generateRequest(const std::string &initDataType, const std::vector<uint8_t> &initData,
+                         const std::vector<uint8_t> &cdmData) override;
+    bool loadSession() override;
+    bool updateSession(const std::vector<uint8_t> &license) override;
+    bool getChallengeData(std::vector<uint8_t> &challengeData) override;
+    void cancelChallengeData() override;
+    void startSpeculativeRequest() override;
+    void setPriority(SessionPriority priority) override;
+    bool containsKey(const std::vector<uint8_t> &keyId) override;
+    bool setDrmHeader(const std::vector<uint8_t> &drmHeader) override;
+    bool selectKeyId(const std::vector<uint8_t> &keyId) override;
+    void addProtectionMeta(GstBuffer *buffer, GstBuffer *subSample, const uint32_t subSampleCount, GstBuffer *IV,
+                           GstBuffer *keyID, uint32_t initWithLast15) override;
+    bool addProtectionMeta(GstBuffer *buffer) override;
+    bool closeSession() override;
+    bool removeSession() override;
+    KeyStatus status(const uint8_t keyId[], uint8_t length) const override;
+    KeyStatus waitForKey(const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout) override;
+
+    const std::string &getSessionId() const override;
+    uint32_t getLastDrmError() const override;
+    uint64_t getDecryptCalls() const override;
+    SessionMemoryUsage getMemoryUsage() override;
+
+private:
+    OpenCDMSessionPrivate &m_session;
+    const bool m_isOwner;
+};
+
+#endif // SHARED_SESSION_H_
@@ -0,0 +1,161 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TraceEvent
+{
+    const char *name;
+    char phase;
+    uint64_t timestampNs;
+    uint64_t durationNs;
+    const void *session;
+    int32_t keySessionId;
+};
+
+/**
+ * Single producer, single consumer ring of trace events. The owning thread pushes without locking, the Tracer writer
+ * thread drains it. Events that do not fit are dropped and counted.
+ */
+class TraceBuffer
+{
+public:
+    static constexpr uint64_t kCapacity{2048};
+
+    explicit TraceBuffer(uint32_t threadId) : m_threadId{threadId} {}
+
+    void push(const TraceEvent &event);
+    template <typename Consumer> void drain(Consumer consumer)
+    {
+        uint64_t readIndex{m_readIndex.load(std::memory_order_relaxed)};
+        const uint64_t kWriteIndex{m_writeIndex.load(std::memory_order_acquire)};
+        for (; readIndex < kWriteIndex; ++readIndex)
+        {
+            consumer(m_events[readIndex % kCapacity]);
+        }
+        m_readIndex.store(readIndex, std::memory_order_release);
+    }
+
+    uint32_t threadId() const { return m_threadId; }
+    uint64_t takeDroppedEvents() { return m_droppedEvents.exchange(0, std::memory_order_relaxed); }
+    void setThreadFinished() { m_isThreadFinished = true; }
+    bool isThreadFinished() const { return m_isThreadFinished; }
+
+private:
+    const uint32_t m_threadId;
+    std::atomic<uint64_t> m_writeIndex{0};
+    std::atomic<uint64_t> m_readIndex{0};
+    std::atomic<uint64_t> m_droppedEvents{0};
+    std::atomic<bool> m_isThreadFinished{false};
+    std::array<TraceEvent, kCapacity> m_events;
+};
+
+/**
+ * Session lifecycle tracing in Chrome trace-event JSON format, which can be opened in chrome://tracing or Perfetto.
+ * Enabled when RIALTO_TRACE_PATH is set, or at runtime with opencdm_ext_start_tracing(). When disabled, a trace
+ * point costs one relaxed atomic load. Events are written to per-thread TraceBuffers and flushed to the file by a
+ * writer thread.
+ */
+class Tracer
+{
+public:
+    static Tracer &instance();
+    bool isEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); }
+
+    bool start(const std::string &path);
+    void stop();
+    void reset();
+
+    void addEvent(const TraceEvent &event);
+    void addInstantEvent(const char *name, const void *session, int32_t keySessionId);
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+    void registerBuffer(const std::shared_ptr<TraceBuffer> &buffer);
+
+private:
+    Tracer();
+    ~Tracer();
+
+    void writerLoop();
+    void writeEvents();
+    void writeAll(const std::string &data);
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_writerThread;
+    std::atomic<bool> m_isEnabled;
+    bool m_isRunning;
+    int m_fd;
+    bool m_isFirstEvent;
+    std::vector<std::shared_ptr<TraceBuffer>> m_buffers;
+    std::string m_output;
+};
+
+/**
+ * Traces the lifetime of a scope as a complete ("X") event. Does nothing when tracing is disabled at construction.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, const void *session = nullptr, int32_t keySessionId = -1)
+        : m_name{Tracer::instance().isEnabled() ? name : nullptr}, m_start{m_name ? Tracer::now() : 0},
+          m_session{session}, m_keySessionId{keySessionId}
+    {
+    }
+    ~TraceScope()
+    {
+        if (m_name)
+        {
+            Tracer::instance().addEvent(
+                TraceEvent{m_name, 'X', m_start, Tracer::now() - m_start, m_session, m_keySessionId});
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    void setSession(const void *session) { m_session = session; }
+    void setKeySessionId(int32_t keySessionId) { m_keySessionId = keySessionId; }
+
+private:
+    const char *const m_name;
+    const uint64_t m_start;
+    const void *m_session;
+    int32_t m_keySessionId;
+};
+
+#endif // TRACER_H_
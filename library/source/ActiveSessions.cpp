@@ -18,8 +18,35 @@
  */
 
 #include "ActiveSessions.h"
+#include "Metrics.h"
 #include "OpenCDMSessionPrivate.h"
+#include "SharedSession.h"
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <string_view>
+
+namespace
+{
+std::atomic<bool> &sessionSharingEnabled()
+{
+    static std::atomic<bool> isEnabled{nullptr != getenv("RIALTO_SHARED_SESSIONS")};
+    return isEnabled;
+}
+
+std::array<uint64_t, 3> getInitDataDigest(const std::vector<uint8_t> &initData)
+{
+    // FNV-1a next to std::hash, different init data matching both by accident is practically impossible
+    uint64_t fnvHash{14695981039346656037ULL};
+    for (const uint8_t kByte : initData)
+    {
+        fnvHash = (fnvHash ^ kByte) * 1099511628211ULL;
+    }
+    const std::string_view kData{reinterpret_cast<const char *>(initData.data()), initData.size()};
+    return {initData.size(), fnvHash, std::hash<std::string_view>{}(kData)};
+}
+} // namespace
 
 ActiveSessions &ActiveSessions::instance()
 {
@@ -27,24 +54,79 @@ ActiveSessions &ActiveSessions::instance()
     return activeSessions;
 }
 
-OpenCDMSession *ActiveSessions::create(const std::shared_ptr<ICdmBackend> &cdm,
+OpenCDMSession *ActiveSessions::create(const std::string &keySystem, const std::shared_ptr<ICdmBackend> &cdm,
                                        const std::shared_ptr<IMessageDispatcher> &messageDispatcher,
                                        const LicenseType &sessionType, OpenCDMSessionCallbacks *callbacks, void *context,
-                                       const std::string &initDataType, const std::vector<uint8_t> &initData)
+                                       const std::string &initDataType, std::vector<uint8_t> initData)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
-    OpenCDMSession *newSession =
-        new OpenCDMSessionPrivate(cdm, messageDispatcher, sessionType, callbacks, context, initDataType, initData);
+    if (isSessionSharingEnabled() && !initData.empty())
+    {
+        return createShared(cdm, messageDispatcher, sessionType, callbacks, context, keySystem, initDataType,
+                            std::move(initData));
+    }
+    ProfiledLock lock{m_mutex};
+    OpenCDMSession *newSession = new OpenCDMSessionPrivate(cdm, messageDispatcher, sessionType, callbacks, context,
+                                                           initDataType, std::move(initData));
     m_activeSessions.insert(std::make_pair(newSession, 1));
+    Metrics::instance().add(MetricId::ACTIVE_SESSIONS);
     return newSession;
 }
 
-OpenCDMSession *ActiveSessions::get(const std::vector<uint8_t> &keyId)
+OpenCDMSession *ActiveSessions::createShared(const std::shared_ptr<ICdmBackend> &cdm,
+                                             const std::shared_ptr<IMessageDispatcher> &messageDispatcher,
+                                             const LicenseType &sessionType, OpenCDMSessionCallbacks *callbacks,
+                                             void *context, const std::string &keySystem,
+                                             const std::string &initDataType, std::vector<uint8_t> initData)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
-    auto sessionIter{std::find_if(m_activeSessions.begin(), m_activeSessions.end(),
-                                  [&](const auto &iter)
-                                  { return iter.first->status(keyId) != KeyStatus::InternalError; })};
+    SharedSessionKey key{keySystem, sessionType, initDataType, getInitDataDigest(initData)};
+    ProfiledLock lock{m_mutex};
+    auto sharedIter{m_sharedSessions.find(key)};
+    if (sharedIter != m_sharedSessions.end())
+    {
+        OpenCDMSessionPrivate *session{sharedIter->second};
+        auto handle{std::make_unique<SharedSession>(*session, false)};
+        if (session->attachSession(handle.get(), callbacks, context, initData))
+        {
+            OpenCDMSession *attachedSession{handle.release()};
+            ++m_activeSessions[session];
+            m_sharedSessionHandles.emplace(attachedSession, session);
+            Metrics::instance().add(MetricId::SHARED_SESSION_ATTACHES);
+            // Callbacks may call ActiveSessions again
+            lock.unlock();
+            session->notifyAttachedSession(attachedSession);
+            return attachedSession;
+        }
+    }
+    // Created without callbacks, they are called for each of the sessions attached to it
+    auto *session{new OpenCDMSessionPrivate(cdm, messageDispatcher, sessionType, nullptr, nullptr, initDataType,
+                                            std::move(initData))};
+    m_activeSessions.insert(std::make_pair(session, 1));
+    Metrics::instance().add(MetricId::ACTIVE_SESSIONS);
+    OpenCDMSession *ownerSession{new SharedSession(*session, true)};
+    session->addAttachedSession(ownerSession, callbacks, context);
+    m_sharedSessionHandles.emplace(ownerSession, session);
+    m_sharedSessions.insert_or_assign(std::move(key), session);
+    return ownerSession;
+}
+
+OpenCDMSession *ActiveSessions::get(const uint8_t keyId[], uint8_t length)
+{
+    ProfiledLock lock{m_mutex};
+    // A session only expecting the key from its init data is used when no session has a license for it yet
+    auto sessionIter{m_activeSessions.end()};
+    for (auto iter = m_activeSessions.begin(); iter != m_activeSessions.end(); ++iter)
+    {
+        const KeyStatus kStatus{iter->first->status(keyId, length)};
+        if (KeyStatus::StatusPending == kStatus && sessionIter == m_activeSessions.end())
+        {
+            sessionIter = iter;
+        }
+        else if (KeyStatus::StatusPending != kStatus && KeyStatus::InternalError != kStatus)
+        {
+            sessionIter = iter;
+            break;
+        }
+    }
     if (sessionIter != m_activeSessions.end())
     {
         ++sessionIter->second;
@@ -55,15 +137,52 @@ OpenCDMSession *ActiveSessions::get(const std::vector<uint8_t> &keyId)
 
 void ActiveSessions::remove(OpenCDMSession *session)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    ProfiledLock lock{m_mutex};
+    auto handleIter{m_sharedSessionHandles.find(session)};
+    if (handleIter != m_sharedSessionHandles.end())
+    {
+        // Releases the shared session, which is counted once for every session attached to it
+        handleIter->second->detachSession(handleIter->first);
+        session = handleIter->second;
+        delete handleIter->first;
+        m_sharedSessionHandles.erase(handleIter);
+    }
     auto sessionIter{m_activeSessions.find(session)};
     if (sessionIter != m_activeSessions.end())
     {
         --sessionIter->second;
         if (0 == sessionIter->second)
         {
+            auto sharedIter{std::find_if(m_sharedSessions.begin(), m_sharedSessions.end(),
+                                         [session](const auto &shared) { return shared.second == session; })};
+            if (sharedIter != m_sharedSessions.end())
+            {
+                m_sharedSessions.erase(sharedIter);
+            }
             delete sessionIter->first;
             m_activeSessions.erase(sessionIter);
+            Metrics::instance().add(MetricId::ACTIVE_SESSIONS, -1);
         }
     }
 }
+
+std::vector<std::pair<const OpenCDMSession *, uint64_t>> ActiveSessions::getDecryptCalls()
+{
+    ProfiledLock lock{m_mutex};
+    std::vector<std::pair<const OpenCDMSession *, uint64_t>> decryptCalls;
+    for (const auto &session : m_activeSessions)
+    {
+        decryptCalls.emplace_back(session.first, session.first->getDecryptCalls());
+    }
+    return decryptCalls;
+}
+
+void ActiveSessions::setSessionSharingEnabled(bool isEnabled)
+{
+    sessionSharingEnabled().store(isEnabled, std::memory_order_relaxed);
+}
+
+bool ActiveSessions::isSessionSharingEnabled()
+{
+    return sessionSharingEnabled().load(std::memory_order_relaxed);
+}
@@ -0,0 +1,347 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinaryLogFile.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t kSegmentSize{4 * 1024 * 1024};
+constexpr uint64_t kFnvPrime{1099511628211ULL};
+
+bool isBinaryLogFormatEnabled()
+{
+    const char *logFormatEnvVar = getenv("RIALTO_LOG_FORMAT");
+    if (logFormatEnvVar)
+    {
+        return std::string(logFormatEnvVar) == "binary";
+    }
+    return false;
+}
+
+std::string getRialtoLogPath()
+{
+    const char *logPathEnvVar = getenv("RIALTO_LOG_PATH");
+    if (logPathEnvVar)
+    {
+        return std::string(logPathEnvVar);
+    }
+    return "";
+}
+
+uint64_t mix(uint64_t key, uint64_t value)
+{
+    return (key ^ value) * kFnvPrime;
+}
+
+uint64_t getTimestampNs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint32_t getThreadId()
+{
+    static thread_local const uint32_t kThreadId{static_cast<uint32_t>(syscall(SYS_gettid))};
+    return kThreadId;
+}
+} // namespace
+
+void BinaryLogRecord::setFormat(const char *format)
+{
+    m_format = format;
+    m_formatKey = mix(m_formatKey, reinterpret_cast<uintptr_t>(format));
+}
+
+std::string BinaryLogRecord::formatTemplate() const
+{
+    std::string result;
+    if (m_format)
+    {
+        for (const char *format = m_format; *format != '\0'; ++format)
+        {
+            if ('{' == *format && '}' == format[1])
+            {
+                result += binarylog::kPlaceholder;
+                ++format;
+                continue;
+            }
+            result += *format;
+            if (('{' == *format || '}' == *format) && *format == format[1])
+            {
+                ++format;
+            }
+        }
+        return result;
+    }
+    for (size_t i = 0; i < m_pieceCount; ++i)
+    {
+        if (m_pieces[i])
+        {
+            result += m_pieces[i];
+        }
+        else
+        {
+            result += binarylog::kPlaceholder;
+        }
+    }
+    return result;
+}
+
+void BinaryLogRecord::addLiteral(const char *text)
+{
+    if (addPiece(text))
+    {
+        m_formatKey = mix(m_formatKey, reinterpret_cast<uintptr_t>(text));
+    }
+}
+
+void BinaryLogRecord::addString(const char *text, size_t length)
+{
+    const size_t kMaxLength{kMaxArgsSize - m_argsSize - sizeof(uint8_t) - sizeof(uint16_t)};
+    if (m_argsSize + sizeof(uint8_t) + sizeof(uint16_t) > kMaxArgsSize)
+    {
+        return;
+    }
+    const uint16_t kLength = static_cast<uint16_t>(std::min(length, kMaxLength));
+    if (!addPiece(nullptr))
+    {
+        return;
+    }
+    m_formatKey = mix(m_formatKey, binarylog::kString);
+    m_args[m_argsSize++] = binarylog::kString;
+    std::memcpy(&m_args[m_argsSize], &kLength, sizeof(kLength));
+    m_argsSize += sizeof(kLength);
+    std::memcpy(&m_args[m_argsSize], text, kLength);
+    m_argsSize += kLength;
+    ++m_argCount;
+}
+
+void BinaryLogRecord::addArg(binarylog::ArgType type, const void *data, size_t size)
+{
+    if (m_argsSize + sizeof(uint8_t) + size > kMaxArgsSize || !addPiece(nullptr))
+    {
+        return;
+    }
+    m_formatKey = mix(m_formatKey, type);
+    m_args[m_argsSize++] = type;
+    std::memcpy(&m_args[m_argsSize], data, size);
+    m_argsSize += size;
+    ++m_argCount;
+}
+
+bool BinaryLogRecord::addPiece(const char *text)
+{
+    if (m_pieceCount >= kMaxPieces)
+    {
+        return false;
+    }
+    m_pieces[m_pieceCount++] = text;
+    return true;
+}
+
+BinaryLogFile &BinaryLogFile::instance()
+{
+    static BinaryLogFile binaryLogFile;
+    return binaryLogFile;
+}
+
+bool BinaryLogFile::write(const std::string &componentName, uint8_t severity, const BinaryLogRecord &record)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (!m_mapping)
+    {
+        return false;
+    }
+
+    auto componentIter = m_componentIds.find(componentName);
+    if (componentIter == m_componentIds.end())
+    {
+        uint32_t componentId{0};
+        if (!defineString(componentName, componentId))
+        {
+            return false;
+        }
+        componentIter = m_componentIds.emplace(componentName, componentId).first;
+    }
+    auto formatIter = m_formatIds.find(record.formatKey());
+    if (formatIter == m_formatIds.end())
+    {
+        uint32_t formatId{0};
+        if (!defineString(record.formatTemplate(), formatId))
+        {
+            return false;
+        }
+        formatIter = m_formatIds.emplace(record.formatKey(), formatId).first;
+    }
+
+    binarylog::LogEntry entry{};
+    entry.timestampNs = getTimestampNs();
+    entry.formatId = formatIter->second;
+    entry.componentId = componentIter->second;
+    entry.threadId = getThreadId();
+    entry.severity = severity;
+    entry.argCount = record.argCount();
+    if (!reserve(sizeof(binarylog::BinaryLogRecordHeader) + sizeof(entry) + record.argsSize()))
+    {
+        return false;
+    }
+    appendRecord(binarylog::kLogEntry, &entry, sizeof(entry), record.args(), record.argsSize());
+    return true;
+}
+
+bool BinaryLogFile::isEnabled() const
+{
+    return m_isEnabled;
+}
+
+void BinaryLogFile::reset()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    tryCloseFile();
+    tryOpenFile();
+}
+
+BinaryLogFile::BinaryLogFile()
+    : m_isEnabled{false}, m_fd{-1}, m_mapping{nullptr}, m_mappedSize{0}, m_offset{0}, m_nextStringId{0}
+{
+    tryOpenFile();
+}
+
+BinaryLogFile::~BinaryLogFile()
+{
+    tryCloseFile();
+}
+
+void BinaryLogFile::tryOpenFile()
+{
+    std::string logPath{getRialtoLogPath()};
+    if (logPath.empty() || !isBinaryLogFormatEnabled())
+    {
+        return;
+    }
+    logPath += binarylog::kFileSuffix;
+    m_fd = open(logPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+    {
+        return;
+    }
+    binarylog::BinaryLogFileHeader header{};
+    std::memcpy(header.magic, binarylog::kMagic, sizeof(header.magic));
+    header.version = binarylog::kVersion;
+    header.headerSize = sizeof(header);
+    if (!reserve(sizeof(header)))
+    {
+        tryCloseFile();
+        return;
+    }
+    std::memcpy(m_mapping, &header, sizeof(header));
+    m_offset = sizeof(header);
+    m_isEnabled = true;
+}
+
+void BinaryLogFile::tryCloseFile()
+{
+    m_isEnabled = false;
+    if (m_mapping)
+    {
+        munmap(m_mapping, m_mappedSize);
+        m_mapping = nullptr;
+    }
+    if (m_fd >= 0)
+    {
+        // Drop the unused, preallocated part of the last segment
+        (void)ftruncate(m_fd, static_cast<off_t>(m_offset));
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_mappedSize = 0;
+    m_offset = 0;
+    m_nextStringId = 0;
+    m_componentIds.clear();
+    m_formatIds.clear();
+}
+
+bool BinaryLogFile::reserve(size_t size)
+{
+    if (m_offset + size <= m_mappedSize)
+    {
+        return true;
+    }
+    if (m_fd < 0)
+    {
+        return false;
+    }
+    const size_t kNewSize{m_mappedSize + kSegmentSize};
+    if (0 != ftruncate(m_fd, static_cast<off_t>(kNewSize)))
+    {
+        return false;
+    }
+    void *mapping = mmap(nullptr, kNewSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == mapping)
+    {
+        return false;
+    }
+    if (m_mapping)
+    {
+        munmap(m_mapping, m_mappedSize);
+    }
+    m_mapping = static_cast<uint8_t *>(mapping);
+    m_mappedSize = kNewSize;
+    return true;
+}
+
+void BinaryLogFile::appendRecord(binarylog::RecordType type, const void *body, size_t bodySize, const void *extra,
+                                 size_t extraSize)
+{
+    binarylog::BinaryLogRecordHeader header{};
+    header.type = type;
+    header.size = static_cast<uint16_t>(sizeof(header) + bodySize + extraSize);
+    std::memcpy(m_mapping + m_offset, &header, sizeof(header));
+    std::memcpy(m_mapping + m_offset + sizeof(header), body, bodySize);
+    if (extraSize)
+    {
+        std::memcpy(m_mapping + m_offset + sizeof(header) + bodySize, extra, extraSize);
+    }
+    m_offset += header.size;
+}
+
+bool BinaryLogFile::defineString(const std::string &text, uint32_t &id)
+{
+    binarylog::StringDefinition definition{};
+    definition.id = m_nextStringId;
+    definition.length = static_cast<uint16_t>(
+        std::min(text.size(), binarylog::kMaxRecordSize - sizeof(binarylog::BinaryLogRecordHeader) - sizeof(definition)));
+    if (!reserve(sizeof(binarylog::BinaryLogRecordHeader) + sizeof(definition) + definition.length))
+    {
+        // Not cached, so that the definition is written again with the next entry using it
+        return false;
+    }
+    appendRecord(binarylog::kStringDefinition, &definition, sizeof(definition), text.data(), definition.length);
+    id = m_nextStringId++;
+    return true;
+}
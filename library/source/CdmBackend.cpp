@@ -18,249 +18,857 @@
  */
 
 #include "CdmBackend.h"
+#include "LatencyStats.h"
+#include "MediaKeysRecorder.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <utility>
+
+namespace
+{
+constexpr std::chrono::seconds kPendingKeySessionWait{1};
+constexpr std::chrono::seconds kPoolRetryDelay{1};
+
+uint32_t readKeySessionPoolSize()
+{
+    const char *size{getenv("RIALTO_KEY_SESSION_POOL_SIZE")};
+    if (!size)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::strtoul(size, nullptr, 10));
+}
+
+std::atomic<uint32_t> &keySessionPoolSize()
+{
+    static std::atomic<uint32_t> poolSize{readKeySessionPoolSize()};
+    return poolSize;
+}
+} // namespace
 
 CdmBackend::CdmBackend(const std::string &keySystem,
-                       const std::shared_ptr<firebolt::rialto::IMediaKeysClient> &mediaKeysClient,
+                       const std::shared_ptr<IMessageDispatcherListener> &mediaKeysClient,
                        const std::shared_ptr<firebolt::rialto::IMediaKeysFactory> &mediaKeysFactory)
     : m_log{"CdmBackend"}, m_appState{firebolt::rialto::ApplicationState::UNKNOWN}, m_keySystem{keySystem},
-      m_mediaKeysClient{mediaKeysClient}, m_mediaKeysFactory{mediaKeysFactory}
+      m_mediaKeysClient{mediaKeysClient}, m_mediaKeysFactory{mediaKeysFactory}, m_nextRequestId{0},
+      m_isPoolRunning{false}, m_isRestoreRunning{false}, m_isRestoreRequested{false}, m_isRestoring{false},
+      m_appStateChanges{0}, m_nextLdlWaiter{0}, m_ldlReservations{0}, m_ldlLimit{0}, m_isLdlLimitKnown{false}
+{
+}
+
+CdmBackend::~CdmBackend()
 {
+    // Stopped first, a restore refills the key session pool
+    if (m_restoreThread.joinable())
+    {
+        {
+            ProfiledLock lock{m_mutex};
+            m_isRestoreRunning = false;
+            m_restoreCv.notify_all();
+        }
+        m_restoreThread.join();
+    }
+    if (m_poolThread.joinable())
+    {
+        {
+            ProfiledLock lock{m_mutex};
+            m_isPoolRunning = false;
+            m_poolCv.notify_one();
+        }
+        m_poolThread.join();
+    }
+    std::deque<PendingKeySession> pendingKeySessions;
+    {
+        ProfiledLock lock{m_mutex};
+        clearKeySessionPool();
+        pendingKeySessions.swap(m_pendingKeySessions);
+    }
+    Metrics::instance().add(MetricId::PENDING_KEY_SESSIONS, -static_cast<int64_t>(pendingKeySessions.size()));
+    for (PendingKeySession &pendingKeySession : pendingKeySessions)
+    {
+        pendingKeySession.callback(false, firebolt::rialto::kInvalidSessionId);
+    }
 }
 
 void CdmBackend::notifyApplicationState(firebolt::rialto::ApplicationState state)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    ProfiledLock lock{m_mutex};
     if (state == m_appState)
     {
         return;
     }
+    Metrics::instance().add(MetricId::APP_STATE_TRANSITIONS);
+    MediaKeysRecorder::instance().recordApplicationState(state);
+    ++m_appStateChanges;
+    m_appState = state;
     if (firebolt::rialto::ApplicationState::RUNNING == state)
     {
-        m_log << info << "Rialto state changed to: RUNNING";
-        if (createMediaKeys())
+        m_log << info << RIALTO_LOG_LITERAL("Rialto state changed to: RUNNING");
+        // The notifying thread is not held up by the MediaKeys IPC, see restoreLoop()
+        m_isRestoreRequested = true;
+        m_isRestoring = true;
+        if (!m_restoreThread.joinable())
         {
-            m_appState = state;
-            m_cv.notify_one();
+            m_isRestoreRunning = true;
+            m_restoreThread = std::thread(&CdmBackend::restoreLoop, this);
         }
+        m_restoreCv.notify_all();
     }
     else
     {
-        m_log << info << "Rialto state changed to: INACTIVE";
+        m_log << info << RIALTO_LOG_LITERAL("Rialto state changed to: INACTIVE");
         m_mediaKeys.reset();
-        m_appState = state;
+        // The new MediaKeys may report a different limit
+        m_isLdlLimitKnown = false;
+        // Pooled sessions are lost with MediaKeys and were never handed out, so there is nothing to restore
+        clearKeySessionPool();
+        // A restore in progress drops its MediaKeys, nothing is waited for
+        m_isRestoreRequested = false;
+        m_isRestoring = false;
+        m_restoreCv.notify_all();
     }
 }
 
 bool CdmBackend::initialize(const firebolt::rialto::ApplicationState &initialState)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    ProfiledLock lock{m_mutex};
+    // CdmBackend initialized by Rialto Client thread in notifyApplicationState(), ready once MediaKeys is created
+    m_restoreCv.wait(lock, [this]() { return !m_isRestoring; });
     if (firebolt::rialto::ApplicationState::UNKNOWN != m_appState)
     {
-        // CdmBackend initialized by Rialto Client thread in notifyApplicationState()
         return true;
     }
     if (firebolt::rialto::ApplicationState::RUNNING == initialState)
     {
-        if (!createMediaKeys())
+        m_mediaKeys = createMediaKeys();
+        if (!m_mediaKeys)
         {
             return false;
         }
     }
-    m_log << info << "CdmBackend initialized in "
+    m_log << info << RIALTO_LOG_LITERAL("CdmBackend initialized in ")
           << (firebolt::rialto::ApplicationState::RUNNING == initialState ? "RUNNING" : "INACTIVE") << " state";
     m_appState = initialState;
+    refillKeySessionPool();
+    replayPendingKeySessions(lock);
     return true;
 }
 
+void CdmBackend::setKeySessionPoolSize(uint32_t size)
+{
+    keySessionPoolSize() = size;
+}
+
+uint32_t CdmBackend::getKeySessionPoolSize()
+{
+    return keySessionPoolSize();
+}
+
 bool CdmBackend::selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::SELECT_KEY_ID, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->selectKeyId(keySessionId, keyId);
+    RecordedCall call{CdmOperation::SELECT_KEY_ID, keySessionId, keyId.size()};
+    return checkStatus(CdmOperation::SELECT_KEY_ID, call.setStatus(m_mediaKeys->selectKeyId(keySessionId, keyId)));
 }
 
 bool CdmBackend::containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::CONTAINS_KEY, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return m_mediaKeys->containsKey(keySessionId, keyId);
+    RecordedCall call{CdmOperation::CONTAINS_KEY, keySessionId, keyId.size()};
+    return call.setStatus(m_mediaKeys->containsKey(keySessionId, keyId));
 }
 
-bool CdmBackend::createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, int32_t &keySessionId)
+bool CdmBackend::createKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                                  int32_t &keySessionId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
     // Sometimes app tries to create session before reaching RUNNING state. We have to wait for it.
-    m_cv.wait_for(lock, std::chrono::seconds(1),
-                  [this]() { return firebolt::rialto::ApplicationState::RUNNING == m_appState; });
+    auto result{std::make_shared<std::promise<std::pair<bool, int32_t>>>()};
+    std::future<std::pair<bool, int32_t>> futureResult{result->get_future()};
+    const uint64_t kRequestId{createKeySessionAsync(sessionType, isLDL, priority,
+                                                    [result](bool isCreated, int32_t createdKeySessionId)
+                                                    { result->set_value({isCreated, createdKeySessionId}); })};
+    if (std::future_status::ready != futureResult.wait_for(kPendingKeySessionWait) &&
+        cancelKeySessionCreation(kRequestId))
+    {
+        m_log << warn << RIALTO_LOG_LITERAL("Rialto did not reach RUNNING state in time, failed to create key session");
+        return false;
+    }
+    const std::pair<bool, int32_t> kResult{futureResult.get()};
+    keySessionId = kResult.second;
+    return kResult.first;
+}
+
+uint64_t CdmBackend::createKeySessionAsync(firebolt::rialto::KeySessionType sessionType, bool isLDL,
+                                           SessionPriority priority, CreateKeySessionCallback callback)
+{
+    ScheduledLock lock{m_scheduler, priority, m_mutex};
+    const uint64_t kRequestId{m_nextRequestId++};
     if (!m_mediaKeys)
     {
+        m_log << info << RIALTO_LOG_LITERAL("Rialto is not RUNNING, key session creation deferred");
+        if (isLDL && m_ldlReservations > 0)
+        {
+            // The reservation counts against the lost MediaKeys, the new one reports its limit again
+            --m_ldlReservations;
+            m_ldlCv.notify_all();
+        }
+        m_pendingKeySessions.push_back(
+            PendingKeySession{kRequestId, sessionType, isLDL, priority, std::move(callback)});
+        Metrics::instance().add(MetricId::PENDING_KEY_SESSIONS);
+        return kRequestId;
+    }
+    int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+    // LDL sessions are created by sessions admitted with admitLdlSession
+    const bool kResult{takePooledKeySession(sessionType, isLDL, priority, keySessionId) ||
+                       executeCreateKeySession(sessionType, isLDL, isLDL, priority, keySessionId)};
+    lock.unlock();
+    callback(kResult, keySessionId);
+    return kRequestId;
+}
+
+bool CdmBackend::cancelKeySessionCreation(uint64_t requestId)
+{
+    ProfiledLock lock{m_mutex};
+    auto pendingIter{std::find_if(m_pendingKeySessions.begin(), m_pendingKeySessions.end(),
+                                  [requestId](const PendingKeySession &pending)
+                                  { return pending.requestId == requestId; })};
+    if (pendingIter == m_pendingKeySessions.end())
+    {
+        return false;
+    }
+    m_pendingKeySessions.erase(pendingIter);
+    Metrics::instance().add(MetricId::PENDING_KEY_SESSIONS, -1);
+    return true;
+}
+
+void CdmBackend::setKeySessionPriority(int32_t keySessionId, SessionPriority priority)
+{
+    ProfiledLock lock{m_mutex};
+    RIALTO_LOG_FMT(m_log, debug, "Key session {} priority: {}", keySessionId, toString(priority));
+    setPriority(keySessionId, priority);
+}
+
+bool CdmBackend::admitLdlSession(SessionPriority priority, std::chrono::milliseconds timeout)
+{
+    TraceScope traceScope{"admitLdlSession"};
+    ProfiledLock lock{m_mutex};
+    const std::pair<SessionPriority, uint64_t> kWaiter{priority, m_nextLdlWaiter++};
+    m_ldlWaiters.insert(kWaiter);
+    const auto kIsAdmitted{[&]() { return *m_ldlWaiters.begin() == kWaiter && isLdlSessionAvailable(); }};
+    bool isAdmitted{kIsAdmitted()};
+    if (!isAdmitted)
+    {
+        Metrics::instance().add(MetricId::LDL_ADMISSION_WAITS);
+        RIALTO_LOG_FMT(m_log, info, "LDL session limit of {} reached, waiting for a session to close", m_ldlLimit);
+        if (timeout.count() > 0)
+        {
+            isAdmitted = m_ldlCv.wait_for(lock, timeout, kIsAdmitted);
+        }
+        else
+        {
+            m_ldlCv.wait(lock, kIsAdmitted);
+            isAdmitted = true;
+        }
+    }
+    m_ldlWaiters.erase(kWaiter);
+    // The next waiter is first in line now, and may fit as well
+    m_ldlCv.notify_all();
+    if (!isAdmitted)
+    {
+        Metrics::instance().add(MetricId::LDL_ADMISSION_TIMEOUTS);
+        RIALTO_LOG_FMT(m_log, warn, "No LDL session became available within {} ms", timeout.count());
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK ==
-           m_mediaKeys->createKeySession(sessionType, m_mediaKeysClient, isLDL, keySessionId);
+    if (0 != m_ldlLimit)
+    {
+        ++m_ldlReservations;
+    }
+    return true;
+}
+
+bool CdmBackend::isLdlSessionAvailable()
+{
+    if (!m_isLdlLimitKnown && m_mediaKeys)
+    {
+        uint32_t ldlLimit{0};
+        RecordedCall call{CdmOperation::GET_LDL_SESSIONS_LIMIT, firebolt::rialto::kInvalidSessionId};
+        // Not retried on failure, the limit is then not enforced
+        m_ldlLimit = checkStatus(CdmOperation::GET_LDL_SESSIONS_LIMIT,
+                                 call.setStatus(m_mediaKeys->getLdlSessionsLimit(ldlLimit)))
+                         ? ldlLimit
+                         : 0;
+        m_isLdlLimitKnown = true;
+        RIALTO_LOG_FMT(m_log, info, "LDL session limit: {}", m_ldlLimit);
+    }
+    if (0 == m_ldlLimit)
+    {
+        return true;
+    }
+    const auto kLdlSessions{std::count_if(m_keySessions.begin(), m_keySessions.end(),
+                                          [](const auto &keySession) { return keySession.second.isLDL; })};
+    return m_ldlReservations + static_cast<uint32_t>(kLdlSessions) < m_ldlLimit;
+}
+
+bool CdmBackend::executeCreateKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL, bool isAdmitted,
+                                         SessionPriority priority, int32_t &keySessionId)
+{
+    TraceScope traceScope{"createKeySession"};
+    // Called with the lock held, so the lock wait is not measured
+    LatencyTimer timer{CdmOperation::CREATE_KEY_SESSION, priority};
+    RecordedCall call{CdmOperation::CREATE_KEY_SESSION, firebolt::rialto::kInvalidSessionId, 0,
+                      static_cast<uint32_t>(sessionType) | (isLDL ? mediakeysrecording::kLdlFlag : 0)};
+    const auto kStatus{m_mediaKeys->createKeySession(sessionType, m_mediaKeysClient, isLDL, keySessionId)};
+    call.setKeySessionId(keySessionId);
+    const bool kResult{checkStatus(CdmOperation::CREATE_KEY_SESSION, call.setStatus(kStatus))};
+    traceScope.setKeySessionId(keySessionId);
+    if (isAdmitted && m_ldlReservations > 0)
+    {
+        // The reservation made by admitLdlSession becomes the session, or is freed for the next waiter
+        --m_ldlReservations;
+    }
+    if (kResult)
+    {
+        m_keySessions[keySessionId] = KeySessionInfo{sessionType, isLDL, false, priority};
+        m_scheduler.setPriority(keySessionId, priority);
+    }
+    else if (isLDL)
+    {
+        m_ldlCv.notify_all();
+    }
+    return kResult;
 }
 
 bool CdmBackend::generateRequest(int32_t keySessionId, firebolt::rialto::InitDataType initDataType,
                                  const std::vector<uint8_t> &initData)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    TraceScope traceScope{"generateRequest", nullptr, keySessionId};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::GENERATE_REQUEST, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK ==
-           m_mediaKeys->generateRequest(keySessionId, initDataType, initData);
+    RecordedCall call{CdmOperation::GENERATE_REQUEST, keySessionId, initData.size(),
+                      static_cast<uint32_t>(initDataType)};
+    return checkStatus(CdmOperation::GENERATE_REQUEST,
+                       call.setStatus(m_mediaKeys->generateRequest(keySessionId, initDataType, initData)));
 }
 
 bool CdmBackend::loadSession(int32_t keySessionId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    TraceScope traceScope{"loadSession", nullptr, keySessionId};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::LOAD_SESSION, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->loadSession(keySessionId);
+    RecordedCall call{CdmOperation::LOAD_SESSION, keySessionId};
+    if (!checkStatus(CdmOperation::LOAD_SESSION, call.setStatus(m_mediaKeys->loadSession(keySessionId))))
+    {
+        return false;
+    }
+    setHasStoredLicense(keySessionId, true);
+    return true;
 }
 
 bool CdmBackend::updateSession(int32_t keySessionId, const std::vector<uint8_t> &responseData)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    TraceScope traceScope{"updateSession", nullptr, keySessionId};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::UPDATE_SESSION, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->updateSession(keySessionId, responseData);
+    RecordedCall call{CdmOperation::UPDATE_SESSION, keySessionId, responseData.size()};
+    if (!checkStatus(CdmOperation::UPDATE_SESSION,
+                     call.setStatus(m_mediaKeys->updateSession(keySessionId, responseData))))
+    {
+        return false;
+    }
+    setHasStoredLicense(keySessionId, true);
+    return true;
 }
 
 bool CdmBackend::setDrmHeader(int32_t keySessionId, const std::vector<uint8_t> &requestData)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::SET_DRM_HEADER, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->setDrmHeader(keySessionId, requestData);
+    RecordedCall call{CdmOperation::SET_DRM_HEADER, keySessionId, requestData.size()};
+    return checkStatus(CdmOperation::SET_DRM_HEADER,
+                       call.setStatus(m_mediaKeys->setDrmHeader(keySessionId, requestData)));
 }
 
 bool CdmBackend::closeKeySession(int32_t keySessionId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    TraceScope traceScope{"closeKeySession", nullptr, keySessionId};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::CLOSE_KEY_SESSION, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
+        // Lost with the previous MediaKeys, make sure it is not restored
+        eraseKeySession(keySessionId);
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->closeKeySession(keySessionId);
+    RecordedCall call{CdmOperation::CLOSE_KEY_SESSION, keySessionId};
+    if (!checkStatus(CdmOperation::CLOSE_KEY_SESSION, call.setStatus(m_mediaKeys->closeKeySession(keySessionId))))
+    {
+        return false;
+    }
+    eraseKeySession(keySessionId);
+    return true;
 }
 
 bool CdmBackend::removeKeySession(int32_t keySessionId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::REMOVE_KEY_SESSION, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->removeKeySession(keySessionId);
+    RecordedCall call{CdmOperation::REMOVE_KEY_SESSION, keySessionId};
+    if (!checkStatus(CdmOperation::REMOVE_KEY_SESSION,
+                     call.setStatus(m_mediaKeys->removeKeySession(keySessionId))))
+    {
+        return false;
+    }
+    setHasStoredLicense(keySessionId, false);
+    return true;
 }
 
 bool CdmBackend::deleteDrmStore()
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::DELETE_DRM_STORE};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->deleteDrmStore();
+    RecordedCall call{CdmOperation::DELETE_DRM_STORE, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::DELETE_DRM_STORE, call.setStatus(m_mediaKeys->deleteDrmStore()));
 }
 
 bool CdmBackend::deleteKeyStore()
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::DELETE_KEY_STORE};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->deleteKeyStore();
+    RecordedCall call{CdmOperation::DELETE_KEY_STORE, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::DELETE_KEY_STORE, call.setStatus(m_mediaKeys->deleteKeyStore()));
 }
 
 bool CdmBackend::getDrmStoreHash(std::vector<unsigned char> &drmStoreHash)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::GET_DRM_STORE_HASH};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getDrmStoreHash(drmStoreHash);
+    RecordedCall call{CdmOperation::GET_DRM_STORE_HASH, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::GET_DRM_STORE_HASH, call.setStatus(m_mediaKeys->getDrmStoreHash(drmStoreHash)));
 }
 
 bool CdmBackend::getKeyStoreHash(std::vector<unsigned char> &keyStoreHash)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::GET_KEY_STORE_HASH};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getKeyStoreHash(keyStoreHash);
+    RecordedCall call{CdmOperation::GET_KEY_STORE_HASH, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::GET_KEY_STORE_HASH, call.setStatus(m_mediaKeys->getKeyStoreHash(keyStoreHash)));
 }
 
 bool CdmBackend::getLdlSessionsLimit(uint32_t &ldlLimit)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::GET_LDL_SESSIONS_LIMIT};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getLdlSessionsLimit(ldlLimit);
+    RecordedCall call{CdmOperation::GET_LDL_SESSIONS_LIMIT, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::GET_LDL_SESSIONS_LIMIT,
+                       call.setStatus(m_mediaKeys->getLdlSessionsLimit(ldlLimit)));
 }
 
 bool CdmBackend::getLastDrmError(int32_t keySessionId, uint32_t &errorCode)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::GET_LAST_DRM_ERROR, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getLastDrmError(keySessionId, errorCode);
+    RecordedCall call{CdmOperation::GET_LAST_DRM_ERROR, keySessionId};
+    return checkStatus(CdmOperation::GET_LAST_DRM_ERROR,
+                       call.setStatus(m_mediaKeys->getLastDrmError(keySessionId, errorCode)));
 }
 
 bool CdmBackend::getDrmTime(uint64_t &drmTime)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    LatencyTimer timer{CdmOperation::GET_DRM_TIME};
+    ScheduledLock lock{m_scheduler, SessionPriority::FOREGROUND, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getDrmTime(drmTime);
+    RecordedCall call{CdmOperation::GET_DRM_TIME, firebolt::rialto::kInvalidSessionId};
+    return checkStatus(CdmOperation::GET_DRM_TIME, call.setStatus(m_mediaKeys->getDrmTime(drmTime)));
 }
 
 bool CdmBackend::getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    const SessionPriority kPriority{m_scheduler.getPriority(keySessionId)};
+    LatencyTimer timer{CdmOperation::GET_CDM_KEY_SESSION_ID, kPriority};
+    ScheduledLock lock{m_scheduler, kPriority, m_mutex};
+    timer.lockAcquired();
     if (!m_mediaKeys)
     {
         return false;
     }
-    return firebolt::rialto::MediaKeyErrorStatus::OK == m_mediaKeys->getCdmKeySessionId(keySessionId, cdmKeySessionId);
+    RecordedCall call{CdmOperation::GET_CDM_KEY_SESSION_ID, keySessionId};
+    return checkStatus(CdmOperation::GET_CDM_KEY_SESSION_ID,
+                       call.setStatus(m_mediaKeys->getCdmKeySessionId(keySessionId, cdmKeySessionId)));
 }
 
-bool CdmBackend::createMediaKeys()
+bool CdmBackend::checkStatus(CdmOperation operation, firebolt::rialto::MediaKeyErrorStatus status)
 {
-    if (!m_mediaKeysFactory)
+    if (firebolt::rialto::MediaKeyErrorStatus::OK != status)
     {
-        m_log << error << "Failed to initialize media keys - not possible to create factory";
+        Metrics::instance().addIpcFailure(operation);
         return false;
     }
+    return true;
+}
 
-    m_mediaKeys = m_mediaKeysFactory->createMediaKeys(m_keySystem);
-    if (!m_mediaKeys)
+void CdmBackend::replayPendingKeySessions(ProfiledLock &lock)
+{
+    if (m_pendingKeySessions.empty() || !m_mediaKeys)
+    {
+        return;
+    }
+    m_log << info << RIALTO_LOG_LITERAL("Creating ") << m_pendingKeySessions.size() << " deferred key sessions";
+    std::deque<PendingKeySession> pendingKeySessions;
+    pendingKeySessions.swap(m_pendingKeySessions);
+    Metrics::instance().add(MetricId::PENDING_KEY_SESSIONS, -static_cast<int64_t>(pendingKeySessions.size()));
+    // Higher priority requests first, in arrival order within a priority
+    std::stable_sort(pendingKeySessions.begin(), pendingKeySessions.end(),
+                     [](const PendingKeySession &lhs, const PendingKeySession &rhs)
+                     { return lhs.priority < rhs.priority; });
+    std::vector<std::pair<bool, int32_t>> results;
+    results.reserve(pendingKeySessions.size());
+    for (const PendingKeySession &pendingKeySession : pendingKeySessions)
+    {
+        int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+        // The LDL reservation was released when the request was deferred
+        const bool kResult{executeCreateKeySession(pendingKeySession.sessionType, pendingKeySession.isLDL, false,
+                                                   pendingKeySession.priority, keySessionId)};
+        results.emplace_back(kResult, keySessionId);
+    }
+    // Callbacks may call the backend again
+    lock.unlock();
+    for (size_t i = 0; i < pendingKeySessions.size(); ++i)
+    {
+        pendingKeySessions[i].callback(results[i].first, results[i].second);
+    }
+}
+
+bool CdmBackend::takePooledKeySession(firebolt::rialto::KeySessionType sessionType, bool isLDL,
+                                      SessionPriority priority, int32_t &keySessionId)
+{
+    if (firebolt::rialto::KeySessionType::TEMPORARY != sessionType || isLDL || 0 == getKeySessionPoolSize())
     {
-        m_log << error << "Failed to initialize media keys - not possible to create media keys";
         return false;
     }
+    if (m_keySessionPool.empty())
+    {
+        Metrics::instance().add(MetricId::KEY_SESSION_POOL_MISSES);
+        refillKeySessionPool();
+        return false;
+    }
+    keySessionId = m_keySessionPool.front();
+    m_keySessionPool.pop_front();
+    // Pooled sessions are created in the background, from now on they are scheduled as their owner's
+    setPriority(keySessionId, priority);
+    Metrics::instance().add(MetricId::POOLED_KEY_SESSIONS, -1);
+    Metrics::instance().add(MetricId::KEY_SESSION_POOL_HITS);
+    Tracer::instance().addInstantEvent("pooledKeySession", nullptr, keySessionId);
+    RIALTO_LOG_FMT(m_log, debug, "Key session {} taken from the pool", keySessionId);
+    refillKeySessionPool();
     return true;
 }
+
+void CdmBackend::refillKeySessionPool()
+{
+    if (0 == getKeySessionPoolSize() || !m_mediaKeys)
+    {
+        return;
+    }
+    if (!m_poolThread.joinable())
+    {
+        m_isPoolRunning = true;
+        m_poolThread = std::thread(&CdmBackend::keySessionPoolLoop, this);
+    }
+    m_poolCv.notify_one();
+}
+
+void CdmBackend::clearKeySessionPool()
+{
+    Metrics::instance().add(MetricId::POOLED_KEY_SESSIONS, -static_cast<int64_t>(m_keySessionPool.size()));
+    for (int32_t keySessionId : m_keySessionPool)
+    {
+        if (m_mediaKeys)
+        {
+            RecordedCall call{CdmOperation::CLOSE_KEY_SESSION, keySessionId};
+            checkStatus(CdmOperation::CLOSE_KEY_SESSION, call.setStatus(m_mediaKeys->closeKeySession(keySessionId)));
+        }
+        eraseKeySession(keySessionId);
+    }
+    m_keySessionPool.clear();
+}
+
+void CdmBackend::keySessionPoolLoop()
+{
+    ProfiledLock lock{m_mutex};
+    const auto kIsRefillNeeded{[this]()
+                               { return m_mediaKeys && m_keySessionPool.size() < getKeySessionPoolSize(); }};
+    while (m_isPoolRunning)
+    {
+        m_poolCv.wait(lock, [&]() { return !m_isPoolRunning || kIsRefillNeeded(); });
+        if (!m_isPoolRunning)
+        {
+            break;
+        }
+        // Sessions are created one at a time with a BACKGROUND turn, so that app calls go first. The turn is
+        // never awaited with the lock held.
+        lock.unlock();
+        m_scheduler.acquire(SessionPriority::BACKGROUND);
+        lock.lock();
+        bool isCreated{true};
+        if (m_isPoolRunning && kIsRefillNeeded())
+        {
+            int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+            isCreated = executeCreateKeySession(firebolt::rialto::KeySessionType::TEMPORARY, false, false,
+                                                SessionPriority::BACKGROUND, keySessionId);
+            if (isCreated)
+            {
+                m_keySessionPool.push_back(keySessionId);
+                Metrics::instance().add(MetricId::POOLED_KEY_SESSIONS);
+            }
+        }
+        lock.unlock();
+        m_scheduler.release();
+        lock.lock();
+        if (!isCreated)
+        {
+            m_log << warn << RIALTO_LOG_LITERAL("Failed to create a pooled key session, retrying later");
+            m_poolCv.wait_for(lock, kPoolRetryDelay, [this]() { return !m_isPoolRunning; });
+        }
+    }
+}
+
+void CdmBackend::restoreLoop()
+{
+    ProfiledLock lock{m_mutex};
+    while (true)
+    {
+        m_restoreCv.wait(lock, [this]() { return !m_isRestoreRunning || m_isRestoreRequested; });
+        if (!m_isRestoreRunning)
+        {
+            break;
+        }
+        m_isRestoreRequested = false;
+        restore(lock);
+        m_isRestoring = m_isRestoreRequested;
+        m_restoreCv.notify_all();
+    }
+    m_isRestoring = false;
+    m_restoreCv.notify_all();
+}
+
+void CdmBackend::restore(ProfiledLock &lock)
+{
+    const uint64_t kAppStateChanges{m_appStateChanges};
+    // Backend calls made in the meantime fail or are queued, as they do while Rialto is INACTIVE
+    lock.unlock();
+    std::unique_ptr<firebolt::rialto::IMediaKeys> mediaKeys{createMediaKeys()};
+    lock.lock();
+    if (kAppStateChanges != m_appStateChanges || !m_isRestoreRunning)
+    {
+        // Rialto left RUNNING meanwhile, this MediaKeys is lost already
+        return;
+    }
+    if (!mediaKeys)
+    {
+        // Not initialized, so that the next RUNNING notification or initialize() tries again
+        m_appState = firebolt::rialto::ApplicationState::UNKNOWN;
+        return;
+    }
+    m_mediaKeys = std::move(mediaKeys);
+    const std::map<int32_t, int32_t> kNewKeySessionIds{restoreKeySessions()};
+    refillKeySessionPool();
+    replayPendingKeySessions(lock);
+    if (!kNewKeySessionIds.empty() && m_mediaKeysClient)
+    {
+        // Sessions are notified without the backend lock, they may be delivering a notification which calls the
+        // backend
+        if (lock.owns_lock())
+        {
+            lock.unlock();
+        }
+        m_mediaKeysClient->onKeySessionIdsChanged(kNewKeySessionIds);
+    }
+    if (!lock.owns_lock())
+    {
+        lock.lock();
+    }
+}
+
+std::map<int32_t, int32_t> CdmBackend::restoreKeySessions()
+{
+    std::map<int32_t, int32_t> newKeySessionIds;
+    if (m_keySessions.empty())
+    {
+        return newKeySessionIds;
+    }
+    TraceScope traceScope{"restoreKeySessions"};
+    std::map<int32_t, KeySessionInfo> lostKeySessions;
+    lostKeySessions.swap(m_keySessions);
+    for (const auto &[kOldKeySessionId, kInfo] : lostKeySessions)
+    {
+        m_scheduler.removePriority(kOldKeySessionId);
+    }
+    for (const auto &[kOldKeySessionId, kInfo] : lostKeySessions)
+    {
+        int32_t newKeySessionId{firebolt::rialto::kInvalidSessionId};
+        // Only persistent licenses survive MediaKeys, sessions of other types have to be negotiated again by the app
+        if (firebolt::rialto::KeySessionType::PERSISTENT_LICENCE == kInfo.sessionType && kInfo.hasStoredLicense &&
+            executeCreateKeySession(kInfo.sessionType, kInfo.isLDL, false, kInfo.priority, newKeySessionId))
+        {
+            RecordedCall call{CdmOperation::LOAD_SESSION, newKeySessionId};
+            if (checkStatus(CdmOperation::LOAD_SESSION, call.setStatus(m_mediaKeys->loadSession(newKeySessionId))))
+            {
+                setHasStoredLicense(newKeySessionId, true);
+            }
+            else
+            {
+                m_mediaKeys->closeKeySession(newKeySessionId);
+                eraseKeySession(newKeySessionId);
+                newKeySessionId = firebolt::rialto::kInvalidSessionId;
+            }
+        }
+        const bool kIsRestored{firebolt::rialto::kInvalidSessionId != newKeySessionId};
+        Metrics::instance().add(kIsRestored ? MetricId::RESTORED_KEY_SESSIONS : MetricId::LOST_KEY_SESSIONS);
+        RIALTO_LOG_FMT(m_log, info, "Key session {} after MediaKeys re-creation: {}", kOldKeySessionId,
+                       newKeySessionId);
+        newKeySessionIds.emplace(kOldKeySessionId, newKeySessionId);
+    }
+    // LDL sessions which were not restored are free again
+    m_ldlCv.notify_all();
+    return newKeySessionIds;
+}
+
+void CdmBackend::eraseKeySession(int32_t keySessionId)
+{
+    auto keySessionIter{m_keySessions.find(keySessionId)};
+    if (keySessionIter == m_keySessions.end())
+    {
+        return;
+    }
+    if (keySessionIter->second.isLDL)
+    {
+        // Wakes admitLdlSession waiters
+        m_ldlCv.notify_all();
+    }
+    m_keySessions.erase(keySessionIter);
+    m_scheduler.removePriority(keySessionId);
+}
+
+void CdmBackend::setPriority(int32_t keySessionId, SessionPriority priority)
+{
+    auto keySessionIter{m_keySessions.find(keySessionId)};
+    if (keySessionIter != m_keySessions.end())
+    {
+        keySessionIter->second.priority = priority;
+        m_scheduler.setPriority(keySessionId, priority);
+    }
+}
+
+void CdmBackend::setHasStoredLicense(int32_t keySessionId, bool hasStoredLicense)
+{
+    auto keySessionIter{m_keySessions.find(keySessionId)};
+    if (keySessionIter != m_keySessions.end())
+    {
+        keySessionIter->second.hasStoredLicense = hasStoredLicense;
+    }
+}
+
+std::unique_ptr<firebolt::rialto::IMediaKeys> CdmBackend::createMediaKeys()
+{
+    if (!m_mediaKeysFactory)
+    {
+        m_log << error << RIALTO_LOG_LITERAL("Failed to initialize media keys - not possible to create factory");
+        return nullptr;
+    }
+
+    TraceScope traceScope{"createMediaKeys"};
+    const uint64_t kStart{MediaKeysRecorder::now()};
+    std::unique_ptr<firebolt::rialto::IMediaKeys> mediaKeys{m_mediaKeysFactory->createMediaKeys(m_keySystem)};
+    MediaKeysRecorder::instance().recordCreateMediaKeys(m_keySystem, kStart, MediaKeysRecorder::now() - kStart,
+                                                        nullptr != mediaKeys);
+    if (!mediaKeys)
+    {
+        m_log << error << RIALTO_LOG_LITERAL("Failed to initialize media keys - not possible to create media keys");
+    }
+    return mediaKeys;
+}
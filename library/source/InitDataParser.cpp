@@ -0,0 +1,495 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InitDataParser.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+using KeyIds = std::vector<std::vector<uint8_t>>;
+
+constexpr size_t kKeyIdSize{16};
+constexpr size_t kMaxKeyIdSize{UINT8_MAX};
+constexpr size_t kBoxHeaderSize{8};
+constexpr size_t kLargeBoxHeaderSize{16};
+constexpr size_t kSystemIdSize{16};
+constexpr std::array<uint8_t, kSystemIdSize> kWidevineSystemId{0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce,
+                                                               0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed};
+constexpr std::array<uint8_t, kSystemIdSize> kPlayReadySystemId{0x9a, 0x04, 0xf0, 0x79, 0x98, 0x40, 0x42, 0x86,
+                                                                0xab, 0x92, 0xe6, 0x5b, 0xe0, 0x88, 0x5f, 0x95};
+constexpr uint64_t kWrmHeaderRecordType{1};
+constexpr uint64_t kWidevineKeyIdField{2};
+
+enum class WireType : uint64_t
+{
+    VARINT = 0,
+    FIXED64 = 1,
+    LENGTH_DELIMITED = 2,
+    FIXED32 = 5
+};
+
+/**
+ * Bounds checked reads from a part of the init data.
+ */
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t *data, size_t size) : m_data{data}, m_size{size}, m_offset{0} {}
+
+    size_t remaining() const { return m_size - m_offset; }
+    const uint8_t *current() const { return m_data + m_offset; }
+
+    bool skip(uint64_t count)
+    {
+        if (count > remaining())
+        {
+            return false;
+        }
+        m_offset += count;
+        return true;
+    }
+
+    bool readBigEndian(size_t count, uint64_t &value)
+    {
+        if (count > remaining())
+        {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            value = (value << 8) | m_data[m_offset++];
+        }
+        return true;
+    }
+
+    bool readLittleEndian(size_t count, uint64_t &value)
+    {
+        if (count > remaining())
+        {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            value |= static_cast<uint64_t>(m_data[m_offset++]) << (8 * i);
+        }
+        return true;
+    }
+
+    bool readVarint(uint64_t &value)
+    {
+        value = 0;
+        for (size_t shift = 0; shift < 64 && m_offset < m_size; shift += 7)
+        {
+            const uint8_t kByte{m_data[m_offset++]};
+            value |= static_cast<uint64_t>(kByte & 0x7f) << shift;
+            if (0 == (kByte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_offset;
+};
+
+/**
+ * Text of a WRM header, read a character at a time so that UTF-16 headers need no conversion. Characters outside
+ * ASCII read as '\0', as the parser only looks for ASCII.
+ */
+class XmlText
+{
+public:
+    static constexpr size_t kNotFound{static_cast<size_t>(-1)};
+
+    XmlText(const uint8_t *data, size_t size) : m_data{data}, m_charSize{1}
+    {
+        // UTF-16 (little-endian) headers start with a byte order mark, or with '<' followed by a zero byte
+        if (size >= 2 && ((0xff == data[0] && 0xfe == data[1]) || 0 == data[1]))
+        {
+            m_charSize = 2;
+        }
+        m_length = size / m_charSize;
+    }
+
+    char at(size_t index) const
+    {
+        if (index >= m_length)
+        {
+            return '\0';
+        }
+        const uint8_t *kCharacter{m_data + index * m_charSize};
+        if ((2 == m_charSize && 0 != kCharacter[1]) || kCharacter[0] >= 0x80)
+        {
+            return '\0';
+        }
+        return static_cast<char>(kCharacter[0]);
+    }
+
+    size_t find(std::string_view text, size_t from) const
+    {
+        for (size_t i = from; i + text.size() <= m_length; ++i)
+        {
+            size_t matched{0};
+            while (matched < text.size() && at(i + matched) == text[matched])
+            {
+                ++matched;
+            }
+            if (matched == text.size())
+            {
+                return i;
+            }
+        }
+        return kNotFound;
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_charSize;
+    size_t m_length;
+};
+
+void addKeyId(KeyIds &keyIds, const uint8_t *keyId, size_t size)
+{
+    if (0 == size || size > kMaxKeyIdSize)
+    {
+        return;
+    }
+    if (std::none_of(keyIds.begin(), keyIds.end(), [&](const std::vector<uint8_t> &known)
+                     { return std::equal(known.begin(), known.end(), keyId, keyId + size); }))
+    {
+        keyIds.emplace_back(keyId, keyId + size);
+    }
+}
+
+int getBase64Value(char character)
+{
+    if (character >= 'A' && character <= 'Z')
+    {
+        return character - 'A';
+    }
+    if (character >= 'a' && character <= 'z')
+    {
+        return character - 'a' + 26;
+    }
+    if (character >= '0' && character <= '9')
+    {
+        return character - '0' + 52;
+    }
+    if ('+' == character || '-' == character)
+    {
+        return 62;
+    }
+    if ('/' == character || '_' == character)
+    {
+        return 63;
+    }
+    return -1;
+}
+
+bool decodeKeyId(const XmlText &text, size_t begin, size_t end, std::array<uint8_t, kKeyIdSize> &keyId)
+{
+    uint32_t bits{0};
+    size_t bitCount{0};
+    size_t size{0};
+    for (size_t i = begin; i < end; ++i)
+    {
+        const char kCharacter{text.at(i)};
+        if ('=' == kCharacter)
+        {
+            break;
+        }
+        const int kValue{getBase64Value(kCharacter)};
+        if (kValue < 0)
+        {
+            if (' ' == kCharacter || '\t' == kCharacter || '\r' == kCharacter || '\n' == kCharacter)
+            {
+                continue;
+            }
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(kValue);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            if (kKeyIdSize == size)
+            {
+                return false;
+            }
+            keyId[size++] = static_cast<uint8_t>(bits >> bitCount);
+            bits &= (1u << bitCount) - 1;
+        }
+    }
+    return kKeyIdSize == size;
+}
+
+/**
+ * PlayReady stores key IDs as base64 encoded GUIDs, whose first three fields are little-endian.
+ */
+void addPlayReadyKeyId(KeyIds &keyIds, const XmlText &text, size_t begin, size_t end)
+{
+    std::array<uint8_t, kKeyIdSize> keyId{};
+    if (!decodeKeyId(text, begin, end, keyId))
+    {
+        return;
+    }
+    std::reverse(keyId.begin(), keyId.begin() + 4);
+    std::reverse(keyId.begin() + 4, keyId.begin() + 6);
+    std::reverse(keyId.begin() + 6, keyId.begin() + 8);
+    addKeyId(keyIds, keyId.data(), keyId.size());
+}
+
+/**
+ * Key IDs are either the content of <KID> elements (header version 4.0), or the VALUE attribute of <KID> elements
+ * (version 4.1 and later, where version 4.2 lists them in <KIDS>).
+ */
+void parseWrmHeader(const uint8_t *data, size_t size, KeyIds &keyIds)
+{
+    const XmlText kText{data, size};
+    size_t position{kText.find("<KID", 0)};
+    while (XmlText::kNotFound != position)
+    {
+        const size_t kNameEnd{position + 4};
+        const size_t kTagEnd{kText.find(">", kNameEnd)};
+        if (XmlText::kNotFound == kTagEnd)
+        {
+            return;
+        }
+        const char kNext{kText.at(kNameEnd)};
+        if ('>' == kNext || '/' == kNext || ' ' == kNext || '\t' == kNext || '\r' == kNext || '\n' == kNext)
+        {
+            size_t valueBegin{kTagEnd + 1};
+            size_t valueEnd{kText.find("<", valueBegin)};
+            const size_t kAttribute{kText.find("VALUE=\"", kNameEnd)};
+            if (kAttribute < kTagEnd)
+            {
+                valueBegin = kAttribute + 7;
+                valueEnd = kText.find("\"", valueBegin);
+            }
+            if (XmlText::kNotFound == valueEnd)
+            {
+                return;
+            }
+            addPlayReadyKeyId(keyIds, kText, valueBegin, valueEnd);
+        }
+        position = kText.find("<KID", kTagEnd);
+    }
+}
+
+/**
+ * A PlayReady Object holds records, of which the WRM header ones have the key IDs. Anything else is taken for a bare
+ * WRM header.
+ */
+void parsePlayReadyHeader(const uint8_t *data, size_t size, KeyIds &keyIds)
+{
+    ByteReader reader{data, size};
+    uint64_t length{0};
+    uint64_t recordCount{0};
+    if (!reader.readLittleEndian(4, length) || length != size || !reader.readLittleEndian(2, recordCount))
+    {
+        parseWrmHeader(data, size, keyIds);
+        return;
+    }
+    for (uint64_t i = 0; i < recordCount; ++i)
+    {
+        uint64_t type{0};
+        uint64_t recordLength{0};
+        if (!reader.readLittleEndian(2, type) || !reader.readLittleEndian(2, recordLength) ||
+            recordLength > reader.remaining())
+        {
+            return;
+        }
+        if (kWrmHeaderRecordType == type)
+        {
+            parseWrmHeader(reader.current(), recordLength, keyIds);
+        }
+        reader.skip(recordLength);
+    }
+}
+
+/**
+ * Widevine pssh data is a WidevinePsshData protocol buffer, listing key IDs in field 2.
+ */
+void parseWidevinePsshData(ByteReader reader, KeyIds &keyIds)
+{
+    uint64_t tag{0};
+    while (reader.remaining() > 0 && reader.readVarint(tag))
+    {
+        uint64_t value{0};
+        switch (static_cast<WireType>(tag & 0x7))
+        {
+        case WireType::VARINT:
+        {
+            if (!reader.readVarint(value))
+            {
+                return;
+            }
+            break;
+        }
+        case WireType::FIXED64:
+        {
+            if (!reader.skip(8))
+            {
+                return;
+            }
+            break;
+        }
+        case WireType::LENGTH_DELIMITED:
+        {
+            if (!reader.readVarint(value) || value > reader.remaining())
+            {
+                return;
+            }
+            if (kWidevineKeyIdField == (tag >> 3) && kKeyIdSize == value)
+            {
+                addKeyId(keyIds, reader.current(), kKeyIdSize);
+            }
+            reader.skip(value);
+            break;
+        }
+        case WireType::FIXED32:
+        {
+            if (!reader.skip(4))
+            {
+                return;
+            }
+            break;
+        }
+        default:
+        {
+            return;
+        }
+        }
+    }
+}
+
+void parsePsshBox(ByteReader box, KeyIds &keyIds)
+{
+    uint64_t version{0};
+    if (!box.readBigEndian(1, version) || !box.skip(3) || box.remaining() < kSystemIdSize)
+    {
+        return;
+    }
+    const uint8_t *kSystemId{box.current()};
+    box.skip(kSystemIdSize);
+    uint64_t keyIdCount{0};
+    if (version > 0)
+    {
+        if (!box.readBigEndian(4, keyIdCount) || keyIdCount > box.remaining() / kKeyIdSize)
+        {
+            return;
+        }
+        for (uint64_t i = 0; i < keyIdCount; ++i)
+        {
+            addKeyId(keyIds, box.current(), kKeyIdSize);
+            box.skip(kKeyIdSize);
+        }
+    }
+    uint64_t dataSize{0};
+    if (0 != keyIdCount || !box.readBigEndian(4, dataSize) || dataSize > box.remaining())
+    {
+        return;
+    }
+    // Without a KID list, the key IDs are only found in the DRM system specific data
+    if (std::equal(kWidevineSystemId.begin(), kWidevineSystemId.end(), kSystemId))
+    {
+        parseWidevinePsshData(ByteReader{box.current(), dataSize}, keyIds);
+    }
+    else if (std::equal(kPlayReadySystemId.begin(), kPlayReadySystemId.end(), kSystemId))
+    {
+        parsePlayReadyHeader(box.current(), dataSize, keyIds);
+    }
+}
+
+void parsePsshBoxes(const std::vector<uint8_t> &initData, KeyIds &keyIds)
+{
+    ByteReader reader{initData.data(), initData.size()};
+    while (reader.remaining() >= kBoxHeaderSize)
+    {
+        const uint8_t *kBox{reader.current()};
+        const size_t kRemaining{reader.remaining()};
+        uint64_t boxSize{0};
+        reader.readBigEndian(4, boxSize);
+        const bool kIsPssh{0 == std::memcmp(reader.current(), "pssh", 4)};
+        reader.skip(4);
+        size_t headerSize{kBoxHeaderSize};
+        if (1 == boxSize)
+        {
+            if (!reader.readBigEndian(8, boxSize))
+            {
+                return;
+            }
+            headerSize = kLargeBoxHeaderSize;
+        }
+        else if (0 == boxSize)
+        {
+            // The last box may extend to the end of the data
+            boxSize = kRemaining;
+        }
+        if (boxSize < headerSize || boxSize > kRemaining)
+        {
+            return;
+        }
+        if (kIsPssh)
+        {
+            parsePsshBox(ByteReader{kBox + headerSize, boxSize - headerSize}, keyIds);
+        }
+        reader.skip(boxSize - headerSize);
+    }
+}
+} // namespace
+
+std::vector<std::vector<uint8_t>> parseKeyIds(firebolt::rialto::InitDataType initDataType,
+                                              const std::vector<uint8_t> &initData)
+{
+    KeyIds keyIds;
+    switch (initDataType)
+    {
+    case firebolt::rialto::InitDataType::CENC:
+    {
+        parsePsshBoxes(initData, keyIds);
+        break;
+    }
+    case firebolt::rialto::InitDataType::WEBM:
+    {
+        addKeyId(keyIds, initData.data(), initData.size());
+        break;
+    }
+    case firebolt::rialto::InitDataType::DRMHEADER:
+    {
+        parsePlayReadyHeader(initData.data(), initData.size(), keyIds);
+        break;
+    }
+    default:
+    {
+        break;
+    }
+    }
+    return keyIds;
+}
@@ -0,0 +1,358 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyStats.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+constexpr uint64_t kDefaultDumpIntervalS{60};
+constexpr uint64_t kNsPerS{1000000000};
+constexpr uint64_t kNsPerUs{1000};
+
+const Logger kLog{"LatencyStats"};
+
+uint64_t getDumpIntervalNs()
+{
+    const char *interval{getenv("RIALTO_LATENCY_STATS_INTERVAL")};
+    if (!interval)
+    {
+        return kDefaultDumpIntervalS * kNsPerS;
+    }
+    return std::strtoull(interval, nullptr, 10) * kNsPerS;
+}
+
+uint64_t nowNs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/**
+ * Registers the histograms of the current thread on first use and folds them into the shared set on thread exit.
+ * The histograms live on the heap, the library may be loaded with dlopen() and has little static TLS available.
+ */
+class ThreadHistogramsHolder
+{
+public:
+    ThreadHistogramsHolder() : m_histograms{std::make_unique<LatencyStats::ThreadHistograms>()}
+    {
+        LatencyStats::instance().registerThread(m_histograms.get());
+    }
+    ~ThreadHistogramsHolder() { LatencyStats::instance().unregisterThread(m_histograms.get()); }
+
+    LatencyStats::ThreadHistograms &histograms() { return *m_histograms; }
+
+private:
+    std::unique_ptr<LatencyStats::ThreadHistograms> m_histograms;
+};
+
+void addTo(const LatencyStats::ThreadHistograms &histograms, size_t index, LatencySnapshot &lockWait,
+           LatencySnapshot &callTime)
+{
+    histograms.lockWait[index].addTo(lockWait);
+    histograms.callTime[index].addTo(callTime);
+}
+
+void addPriorityTo(const LatencyStats::ThreadHistograms &histograms, size_t index, LatencySnapshot &lockWait,
+                   LatencySnapshot &callTime)
+{
+    histograms.priorityLockWait[index].addTo(lockWait);
+    histograms.priorityCallTime[index].addTo(callTime);
+}
+} // namespace
+
+const char *toString(CdmOperation operation)
+{
+    switch (operation)
+    {
+    case CdmOperation::SELECT_KEY_ID:
+        return "selectKeyId";
+    case CdmOperation::CONTAINS_KEY:
+        return "containsKey";
+    case CdmOperation::CREATE_KEY_SESSION:
+        return "createKeySession";
+    case CdmOperation::GENERATE_REQUEST:
+        return "generateRequest";
+    case CdmOperation::LOAD_SESSION:
+        return "loadSession";
+    case CdmOperation::UPDATE_SESSION:
+        return "updateSession";
+    case CdmOperation::SET_DRM_HEADER:
+        return "setDrmHeader";
+    case CdmOperation::CLOSE_KEY_SESSION:
+        return "closeKeySession";
+    case CdmOperation::REMOVE_KEY_SESSION:
+        return "removeKeySession";
+    case CdmOperation::DELETE_DRM_STORE:
+        return "deleteDrmStore";
+    case CdmOperation::DELETE_KEY_STORE:
+        return "deleteKeyStore";
+    case CdmOperation::GET_DRM_STORE_HASH:
+        return "getDrmStoreHash";
+    case CdmOperation::GET_KEY_STORE_HASH:
+        return "getKeyStoreHash";
+    case CdmOperation::GET_LDL_SESSIONS_LIMIT:
+        return "getLdlSessionsLimit";
+    case CdmOperation::GET_LAST_DRM_ERROR:
+        return "getLastDrmError";
+    case CdmOperation::GET_DRM_TIME:
+        return "getDrmTime";
+    case CdmOperation::GET_CDM_KEY_SESSION_ID:
+        return "getCdmKeySessionId";
+    case CdmOperation::COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+size_t LatencySnapshot::bucketIndex(uint64_t valueNs)
+{
+    if (valueNs < kSubBuckets)
+    {
+        return static_cast<size_t>(valueNs);
+    }
+    const size_t kMostSignificantBit{static_cast<size_t>(63 - __builtin_clzll(valueNs))};
+    if (kMostSignificantBit >= kMaxBits)
+    {
+        return kBuckets - 1;
+    }
+    // The two bits below the most significant one select the linear bucket
+    static_assert(4 == kSubBuckets, "Sub-bucket selection assumes four sub-buckets");
+    const size_t kSubBucket{static_cast<size_t>(valueNs >> (kMostSignificantBit - 2)) & (kSubBuckets - 1)};
+    return (kMostSignificantBit - 1) * kSubBuckets + kSubBucket;
+}
+
+uint64_t LatencySnapshot::bucketUpperBound(size_t index)
+{
+    if (index < kSubBuckets)
+    {
+        return index;
+    }
+    const size_t kShift{index / kSubBuckets - 1};
+    const uint64_t kLowerBound{static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << kShift};
+    return kLowerBound + (uint64_t{1} << kShift) - 1;
+}
+
+uint64_t LatencySnapshot::percentile(double fraction) const
+{
+    if (0 == count)
+    {
+        return 0;
+    }
+    const uint64_t kRank{std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5))};
+    uint64_t seen{0};
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= kRank)
+        {
+            return std::min(bucketUpperBound(i), maxNs);
+        }
+    }
+    return maxNs;
+}
+
+void LatencyHistogram::record(uint64_t valueNs)
+{
+    increment(m_buckets[LatencySnapshot::bucketIndex(valueNs)], 1);
+    increment(m_totalNs, valueNs);
+    if (valueNs > m_maxNs.load(std::memory_order_relaxed))
+    {
+        m_maxNs.store(valueNs, std::memory_order_relaxed);
+    }
+    // Published last, so that a reader never sees more calls than bucket entries
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LatencyHistogram::reset()
+{
+    m_count.store(0, std::memory_order_relaxed);
+    m_totalNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+    for (auto &bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::addTo(LatencySnapshot &snapshot) const
+{
+    snapshot.count += m_count.load(std::memory_order_acquire);
+    snapshot.totalNs += m_totalNs.load(std::memory_order_relaxed);
+    snapshot.maxNs = std::max(snapshot.maxNs, m_maxNs.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < LatencySnapshot::kBuckets; ++i)
+    {
+        snapshot.buckets[i] += m_buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+LatencyStats &LatencyStats::instance()
+{
+    static LatencyStats latencyStats;
+    return latencyStats;
+}
+
+LatencyStats::LatencyStats() : m_dumpIntervalNs{getDumpIntervalNs()}, m_nextDumpNs{nowNs() + m_dumpIntervalNs} {}
+
+void LatencyStats::record(CdmOperation operation, SessionPriority priority, uint64_t lockWaitNs, uint64_t callTimeNs)
+{
+    thread_local ThreadHistogramsHolder holder;
+    const size_t kIndex{static_cast<size_t>(operation)};
+    holder.histograms().lockWait[kIndex].record(lockWaitNs);
+    holder.histograms().callTime[kIndex].record(callTimeNs);
+    const size_t kPriorityIndex{static_cast<size_t>(priority)};
+    holder.histograms().priorityLockWait[kPriorityIndex].record(lockWaitNs);
+    holder.histograms().priorityCallTime[kPriorityIndex].record(callTimeNs);
+
+    if (0 != m_dumpIntervalNs)
+    {
+        dumpIfDue(nowNs());
+    }
+}
+
+void LatencyStats::getStats(CdmOperation operation, LatencySnapshot &lockWait, LatencySnapshot &callTime)
+{
+    const size_t kIndex{static_cast<size_t>(operation)};
+    std::unique_lock<std::mutex> lock{m_mutex};
+    lockWait = m_finishedLockWait[kIndex];
+    callTime = m_finishedCallTime[kIndex];
+    for (const ThreadHistograms *histograms : m_threadHistograms)
+    {
+        addTo(*histograms, kIndex, lockWait, callTime);
+    }
+}
+
+void LatencyStats::getStats(SessionPriority priority, LatencySnapshot &lockWait, LatencySnapshot &callTime)
+{
+    const size_t kIndex{static_cast<size_t>(priority)};
+    std::unique_lock<std::mutex> lock{m_mutex};
+    lockWait = m_finishedPriorityLockWait[kIndex];
+    callTime = m_finishedPriorityCallTime[kIndex];
+    for (const ThreadHistograms *histograms : m_threadHistograms)
+    {
+        addPriorityTo(*histograms, kIndex, lockWait, callTime);
+    }
+}
+
+void LatencyStats::dumpToLog()
+{
+    if (!kLog.isEnabled(info))
+    {
+        return;
+    }
+    for (size_t i = 0; i < static_cast<size_t>(CdmOperation::COUNT); ++i)
+    {
+        LatencySnapshot lockWait;
+        LatencySnapshot callTime;
+        getStats(static_cast<CdmOperation>(i), lockWait, callTime);
+        if (0 == callTime.count)
+        {
+            continue;
+        }
+        RIALTO_LOG_FMT(kLog, info,
+                       "{}: calls {}, call us p50 {} p99 {} max {}, lock wait us p50 {} p99 {} max {} total {}",
+                       toString(static_cast<CdmOperation>(i)), callTime.count, callTime.percentile(0.5) / kNsPerUs,
+                       callTime.percentile(0.99) / kNsPerUs, callTime.maxNs / kNsPerUs,
+                       lockWait.percentile(0.5) / kNsPerUs, lockWait.percentile(0.99) / kNsPerUs,
+                       lockWait.maxNs / kNsPerUs, lockWait.totalNs / kNsPerUs);
+    }
+    for (size_t i = 0; i < kSessionPriorityCount; ++i)
+    {
+        LatencySnapshot lockWait;
+        LatencySnapshot callTime;
+        getStats(static_cast<SessionPriority>(i), lockWait, callTime);
+        if (0 == callTime.count)
+        {
+            continue;
+        }
+        RIALTO_LOG_FMT(kLog, info, "{} priority: calls {}, call us p50 {} p99 {}, lock wait us p50 {} p99 {} max {}",
+                       toString(static_cast<SessionPriority>(i)), callTime.count, callTime.percentile(0.5) / kNsPerUs,
+                       callTime.percentile(0.99) / kNsPerUs, lockWait.percentile(0.5) / kNsPerUs,
+                       lockWait.percentile(0.99) / kNsPerUs, lockWait.maxNs / kNsPerUs);
+    }
+}
+
+void LatencyStats::reset()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_finishedLockWait = {};
+    m_finishedCallTime = {};
+    m_finishedPriorityLockWait = {};
+    m_finishedPriorityCallTime = {};
+    for (ThreadHistograms *histograms : m_threadHistograms)
+    {
+        // Histograms of other threads are only written by them, so this is only exact while no call is in progress
+        for (size_t i = 0; i < static_cast<size_t>(CdmOperation::COUNT); ++i)
+        {
+            histograms->lockWait[i].reset();
+            histograms->callTime[i].reset();
+        }
+        for (size_t i = 0; i < kSessionPriorityCount; ++i)
+        {
+            histograms->priorityLockWait[i].reset();
+            histograms->priorityCallTime[i].reset();
+        }
+    }
+}
+
+void LatencyStats::registerThread(ThreadHistograms *histograms)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_threadHistograms.push_back(histograms);
+}
+
+void LatencyStats::unregisterThread(ThreadHistograms *histograms)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    for (size_t i = 0; i < static_cast<size_t>(CdmOperation::COUNT); ++i)
+    {
+        addTo(*histograms, i, m_finishedLockWait[i], m_finishedCallTime[i]);
+    }
+    for (size_t i = 0; i < kSessionPriorityCount; ++i)
+    {
+        addPriorityTo(*histograms, i, m_finishedPriorityLockWait[i], m_finishedPriorityCallTime[i]);
+    }
+    m_threadHistograms.erase(std::remove(m_threadHistograms.begin(), m_threadHistograms.end(), histograms),
+                             m_threadHistograms.end());
+}
+
+void LatencyStats::dumpIfDue(uint64_t nowNs)
+{
+    uint64_t nextDumpNs{m_nextDumpNs.load(std::memory_order_relaxed)};
+    if (nowNs < nextDumpNs ||
+        !m_nextDumpNs.compare_exchange_strong(nextDumpNs, nowNs + m_dumpIntervalNs, std::memory_order_relaxed))
+    {
+        return;
+    }
+    dumpToLog();
+}
+
+LatencyTimer::~LatencyTimer()
+{
+    const auto kEnd{std::chrono::steady_clock::now()};
+    LatencyStats::instance().record(
+        m_operation, m_priority,
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(m_lockAcquired - m_start).count()),
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(kEnd - m_lockAcquired).count()));
+}
@@ -0,0 +1,213 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+#ifdef RIALTO_ENABLE_LOCK_PROFILING
+uint64_t nowNs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+#endif
+
+double toMs(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000000.0;
+}
+
+double toUs(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000.0;
+}
+} // namespace
+
+void LockProfile::recordAcquisition(uint64_t waitNs)
+{
+    m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (0 != waitNs)
+    {
+        m_contentions.fetch_add(1, std::memory_order_relaxed);
+        m_totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+        updateMax(m_maxWaitNs, waitNs);
+    }
+}
+
+void LockProfile::recordRelease(uint64_t holdNs)
+{
+    m_totalHoldNs.fetch_add(holdNs, std::memory_order_relaxed);
+    updateMax(m_maxHoldNs, holdNs);
+}
+
+void LockProfile::updateMax(std::atomic<uint64_t> &max, uint64_t value)
+{
+    uint64_t current{max.load(std::memory_order_relaxed)};
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+LockProfiler &LockProfiler::instance()
+{
+    static LockProfiler lockProfiler;
+    return lockProfiler;
+}
+
+LockProfiler::~LockProfiler()
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    const char *kPath{getenv("RIALTO_LOCK_PROFILE_PATH")};
+    dump(kPath && '\0' != kPath[0] ? kPath : nullptr);
+}
+
+LockProfile &LockProfiler::getProfile(const std::string &name)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto profileIter{std::find_if(m_profiles.begin(), m_profiles.end(),
+                                  [&](const LockProfile &profile) { return profile.name() == name; })};
+    if (profileIter != m_profiles.end())
+    {
+        return *profileIter;
+    }
+    return m_profiles.emplace_back(name);
+}
+
+std::vector<LockProfileSnapshot> LockProfiler::getSnapshots()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    std::vector<LockProfileSnapshot> snapshots;
+    for (const LockProfile &profile : m_profiles)
+    {
+        LockProfileSnapshot snapshot;
+        snapshot.name = profile.m_name;
+        snapshot.acquisitions = profile.m_acquisitions.load(std::memory_order_relaxed);
+        snapshot.contentions = profile.m_contentions.load(std::memory_order_relaxed);
+        snapshot.totalWaitNs = profile.m_totalWaitNs.load(std::memory_order_relaxed);
+        snapshot.maxWaitNs = profile.m_maxWaitNs.load(std::memory_order_relaxed);
+        snapshot.totalHoldNs = profile.m_totalHoldNs.load(std::memory_order_relaxed);
+        snapshot.maxHoldNs = profile.m_maxHoldNs.load(std::memory_order_relaxed);
+        snapshots.push_back(snapshot);
+    }
+    return snapshots;
+}
+
+std::string LockProfiler::report()
+{
+    std::vector<LockProfileSnapshot> snapshots{getSnapshots()};
+    // Most waited for locks first
+    std::stable_sort(snapshots.begin(), snapshots.end(),
+                     [](const LockProfileSnapshot &lhs, const LockProfileSnapshot &rhs)
+                     { return lhs.totalWaitNs > rhs.totalWaitNs; });
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-24s %12s %12s %14s %12s %14s %12s\n", "lock", "acquisitions", "contended",
+                  "wait total ms", "wait max us", "hold total ms", "hold max us");
+    std::string result{line};
+    for (const LockProfileSnapshot &snapshot : snapshots)
+    {
+        std::snprintf(line, sizeof(line), "%-24s %12" PRIu64 " %12" PRIu64 " %14.3f %12.1f %14.3f %12.1f\n",
+                      snapshot.name.c_str(), snapshot.acquisitions, snapshot.contentions, toMs(snapshot.totalWaitNs),
+                      toUs(snapshot.maxWaitNs), toMs(snapshot.totalHoldNs), toUs(snapshot.maxHoldNs));
+        result += line;
+    }
+    return result;
+}
+
+bool LockProfiler::dump(const char *path)
+{
+    FILE *file{path ? std::fopen(path, "w") : stderr};
+    if (!file)
+    {
+        return false;
+    }
+    const std::string kReport{report()};
+    const bool kResult{kReport.size() == std::fwrite(kReport.data(), 1, kReport.size(), file)};
+    if (path)
+    {
+        std::fclose(file);
+    }
+    else
+    {
+        std::fflush(file);
+    }
+    return kResult;
+}
+
+void LockProfiler::reset()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    for (LockProfile &profile : m_profiles)
+    {
+        profile.m_acquisitions.store(0, std::memory_order_relaxed);
+        profile.m_contentions.store(0, std::memory_order_relaxed);
+        profile.m_totalWaitNs.store(0, std::memory_order_relaxed);
+        profile.m_maxWaitNs.store(0, std::memory_order_relaxed);
+        profile.m_totalHoldNs.store(0, std::memory_order_relaxed);
+        profile.m_maxHoldNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+#ifdef RIALTO_ENABLE_LOCK_PROFILING
+void ProfiledMutex::lock()
+{
+    uint64_t waitNs{0};
+    if (!m_mutex.try_lock())
+    {
+        const uint64_t kWaitStartNs{nowNs()};
+        m_mutex.lock();
+        m_acquiredNs = nowNs();
+        // A contended acquisition never counts as zero wait
+        waitNs = std::max<uint64_t>(m_acquiredNs - kWaitStartNs, 1);
+    }
+    else
+    {
+        m_acquiredNs = nowNs();
+    }
+    m_profile.recordAcquisition(waitNs);
+}
+
+// NOLINTNEXTLINE(build/function_format) - name required by the Lockable requirements
+bool ProfiledMutex::try_lock()
+{
+    if (!m_mutex.try_lock())
+    {
+        return false;
+    }
+    m_acquiredNs = nowNs();
+    m_profile.recordAcquisition(0);
+    return true;
+}
+
+void ProfiledMutex::unlock()
+{
+    m_profile.recordRelease(nowNs() - m_acquiredNs);
+    m_mutex.unlock();
+}
+#endif
@@ -18,35 +18,54 @@
  */
 
 #include "Logger.h"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fcntl.h>
 #include <iomanip>
 #include <iostream>
 #include <syslog.h>
 #include <unistd.h>
+#include <vector>
 
 namespace
 {
-Severity getLogLevel()
+constexpr int kDefaultLogLevel{Severity::warn};
+constexpr uint64_t kDefaultMaxLogFileSize{8 * 1024 * 1024};
+constexpr uint64_t kDefaultMaxLogFiles{3};
+constexpr size_t kLogFlushThreshold{64 * 1024};
+constexpr size_t kMaxLogBufferSize{1024 * 1024};
+constexpr std::chrono::milliseconds kLogFlushInterval{500};
+// Components registered after the table is full share the last slot, which always uses the global level
+constexpr uint32_t kSharedComponentId{LogLevels::kMaxComponents - 1};
+
+bool parseLogLevel(const std::string &text, int &level)
 {
-    const char *debugVar = getenv("RIALTO_DEBUG");
-    if (debugVar)
+    if (1 != text.size() || text[0] < '0' + Severity::fatal || text[0] > '0' + Severity::debug)
+    {
+        return false;
+    }
+    level = text[0] - '0';
+    return true;
+}
+
+uint64_t getEnvNumber(const char *name, uint64_t defaultValue)
+{
+    const char *value = getenv(name);
+    if (value)
     {
-        std::string varStr{debugVar};
-        if ("0" == varStr)
-            return Severity::fatal;
-        if ("1" == varStr)
-            return Severity::error;
-        if ("2" == varStr)
-            return Severity::warn;
-        if ("3" == varStr)
-            return Severity::mil;
-        if ("4" == varStr)
-            return Severity::info;
-        if ("5" == varStr)
-            return Severity::debug;
+        char *end{nullptr};
+        const unsigned long long kResult{std::strtoull(value, &end, 10)}; // NOLINT(runtime/int)
+        if (end != value && '\0' == *end)
+        {
+            return kResult;
+        }
     }
-    return Severity::warn;
+    return defaultValue;
 }
 
 bool isConsoleLogEnabled()
@@ -54,7 +73,7 @@ bool isConsoleLogEnabled()
     const char *debugVar = getenv("RIALTO_CONSOLE_LOG");
     if (debugVar)
     {
-        return std::string(debugVar) == "1";
+        return std::strcmp(debugVar, "1") == 0;
     }
     return false;
 }
@@ -69,7 +88,17 @@ std::string getRialtoLogPath()
     return "";
 }
 
-std::string toString(const Severity &severity)
+bool isBinaryLogFormatEnabled()
+{
+    const char *logFormatEnvVar = getenv("RIALTO_LOG_FORMAT");
+    if (logFormatEnvVar)
+    {
+        return std::string(logFormatEnvVar) == "binary";
+    }
+    return false;
+}
+
+const char *toString(const Severity &severity)
 {
     if (Severity::fatal == severity)
         return "ftl";
@@ -86,6 +115,29 @@ std::string toString(const Severity &severity)
     return "???";
 }
 
+int64_t getSteadyTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Rate limiters with dropped messages that have not been reported yet.
+ */
+struct PendingRateLimiters
+{
+    std::mutex mutex;
+    std::vector<LogRateLimiter *> limiters;
+    std::atomic<size_t> count{0};
+};
+
+PendingRateLimiters &getPendingRateLimiters()
+{
+    // Never destroyed - static limiters may still log while other static objects are torn down
+    static PendingRateLimiters *pendingRateLimiters{new PendingRateLimiters};
+    return *pendingRateLimiters;
+}
+
 int convertSeverity(const Severity &severity)
 {
     switch (severity)
@@ -113,16 +165,32 @@ LogFile &LogFile::instance()
     return logFile;
 }
 
-bool LogFile::write(const std::string &line)
+bool LogFile::write(std::string_view line, const Severity &severity)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
-    m_file << line << std::endl;
+    ProfiledLock lock{m_mutex};
+    if (m_buffer.size() + line.size() + 1 > kMaxLogBufferSize)
+    {
+        ++m_droppedLines;
+        return false;
+    }
+    m_buffer += line;
+    m_buffer += '\n';
+    if (severity <= Severity::error)
+    {
+        // Written and synced right away by the writer thread, so that the last lines before a crash are not lost
+        m_isFlushRequested = true;
+        m_cv.notify_one();
+    }
+    else if (m_buffer.size() >= kLogFlushThreshold)
+    {
+        m_cv.notify_one();
+    }
     return true;
 }
 
 bool LogFile::isEnabled() const
 {
-    return m_file.is_open();
+    return m_isEnabled;
 }
 
 void LogFile::reset()
@@ -132,6 +200,8 @@ void LogFile::reset()
 }
 
 LogFile::LogFile()
+    : m_isEnabled{false}, m_isRunning{false}, m_droppedLines{0}, m_isFlushRequested{false}, m_fd{-1},
+      m_maxFileSize{0}, m_maxFiles{1}, m_fileSize{0}
 {
     tryOpenFile();
 }
@@ -144,25 +214,359 @@ LogFile::~LogFile()
 void LogFile::tryOpenFile()
 {
     std::string logPath{getRialtoLogPath()};
-    if (!logPath.empty())
+    if (!logPath.empty() && !isBinaryLogFormatEnabled())
     {
         // Add suffix to have rialto client and rialto ocdm logs in separate files
-        logPath += ".ocdm";
-        m_file = std::fstream(logPath, std::fstream::out);
+        m_path = logPath + ".ocdm";
+        m_maxFileSize = getEnvNumber("RIALTO_LOG_MAX_SIZE", kDefaultMaxLogFileSize);
+        m_maxFiles = static_cast<uint32_t>(
+            std::max<uint64_t>(getEnvNumber("RIALTO_LOG_MAX_FILES", kDefaultMaxLogFiles), 1));
+
+        // Keep the log of the previous run instead of truncating it
+        rotate();
+        if (m_fd < 0)
+        {
+            return;
+        }
+        m_buffer.reserve(kLogFlushThreshold);
+        m_writeBuffer.reserve(kLogFlushThreshold);
+        m_isRunning = true;
+        m_isEnabled = true;
+        m_writerThread = std::thread(&LogFile::writerLoop, this);
     }
 }
 
 void LogFile::tryCloseFile()
 {
-    if (m_file.is_open())
+    m_isEnabled = false;
+    if (m_writerThread.joinable())
+    {
+        {
+            ProfiledLock lock{m_mutex};
+            m_isRunning = false;
+            m_cv.notify_one();
+        }
+        m_writerThread.join();
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_buffer.clear();
+    m_droppedLines = 0;
+    m_isFlushRequested = false;
+}
+
+void LogFile::writerLoop()
+{
+    ProfiledLock lock{m_mutex};
+    while (true)
+    {
+        m_cv.wait_for(lock, kLogFlushInterval, [this]()
+                      { return !m_isRunning || m_isFlushRequested || m_buffer.size() >= kLogFlushThreshold; });
+        if (m_isRunning)
+        {
+            // Call sites that stopped logging after dropping messages are reported with the periodic flush
+            lock.unlock();
+            LogRateLimiter::reportSuppressedMessages();
+            lock.lock();
+        }
+        const bool kIsRunning{m_isRunning};
+        const uint64_t kDroppedLines{m_droppedLines};
+        m_droppedLines = 0;
+        const bool kIsSyncRequired{m_isFlushRequested};
+        m_isFlushRequested = false;
+        std::swap(m_buffer, m_writeBuffer);
+        lock.unlock();
+
+        if (0 != kDroppedLines)
+        {
+            writeToFile("[LogFile]: Dropped " + std::to_string(kDroppedLines) + " lines - log writer too slow\n");
+        }
+        writeToFile(m_writeBuffer);
+        m_writeBuffer.clear();
+        if (kIsSyncRequired && m_fd >= 0)
+        {
+            fdatasync(m_fd);
+        }
+
+        lock.lock();
+        if (!kIsRunning && m_buffer.empty())
+        {
+            return;
+        }
+    }
+}
+
+void LogFile::writeToFile(const std::string &data)
+{
+    size_t offset{0};
+    while (offset < data.size() && m_fd >= 0)
+    {
+        size_t length{data.size() - offset};
+        if (0 != m_maxFileSize && m_fileSize + length > m_maxFileSize)
+        {
+            // Split the batch on a line boundary, so that every file holds complete lines only
+            const size_t kSpace{m_fileSize < m_maxFileSize ? static_cast<size_t>(m_maxFileSize - m_fileSize) : 0};
+            const size_t kLastNewLine{kSpace > 0 ? data.rfind('\n', offset + kSpace - 1) : std::string::npos};
+            if (std::string::npos != kLastNewLine && kLastNewLine >= offset)
+            {
+                length = kLastNewLine + 1 - offset;
+            }
+            else if (0 != m_fileSize)
+            {
+                rotate();
+                continue;
+            }
+            else
+            {
+                // Single line longer than the limit
+                const size_t kNewLine{data.find('\n', offset)};
+                length = std::string::npos != kNewLine ? kNewLine + 1 - offset : data.size() - offset;
+            }
+        }
+        writeAll(data.data() + offset, length);
+        offset += length;
+    }
+}
+
+void LogFile::writeAll(const char *data, size_t size)
+{
+    size_t written{0};
+    while (written < size)
+    {
+        const ssize_t kResult{::write(m_fd, data + written, size - written)};
+        if (kResult < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        written += static_cast<size_t>(kResult);
+    }
+    m_fileSize += written;
+}
+
+void LogFile::rotate()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+    if (m_maxFiles > 1)
     {
-        m_file.close();
+        // <path>.N-2 -> <path>.N-1, ..., <path> -> <path>.1
+        std::remove((m_path + "." + std::to_string(m_maxFiles - 1)).c_str());
+        for (uint32_t i = m_maxFiles - 1; i > 1; --i)
+        {
+            std::rename((m_path + "." + std::to_string(i - 1)).c_str(), (m_path + "." + std::to_string(i)).c_str());
+        }
+        std::rename(m_path.c_str(), (m_path + ".1").c_str());
     }
+    m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    m_fileSize = 0;
+}
+
+LogRateLimiter::LogRateLimiter(uint32_t burst, uint32_t messagesPerSecond)
+    : m_emissionIntervalNs{1000000000LL / std::max<uint32_t>(messagesPerSecond, 1)},
+      m_burstToleranceNs{m_emissionIntervalNs * std::max<uint32_t>(burst, 1)}, m_theoreticalArrivalNs{0},
+      m_suppressedMessages{0}, m_severity{Severity::debug}, m_isPending{false}
+{
 }
 
-Flusher::Flusher(std::stringstream &stream, const std::string &componentName, const Severity &severity)
-    : m_stream{stream}, m_severity{severity}
+LogRateLimiter::~LogRateLimiter()
 {
+    PendingRateLimiters &pending{getPendingRateLimiters()};
+    std::unique_lock<std::mutex> lock{pending.mutex};
+    if (m_isPending)
+    {
+        pending.limiters.erase(std::find(pending.limiters.begin(), pending.limiters.end(), this));
+        pending.count = pending.limiters.size();
+    }
+}
+
+bool LogRateLimiter::tryAcquire(uint32_t &suppressedMessages)
+{
+    // Token bucket expressed as a theoretical arrival time (GCRA), so that it can be updated without a lock
+    const int64_t kNowNs{getSteadyTimeNs()};
+    int64_t arrivalNs{m_theoreticalArrivalNs.load(std::memory_order_relaxed)};
+    int64_t newArrivalNs{0};
+    do
+    {
+        newArrivalNs = std::max(arrivalNs, kNowNs) + m_emissionIntervalNs;
+        if (newArrivalNs - kNowNs > m_burstToleranceNs)
+        {
+            return false;
+        }
+    } while (!m_theoreticalArrivalNs.compare_exchange_weak(arrivalNs, newArrivalNs, std::memory_order_relaxed));
+
+    suppressedMessages = m_suppressedMessages.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+void LogRateLimiter::suppress(const std::string &componentName, const Severity &severity)
+{
+    if (0 != m_suppressedMessages.fetch_add(1, std::memory_order_relaxed))
+    {
+        // Already waiting to be reported
+        return;
+    }
+    PendingRateLimiters &pending{getPendingRateLimiters()};
+    std::unique_lock<std::mutex> lock{pending.mutex};
+    if (!m_isPending)
+    {
+        m_componentName = componentName;
+        m_severity = severity;
+        m_isPending = true;
+        pending.limiters.push_back(this);
+        pending.count = pending.limiters.size();
+    }
+}
+
+void LogRateLimiter::reportSuppressedMessages()
+{
+    PendingRateLimiters &pending{getPendingRateLimiters()};
+    if (0 == pending.count.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    struct Summary
+    {
+        std::string componentName;
+        Severity severity;
+        uint32_t suppressedMessages;
+    };
+    std::vector<Summary> summaries;
+    {
+        std::unique_lock<std::mutex> lock{pending.mutex};
+        const int64_t kNowNs{getSteadyTimeNs()};
+        auto limiterIter = pending.limiters.begin();
+        while (limiterIter != pending.limiters.end())
+        {
+            LogRateLimiter &limiter{**limiterIter};
+            if (!limiter.hasToken(kNowNs))
+            {
+                ++limiterIter;
+                continue;
+            }
+            const uint32_t kSuppressedMessages{limiter.m_suppressedMessages.exchange(0, std::memory_order_relaxed)};
+            if (0 != kSuppressedMessages)
+            {
+                summaries.push_back(Summary{limiter.m_componentName, limiter.m_severity, kSuppressedMessages});
+            }
+            limiter.m_isPending = false;
+            limiterIter = pending.limiters.erase(limiterIter);
+        }
+        pending.count = pending.limiters.size();
+    }
+    // Written without the lock, as writing a line reports suppressed messages again
+    for (const auto &summary : summaries)
+    {
+        std::stringstream stream;
+        Flusher(stream, summary.componentName, summary.severity)
+            << "Rate limiter suppressed " << summary.suppressedMessages << " messages";
+    }
+}
+
+bool LogRateLimiter::hasToken(int64_t nowNs) const
+{
+    const int64_t kArrivalNs{m_theoreticalArrivalNs.load(std::memory_order_relaxed)};
+    return std::max(kArrivalNs, nowNs) + m_emissionIntervalNs - nowNs <= m_burstToleranceNs;
+}
+
+LogLevels &LogLevels::instance()
+{
+    static LogLevels logLevels;
+    return logLevels;
+}
+
+uint32_t LogLevels::registerComponent(const std::string &componentName)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto componentIter = m_componentIds.find(componentName);
+    if (componentIter != m_componentIds.end())
+    {
+        return componentIter->second;
+    }
+    if (m_componentIds.size() >= kSharedComponentId)
+    {
+        return kSharedComponentId;
+    }
+    const uint32_t kComponentId = static_cast<uint32_t>(m_componentIds.size());
+    m_componentIds.emplace(componentName, kComponentId);
+    m_levels[kComponentId].store(getLevel(componentName), std::memory_order_relaxed);
+    return kComponentId;
+}
+
+void LogLevels::reload()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_defaultLevel = kDefaultLogLevel;
+    m_configuredLevels.clear();
+
+    const char *debugVar = getenv("RIALTO_DEBUG");
+    if (debugVar)
+    {
+        std::stringstream config{debugVar};
+        std::string entry;
+        while (std::getline(config, entry, ','))
+        {
+            int level{kDefaultLogLevel};
+            const size_t kSeparator{entry.rfind(':')};
+            if (std::string::npos == kSeparator)
+            {
+                if (parseLogLevel(entry, level))
+                {
+                    m_defaultLevel = level;
+                }
+            }
+            else if (parseLogLevel(entry.substr(kSeparator + 1), level))
+            {
+                m_configuredLevels[entry.substr(0, kSeparator)] = level;
+            }
+        }
+    }
+
+    for (const auto &component : m_componentIds)
+    {
+        m_levels[component.second].store(getLevel(component.first), std::memory_order_relaxed);
+    }
+    m_levels[kSharedComponentId].store(m_defaultLevel, std::memory_order_relaxed);
+}
+
+LogLevels::LogLevels() : m_defaultLevel{kDefaultLogLevel}
+{
+    reload();
+}
+
+int LogLevels::getLevel(const std::string &componentName) const
+{
+    auto levelIter = m_configuredLevels.find(componentName);
+    if (levelIter != m_configuredLevels.end())
+    {
+        return levelIter->second;
+    }
+    return m_defaultLevel;
+}
+
+Flusher::Flusher(std::stringstream &stream, const std::string &componentName, const Severity &severity,
+                 bool isSuppressed)
+    : m_stream{stream}, m_componentName{componentName}, m_severity{severity}, m_isSuppressed{isSuppressed},
+      m_isBinary{BinaryLogFile::instance().isEnabled()}
+{
+    if (m_isSuppressed)
+    {
+        return;
+    }
+    if (m_isBinary)
+    {
+        // Timestamp, component and severity are stored in the record header
+        return;
+    }
     if (LogFile::instance().isEnabled() || isConsoleLogEnabled())
     {
         const std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
@@ -174,27 +578,96 @@ Flusher::Flusher(std::stringstream &stream, const std::string &componentName, co
 
 Flusher::~Flusher()
 {
-    if (getLogLevel() >= m_severity)
+    if (m_isSuppressed)
     {
+        return;
+    }
+    LogRateLimiter::reportSuppressedMessages();
+    if (m_isBinary)
+    {
+        BinaryLogFile::instance().write(m_componentName, static_cast<uint8_t>(m_severity), m_record);
+    }
+    else
+    {
+        const std::string kLine{m_stream.str()};
         if (LogFile::instance().isEnabled())
         {
-            LogFile::instance().write(m_stream.str());
+            LogFile::instance().write(kLine, m_severity);
         }
         else if (isConsoleLogEnabled())
         {
-            std::cout << m_stream.str() << std::endl;
+            std::cout << kLine << std::endl;
         }
         else
         {
-            syslog(convertSeverity(m_severity), "%s", m_stream.str().c_str());
+            syslog(convertSeverity(m_severity), "%s", kLine.c_str());
         }
     }
     m_stream.str("");
 }
 
-Logger::Logger(const std::string &componentName) : m_componentName{componentName} {}
+Logger::Logger(const std::string &componentName)
+    : m_componentName{componentName}, m_componentId{LogLevels::instance().registerComponent(componentName)}
+{
+}
 
 Flusher Logger::operator<<(const Severity &severity) const
 {
-    return Flusher(m_stream, m_componentName, severity);
+    return Flusher(m_stream, m_componentName, severity, !LogLevels::instance().isEnabled(m_componentId, severity));
+}
+
+Flusher Logger::operator<<(const RateLimitedSeverity &rateLimitedSeverity) const
+{
+    if (!LogLevels::instance().isEnabled(m_componentId, rateLimitedSeverity.severity))
+    {
+        // Filtered messages do not use up the call site's tokens
+        return Flusher(m_stream, m_componentName, rateLimitedSeverity.severity, true);
+    }
+    uint32_t suppressedMessages{0};
+    if (!rateLimitedSeverity.limiter.tryAcquire(suppressedMessages))
+    {
+        rateLimitedSeverity.limiter.suppress(m_componentName, rateLimitedSeverity.severity);
+        return Flusher(m_stream, m_componentName, rateLimitedSeverity.severity, true);
+    }
+    if (0 != suppressedMessages)
+    {
+        Flusher(m_stream, m_componentName, rateLimitedSeverity.severity)
+            << "Rate limiter suppressed " << suppressedMessages << " messages like the following one";
+    }
+    return Flusher(m_stream, m_componentName, rateLimitedSeverity.severity);
+}
+
+void Logger::writePrefix(logformat::LogBuffer &buffer, const Severity &severity) const
+{
+    if (LogFile::instance().isEnabled() || isConsoleLogEnabled())
+    {
+        const std::time_t kNow{std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())};
+        std::tm localTime{};
+        char timestamp[32];
+        const size_t kLength{std::strftime(timestamp, sizeof(timestamp), "[%F %T]", localtime_r(&kNow, &localTime))};
+        buffer.append(timestamp, kLength);
+    }
+    buffer.append('[');
+    buffer.append(m_componentName);
+    buffer.append("][");
+    buffer.append(toString(severity));
+    buffer.append("]: ");
+}
+
+void Logger::writeLine(logformat::LogBuffer &buffer, const Severity &severity) const
+{
+    LogRateLimiter::reportSuppressedMessages();
+    if (LogFile::instance().isEnabled())
+    {
+        LogFile::instance().write(buffer.view(), severity);
+    }
+    else if (isConsoleLogEnabled())
+    {
+        const std::string_view kLine{buffer.view()};
+        std::cout.write(kLine.data(), static_cast<std::streamsize>(kLine.size())) << std::endl;
+    }
+    else
+    {
+        syslog(convertSeverity(severity), "%s", buffer.cString());
+    }
 }
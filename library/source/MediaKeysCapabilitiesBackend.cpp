@@ -18,6 +18,7 @@
  */
 
 #include "MediaKeysCapabilitiesBackend.h"
+#include "Tracer.h"
 
 MediaKeysCapabilitiesBackend &MediaKeysCapabilitiesBackend::instance()
 {
@@ -61,6 +62,7 @@ bool MediaKeysCapabilitiesBackend::getSupportedKeySystemVersion(const std::strin
 
 MediaKeysCapabilitiesBackend::MediaKeysCapabilitiesBackend()
 {
+    TraceScope traceScope{"createMediaKeysCapabilities"};
     std::shared_ptr<firebolt::rialto::IMediaKeysCapabilitiesFactory> factory =
         firebolt::rialto::IMediaKeysCapabilitiesFactory::createFactory();
     if (factory)
@@ -0,0 +1,234 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MediaKeysRecorder.h"
+#include "Logger.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t kFlushThreshold{64 * 1024};
+
+const Logger kLog{"MediaKeysRecorder"};
+} // namespace
+
+MediaKeysRecorder &MediaKeysRecorder::instance()
+{
+    static MediaKeysRecorder recorder;
+    return recorder;
+}
+
+MediaKeysRecorder::MediaKeysRecorder() : m_isEnabled{false}, m_fd{-1}, m_startNs{0}
+{
+    reset();
+}
+
+MediaKeysRecorder::~MediaKeysRecorder()
+{
+    stop();
+}
+
+bool MediaKeysRecorder::start(const std::string &path)
+{
+    stop();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+    {
+        kLog << error << "Failed to open recording file " << path << ", errno: " << errno;
+        return false;
+    }
+    mediakeysrecording::RecordingFileHeader header{};
+    std::memcpy(header.magic, mediakeysrecording::kMagic, sizeof(header.magic));
+    header.version = mediakeysrecording::kVersion;
+    header.headerSize = sizeof(header);
+    m_buffer.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_startNs = now();
+    m_isEnabled = true;
+    kLog << info << "Recording MediaKeys traffic to " << path;
+    return true;
+}
+
+void MediaKeysRecorder::stop()
+{
+    m_isEnabled = false;
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_fd >= 0)
+    {
+        flush();
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_buffer.clear();
+}
+
+void MediaKeysRecorder::reset()
+{
+    const char *path{getenv("RIALTO_RECORD_PATH")};
+    if (path && '\0' != path[0])
+    {
+        start(path);
+    }
+    else
+    {
+        stop();
+    }
+}
+
+void MediaKeysRecorder::recordCall(CdmOperation operation, int32_t keySessionId, uint64_t startNs, uint64_t durationNs,
+                                   int32_t status, uint32_t payloadSize, uint32_t extra)
+{
+    mediakeysrecording::Record record{};
+    record.timestampNs = startNs;
+    record.durationNs = durationNs;
+    record.keySessionId = keySessionId;
+    record.payloadSize = payloadSize;
+    record.type = mediakeysrecording::kCall;
+    record.operation = static_cast<uint16_t>(operation);
+    record.status = status;
+    record.extra = extra;
+    addRecord(record);
+}
+
+void MediaKeysRecorder::recordCreateMediaKeys(const std::string &keySystem, uint64_t startNs, uint64_t durationNs,
+                                              bool isCreated)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    mediakeysrecording::Record record{};
+    record.timestampNs = startNs;
+    record.durationNs = durationNs;
+    record.keySessionId = firebolt::rialto::kInvalidSessionId;
+    record.dataSize = static_cast<uint32_t>(keySystem.size());
+    record.type = mediakeysrecording::kCreateMediaKeys;
+    record.status = isCreated ? 1 : 0;
+    addRecord(record, keySystem.data());
+}
+
+void MediaKeysRecorder::recordLicenseRequest(int32_t keySessionId, uint32_t messageSize, uint32_t urlLength)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    mediakeysrecording::Record record{};
+    record.timestampNs = now();
+    record.keySessionId = keySessionId;
+    record.payloadSize = messageSize;
+    record.type = mediakeysrecording::kLicenseRequest;
+    record.extra = urlLength;
+    addRecord(record);
+}
+
+void MediaKeysRecorder::recordLicenseRenewal(int32_t keySessionId, uint32_t messageSize)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    mediakeysrecording::Record record{};
+    record.timestampNs = now();
+    record.keySessionId = keySessionId;
+    record.payloadSize = messageSize;
+    record.type = mediakeysrecording::kLicenseRenewal;
+    addRecord(record);
+}
+
+void MediaKeysRecorder::recordKeyStatusesChanged(int32_t keySessionId,
+                                                 const firebolt::rialto::KeyStatusVector &keyStatuses)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    mediakeysrecording::Record record{};
+    record.timestampNs = now();
+    record.keySessionId = keySessionId;
+    record.payloadSize = static_cast<uint32_t>(keyStatuses.size());
+    record.dataSize = static_cast<uint32_t>(keyStatuses.size());
+    record.type = mediakeysrecording::kKeyStatusesChanged;
+
+    std::string statuses;
+    statuses.reserve(keyStatuses.size());
+    for (const auto &keyStatus : keyStatuses)
+    {
+        statuses.push_back(static_cast<char>(keyStatus.second));
+    }
+    addRecord(record, statuses.data());
+}
+
+void MediaKeysRecorder::recordApplicationState(firebolt::rialto::ApplicationState state)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    mediakeysrecording::Record record{};
+    record.timestampNs = now();
+    record.keySessionId = firebolt::rialto::kInvalidSessionId;
+    record.type = mediakeysrecording::kApplicationState;
+    record.extra = static_cast<uint32_t>(state);
+    addRecord(record);
+}
+
+void MediaKeysRecorder::addRecord(mediakeysrecording::Record record, const void *data)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_fd < 0)
+    {
+        return;
+    }
+    // Calls started before the recording are stamped with its start
+    record.timestampNs = record.timestampNs > m_startNs ? record.timestampNs - m_startNs : 0;
+    m_buffer.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    if (data)
+    {
+        m_buffer.append(static_cast<const char *>(data), record.dataSize);
+    }
+    if (m_buffer.size() >= kFlushThreshold)
+    {
+        flush();
+    }
+}
+
+void MediaKeysRecorder::flush()
+{
+    size_t written{0};
+    while (written < m_buffer.size())
+    {
+        const ssize_t kResult{write(m_fd, m_buffer.data() + written, m_buffer.size() - written)};
+        if (kResult < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            kLog << error << "Failed to write recording, errno: " << errno;
+            break;
+        }
+        written += static_cast<size_t>(kResult);
+    }
+    m_buffer.clear();
+}
@@ -18,9 +18,11 @@
  */
 
 #include "MessageDispatcher.h"
+#include "MediaKeysRecorder.h"
+#include "Metrics.h"
 
 MessageDispatcher::MessageDispatcherClient::MessageDispatcherClient(MessageDispatcher &dispatcher,
-                                                                    firebolt::rialto::IMediaKeysClient *client)
+                                                                    IMessageDispatcherListener *client)
     : m_dispatcher{dispatcher}, m_client{client}
 {
     m_dispatcher.addClient(m_client);
@@ -31,27 +33,36 @@ MessageDispatcher::MessageDispatcherClient::~MessageDispatcherClient()
     m_dispatcher.removeClient(m_client);
 }
 
-std::unique_ptr<IMessageDispatcherClient> MessageDispatcher::createClient(firebolt::rialto::IMediaKeysClient *client)
+std::unique_ptr<IMessageDispatcherClient> MessageDispatcher::createClient(IMessageDispatcherListener *client)
 {
     return std::make_unique<MessageDispatcherClient>(*this, client);
 }
 
-void MessageDispatcher::addClient(firebolt::rialto::IMediaKeysClient *client)
+void MessageDispatcher::addClient(IMessageDispatcherListener *client)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
-    m_clients.emplace(client);
+    ProfiledLock lock{m_mutex};
+    if (m_clients.emplace(client).second)
+    {
+        Metrics::instance().add(MetricId::DISPATCHER_CLIENTS);
+    }
 }
 
-void MessageDispatcher::removeClient(firebolt::rialto::IMediaKeysClient *client)
+void MessageDispatcher::removeClient(IMessageDispatcherListener *client)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
-    m_clients.erase(client);
+    ProfiledLock lock{m_mutex};
+    if (0 != m_clients.erase(client))
+    {
+        Metrics::instance().add(MetricId::DISPATCHER_CLIENTS, -1);
+    }
 }
 
 void MessageDispatcher::onLicenseRequest(int32_t keySessionId, const std::vector<unsigned char> &licenseRequestMessage,
                                          const std::string &url)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    MediaKeysRecorder::instance().recordLicenseRequest(keySessionId,
+                                                       static_cast<uint32_t>(licenseRequestMessage.size()),
+                                                       static_cast<uint32_t>(url.size()));
+    ProfiledLock lock{m_mutex};
     for (auto *client : m_clients)
     {
         client->onLicenseRequest(keySessionId, licenseRequestMessage, url);
@@ -60,7 +71,9 @@ void MessageDispatcher::onLicenseRequest(int32_t keySessionId, const std::vector
 
 void MessageDispatcher::onLicenseRenewal(int32_t keySessionId, const std::vector<unsigned char> &licenseRenewalMessage)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    MediaKeysRecorder::instance().recordLicenseRenewal(keySessionId,
+                                                       static_cast<uint32_t>(licenseRenewalMessage.size()));
+    ProfiledLock lock{m_mutex};
     for (auto *client : m_clients)
     {
         client->onLicenseRenewal(keySessionId, licenseRenewalMessage);
@@ -69,9 +82,19 @@ void MessageDispatcher::onLicenseRenewal(int32_t keySessionId, const std::vector
 
 void MessageDispatcher::onKeyStatusesChanged(int32_t keySessionId, const firebolt::rialto::KeyStatusVector &keyStatuses)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    MediaKeysRecorder::instance().recordKeyStatusesChanged(keySessionId, keyStatuses);
+    ProfiledLock lock{m_mutex};
     for (auto *client : m_clients)
     {
         client->onKeyStatusesChanged(keySessionId, keyStatuses);
     }
 }
+
+void MessageDispatcher::onKeySessionIdsChanged(const std::map<int32_t, int32_t> &newKeySessionIds)
+{
+    ProfiledLock lock{m_mutex};
+    for (auto *client : m_clients)
+    {
+        client->onKeySessionIdsChanged(newKeySessionIds);
+    }
+}
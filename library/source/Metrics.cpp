@@ -0,0 +1,218 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Metrics.h"
+#include "ActiveSessions.h"
+#include "Logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+constexpr uint64_t kDefaultWriteIntervalS{10};
+
+const Logger kLog{"Metrics"};
+
+struct MetricDefinition
+{
+    const char *name;
+    const char *help;
+    bool isGauge;
+};
+
+constexpr std::array<MetricDefinition, static_cast<size_t>(MetricId::COUNT)> kDefinitions{
+    {{"ocdm_active_sessions", "Sessions held by ActiveSessions", true},
+     {"ocdm_dispatcher_clients", "Sessions registered for Rialto callbacks", true},
+     {"ocdm_decrypt_calls_total", "Buffers passed to decrypt", false},
+     {"ocdm_key_status_updates_total", "Key status change notifications", false},
+     {"ocdm_challenge_waits_total", "Calls waiting for a license challenge", false},
+     {"ocdm_challenge_wait_microseconds_total", "Time spent waiting for license challenges", false},
+     {"ocdm_challenge_timeouts_total", "Challenge waits ended by the challenge timeout", false},
+     {"ocdm_challenge_cancellations_total", "Challenge waits ended by opencdm_session_cancel_challenge_data", false},
+     {"ocdm_app_state_transitions_total", "Rialto application state changes", false},
+     {"ocdm_pending_key_sessions", "Key session creations waiting for Rialto to be RUNNING", true},
+     {"ocdm_restored_key_sessions_total", "Persistent key sessions loaded again after Rialto resumed", false},
+     {"ocdm_lost_key_sessions_total", "Key sessions not restored after Rialto resumed", false},
+     {"ocdm_pooled_key_sessions", "Key sessions created in advance and not yet used", true},
+     {"ocdm_key_session_pool_hits_total", "Key session creations served from the pool", false},
+     {"ocdm_key_session_pool_misses_total", "Key session creations which found the pool empty", false},
+     {"ocdm_ldl_admission_waits_total", "LDL session creations which waited for the LDL session limit", false},
+     {"ocdm_ldl_admission_timeouts_total", "LDL session creations refused after waiting for the limit", false},
+     {"ocdm_scheduler_starvation_grants_total", "CdmBackend turns given out of priority order to a starving call",
+      false},
+     {"ocdm_shared_session_attaches_total", "Sessions sharing the key session of a session with the same init data",
+      false}}};
+
+constexpr MetricDefinition kIpcFailuresDefinition{"ocdm_ipc_failures_total", "Failed CdmBackend calls to Rialto",
+                                                  false};
+constexpr MetricDefinition kSessionDecryptCallsDefinition{"ocdm_session_decrypt_calls_total",
+                                                          "Buffers passed to decrypt per active session", false};
+} // namespace
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics() : m_isRunning{false}, m_interval{kDefaultWriteIntervalS}
+{
+    // collect() uses ActiveSessions, make sure it outlives the last write at exit
+    ActiveSessions::instance();
+    startWriter();
+}
+
+Metrics::~Metrics()
+{
+    stopWriter();
+}
+
+uint64_t Metrics::get(MetricId id) const
+{
+    return static_cast<uint64_t>(m_values[static_cast<size_t>(id)].load(std::memory_order_relaxed));
+}
+
+uint64_t Metrics::getIpcFailures(CdmOperation operation) const
+{
+    return m_ipcFailures[static_cast<size_t>(operation)].load(std::memory_order_relaxed);
+}
+
+std::vector<MetricSample> Metrics::collect() const
+{
+    std::vector<MetricSample> samples;
+    for (size_t i = 0; i < kDefinitions.size(); ++i)
+    {
+        samples.push_back(MetricSample{kDefinitions[i].name, kDefinitions[i].help, kDefinitions[i].isGauge, "",
+                                       get(static_cast<MetricId>(i))});
+    }
+    for (size_t i = 0; i < static_cast<size_t>(CdmOperation::COUNT); ++i)
+    {
+        samples.push_back(MetricSample{kIpcFailuresDefinition.name, kIpcFailuresDefinition.help, false,
+                                       std::string("method=\"") + toString(static_cast<CdmOperation>(i)) + "\"",
+                                       getIpcFailures(static_cast<CdmOperation>(i))});
+    }
+    for (const auto &sessionDecryptCalls : ActiveSessions::instance().getDecryptCalls())
+    {
+        char labels[48];
+        std::snprintf(labels, sizeof(labels), "session=\"%p\"", static_cast<const void *>(sessionDecryptCalls.first));
+        samples.push_back(MetricSample{kSessionDecryptCallsDefinition.name, kSessionDecryptCallsDefinition.help, false,
+                                       labels, sessionDecryptCalls.second});
+    }
+    return samples;
+}
+
+bool Metrics::writePrometheus(const std::string &path) const
+{
+    // Written to a temporary file and renamed, so that a collector never reads a partial file
+    const std::string kTemporaryPath{path + ".tmp"};
+    {
+        std::ofstream file{kTemporaryPath, std::ios::trunc};
+        if (!file.is_open())
+        {
+            kLog << error << "Failed to open metrics file " << kTemporaryPath;
+            return false;
+        }
+        const char *lastName{nullptr};
+        for (const auto &sample : collect())
+        {
+            if (sample.name != lastName)
+            {
+                file << "# HELP " << sample.name << " " << sample.help << "\n# TYPE " << sample.name << " "
+                     << (sample.isGauge ? "gauge" : "counter") << "\n";
+                lastName = sample.name;
+            }
+            file << sample.name;
+            if (!sample.labels.empty())
+            {
+                file << "{" << sample.labels << "}";
+            }
+            file << " " << sample.value << "\n";
+        }
+        if (!file.flush())
+        {
+            kLog << error << "Failed to write metrics file " << kTemporaryPath;
+            return false;
+        }
+    }
+    if (0 != std::rename(kTemporaryPath.c_str(), path.c_str()))
+    {
+        kLog << error << "Failed to rename metrics file to " << path;
+        return false;
+    }
+    return true;
+}
+
+void Metrics::reset()
+{
+    stopWriter();
+    for (auto &value : m_values)
+    {
+        value = 0;
+    }
+    for (auto &ipcFailures : m_ipcFailures)
+    {
+        ipcFailures = 0;
+    }
+    startWriter();
+}
+
+void Metrics::startWriter()
+{
+    const char *path{getenv("RIALTO_METRICS_PATH")};
+    if (!path || '\0' == path[0])
+    {
+        return;
+    }
+    const char *interval{getenv("RIALTO_METRICS_INTERVAL")};
+    m_path = path;
+    m_interval = std::chrono::seconds{interval ? std::strtoull(interval, nullptr, 10) : kDefaultWriteIntervalS};
+    if (m_interval.count() == 0)
+    {
+        m_interval = std::chrono::seconds{kDefaultWriteIntervalS};
+    }
+    m_isRunning = true;
+    m_writerThread = std::thread(&Metrics::writerLoop, this);
+}
+
+void Metrics::stopWriter()
+{
+    if (m_writerThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_isRunning = false;
+            m_cv.notify_one();
+        }
+        m_writerThread.join();
+    }
+}
+
+void Metrics::writerLoop()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    bool isRunning{true};
+    while (isRunning)
+    {
+        m_cv.wait_for(lock, m_interval, [this]() { return !m_isRunning; });
+        // Also written once when stopped, so that the file holds the final values
+        isRunning = m_isRunning;
+        writePrometheus(m_path);
+    }
+}
@@ -18,10 +18,16 @@
  */
 
 #include "OpenCDMSessionPrivate.h"
+#include "InitDataParser.h"
+#include "Metrics.h"
 #include "RialtoGStreamerEMEProtectionMetadata.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstdlib>
 #include <gst/base/base.h>
 #include <gst/gst.h>
 #include <gst/gstprotection.h>
+#include <utility>
 
 namespace
 {
@@ -57,25 +63,89 @@ const KeyStatus convertKeyStatus(const firebolt::rialto::KeyStatus &keyStatus)
     }
 }
 
+template <typename T> void releaseBuffer(T &buffer)
+{
+    // clear() keeps the allocation
+    T{}.swap(buffer);
+}
+
+void notifyChallenge(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks, void *context, const std::string &url,
+                     const std::vector<unsigned char> &challenge)
+{
+    if (callbacks && callbacks->process_challenge_callback)
+    {
+        callbacks->process_challenge_callback(session, context, url.c_str(), challenge.data(), challenge.size());
+    }
+}
+
+void notifyKeyStatuses(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks, void *context,
+                       const firebolt::rialto::KeyStatusVector &keyStatuses)
+{
+    if (!callbacks || !callbacks->key_update_callback)
+    {
+        return;
+    }
+    for (const std::pair<std::vector<uint8_t>, firebolt::rialto::KeyStatus> &keyStatus : keyStatuses)
+    {
+        const std::vector<uint8_t> &key = keyStatus.first;
+        callbacks->key_update_callback(session, context, key.data(), key.size());
+    }
+    if (callbacks->keys_updated_callback)
+    {
+        callbacks->keys_updated_callback(session, context);
+    }
+}
+
 const std::string kDefaultSessionId{"0"};
+constexpr int64_t kDefaultChallengeTimeoutMs{10000};
+
+int64_t readChallengeTimeoutMs()
+{
+    const char *timeout{getenv("RIALTO_CHALLENGE_TIMEOUT_MS")};
+    if (!timeout)
+    {
+        return kDefaultChallengeTimeoutMs;
+    }
+    return std::strtoll(timeout, nullptr, 10);
+}
+
+std::atomic<int64_t> &challengeTimeoutMs()
+{
+    static std::atomic<int64_t> timeoutMs{readChallengeTimeoutMs()};
+    return timeoutMs;
+}
+
+std::atomic<bool> &speculativeChallengeEnabled()
+{
+    static std::atomic<bool> isEnabled{nullptr != getenv("RIALTO_SPECULATIVE_CHALLENGE")};
+    return isEnabled;
+}
 } // namespace
 
 OpenCDMSessionPrivate::OpenCDMSessionPrivate(const std::shared_ptr<ICdmBackend> &cdm,
                                              const std::shared_ptr<IMessageDispatcher> &messageDispatcher,
                                              const LicenseType &sessionType, OpenCDMSessionCallbacks *callbacks,
                                              void *context, const std::string &initDataType,
-                                             const std::vector<uint8_t> &initData)
+                                             std::vector<uint8_t> initData)
     : m_log{"OpenCDMSessionPrivate"}, m_context(context), m_cdmBackend(cdm), m_messageDispatcher(messageDispatcher),
       m_rialtoSessionId(firebolt::rialto::kInvalidSessionId), m_callbacks(callbacks),
       m_sessionType(getRialtoSessionType(sessionType)), m_initDataType(getRialtoInitDataType(initDataType)),
-      m_initData(initData), m_isInitialized{false}
+      m_initData(std::move(initData)), m_isInitialized{false}, m_decryptCalls{0}, m_hasRequest{false},
+      m_isChallengeCancelled{false}, m_playreadyKeyId{nullptr}, m_isSpeculativeSession{false},
+      m_isRequestGenerated{false}, m_priority{SessionPriority::FOREGROUND}
 {
-    m_log << debug << "constructed: " << static_cast<void *>(this);
+    RIALTO_LOG_FMT(m_log, debug, "constructed: {}", static_cast<void *>(this));
+    addExpectedKeyIds(m_initDataType, m_initData);
 }
 
 OpenCDMSessionPrivate::~OpenCDMSessionPrivate()
 {
-    m_log << debug << "destructed: " << static_cast<void *>(this);
+    RIALTO_LOG_FMT(m_log, debug, "destructed: {}", static_cast<void *>(this));
+    collectSpeculativeRequest();
+    if (m_playreadyKeyId)
+    {
+        gst_buffer_unref(m_playreadyKeyId);
+    }
 }
 
 bool OpenCDMSessionPrivate::initialize()
@@ -84,47 +154,127 @@ bool OpenCDMSessionPrivate::initialize()
 }
 
 bool OpenCDMSessionPrivate::initialize(bool isLDL)
+{
+    collectSpeculativeRequest();
+    if (m_isSpeculativeSession && isLDL)
+    {
+        discardSpeculativeSession();
+    }
+    m_isSpeculativeSession = false;
+    return initializeKeySession(isLDL);
+}
+
+void OpenCDMSessionPrivate::startSpeculativeRequest()
+{
+    if (m_speculativeRequest.valid() || m_isInitialized)
+    {
+        return;
+    }
+    m_log << debug << RIALTO_LOG_LITERAL("Starting speculative key session creation and challenge generation");
+    m_isSpeculativeSession = true;
+    m_speculativeRequest = std::async(std::launch::async,
+                                      [this]()
+                                      {
+                                          TraceScope traceScope{"speculativeRequest", this};
+                                          // LDL is only known when the challenge is requested, a session created
+                                          // here is replaced when it turns out to be needed
+                                          return initializeKeySession(false) && requestChallenge();
+                                      });
+}
+
+void OpenCDMSessionPrivate::setPriority(SessionPriority priority)
+{
+    collectSpeculativeRequest();
+    m_priority = priority;
+    if (m_isInitialized && m_cdmBackend)
+    {
+        m_cdmBackend->setKeySessionPriority(m_rialtoSessionId, priority);
+    }
+}
+
+bool OpenCDMSessionPrivate::initializeKeySession(bool isLDL)
 {
     if (!m_cdmBackend || !m_messageDispatcher)
     {
-        m_log << error << "Cdm/message dispatcher is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm/message dispatcher is NULL or not initialized");
         return false;
     }
     if (!m_isInitialized)
     {
-        if (!m_cdmBackend->createKeySession(m_sessionType, isLDL, m_rialtoSessionId))
+        // Waiting for a free LDL session here saves a createKeySession call bound to fail, and the app's retries
+        if (isLDL && !m_cdmBackend->admitLdlSession(m_priority, getChallengeTimeout()))
         {
-            m_log << error << "Failed to create a session. Got drm error %u", getLastDrmError();
+            m_log << error << RIALTO_LOG_LITERAL("Failed to create a session - no LDL session available");
             return false;
         }
+        int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+        if (!createKeySession(isLDL, keySessionId))
+        {
+            return false;
+        }
+        m_rialtoSessionId = keySessionId;
         m_messageDispatcherClient = m_messageDispatcher->createClient(this);
         m_isInitialized = true;
-        m_log << info << "Successfully created a session";
+        m_log << info << RIALTO_LOG_LITERAL("Successfully created a session");
     }
     return true;
 }
 
+bool OpenCDMSessionPrivate::createKeySession(bool isLDL, int32_t &keySessionId)
+{
+    // Requests made before Rialto is RUNNING are queued by the backend. The session waits for the queued request as
+    // long as it would wait for the challenge, rather than the one second of CdmBackend::createKeySession.
+    auto result{std::make_shared<std::promise<std::pair<bool, int32_t>>>()};
+    std::future<std::pair<bool, int32_t>> futureResult{result->get_future()};
+    const ICdmBackend::CreateKeySessionCallback kCallback{[result](bool isCreated, int32_t createdKeySessionId)
+                                                          { result->set_value({isCreated, createdKeySessionId}); }};
+    const uint64_t kRequestId{m_cdmBackend->createKeySessionAsync(m_sessionType, isLDL, m_priority, kCallback)};
+    const auto kTimeout{getChallengeTimeout()};
+    if (kTimeout.count() > 0 && std::future_status::ready != futureResult.wait_for(kTimeout) &&
+        m_cdmBackend->cancelKeySessionCreation(kRequestId))
+    {
+        RIALTO_LOG_FMT(m_log, error, "Rialto did not reach RUNNING state within {} ms, failed to create a session",
+                       kTimeout.count());
+        return false;
+    }
+    // Not cancelled, the callback has been or is being called
+    const std::pair<bool, int32_t> kResult{futureResult.get()};
+    keySessionId = kResult.second;
+    if (!kResult.first)
+    {
+        RIALTO_LOG_FMT(m_log, error, "Failed to create a session. Got drm error {}", getLastDrmError());
+    }
+    return kResult.first;
+}
+
 bool OpenCDMSessionPrivate::generateRequest(const std::string &initDataType, const std::vector<uint8_t> &initData,
                                             const std::vector<uint8_t> &cdmData)
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     firebolt::rialto::InitDataType dataType = getRialtoInitDataType(initDataType);
+    const std::vector<uint8_t> &kInitData{initData.empty() ? m_initData : initData};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if ((dataType != firebolt::rialto::InitDataType::UNKNOWN) && (-1 != m_rialtoSessionId))
+    if ((dataType != firebolt::rialto::InitDataType::UNKNOWN) && (-1 != kKeySessionId))
     {
-        if (m_cdmBackend->generateRequest(m_rialtoSessionId, dataType, initData))
+        if (m_cdmBackend->generateRequest(kKeySessionId, dataType, kInitData))
         {
-            m_log << info << "Successfully generated the request for the session";
+            m_log << info << RIALTO_LOG_LITERAL("Successfully generated the request for the session");
             initializeCdmKeySessionId();
+            addExpectedKeyIds(dataType, kInitData);
+            ProfiledLock lock{m_mutex};
+            m_hasRequest = true;
             return true;
         }
         else
         {
-            m_log << error << "Failed to request for the session. Got drm error " << getLastDrmError();
+            m_log << error << RIALTO_LOG_LITERAL("Failed to request for the session. Got drm error ")
+                  << getLastDrmError();
         }
     }
 
@@ -133,22 +283,24 @@ bool OpenCDMSessionPrivate::generateRequest(const std::string &initDataType, con
 
 bool OpenCDMSessionPrivate::loadSession()
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        if (m_cdmBackend->loadSession(m_rialtoSessionId))
+        if (m_cdmBackend->loadSession(kKeySessionId))
         {
-            m_log << info << "Successfully loaded the session";
+            m_log << info << RIALTO_LOG_LITERAL("Successfully loaded the session");
             return true;
         }
         else
         {
-            m_log << error << "Failed to load the session. Got drm error " << getLastDrmError();
+            m_log << error << RIALTO_LOG_LITERAL("Failed to load the session. Got drm error ") << getLastDrmError();
         }
     }
     return false;
@@ -156,22 +308,32 @@ bool OpenCDMSessionPrivate::loadSession()
 
 bool OpenCDMSessionPrivate::updateSession(const std::vector<uint8_t> &license)
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        if (m_cdmBackend->updateSession(m_rialtoSessionId, license))
+        if (m_cdmBackend->updateSession(kKeySessionId, license))
         {
-            m_log << info << "Successfully updated the session";
+            m_log << info << RIALTO_LOG_LITERAL("Successfully updated the session");
+            // With the license applied, no further request is generated and the challenge has been answered
+            ProfiledLock lock{m_mutex};
+            if (m_attachedSessions.empty())
+            {
+                releaseBuffer(m_initData);
+                releaseBuffer(m_challengeData);
+                releaseBuffer(m_challengeUrl);
+            }
             return true;
         }
         else
         {
-            m_log << error << "Failed to update the session. Got drm error " << getLastDrmError();
+            m_log << error << RIALTO_LOG_LITERAL("Failed to update the session. Got drm error ") << getLastDrmError();
         }
     }
 
@@ -180,53 +342,169 @@ bool OpenCDMSessionPrivate::updateSession(const std::vector<uint8_t> &license)
 
 bool OpenCDMSessionPrivate::getChallengeData(std::vector<uint8_t> &challengeData)
 {
+    TraceScope traceScope{"getChallengeData", this, m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
-    if ((m_initDataType != firebolt::rialto::InitDataType::UNKNOWN) && (-1 != m_rialtoSessionId))
+    collectSpeculativeRequest();
     {
-        if (m_cdmBackend->generateRequest(m_rialtoSessionId, m_initDataType, m_initData))
-        {
-            m_log << info << "Successfully generated the request for the session";
-            initializeCdmKeySessionId();
-        }
-        else
+        // A cancellation only applies to the request in progress when it is made
+        ProfiledLock lock{m_mutex};
+        m_isChallengeCancelled = false;
+        if (!m_isRequestGenerated && m_hasRequest && !m_challengeData.empty())
         {
-            m_log << error << "Failed to request for the session. Got drm error " << getLastDrmError();
-            return false;
+            // Apps ask for the size first and then for the data, both calls get the challenge of the same request
+            challengeData = m_challengeData;
+            return true;
         }
     }
+    if (m_isRequestGenerated)
+    {
+        // Generated by startSpeculativeRequest, the challenge is on its way or already stored
+        m_log << info << RIALTO_LOG_LITERAL("Using the speculatively generated request");
+        m_isRequestGenerated = false;
+    }
+    else if (requestChallenge())
+    {
+        initializeCdmKeySessionId();
+    }
     else
     {
         return false;
     }
-    std::unique_lock<std::mutex> lock{m_mutex};
-    m_challengeCv.wait(lock, [this]() { return !m_challengeData.empty(); });
-    challengeData = m_challengeData;
+    return waitForChallenge(challengeData);
+}
+
+bool OpenCDMSessionPrivate::waitForChallenge(std::vector<uint8_t> &challengeData)
+{
+    const auto kTimeout{getChallengeTimeout()};
+    const auto kWaitStart{std::chrono::steady_clock::now()};
+    ProfiledLock lock{m_mutex};
+    const auto kIsWaitOver{[this]() { return !m_challengeData.empty() || m_isChallengeCancelled; }};
+    if (kTimeout.count() > 0)
+    {
+        m_challengeCv.wait_until(lock, kWaitStart + kTimeout, kIsWaitOver);
+    }
+    else
+    {
+        m_challengeCv.wait(lock, kIsWaitOver);
+    }
+    const auto kWaitTime{std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               kWaitStart)};
+    Metrics::instance().add(MetricId::CHALLENGE_WAITS);
+    Metrics::instance().add(MetricId::CHALLENGE_WAIT_TIME_US, kWaitTime.count());
+    if (!m_challengeData.empty())
+    {
+        challengeData = m_challengeData;
+        return true;
+    }
+    if (m_isChallengeCancelled)
+    {
+        Metrics::instance().add(MetricId::CHALLENGE_CANCELLATIONS);
+        RIALTO_LOG_FMT(m_log, info, "Challenge wait cancelled after {} us", kWaitTime.count());
+        return false;
+    }
+    Metrics::instance().add(MetricId::CHALLENGE_TIMEOUTS);
+    const int32_t kKeySessionId{m_rialtoSessionId};
+    Tracer::instance().addInstantEvent("challengeTimeout", this, kKeySessionId);
+    RIALTO_LOG_FMT(m_log, error, "No license request for session {} within {} ms", kKeySessionId, kTimeout.count());
+    return false;
+}
+
+bool OpenCDMSessionPrivate::requestChallenge()
+{
+    const int32_t kKeySessionId{m_rialtoSessionId};
+    if ((m_initDataType == firebolt::rialto::InitDataType::UNKNOWN) || (-1 == kKeySessionId))
+    {
+        return false;
+    }
+    if (m_initData.empty())
+    {
+        m_log << error
+              << RIALTO_LOG_LITERAL("No init data to generate the request from, the license has been applied already");
+        return false;
+    }
+    if (!m_cdmBackend->generateRequest(kKeySessionId, m_initDataType, m_initData))
+    {
+        m_log << error << RIALTO_LOG_LITERAL("Failed to request for the session. Got drm error ")
+              << getLastDrmError();
+        return false;
+    }
+    m_log << info << RIALTO_LOG_LITERAL("Successfully generated the request for the session");
+    ProfiledLock lock{m_mutex};
+    m_hasRequest = true;
     return true;
 }
 
+void OpenCDMSessionPrivate::collectSpeculativeRequest()
+{
+    if (m_speculativeRequest.valid())
+    {
+        m_isRequestGenerated = m_speculativeRequest.get();
+        if (m_isRequestGenerated)
+        {
+            initializeCdmKeySessionId();
+        }
+    }
+}
+
+void OpenCDMSessionPrivate::discardSpeculativeSession()
+{
+    m_log << info << RIALTO_LOG_LITERAL("Replacing the speculatively created session with an LDL session");
+    // Notifications for the discarded key session are ignored from now on
+    const int32_t kKeySessionId{m_rialtoSessionId.exchange(firebolt::rialto::kInvalidSessionId)};
+    if (m_isInitialized && !m_cdmBackend->closeKeySession(kKeySessionId))
+    {
+        m_log << warn << RIALTO_LOG_LITERAL("Failed to close the speculatively created session");
+    }
+    m_messageDispatcherClient.reset();
+    m_isInitialized = false;
+    m_isRequestGenerated = false;
+    ProfiledLock lock{m_mutex};
+    releaseBuffer(m_challengeData);
+    releaseBuffer(m_challengeUrl);
+    m_hasRequest = false;
+}
+
+void OpenCDMSessionPrivate::resetChallengeCancellation()
+{
+    ProfiledLock lock{m_mutex};
+    m_isChallengeCancelled = false;
+}
+
+void OpenCDMSessionPrivate::cancelChallengeData()
+{
+    ProfiledLock lock{m_mutex};
+    m_isChallengeCancelled = true;
+    m_challengeCv.notify_all();
+}
+
 void OpenCDMSessionPrivate::addProtectionMeta(GstBuffer *buffer, GstBuffer *subSample, const uint32_t subSampleCount,
                                               GstBuffer *IV, GstBuffer *keyID, uint32_t initWithLast15)
 {
+    countDecrypt();
+    const int32_t kKeySessionId{m_rialtoSessionId};
+
     // Set key for Playready
-    GstBuffer *keyToApply = keyID;
-    bool shouldReleaseKey{false};
-    if (keyID && 0 == gst_buffer_get_size(keyID) && !m_playreadyKeyId.empty())
+    GstBuffer *playreadyKeyId{nullptr};
+    if (keyID && 0 == gst_buffer_get_size(keyID))
     {
-        keyToApply = gst_buffer_new_allocate(nullptr, m_playreadyKeyId.size(), nullptr);
-        gst_buffer_fill(keyToApply, 0, m_playreadyKeyId.data(), m_playreadyKeyId.size());
-        shouldReleaseKey = true;
+        playreadyKeyId = getPlayreadyKeyId();
     }
+    GstBuffer *keyToApply = playreadyKeyId ? playreadyKeyId : keyID;
 
     GstStructure *info = gst_structure_new("application/x-cenc", "encrypted", G_TYPE_BOOLEAN, TRUE, "mks_id",
-                                           G_TYPE_INT, m_rialtoSessionId, "kid", GST_TYPE_BUFFER, keyToApply, "iv_size",
-                                           G_TYPE_UINT, gst_buffer_get_size(IV), "iv", GST_TYPE_BUFFER, IV,
+                                           G_TYPE_INT, kKeySessionId, "kid", GST_TYPE_BUFFER, keyToApply,
+                                           "iv_size", G_TYPE_UINT, gst_buffer_get_size(IV), "iv", GST_TYPE_BUFFER, IV,
                                            "subsample_count", G_TYPE_UINT, subSampleCount, "subsamples", GST_TYPE_BUFFER,
                                            subSample, "encryption_scheme", G_TYPE_UINT, 0, // AES Counter
                                            "init_with_last_15", G_TYPE_UINT, initWithLast15, NULL);
+    if (playreadyKeyId)
+    {
+        gst_buffer_unref(playreadyKeyId);
+    }
 
     GstProtectionMeta *protectionMeta = reinterpret_cast<GstProtectionMeta *>(gst_buffer_get_protection_meta(buffer));
     if (protectionMeta && protectionMeta->info)
@@ -253,24 +531,21 @@ void OpenCDMSessionPrivate::addProtectionMeta(GstBuffer *buffer, GstBuffer *subS
     }
 
     rialto_mse_add_protection_metadata(buffer, info);
-
-    if (shouldReleaseKey)
-    {
-        gst_buffer_unref(keyToApply);
-    }
 }
 
 bool OpenCDMSessionPrivate::addProtectionMeta(GstBuffer *buffer)
 {
+    countDecrypt();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     GstProtectionMeta *protectionMeta = reinterpret_cast<GstProtectionMeta *>(gst_buffer_get_protection_meta(buffer));
     if (!protectionMeta)
     {
-        m_log << debug << "No protection meta added to the buffer";
+        m_log << RIALTO_LOG_RATE_LIMITED(debug) << RIALTO_LOG_LITERAL("No protection meta added to the buffer");
         return false;
     }
 
     GstStructure *info = gst_structure_copy(protectionMeta->info);
-    gst_structure_set(info, "mks_id", G_TYPE_INT, m_rialtoSessionId, NULL);
+    gst_structure_set(info, "mks_id", G_TYPE_INT, kKeySessionId, NULL);
 
     if (!gst_structure_has_field_typed(info, "encrypted", G_TYPE_BOOLEAN))
     {
@@ -297,12 +572,11 @@ bool OpenCDMSessionPrivate::addProtectionMeta(GstBuffer *buffer)
     }
 
     // Set key for Playready
-    if (!m_playreadyKeyId.empty())
+    GstBuffer *playreadyKeyId{getPlayreadyKeyId()};
+    if (playreadyKeyId)
     {
-        GstBuffer *keyID = gst_buffer_new_allocate(nullptr, m_playreadyKeyId.size(), nullptr);
-        gst_buffer_fill(keyID, 0, m_playreadyKeyId.data(), m_playreadyKeyId.size());
-        gst_structure_set(info, "kid", GST_TYPE_BUFFER, keyID, NULL);
-        gst_buffer_unref(keyID);
+        gst_structure_set(info, "kid", GST_TYPE_BUFFER, playreadyKeyId, NULL);
+        gst_buffer_unref(playreadyKeyId);
     }
 
     rialto_mse_add_protection_metadata(buffer, info);
@@ -312,25 +586,44 @@ bool OpenCDMSessionPrivate::addProtectionMeta(GstBuffer *buffer)
 
 bool OpenCDMSessionPrivate::closeSession()
 {
+    return closeSession(this);
+}
+
+bool OpenCDMSessionPrivate::closeSession(OpenCDMSession *session)
+{
+    if (detachSession(session))
+    {
+        RIALTO_LOG_FMT(m_log, info, "Key session {} still used by attached sessions, not closed",
+                       m_rialtoSessionId.load());
+        return true;
+    }
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        if (m_cdmBackend->closeKeySession(m_rialtoSessionId))
+        if (m_cdmBackend->closeKeySession(kKeySessionId))
         {
-            m_log << info << "Successfully closed the session";
+            m_log << info << RIALTO_LOG_LITERAL("Successfully closed the session");
             m_messageDispatcherClient.reset();
-            m_challengeData.clear();
+            ProfiledLock lock{m_mutex};
+            releaseBuffer(m_initData);
+            releaseBuffer(m_challengeData);
+            releaseBuffer(m_challengeUrl);
             m_keyStatuses.clear();
+            m_expectedKeyIds.clear();
+            m_hasRequest = false;
+            m_keyStatusCv.notify_all();
             return true;
         }
         else
         {
-            m_log << warn << "Failed to close the session.";
+            m_log << warn << RIALTO_LOG_LITERAL("Failed to close the session.");
         }
     }
 
@@ -339,22 +632,24 @@ bool OpenCDMSessionPrivate::closeSession()
 
 bool OpenCDMSessionPrivate::removeSession()
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        if (m_cdmBackend->removeKeySession(m_rialtoSessionId))
+        if (m_cdmBackend->removeKeySession(kKeySessionId))
         {
-            m_log << info << "Successfully removed the session";
+            m_log << info << RIALTO_LOG_LITERAL("Successfully removed the session");
             return true;
         }
         else
         {
-            m_log << warn << "Failed to remove the session.";
+            m_log << warn << RIALTO_LOG_LITERAL("Failed to remove the session.");
         }
     }
 
@@ -363,54 +658,85 @@ bool OpenCDMSessionPrivate::removeSession()
 
 bool OpenCDMSessionPrivate::containsKey(const std::vector<uint8_t> &keyId)
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        return m_cdmBackend->containsKey(m_rialtoSessionId, keyId);
+        return m_cdmBackend->containsKey(kKeySessionId, keyId);
     }
     return false;
 }
 
 bool OpenCDMSessionPrivate::setDrmHeader(const std::vector<uint8_t> &drmHeader)
 {
+    collectSpeculativeRequest();
+    const int32_t kKeySessionId{m_rialtoSessionId};
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return false;
     }
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        return m_cdmBackend->setDrmHeader(m_rialtoSessionId, drmHeader);
+        return m_cdmBackend->setDrmHeader(kKeySessionId, drmHeader);
     }
     return false;
 }
 
 bool OpenCDMSessionPrivate::selectKeyId(const std::vector<uint8_t> &keyId)
 {
-    m_log << debug << "Playready key selected.";
-    m_playreadyKeyId = keyId;
+    m_log << debug << RIALTO_LOG_LITERAL("Playready key selected.");
+    // Kept as a GstBuffer, so that the protection meta of every decrypted buffer only takes a reference to it
+    GstBuffer *keyIdBuffer{nullptr};
+    if (!keyId.empty())
+    {
+        keyIdBuffer = gst_buffer_new_allocate(nullptr, keyId.size(), nullptr);
+        gst_buffer_fill(keyIdBuffer, 0, keyId.data(), keyId.size());
+    }
+    {
+        // Decrypting threads take their own reference under the lock, see getPlayreadyKeyId()
+        ProfiledLock lock{m_mutex};
+        std::swap(m_playreadyKeyId, keyIdBuffer);
+    }
+    if (keyIdBuffer)
+    {
+        gst_buffer_unref(keyIdBuffer);
+    }
     return true;
 }
 
+GstBuffer *OpenCDMSessionPrivate::getPlayreadyKeyId()
+{
+    ProfiledLock lock{m_mutex};
+    return m_playreadyKeyId ? gst_buffer_ref(m_playreadyKeyId) : nullptr;
+}
+
 void OpenCDMSessionPrivate::onLicenseRequest(int32_t keySessionId,
                                              const std::vector<unsigned char> &licenseRequestMessage,
                                              const std::string &url)
 {
     if (keySessionId == m_rialtoSessionId)
     {
-        updateChallenge(licenseRequestMessage);
+        Tracer::instance().addInstantEvent("onLicenseRequest", this, keySessionId);
+        updateChallenge(licenseRequestMessage, url);
 
         if ((m_callbacks) && (m_callbacks->process_challenge_callback))
         {
             m_callbacks->process_challenge_callback(this, m_context, url.c_str(), licenseRequestMessage.data(),
                                                     licenseRequestMessage.size());
         }
+        for (const AttachedSession &attachedSession : getAttachedSessions())
+        {
+            notifyChallenge(attachedSession.session, attachedSession.callbacks, attachedSession.context, url,
+                            licenseRequestMessage);
+        }
     }
 }
 
@@ -418,51 +744,202 @@ void OpenCDMSessionPrivate::onLicenseRenewal(int32_t keySessionId, const std::ve
 {
     if (keySessionId == m_rialtoSessionId)
     {
-        updateChallenge(licenseRenewalMessage);
+        updateChallenge(licenseRenewalMessage, "");
 
         if ((m_callbacks) && (m_callbacks->process_challenge_callback))
         {
             m_callbacks->process_challenge_callback(this, m_context, "" /*URL*/, licenseRenewalMessage.data(),
                                                     licenseRenewalMessage.size());
         }
+        for (const AttachedSession &attachedSession : getAttachedSessions())
+        {
+            notifyChallenge(attachedSession.session, attachedSession.callbacks, attachedSession.context, "",
+                            licenseRenewalMessage);
+        }
     }
 }
 
-void OpenCDMSessionPrivate::updateChallenge(const std::vector<unsigned char> &challenge)
+void OpenCDMSessionPrivate::onKeySessionIdsChanged(const std::map<int32_t, int32_t> &newKeySessionIds)
 {
-    std::unique_lock<std::mutex> lock{m_mutex};
+    int32_t keySessionId{m_rialtoSessionId};
+    auto idIter{newKeySessionIds.find(keySessionId)};
+    if (idIter == newKeySessionIds.end())
+    {
+        return;
+    }
+    // Left alone when the session has moved on to another key session in the meantime
+    if (!m_rialtoSessionId.compare_exchange_strong(keySessionId, idIter->second))
+    {
+        return;
+    }
+    Tracer::instance().addInstantEvent("onKeySessionIdsChanged", this, idIter->second);
+    RIALTO_LOG_FMT(m_log, info, "Key session {} re-created as {}", idIter->first, idIter->second);
+}
+
+void OpenCDMSessionPrivate::updateChallenge(const std::vector<unsigned char> &challenge, const std::string &url)
+{
+    ProfiledLock lock{m_mutex};
     m_challengeData = challenge;
-    m_challengeCv.notify_one();
+    m_challengeUrl = url;
+    m_challengeCv.notify_all();
 }
 
 void OpenCDMSessionPrivate::onKeyStatusesChanged(int32_t keySessionId,
                                                  const firebolt::rialto::KeyStatusVector &keyStatuses)
 {
-    if ((keySessionId == m_rialtoSessionId) && (m_callbacks) && (m_callbacks->key_update_callback))
+    if (keySessionId != m_rialtoSessionId)
+    {
+        return;
+    }
     {
+        // Update internal key statuses, also without callbacks, as decryptors may be waiting for them
+        ProfiledLock lock{m_mutex};
         for (const std::pair<std::vector<uint8_t>, firebolt::rialto::KeyStatus> &keyStatus : keyStatuses)
         {
-            // Update internal key statuses
             m_keyStatuses[keyStatus.first] = keyStatus.second;
-
-            const std::vector<uint8_t> &key = keyStatus.first;
-            m_callbacks->key_update_callback(this, m_context, key.data(), key.size());
         }
+        m_keyStatusCv.notify_all();
+    }
+    const std::vector<AttachedSession> kAttachedSessions{getAttachedSessions()};
+    if ((!m_callbacks || !m_callbacks->key_update_callback) && kAttachedSessions.empty())
+    {
+        return;
+    }
+    Tracer::instance().addInstantEvent("onKeyStatusesChanged", this, keySessionId);
+    Metrics::instance().add(MetricId::KEY_STATUS_UPDATES);
+    notifyKeyStatuses(this, m_callbacks, m_context, keyStatuses);
+    for (const AttachedSession &attachedSession : kAttachedSessions)
+    {
+        notifyKeyStatuses(attachedSession.session, attachedSession.callbacks, attachedSession.context, keyStatuses);
+    }
+}
+
+void OpenCDMSessionPrivate::addAttachedSession(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks,
+                                               void *context)
+{
+    ProfiledLock lock{m_mutex};
+    m_attachedSessions.push_back(AttachedSession{session, callbacks, context});
+}
+
+bool OpenCDMSessionPrivate::attachSession(OpenCDMSession *session, OpenCDMSessionCallbacks *callbacks, void *context,
+                                          const std::vector<uint8_t> &initData)
+{
+    ProfiledLock lock{m_mutex};
+    if (!m_hasRequest)
+    {
+        return false;
+    }
+    if (initData != m_initData)
+    {
+        m_log << warn << RIALTO_LOG_LITERAL("Init data digest matched different init data, key session not shared");
+        return false;
+    }
+    m_attachedSessions.push_back(AttachedSession{session, callbacks, context});
+    RIALTO_LOG_FMT(m_log, info, "Session {} attached to key session {}", static_cast<void *>(session),
+                   m_rialtoSessionId.load());
+    return true;
+}
 
-        if (m_callbacks->keys_updated_callback)
+void OpenCDMSessionPrivate::notifyAttachedSession(OpenCDMSession *session)
+{
+    ProfiledLock lock{m_mutex};
+    auto attachedIter{std::find_if(m_attachedSessions.begin(), m_attachedSessions.end(),
+                                   [session](const AttachedSession &attached) { return attached.session == session; })};
+    if (attachedIter == m_attachedSessions.end())
+    {
+        return;
+    }
+    const AttachedSession kAttachedSession{*attachedIter};
+    const std::vector<uint8_t> kChallenge{m_challengeData};
+    const std::string kUrl{m_challengeUrl};
+    const firebolt::rialto::KeyStatusVector kKeyStatuses{m_keyStatuses.begin(), m_keyStatuses.end()};
+    // Callbacks may call the session again
+    lock.unlock();
+    if (!kKeyStatuses.empty())
+    {
+        notifyKeyStatuses(session, kAttachedSession.callbacks, kAttachedSession.context, kKeyStatuses);
+    }
+    else if (!kChallenge.empty())
+    {
+        notifyChallenge(session, kAttachedSession.callbacks, kAttachedSession.context, kUrl, kChallenge);
+    }
+}
+
+bool OpenCDMSessionPrivate::detachSession(OpenCDMSession *session)
+{
+    ProfiledLock lock{m_mutex};
+    m_attachedSessions.erase(std::remove_if(m_attachedSessions.begin(), m_attachedSessions.end(),
+                                            [session](const AttachedSession &attached)
+                                            { return attached.session == session; }),
+                             m_attachedSessions.end());
+    return !m_attachedSessions.empty();
+}
+
+bool OpenCDMSessionPrivate::isFirstAttachedSession(const OpenCDMSession *session)
+{
+    ProfiledLock lock{m_mutex};
+    return !m_attachedSessions.empty() && m_attachedSessions.front().session == session;
+}
+
+size_t OpenCDMSessionPrivate::getAttachedSessionCount()
+{
+    ProfiledLock lock{m_mutex};
+    return m_attachedSessions.size();
+}
+
+std::vector<OpenCDMSessionPrivate::AttachedSession> OpenCDMSessionPrivate::getAttachedSessions()
+{
+    ProfiledLock lock{m_mutex};
+    return m_attachedSessions;
+}
+
+void OpenCDMSessionPrivate::addExpectedKeyIds(firebolt::rialto::InitDataType initDataType,
+                                              const std::vector<uint8_t> &initData)
+{
+    std::vector<std::vector<uint8_t>> keyIds{parseKeyIds(initDataType, initData)};
+    if (keyIds.empty())
+    {
+        return;
+    }
+    RIALTO_LOG_FMT(m_log, debug, "{} key IDs expected from the init data", keyIds.size());
+    ProfiledLock lock{m_mutex};
+    for (std::vector<uint8_t> &keyId : keyIds)
+    {
+        if (std::find(m_expectedKeyIds.begin(), m_expectedKeyIds.end(), keyId) == m_expectedKeyIds.end())
         {
-            m_callbacks->keys_updated_callback(this, m_context);
+            m_expectedKeyIds.push_back(std::move(keyId));
         }
     }
 }
 
-KeyStatus OpenCDMSessionPrivate::status(const std::vector<uint8_t> &key) const
+KeyStatus OpenCDMSessionPrivate::status(const uint8_t keyId[], uint8_t length) const
+{
+    ProfiledLock lock{m_mutex};
+    return getKeyStatus(keyId, length);
+}
+
+KeyStatus OpenCDMSessionPrivate::waitForKey(const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout)
 {
-    auto it = m_keyStatuses.find(key);
+    ProfiledLock lock{m_mutex};
+    m_keyStatusCv.wait_for(lock, timeout, [&]() { return StatusPending != getKeyStatus(keyId, length); });
+    return getKeyStatus(keyId, length);
+}
+
+KeyStatus OpenCDMSessionPrivate::getKeyStatus(const uint8_t keyId[], uint8_t length) const
+{
+    // Sessions hold a handful of keys, so a linear search is cheap and avoids copying the key into a vector
+    const auto kIsKeyId{[&](const std::vector<uint8_t> &knownKeyId)
+                        { return std::equal(knownKeyId.begin(), knownKeyId.end(), keyId, keyId + length); }};
+    auto it = std::find_if(m_keyStatuses.begin(), m_keyStatuses.end(),
+                           [&](const auto &keyStatus) { return kIsKeyId(keyStatus.first); });
     if (it != m_keyStatuses.end())
     {
         return convertKeyStatus(it->second);
     }
+    if (std::any_of(m_expectedKeyIds.begin(), m_expectedKeyIds.end(), kIsKeyId))
+    {
+        return StatusPending;
+    }
     return KeyStatus::InternalError;
 }
 
@@ -474,10 +951,11 @@ const std::string &OpenCDMSessionPrivate::getSessionId() const
 void OpenCDMSessionPrivate::initializeCdmKeySessionId()
 {
     bool result{false};
+    const int32_t kKeySessionId{m_rialtoSessionId};
 
-    if (-1 != m_rialtoSessionId)
+    if (-1 != kKeySessionId)
     {
-        result = m_cdmBackend->getCdmKeySessionId(m_rialtoSessionId, m_cdmKeySessionId);
+        result = m_cdmBackend->getCdmKeySessionId(kKeySessionId, m_cdmKeySessionId);
     }
     if (!result)
     {
@@ -485,12 +963,64 @@ void OpenCDMSessionPrivate::initializeCdmKeySessionId()
     }
 }
 
+void OpenCDMSessionPrivate::countDecrypt()
+{
+    Metrics::instance().add(MetricId::DECRYPT_CALLS);
+    if (0 == m_decryptCalls.fetch_add(1, std::memory_order_relaxed))
+    {
+        Tracer::instance().addInstantEvent("firstDecrypt", this, m_rialtoSessionId);
+    }
+}
+
+uint64_t OpenCDMSessionPrivate::getDecryptCalls() const
+{
+    return m_decryptCalls.load(std::memory_order_relaxed);
+}
+
+SessionMemoryUsage OpenCDMSessionPrivate::getMemoryUsage()
+{
+    ProfiledLock lock{m_mutex};
+    SessionMemoryUsage usage;
+    usage.sessionBytes = sizeof(*this);
+    usage.initDataBytes = m_initData.capacity();
+    usage.challengeBytes = m_challengeData.capacity() + m_challengeUrl.size();
+    for (const auto &keyStatus : m_keyStatuses)
+    {
+        usage.keyIdBytes += sizeof(keyStatus) + keyStatus.first.capacity();
+    }
+    for (const std::vector<uint8_t> &keyId : m_expectedKeyIds)
+    {
+        usage.keyIdBytes += sizeof(keyId) + keyId.capacity();
+    }
+    return usage;
+}
+
+void OpenCDMSessionPrivate::setChallengeTimeout(std::chrono::milliseconds timeout)
+{
+    challengeTimeoutMs().store(timeout.count(), std::memory_order_relaxed);
+}
+
+std::chrono::milliseconds OpenCDMSessionPrivate::getChallengeTimeout()
+{
+    return std::chrono::milliseconds{challengeTimeoutMs().load(std::memory_order_relaxed)};
+}
+
+void OpenCDMSessionPrivate::setSpeculativeChallengeEnabled(bool isEnabled)
+{
+    speculativeChallengeEnabled().store(isEnabled, std::memory_order_relaxed);
+}
+
+bool OpenCDMSessionPrivate::isSpeculativeChallengeEnabled()
+{
+    return speculativeChallengeEnabled().load(std::memory_order_relaxed);
+}
+
 uint32_t OpenCDMSessionPrivate::getLastDrmError() const
 {
     uint32_t err = 0;
     if (!m_cdmBackend)
     {
-        m_log << error << "Cdm is NULL or not initialized";
+        m_log << error << RIALTO_LOG_LITERAL("Cdm is NULL or not initialized");
         return -1;
     }
 
@@ -20,14 +20,29 @@
 #include "OpenCDMSystemPrivate.h"
 #include "ActiveSessions.h"
 #include "IMediaKeys.h"
+#include "Tracer.h"
 #include <MediaCommon.h>
 
+namespace
+{
+std::shared_ptr<firebolt::rialto::IControl> createControl()
+{
+    TraceScope traceScope{"createControl"};
+    return firebolt::rialto::IControlFactory::createFactory()->createControl();
+}
+} // namespace
+
 OpenCDMSystem *createSystem(const char system[], const std::string &metadata)
 {
     const std::string kKeySystem{system};
-    auto messageDispatcher{std::make_shared<MessageDispatcher>()};
-    auto cdmBackend{std::make_shared<CdmBackend>(kKeySystem, messageDispatcher,
-                                                 firebolt::rialto::IMediaKeysFactory::createFactory())};
+    std::shared_ptr<MessageDispatcher> messageDispatcher;
+    std::shared_ptr<CdmBackend> cdmBackend;
+    {
+        TraceScope traceScope{"createCdmBackend"};
+        messageDispatcher = std::make_shared<MessageDispatcher>();
+        cdmBackend = std::make_shared<CdmBackend>(kKeySystem, messageDispatcher,
+                                                  firebolt::rialto::IMediaKeysFactory::createFactory());
+    }
     return new OpenCDMSystemPrivate(kKeySystem, metadata, messageDispatcher, cdmBackend);
 }
 
@@ -35,7 +50,7 @@ OpenCDMSystemPrivate::OpenCDMSystemPrivate(const std::string &system, const std:
                                            const std::shared_ptr<MessageDispatcher> &messageDispatcher,
                                            const std::shared_ptr<CdmBackend> &cdmBackend)
     : m_log{"OpenCDMSystemPrivate"}, m_keySystem(system),
-      m_metadata(metadata), m_control{firebolt::rialto::IControlFactory::createFactory()->createControl()},
+      m_metadata(metadata), m_control{createControl()},
       m_messageDispatcher{messageDispatcher}, m_cdmBackend{cdmBackend}
 {
     m_log << debug << "constructed: " << static_cast<void *>(this);
@@ -44,7 +59,10 @@ OpenCDMSystemPrivate::OpenCDMSystemPrivate(const std::string &system, const std:
         return;
     }
     firebolt::rialto::ApplicationState initialState{firebolt::rialto::ApplicationState::UNKNOWN};
-    m_control->registerClient(m_cdmBackend, initialState);
+    {
+        TraceScope traceScope{"registerClient"};
+        m_control->registerClient(m_cdmBackend, initialState);
+    }
     m_cdmBackend->initialize(initialState);
 }
 
@@ -65,10 +83,10 @@ const std::string &OpenCDMSystemPrivate::metadata() const
 
 OpenCDMSession *OpenCDMSystemPrivate::createSession(const LicenseType licenseType, OpenCDMSessionCallbacks *callbacks,
                                                     void *userData, const std::string &initDataType,
-                                                    const std::vector<uint8_t> &initData) const
+                                                    std::vector<uint8_t> initData) const
 {
-    return ActiveSessions::instance().create(m_cdmBackend, m_messageDispatcher, licenseType, callbacks, userData,
-                                             initDataType, initData);
+    return ActiveSessions::instance().create(m_keySystem, m_cdmBackend, m_messageDispatcher, licenseType, callbacks,
+                                             userData, initDataType, std::move(initData));
 }
 
 bool OpenCDMSystemPrivate::getDrmTime(uint64_t &drmTime) const
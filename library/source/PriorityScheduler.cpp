@@ -0,0 +1,114 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PriorityScheduler.h"
+#include "Metrics.h"
+#include <algorithm>
+
+void PriorityScheduler::acquire(SessionPriority priority)
+{
+    ProfiledLock lock{m_mutex};
+    if (!m_isBusy && m_waiters.empty())
+    {
+        m_isBusy = true;
+        return;
+    }
+    const std::pair<SessionPriority, uint64_t> kWaiter{priority, ++m_nextTicket};
+    m_waiters.insert(kWaiter);
+    m_cv.wait(lock, [&]() { return m_grantedTicket == kWaiter.second; });
+}
+
+void PriorityScheduler::release()
+{
+    ProfiledLock lock{m_mutex};
+    if (m_waiters.empty())
+    {
+        m_isBusy = false;
+        return;
+    }
+    const auto kOldest{std::min_element(m_waiters.begin(), m_waiters.end(),
+                                        [](const auto &lhs, const auto &rhs) { return lhs.second < rhs.second; })};
+    auto grantedIter{m_waiters.begin()};
+    if (kOldest == grantedIter)
+    {
+        m_overtakes = 0;
+    }
+    else if (m_overtakes >= kMaxOvertakes)
+    {
+        Metrics::instance().add(MetricId::SCHEDULER_STARVATION_GRANTS);
+        m_overtakes = 0;
+        grantedIter = kOldest;
+    }
+    else
+    {
+        ++m_overtakes;
+    }
+    // Stays busy, the turn is handed over to the granted waiter
+    m_grantedTicket = grantedIter->second;
+    m_waiters.erase(grantedIter);
+    m_cv.notify_all();
+}
+
+void PriorityScheduler::setPriority(int32_t keySessionId, SessionPriority priority)
+{
+    ProfiledLock lock{m_mutex};
+    m_priorities[keySessionId] = priority;
+}
+
+size_t PriorityScheduler::getWaitingCount()
+{
+    ProfiledLock lock{m_mutex};
+    return m_waiters.size();
+}
+
+SessionPriority PriorityScheduler::getPriority(int32_t keySessionId)
+{
+    ProfiledLock lock{m_mutex};
+    auto priorityIter{m_priorities.find(keySessionId)};
+    return priorityIter != m_priorities.end() ? priorityIter->second : SessionPriority::FOREGROUND;
+}
+
+void PriorityScheduler::removePriority(int32_t keySessionId)
+{
+    ProfiledLock lock{m_mutex};
+    m_priorities.erase(keySessionId);
+}
+
+ScheduledLock::ScheduledLock(PriorityScheduler &scheduler, SessionPriority priority, ProfiledMutex &mutex)
+    : m_scheduler{scheduler}, m_isScheduled{(scheduler.acquire(priority), true)}, m_lock{mutex}
+{
+}
+
+ScheduledLock::~ScheduledLock()
+{
+    unlock();
+}
+
+void ScheduledLock::unlock()
+{
+    if (m_lock.owns_lock())
+    {
+        m_lock.unlock();
+    }
+    if (m_isScheduled)
+    {
+        m_isScheduled = false;
+        m_scheduler.release();
+    }
+}
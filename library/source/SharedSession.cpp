@@ -0,0 +1,156 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedSession.h"
+
+SharedSession::SharedSession(OpenCDMSessionPrivate &session, bool isOwner) : m_session{session}, m_isOwner{isOwner}
+{
+}
+
+bool SharedSession::initialize()
+{
+    return !m_isOwner || m_session.initialize();
+}
+
+bool SharedSession::initialize(bool isLDL)
+{
+    return !m_isOwner || m_session.initialize(isLDL);
+}
+
+bool SharedSession::generateRequest(const std::string &initDataType, const std::vector<uint8_t> &initData,
+                                    const std::vector<uint8_t> &cdmData)
+{
+    // Attached sessions are given the challenge of the owner's request
+    return !m_isOwner || m_session.generateRequest(initDataType, initData, cdmData);
+}
+
+bool SharedSession::loadSession()
+{
+    return !m_isOwner || m_session.loadSession();
+}
+
+bool SharedSession::updateSession(const std::vector<uint8_t> &license)
+{
+    if (!m_session.isFirstAttachedSession(this))
+    {
+        // The license is applied once for all attached sessions, by the owner or the oldest session left after it
+        // was closed. The others get the key statuses through their callbacks.
+        return true;
+    }
+    return m_session.updateSession(license);
+}
+
+bool SharedSession::getChallengeData(std::vector<uint8_t> &challengeData)
+{
+    if (m_isOwner)
+    {
+        return m_session.getChallengeData(challengeData);
+    }
+    m_session.resetChallengeCancellation();
+    return m_session.waitForChallenge(challengeData);
+}
+
+void SharedSession::cancelChallengeData()
+{
+    m_session.cancelChallengeData();
+}
+
+void SharedSession::startSpeculativeRequest()
+{
+    if (m_isOwner)
+    {
+        m_session.startSpeculativeRequest();
+    }
+}
+
+void SharedSession::setPriority(SessionPriority priority)
+{
+    m_session.setPriority(priority);
+}
+
+bool SharedSession::containsKey(const std::vector<uint8_t> &keyId)
+{
+    return m_session.containsKey(keyId);
+}
+
+bool SharedSession::setDrmHeader(const std::vector<uint8_t> &drmHeader)
+{
+    return m_session.setDrmHeader(drmHeader);
+}
+
+bool SharedSession::selectKeyId(const std::vector<uint8_t> &keyId)
+{
+    return m_session.selectKeyId(keyId);
+}
+
+void SharedSession::addProtectionMeta(GstBuffer *buffer, GstBuffer *subSample, const uint32_t subSampleCount,
+                                      GstBuffer *IV, GstBuffer *keyID, uint32_t initWithLast15)
+{
+    m_session.addProtectionMeta(buffer, subSample, subSampleCount, IV, keyID, initWithLast15);
+}
+
+bool SharedSession::addProtectionMeta(GstBuffer *buffer)
+{
+    return m_session.addProtectionMeta(buffer);
+}
+
+bool SharedSession::closeSession()
+{
+    return m_session.closeSession(this);
+}
+
+bool SharedSession::removeSession()
+{
+    if (m_session.getAttachedSessionCount() > 1)
+    {
+        // The license is still used by the other attached sessions
+        return false;
+    }
+    return m_session.removeSession();
+}
+
+KeyStatus SharedSession::status(const uint8_t keyId[], uint8_t length) const
+{
+    return m_session.status(keyId, length);
+}
+
+KeyStatus SharedSession::waitForKey(const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout)
+{
+    return m_session.waitForKey(keyId, length, timeout);
+}
+
+const std::string &SharedSession::getSessionId() const
+{
+    return m_session.getSessionId();
+}
+
+uint32_t SharedSession::getLastDrmError() const
+{
+    return m_session.getLastDrmError();
+}
+
+uint64_t SharedSession::getDecryptCalls() const
+{
+    return m_session.getDecryptCalls();
+}
+
+SessionMemoryUsage SharedSession::getMemoryUsage()
+{
+    return m_session.getMemoryUsage();
+}
@@ -0,0 +1,242 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Tracer.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr std::chrono::milliseconds kTraceFlushInterval{200};
+
+const Logger kLog{"Tracer"};
+
+/**
+ * Owns the trace buffer of the current thread. The buffer stays registered in the Tracer until the writer thread
+ * has drained it after the thread finished.
+ */
+class ThreadTraceBuffer
+{
+public:
+    ThreadTraceBuffer() : m_buffer{std::make_shared<TraceBuffer>(static_cast<uint32_t>(syscall(SYS_gettid)))}
+    {
+        Tracer::instance().registerBuffer(m_buffer);
+    }
+    ~ThreadTraceBuffer() { m_buffer->setThreadFinished(); }
+
+    TraceBuffer &buffer() { return *m_buffer; }
+
+private:
+    std::shared_ptr<TraceBuffer> m_buffer;
+};
+
+void appendEvent(std::string &output, const TraceEvent &event, uint32_t processId, uint32_t threadId)
+{
+    char text[320];
+    int length{std::snprintf(text, sizeof(text),
+                             "{\"name\":\"%s\",\"cat\":\"ocdm\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03" PRIu64
+                             ",\"pid\":%u,\"tid\":%u",
+                             event.name, event.phase, event.timestampNs / 1000, event.timestampNs % 1000, processId,
+                             threadId)};
+    if ('X' == event.phase)
+    {
+        length += std::snprintf(text + length, sizeof(text) - length, ",\"dur\":%" PRIu64 ".%03" PRIu64,
+                                event.durationNs / 1000, event.durationNs % 1000);
+    }
+    else if ('i' == event.phase)
+    {
+        length += std::snprintf(text + length, sizeof(text) - length, ",\"s\":\"t\"");
+    }
+    length += std::snprintf(text + length, sizeof(text) - length, ",\"args\":{\"session\":\"%p\"", event.session);
+    if (event.keySessionId >= 0)
+    {
+        length += std::snprintf(text + length, sizeof(text) - length, ",\"keySessionId\":%d", event.keySessionId);
+    }
+    length += std::snprintf(text + length, sizeof(text) - length, "}}");
+    output.append(text, std::min(static_cast<size_t>(length), sizeof(text) - 1));
+}
+} // namespace
+
+void TraceBuffer::push(const TraceEvent &event)
+{
+    const uint64_t kWriteIndex{m_writeIndex.load(std::memory_order_relaxed)};
+    if (kWriteIndex - m_readIndex.load(std::memory_order_acquire) >= kCapacity)
+    {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_events[kWriteIndex % kCapacity] = event;
+    m_writeIndex.store(kWriteIndex + 1, std::memory_order_release);
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : m_isEnabled{false}, m_isRunning{false}, m_fd{-1}, m_isFirstEvent{true}
+{
+    reset();
+}
+
+Tracer::~Tracer()
+{
+    stop();
+}
+
+bool Tracer::start(const std::string &path)
+{
+    stop();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+    {
+        kLog << error << "Failed to open trace file " << path << ", errno: " << errno;
+        return false;
+    }
+    // Discard events recorded after the previous trace was stopped
+    for (const auto &buffer : m_buffers)
+    {
+        buffer->drain([](const TraceEvent &) {});
+        buffer->takeDroppedEvents();
+    }
+    writeAll("[\n");
+    m_isFirstEvent = true;
+    m_isRunning = true;
+    m_writerThread = std::thread(&Tracer::writerLoop, this);
+    m_isEnabled = true;
+    kLog << info << "Tracing to " << path;
+    return true;
+}
+
+void Tracer::stop()
+{
+    m_isEnabled = false;
+    if (m_writerThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_isRunning = false;
+            m_cv.notify_one();
+        }
+        m_writerThread.join();
+    }
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_fd >= 0)
+    {
+        writeAll("\n]\n");
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void Tracer::reset()
+{
+    const char *path{getenv("RIALTO_TRACE_PATH")};
+    if (path && '\0' != path[0])
+    {
+        start(path);
+    }
+    else
+    {
+        stop();
+    }
+}
+
+void Tracer::addEvent(const TraceEvent &event)
+{
+    thread_local ThreadTraceBuffer threadBuffer;
+    threadBuffer.buffer().push(event);
+}
+
+void Tracer::addInstantEvent(const char *name, const void *session, int32_t keySessionId)
+{
+    if (isEnabled())
+    {
+        addEvent(TraceEvent{name, 'i', now(), 0, session, keySessionId});
+    }
+}
+
+void Tracer::registerBuffer(const std::shared_ptr<TraceBuffer> &buffer)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_buffers.push_back(buffer);
+}
+
+void Tracer::writerLoop()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (m_isRunning)
+    {
+        m_cv.wait_for(lock, kTraceFlushInterval, [this]() { return !m_isRunning; });
+        writeEvents();
+    }
+}
+
+void Tracer::writeEvents()
+{
+    const uint32_t kProcessId{static_cast<uint32_t>(getpid())};
+    m_output.clear();
+    for (auto bufferIter = m_buffers.begin(); bufferIter != m_buffers.end();)
+    {
+        const std::shared_ptr<TraceBuffer> &kBuffer{*bufferIter};
+        // Checked before draining, so that events pushed just before the thread finished are not lost
+        const bool kIsThreadFinished{kBuffer->isThreadFinished()};
+        kBuffer->drain(
+            [&](const TraceEvent &event)
+            {
+                m_output += m_isFirstEvent ? "" : ",\n";
+                m_isFirstEvent = false;
+                appendEvent(m_output, event, kProcessId, kBuffer->threadId());
+            });
+        const uint64_t kDroppedEvents{kBuffer->takeDroppedEvents()};
+        if (0 != kDroppedEvents)
+        {
+            kLog << warn << "Dropped " << kDroppedEvents << " trace events of thread " << kBuffer->threadId();
+        }
+        bufferIter = kIsThreadFinished ? m_buffers.erase(bufferIter) : bufferIter + 1;
+    }
+    writeAll(m_output);
+}
+
+void Tracer::writeAll(const std::string &data)
+{
+    size_t written{0};
+    while (written < data.size())
+    {
+        const ssize_t kResult{write(m_fd, data.data() + written, data.size() - written)};
+        if (kResult < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return;
+        }
+        written += static_cast<size_t>(kResult);
+    }
+}
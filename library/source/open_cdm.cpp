@@ -23,9 +23,12 @@
 #include "Logger.h"
 #include "MediaKeysCapabilitiesBackend.h"
 #include "OpenCDMSession.h"
+#include "OpenCDMSessionPrivate.h"
 #include "OpenCDMSystemPrivate.h"
+#include "Tracer.h"
 #include <cassert>
 #include <cstring>
+#include <utility>
 
 namespace
 {
@@ -40,8 +43,12 @@ bool isPlayreadyKeysystem(const std::string &keySystem)
 OpenCDMSystem *opencdm_create_system(const char keySystem[])
 {
     kLog << debug << __func__;
-    const std::string kCommitId{COMMIT_ID};
-    kLog << info << "Commit ID: " << (kCommitId.empty() ? "Unknown" : kCommitId.c_str());
+    TraceScope traceScope{"opencdm_create_system"};
+    {
+        TraceScope logScope{"logCommitId"};
+        const std::string kCommitId{COMMIT_ID};
+        kLog << info << RIALTO_LOG_LITERAL("Commit ID: ") << (kCommitId.empty() ? "Unknown" : kCommitId.c_str());
+    }
 
     OpenCDMSystem *result = nullptr;
     opencdm_create_system_extended(keySystem, &result);
@@ -73,6 +80,7 @@ OpenCDMError opencdm_destruct_system(struct OpenCDMSystem *system)
 OpenCDMError opencdm_is_type_supported(const char keySystem[], const char mimeType[])
 {
     kLog << debug << __func__;
+    TraceScope traceScope{"opencdm_is_type_supported"};
     return MediaKeysCapabilitiesBackend::instance().supportsKeySystem(std::string(keySystem));
 }
 
@@ -113,12 +121,12 @@ OpenCDMError opencdm_system_get_drm_time(struct OpenCDMSystem *system, uint64_t
     kLog << debug << __func__;
     if (!time || !system)
     {
-        kLog << error << "Ptr is null";
+        kLog << error << RIALTO_LOG_LITERAL("Ptr is null");
         return ERROR_FAIL;
     }
     if (!system->getDrmTime(*time))
     {
-        kLog << error << "Failed to get DRM Time";
+        kLog << error << RIALTO_LOG_LITERAL("Failed to get DRM Time");
         return ERROR_FAIL;
     }
     return ERROR_NONE;
@@ -128,7 +136,7 @@ struct OpenCDMSession *opencdm_get_system_session(struct OpenCDMSystem *system,
                                                   const uint8_t length, const uint32_t waitTime)
 {
     kLog << debug << __func__;
-    return ActiveSessions::instance().get(std::vector<uint8_t>(keyId, keyId + length));
+    return ActiveSessions::instance().get(keyId, length);
 }
 
 OpenCDMError opencdm_system_set_server_certificate(struct OpenCDMSystem *system, const uint8_t serverCertificate[],
@@ -151,41 +159,50 @@ OpenCDMError opencdm_construct_session(struct OpenCDMSystem *system, const Licen
                                        struct OpenCDMSession **session)
 {
     kLog << debug << __func__;
+    TraceScope traceScope{"opencdm_construct_session"};
     if (!system)
     {
-        kLog << error << "System is NULL or not initialized";
+        kLog << error << RIALTO_LOG_LITERAL("System is NULL or not initialized");
         return ERROR_FAIL;
     }
     std::string initializationDataType(initDataType);
     std::vector<uint8_t> initDataVec((uint8_t *)(initData), (uint8_t *)(initData) + initDataLength);
 
+    // The session takes over the init data, it is kept until the license has been applied
     OpenCDMSession *newSession =
-        system->createSession(licenseType, callbacks, userData, initializationDataType, initDataVec);
+        system->createSession(licenseType, callbacks, userData, initializationDataType, std::move(initDataVec));
 
     if (!newSession)
     {
         return ERROR_INVALID_SESSION;
     }
+    traceScope.setSession(newSession);
 
     if (!isPlayreadyKeysystem(system->keySystem()))
     {
         if (!newSession->initialize())
         {
-            kLog << error << "Failed to create session";
+            kLog << error << RIALTO_LOG_LITERAL("Failed to create session");
             ActiveSessions::instance().remove(newSession);
             return ERROR_FAIL;
         }
-        std::vector<uint8_t> cdmDataVec((uint8_t *)(CDMData), (uint8_t *)(CDMData) + CDMDataLength);
+        const std::vector<uint8_t> kCdmDataVec((uint8_t *)(CDMData), (uint8_t *)(CDMData) + CDMDataLength);
 
-        if (!newSession->generateRequest(initializationDataType, initDataVec, cdmDataVec /*not used yet*/))
+        // Generated from the init data the session was created with
+        if (!newSession->generateRequest(initializationDataType, {}, kCdmDataVec /*not used yet*/))
         {
-            kLog << error << "Failed to generate request";
+            kLog << error << RIALTO_LOG_LITERAL("Failed to generate request");
 
             opencdm_session_close(newSession);
             ActiveSessions::instance().remove(newSession);
             return ERROR_FAIL;
         }
     }
+    else if (OpenCDMSessionPrivate::isSpeculativeChallengeEnabled())
+    {
+        // Overlaps the key session creation and challenge generation with the app preparing the license request
+        newSession->startSpeculativeRequest();
+    }
 
     *session = newSession;
 
@@ -212,7 +229,7 @@ OpenCDMError opencdm_session_load(struct OpenCDMSession *session)
         }
         else
         {
-            kLog << error << "Failed to load the session";
+            kLog << error << RIALTO_LOG_LITERAL("Failed to load the session");
             result = ERROR_FAIL;
         }
     }
@@ -253,7 +270,7 @@ uint32_t opencdm_session_has_key_id(struct OpenCDMSession *session, const uint8_
     kLog << debug << __func__;
     if (!session)
     {
-        kLog << error << "Failed to check key id";
+        kLog << error << RIALTO_LOG_LITERAL("Failed to check key id");
         return 0;
     }
     std::vector<uint8_t> key(keyId, keyId + length);
@@ -265,8 +282,7 @@ KeyStatus opencdm_session_status(const struct OpenCDMSession *session, const uin
     kLog << debug << __func__;
     if (session && keyId && 0 != length)
     {
-        std::vector<uint8_t> key(keyId, keyId + length);
-        return session->status(key);
+        return session->status(keyId, length);
     }
 
     return InternalError;
@@ -298,6 +314,7 @@ OpenCDMError opencdm_session_system_error(const struct OpenCDMSession *session)
 OpenCDMError opencdm_session_update(struct OpenCDMSession *session, const uint8_t keyMessage[], uint16_t keyLength)
 {
     kLog << debug << __func__;
+    TraceScope traceScope{"opencdm_session_update", session};
     if (!session)
     {
         kLog << error << __func__ << ": Session is NULL";
@@ -311,7 +328,7 @@ OpenCDMError opencdm_session_update(struct OpenCDMSession *session, const uint8_
     std::vector<uint8_t> license(keyMessage, keyMessage + keyLength);
     if (!session->updateSession(license))
     {
-        kLog << error << "Failed to update the session";
+        kLog << error << RIALTO_LOG_LITERAL("Failed to update the session");
         return ERROR_FAIL;
     }
 
@@ -330,7 +347,7 @@ OpenCDMError opencdm_session_remove(struct OpenCDMSession *session)
         }
         else
         {
-            kLog << error << "Failed to remove the key session";
+            kLog << error << RIALTO_LOG_LITERAL("Failed to remove the key session");
             result = ERROR_FAIL;
         }
     }
@@ -354,6 +371,7 @@ OpenCDMError opencdm_session_set_parameter(struct OpenCDMSession *session, const
 OpenCDMError opencdm_session_close(struct OpenCDMSession *session)
 {
     kLog << debug << __func__;
+    TraceScope traceScope{"opencdm_session_close", session};
     OpenCDMError result = ERROR_INVALID_SESSION;
     if (session)
     {
@@ -363,7 +381,7 @@ OpenCDMError opencdm_session_close(struct OpenCDMSession *session)
         }
         else
         {
-            kLog << error << "Failed to close the key session";
+            kLog << error << RIALTO_LOG_LITERAL("Failed to close the key session");
             result = ERROR_FAIL;
         }
     }
@@ -32,7 +32,7 @@ OpenCDMError opencdm_gstreamer_session_decrypt_ex(struct OpenCDMSession *session
 {
     if (nullptr == session)
     {
-        kLog << error << "Failed to decrypt - session is NULL";
+        kLog << RIALTO_LOG_RATE_LIMITED(error) << RIALTO_LOG_LITERAL("Failed to decrypt - session is NULL");
         return ERROR_FAIL;
     }
     session->addProtectionMeta(buffer, subSample, subSampleCount, IV, keyID, initWithLast15);
@@ -52,13 +52,14 @@ OpenCDMError opencdm_gstreamer_session_decrypt_buffer(struct OpenCDMSession *ses
 {
     if (nullptr == session)
     {
-        kLog << error << "Failed to decrypt - session is NULL";
+        kLog << RIALTO_LOG_RATE_LIMITED(error) << RIALTO_LOG_LITERAL("Failed to decrypt - session is NULL");
         return ERROR_FAIL;
     }
 
     if (!session->addProtectionMeta(buffer))
     {
-        kLog << error << "Failed to decrypt - could not append protection meta";
+        kLog << RIALTO_LOG_RATE_LIMITED(error)
+             << RIALTO_LOG_LITERAL("Failed to decrypt - could not append protection meta");
         return ERROR_FAIL;
     }
 
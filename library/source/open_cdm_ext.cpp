@@ -17,14 +17,40 @@
  * limitations under the License.
  */
 
+#include "ActiveSessions.h"
+#include "CdmBackend.h"
+#include "LatencyStats.h"
+#include "LockProfiler.h"
 #include "Logger.h"
+#include "MediaKeysRecorder.h"
+#include "Metrics.h"
 #include "OpenCDMSession.h"
+#include "OpenCDMSessionPrivate.h"
 #include "OpenCDMSystem.h"
+#include "OpenCdmRialtoExt.h"
+#include "Tracer.h"
+#include <cstdio>
+#include <cstring>
 #include <opencdm/open_cdm_ext.h>
 
 namespace
 {
 const Logger kLog{"open_cdm_ext"};
+
+void fillLatencyStats(const LatencySnapshot &snapshot, OpenCDMLatencyStats *stats)
+{
+    if (!stats)
+    {
+        return;
+    }
+    stats->count = snapshot.count;
+    stats->totalNs = snapshot.totalNs;
+    stats->maxNs = snapshot.maxNs;
+    stats->p50Ns = snapshot.percentile(0.5);
+    stats->p90Ns = snapshot.percentile(0.9);
+    stats->p99Ns = snapshot.percentile(0.99);
+    stats->p999Ns = snapshot.percentile(0.999);
+}
 } // namespace
 
 OpenCDMError opencdm_system_ext_get_ldl_session_limit(struct OpenCDMSystem *system, uint32_t *ldlLimit)
@@ -215,7 +241,14 @@ OpenCDMError opencdm_session_get_challenge_data(struct OpenCDMSession *mOpenCDMS
 OpenCDMError opencdm_session_cancel_challenge_data(struct OpenCDMSession *mOpenCDMSession)
 {
     kLog << debug << __func__;
-    // MKS is destructed in opencdm_session_clean_decrypt_context
+    if (nullptr == mOpenCDMSession)
+    {
+        kLog << error << "Failed to cancel challenge data - session is NULL";
+        return ERROR_INVALID_SESSION;
+    }
+    // Wakes a thread blocked in opencdm_session_get_challenge_data. MKS is destructed in
+    // opencdm_session_clean_decrypt_context
+    mOpenCDMSession->cancelChallengeData();
     return ERROR_NONE;
 }
 
@@ -283,3 +316,251 @@ OpenCDMError opencdm_session_clean_decrypt_context(struct OpenCDMSession *mOpenC
     }
     return ERROR_NONE;
 }
+
+const char *opencdm_ext_get_latency_operation(uint32_t index)
+{
+    if (index >= static_cast<uint32_t>(CdmOperation::COUNT))
+    {
+        return nullptr;
+    }
+    return toString(static_cast<CdmOperation>(index));
+}
+
+OpenCDMError opencdm_ext_get_latency_stats(const char operation[], OpenCDMLatencyStats *callTime,
+                                           OpenCDMLatencyStats *lockWait)
+{
+    if (!operation)
+    {
+        kLog << error << "Failed to get latency stats - operation is NULL";
+        return ERROR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < static_cast<uint32_t>(CdmOperation::COUNT); ++i)
+    {
+        if (0 == std::strcmp(operation, toString(static_cast<CdmOperation>(i))))
+        {
+            LatencySnapshot lockWaitSnapshot;
+            LatencySnapshot callTimeSnapshot;
+            LatencyStats::instance().getStats(static_cast<CdmOperation>(i), lockWaitSnapshot, callTimeSnapshot);
+            fillLatencyStats(callTimeSnapshot, callTime);
+            fillLatencyStats(lockWaitSnapshot, lockWait);
+            return ERROR_NONE;
+        }
+    }
+    kLog << error << "Failed to get latency stats - unknown operation: " << operation;
+    return ERROR_INVALID_ARG;
+}
+
+OpenCDMError opencdm_ext_get_priority_latency_stats(OpenCDMSessionPriority priority, OpenCDMLatencyStats *callTime,
+                                                    OpenCDMLatencyStats *lockWait)
+{
+    if (priority < OPENCDM_SESSION_PRIORITY_FOREGROUND || priority > OPENCDM_SESSION_PRIORITY_BACKGROUND)
+    {
+        kLog << error << "Failed to get latency stats - unknown priority " << static_cast<int>(priority);
+        return ERROR_INVALID_ARG;
+    }
+    LatencySnapshot lockWaitSnapshot;
+    LatencySnapshot callTimeSnapshot;
+    LatencyStats::instance().getStats(static_cast<SessionPriority>(priority), lockWaitSnapshot, callTimeSnapshot);
+    fillLatencyStats(callTimeSnapshot, callTime);
+    fillLatencyStats(lockWaitSnapshot, lockWait);
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_start_tracing(const char path[])
+{
+    kLog << debug << __func__;
+    if (!path)
+    {
+        kLog << error << "Failed to start tracing - path is NULL";
+        return ERROR_INVALID_ARG;
+    }
+    if (!Tracer::instance().start(path))
+    {
+        return ERROR_FAIL;
+    }
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_stop_tracing()
+{
+    kLog << debug << __func__;
+    Tracer::instance().stop();
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_get_metrics(OpenCDMMetric metrics[], uint32_t *count)
+{
+    kLog << debug << __func__;
+    if (!count || (!metrics && 0 != *count))
+    {
+        kLog << error << "Failed to get metrics - arguments are not valid";
+        return ERROR_INVALID_ARG;
+    }
+    const std::vector<MetricSample> kSamples{Metrics::instance().collect()};
+    if (kSamples.size() > *count)
+    {
+        *count = static_cast<uint32_t>(kSamples.size());
+        return ERROR_BUFFER_TOO_SMALL;
+    }
+    for (size_t i = 0; i < kSamples.size(); ++i)
+    {
+        metrics[i].name = kSamples[i].name;
+        std::snprintf(metrics[i].labels, sizeof(metrics[i].labels), "%s", kSamples[i].labels.c_str());
+        metrics[i].value = kSamples[i].value;
+    }
+    *count = static_cast<uint32_t>(kSamples.size());
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_write_metrics(const char path[])
+{
+    kLog << debug << __func__;
+    if (!path)
+    {
+        kLog << error << "Failed to write metrics - path is NULL";
+        return ERROR_INVALID_ARG;
+    }
+    if (!Metrics::instance().writePrometheus(path))
+    {
+        return ERROR_FAIL;
+    }
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_start_recording(const char path[])
+{
+    kLog << debug << __func__;
+    if (!path)
+    {
+        kLog << error << "Failed to start recording - path is NULL";
+        return ERROR_INVALID_ARG;
+    }
+    if (!MediaKeysRecorder::instance().start(path))
+    {
+        return ERROR_FAIL;
+    }
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_stop_recording()
+{
+    kLog << debug << __func__;
+    MediaKeysRecorder::instance().stop();
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_dump_lock_profile(const char path[])
+{
+    kLog << debug << __func__;
+    if (!LockProfiler::isEnabled())
+    {
+        kLog << error << "Failed to dump lock profile - lock profiling is not enabled in this build";
+        return ERROR_METHOD_NOT_IMPLEMENTED;
+    }
+    if (!LockProfiler::instance().dump(path))
+    {
+        kLog << error << "Failed to dump lock profile to " << (path ? path : "stderr");
+        return ERROR_FAIL;
+    }
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_set_challenge_timeout(uint32_t timeoutMs)
+{
+    kLog << debug << __func__;
+    OpenCDMSessionPrivate::setChallengeTimeout(std::chrono::milliseconds{timeoutMs});
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_set_speculative_challenge(uint32_t isEnabled)
+{
+    kLog << debug << __func__;
+    OpenCDMSessionPrivate::setSpeculativeChallengeEnabled(0 != isEnabled);
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_set_session_sharing(uint32_t isEnabled)
+{
+    kLog << debug << __func__;
+    ActiveSessions::setSessionSharingEnabled(0 != isEnabled);
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_set_key_session_pool_size(uint32_t size)
+{
+    kLog << debug << __func__;
+    CdmBackend::setKeySessionPoolSize(size);
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_session_set_priority(struct OpenCDMSession *session, OpenCDMSessionPriority priority)
+{
+    kLog << debug << __func__;
+    if (!session)
+    {
+        kLog << error << "Failed to set session priority - session is NULL";
+        return ERROR_INVALID_SESSION;
+    }
+    switch (priority)
+    {
+    case OPENCDM_SESSION_PRIORITY_FOREGROUND:
+    {
+        session->setPriority(SessionPriority::FOREGROUND);
+        return ERROR_NONE;
+    }
+    case OPENCDM_SESSION_PRIORITY_PREFETCH:
+    {
+        session->setPriority(SessionPriority::PREFETCH);
+        return ERROR_NONE;
+    }
+    case OPENCDM_SESSION_PRIORITY_BACKGROUND:
+    {
+        session->setPriority(SessionPriority::BACKGROUND);
+        return ERROR_NONE;
+    }
+    default:
+    {
+        kLog << error << "Failed to set session priority - unknown priority " << static_cast<int>(priority);
+        return ERROR_INVALID_ARG;
+    }
+    }
+}
+
+OpenCDMError opencdm_ext_session_wait_for_key(struct OpenCDMSession *session, const uint8_t keyId[], uint8_t length,
+                                              uint32_t timeoutMs, KeyStatus *status)
+{
+    kLog << debug << __func__;
+    if (!session)
+    {
+        kLog << error << "Failed to wait for key - session is NULL";
+        return ERROR_INVALID_SESSION;
+    }
+    if (!keyId || 0 == length || !status)
+    {
+        kLog << error << "Failed to wait for key - invalid argument";
+        return ERROR_INVALID_ARG;
+    }
+    *status = session->waitForKey(keyId, length, std::chrono::milliseconds{timeoutMs});
+    return ERROR_NONE;
+}
+
+OpenCDMError opencdm_ext_session_get_memory_usage(struct OpenCDMSession *session, OpenCDMSessionMemoryUsage *usage)
+{
+    kLog << debug << __func__;
+    if (!session)
+    {
+        kLog << error << "Failed to get session memory usage - session is NULL";
+        return ERROR_INVALID_SESSION;
+    }
+    if (!usage)
+    {
+        kLog << error << "Failed to get session memory usage - usage is NULL";
+        return ERROR_INVALID_ARG;
+    }
+    const SessionMemoryUsage kUsage{session->getMemoryUsage()};
+    usage->sessionBytes = kUsage.sessionBytes;
+    usage->initDataBytes = kUsage.initDataBytes;
+    usage->challengeBytes = kUsage.challengeBytes;
+    usage->keyIdBytes = kUsage.keyIdBytes;
+    return ERROR_NONE;
+}
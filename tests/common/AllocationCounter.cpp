@@ -0,0 +1,93 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+#include <cerrno>
+#include <cstddef>
+
+// glibc allocator entry points, used by the replacements below
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+thread_local uint64_t gAllocations{0};
+thread_local uint64_t gAllocatedBytes{0};
+
+void countAllocation(size_t size)
+{
+    ++gAllocations;
+    gAllocatedBytes += size;
+}
+} // namespace
+
+uint64_t AllocationCounter::allocations()
+{
+    return gAllocations;
+}
+
+uint64_t AllocationCounter::allocatedBytes()
+{
+    return gAllocatedBytes;
+}
+
+extern "C"
+{
+    void *malloc(size_t size)
+    {
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        countAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **ptr, size_t alignment, size_t size)
+    {
+        countAllocation(size);
+        *ptr = __libc_memalign(alignment, size);
+        return *ptr ? 0 : ENOMEM;
+    }
+}
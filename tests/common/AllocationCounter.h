@@ -0,0 +1,37 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+/**
+ * Counts heap allocations (malloc family, which also backs operator new and g_malloc) made by the calling thread.
+ * Linking AllocationCounter.cpp into an executable interposes the glibc allocator, so only the performance tests and
+ * RialtoOcdmAllocationTests link it - the other unit tests keep the default allocator.
+ */
+class AllocationCounter
+{
+public:
+    static uint64_t allocations();
+    static uint64_t allocatedBytes();
+};
+
+#endif // ALLOCATION_COUNTER_H_
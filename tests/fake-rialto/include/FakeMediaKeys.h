@@ -0,0 +1,89 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_H_
+#define FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_H_
+
+#include "IMediaKeys.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace firebolt::rialto::fake
+{
+/**
+ * IMediaKeys answering every call locally. generateRequest is answered with onLicenseRequest and updateSession
+ * with onKeyStatusesChanged, both from the FakeRialto notification thread. A license response made of 16 byte
+ * blocks is treated as a list of key IDs, any other response licenses one key ID derived from the session ID.
+ */
+class FakeMediaKeys : public IMediaKeys
+{
+public:
+    explicit FakeMediaKeys(const std::string &keySystem);
+    ~FakeMediaKeys() override = default;
+
+    MediaKeyErrorStatus selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
+    bool containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
+    MediaKeyErrorStatus createKeySession(KeySessionType sessionType, std::weak_ptr<IMediaKeysClient> client, bool isLDL,
+                                         int32_t &keySessionId) override;
+    MediaKeyErrorStatus generateRequest(int32_t keySessionId, InitDataType initDataType,
+                                        const std::vector<uint8_t> &initData) override;
+    MediaKeyErrorStatus loadSession(int32_t keySessionId) override;
+    MediaKeyErrorStatus updateSession(int32_t keySessionId, const std::vector<uint8_t> &responseData) override;
+    MediaKeyErrorStatus setDrmHeader(int32_t keySessionId, const std::vector<uint8_t> &requestData) override;
+    MediaKeyErrorStatus closeKeySession(int32_t keySessionId) override;
+    MediaKeyErrorStatus removeKeySession(int32_t keySessionId) override;
+    MediaKeyErrorStatus deleteDrmStore() override;
+    MediaKeyErrorStatus deleteKeyStore() override;
+    MediaKeyErrorStatus getDrmStoreHash(std::vector<unsigned char> &drmStoreHash) override;
+    MediaKeyErrorStatus getKeyStoreHash(std::vector<unsigned char> &keyStoreHash) override;
+    MediaKeyErrorStatus getLdlSessionsLimit(uint32_t &ldlLimit) override;
+    MediaKeyErrorStatus getLastDrmError(int32_t keySessionId, uint32_t &errorCode) override;
+    MediaKeyErrorStatus getDrmTime(uint64_t &drmTime) override;
+    MediaKeyErrorStatus getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId) override;
+
+private:
+    struct Session
+    {
+        KeySessionType type;
+        std::weak_ptr<IMediaKeysClient> client;
+        bool isLDL;
+        std::vector<std::vector<uint8_t>> keyIds;
+    };
+
+    void notifyKeyStatuses(int32_t keySessionId, const Session &session, KeyStatus status);
+
+private:
+    const std::string m_keySystem;
+    std::mutex m_mutex;
+    std::map<int32_t, Session> m_sessions;
+};
+
+class FakeMediaKeysFactory : public IMediaKeysFactory
+{
+public:
+    std::unique_ptr<IMediaKeys>
+    createMediaKeys(const std::string &keySystem,
+                    std::weak_ptr<client::IMediaKeysIpcFactory> mediaKeysIpcFactory) const override;
+};
+} // namespace firebolt::rialto::fake
+
+#endif // FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_H_
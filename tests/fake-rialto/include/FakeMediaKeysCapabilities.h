@@ -0,0 +1,45 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_CAPABILITIES_H_
+#define FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_CAPABILITIES_H_
+
+#include "IMediaKeysCapabilities.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace firebolt::rialto::fake
+{
+class FakeMediaKeysCapabilities : public IMediaKeysCapabilities
+{
+public:
+    std::vector<std::string> getSupportedKeySystems() override;
+    bool supportsKeySystem(const std::string &keySystem) override;
+    bool getSupportedKeySystemVersion(const std::string &keySystem, std::string &version) override;
+};
+
+class FakeMediaKeysCapabilitiesFactory : public IMediaKeysCapabilitiesFactory
+{
+public:
+    std::shared_ptr<IMediaKeysCapabilities> getMediaKeysCapabilities() const override;
+};
+} // namespace firebolt::rialto::fake
+
+#endif // FIREBOLT_RIALTO_FAKE_FAKE_MEDIA_KEYS_CAPABILITIES_H_
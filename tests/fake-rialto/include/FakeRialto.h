@@ -0,0 +1,142 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIREBOLT_RIALTO_FAKE_FAKE_RIALTO_H_
+#define FIREBOLT_RIALTO_FAKE_FAKE_RIALTO_H_
+
+#include "ControlCommon.h"
+#include "IControlClient.h"
+#include "MediaKeysRecording.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace firebolt::rialto::fake
+{
+struct ApplicationStateChange
+{
+    std::chrono::milliseconds delay;
+    ApplicationState state;
+};
+
+/**
+ * Behaviour of the fake Rialto client library. Defaults can be overridden with environment variables, so that an
+ * unmodified application can be run against the fake:
+ *     RIALTO_FAKE_CALL_LATENCY_US        - latency added to every IMediaKeys/IControl call (emulates IPC)
+ *     RIALTO_FAKE_CONNECT_LATENCY_US     - latency added once per process, when the first IControl or
+ *                                          IMediaKeysCapabilities is created (emulates the IPC channel set-up)
+ *     RIALTO_FAKE_LICENSE_LATENCY_US     - time from generateRequest to onLicenseRequest
+ *     RIALTO_FAKE_KEY_STATUS_LATENCY_US  - time from updateSession to onKeyStatusesChanged
+ *     RIALTO_FAKE_LDL_SESSIONS_LIMIT     - number of LDL sessions that can be created
+ *     RIALTO_FAKE_APP_STATES             - initial state and scripted transitions (delays in milliseconds, relative
+ *                                          to the previous transition), e.g. "RUNNING,2000:INACTIVE,500:RUNNING"
+ *     RIALTO_FAKE_REPLAY_PATH            - MediaKeys traffic recorded with RIALTO_RECORD_PATH. When set, MediaKeys
+ *                                          answer with the recorded statuses, durations and notifications instead
+ *                                          of the latencies above (see MediaKeysReplay)
+ */
+struct FakeRialtoConfig
+{
+    std::chrono::microseconds callLatency{0};
+    std::chrono::microseconds connectLatency{0};
+    std::chrono::microseconds licenseRequestLatency{0};
+    std::chrono::microseconds keyStatusLatency{0};
+    uint32_t ldlSessionsLimit{16};
+    ApplicationState initialApplicationState{ApplicationState::RUNNING};
+    std::vector<ApplicationStateChange> applicationStateScript;
+    std::vector<std::string> supportedKeySystems{"com.widevine.alpha", "com.microsoft.playready",
+                                                 "com.netflix.playready", "org.w3.clearkey"};
+    std::shared_ptr<const MediaKeysRecording> replayRecording;
+};
+
+class MediaKeysReplay;
+
+/**
+ * Shared state of the fake: configuration, application state and the thread that delivers client notifications.
+ */
+class FakeRialto
+{
+public:
+    static FakeRialto &instance();
+
+    /**
+     * Replaces the configuration and resets the application state to config.initialApplicationState. The
+     * state script starts when the next control client registers.
+     */
+    void configure(const FakeRialtoConfig &config);
+    FakeRialtoConfig config() const;
+    std::chrono::microseconds licenseRequestLatency() const;
+    std::chrono::microseconds keyStatusLatency() const;
+    uint32_t ldlSessionsLimit() const;
+    std::shared_ptr<MediaKeysReplay> replay() const;
+
+    ApplicationState registerControlClient(const std::weak_ptr<IControlClient> &client);
+    void setApplicationState(ApplicationState state);
+    ApplicationState applicationState() const;
+
+    /**
+     * Runs the task on the notification thread after the delay. Tasks due at the same time run in posting order.
+     */
+    void post(std::chrono::microseconds delay, std::function<void()> &&task);
+
+    /**
+     * Blocks the caller for the configured call latency.
+     */
+    void simulateCallLatency() const;
+
+    /**
+     * Blocks the first caller in the process for the configured connect latency.
+     */
+    void simulateConnectLatency();
+    int32_t nextKeySessionId() { return ++m_lastKeySessionId; }
+    bool isKeySystemSupported(const std::string &keySystem) const;
+
+private:
+    FakeRialto();
+    ~FakeRialto();
+
+    void eventLoop();
+    void notifyApplicationState(ApplicationState state);
+
+private:
+    mutable std::mutex m_mutex;
+    FakeRialtoConfig m_config;
+    std::shared_ptr<MediaKeysReplay> m_replay;
+    ApplicationState m_applicationState;
+    bool m_isScriptPending;
+    std::vector<std::weak_ptr<IControlClient>> m_controlClients;
+    std::atomic<int32_t> m_lastKeySessionId;
+    std::atomic<bool> m_isConnected;
+
+    std::mutex m_eventMutex;
+    std::condition_variable m_eventCv;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> m_events;
+    bool m_isRunning;
+    std::thread m_eventThread;
+};
+} // namespace firebolt::rialto::fake
+
+#endif // FIREBOLT_RIALTO_FAKE_FAKE_RIALTO_H_
@@ -0,0 +1,52 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIREBOLT_RIALTO_FAKE_MEDIA_KEYS_RECORDING_H_
+#define FIREBOLT_RIALTO_FAKE_MEDIA_KEYS_RECORDING_H_
+
+#include "MediaKeysRecordingFormat.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace firebolt::rialto::fake
+{
+struct RecordedEvent
+{
+    mediakeysrecording::Record record;
+    std::vector<uint8_t> data;
+};
+
+/**
+ * MediaKeys traffic recorded by ocdmRialto with RIALTO_RECORD_PATH set, loaded for replay. Events are sorted by
+ * timestamp.
+ */
+struct MediaKeysRecording
+{
+    /**
+     * Returns nullptr when the file cannot be read or is not a recording. A truncated last record is ignored.
+     */
+    static std::shared_ptr<const MediaKeysRecording> load(const std::string &path);
+
+    std::vector<RecordedEvent> events;
+};
+} // namespace firebolt::rialto::fake
+
+#endif // FIREBOLT_RIALTO_FAKE_MEDIA_KEYS_RECORDING_H_
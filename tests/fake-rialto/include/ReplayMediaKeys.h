@@ -0,0 +1,119 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIREBOLT_RIALTO_FAKE_REPLAY_MEDIA_KEYS_H_
+#define FIREBOLT_RIALTO_FAKE_REPLAY_MEDIA_KEYS_H_
+
+#include "IMediaKeys.h"
+#include "LatencyStats.h"
+#include "MediaKeysRecording.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace firebolt::rialto::fake
+{
+/**
+ * Replay state shared by all ReplayMediaKeys of the process, so that it survives MediaKeys being recreated on
+ * application state changes.
+ *
+ * Every key session created during the replay is bound to the next key session of the recording, in creation
+ * order. A call on a bound session consumes the next recorded call of the same operation on the recorded session:
+ * the caller is blocked for the recorded duration and gets the recorded status, and the notifications recorded
+ * between this call and the next call of the session are scheduled with their recorded delays. Notifications carry
+ * synthetic payloads of the recorded sizes. Calls without a recorded counterpart succeed immediately, failed
+ * createKeySession calls are not replayed.
+ */
+class MediaKeysReplay
+{
+public:
+    explicit MediaKeysReplay(const std::shared_ptr<const MediaKeysRecording> &recording);
+
+    bool createMediaKeys();
+    MediaKeyErrorStatus createKeySession(std::weak_ptr<IMediaKeysClient> client, int32_t &keySessionId);
+    int32_t replayCall(CdmOperation operation, int32_t keySessionId, int32_t defaultStatus);
+
+private:
+    struct RecordedSession
+    {
+        std::vector<size_t> events;
+        size_t nextEvent{0};
+    };
+
+    struct BoundSession
+    {
+        int32_t recordedKeySessionId;
+        std::weak_ptr<IMediaKeysClient> client;
+    };
+
+    int32_t replayRecordedCall(size_t callIndex, std::unique_lock<std::mutex> &lock);
+    void scheduleNotification(const RecordedEvent &event, const RecordedEvent &call, int32_t keySessionId,
+                              const std::weak_ptr<IMediaKeysClient> &client) const;
+
+private:
+    const std::shared_ptr<const MediaKeysRecording> m_recording;
+    std::mutex m_mutex;
+    std::map<int32_t, RecordedSession> m_recordedSessions;
+    std::deque<int32_t> m_unboundSessions;
+    std::map<int32_t, BoundSession> m_boundSessions;
+    std::map<uint16_t, std::deque<size_t>> m_sessionlessCalls;
+    std::deque<size_t> m_createMediaKeysCalls;
+};
+
+/**
+ * IMediaKeys answering every call from a MediaKeysReplay.
+ */
+class ReplayMediaKeys : public IMediaKeys
+{
+public:
+    explicit ReplayMediaKeys(const std::shared_ptr<MediaKeysReplay> &replay);
+    ~ReplayMediaKeys() override = default;
+
+    MediaKeyErrorStatus selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
+    bool containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId) override;
+    MediaKeyErrorStatus createKeySession(KeySessionType sessionType, std::weak_ptr<IMediaKeysClient> client, bool isLDL,
+                                         int32_t &keySessionId) override;
+    MediaKeyErrorStatus generateRequest(int32_t keySessionId, InitDataType initDataType,
+                                        const std::vector<uint8_t> &initData) override;
+    MediaKeyErrorStatus loadSession(int32_t keySessionId) override;
+    MediaKeyErrorStatus updateSession(int32_t keySessionId, const std::vector<uint8_t> &responseData) override;
+    MediaKeyErrorStatus setDrmHeader(int32_t keySessionId, const std::vector<uint8_t> &requestData) override;
+    MediaKeyErrorStatus closeKeySession(int32_t keySessionId) override;
+    MediaKeyErrorStatus removeKeySession(int32_t keySessionId) override;
+    MediaKeyErrorStatus deleteDrmStore() override;
+    MediaKeyErrorStatus deleteKeyStore() override;
+    MediaKeyErrorStatus getDrmStoreHash(std::vector<unsigned char> &drmStoreHash) override;
+    MediaKeyErrorStatus getKeyStoreHash(std::vector<unsigned char> &keyStoreHash) override;
+    MediaKeyErrorStatus getLdlSessionsLimit(uint32_t &ldlLimit) override;
+    MediaKeyErrorStatus getLastDrmError(int32_t keySessionId, uint32_t &errorCode) override;
+    MediaKeyErrorStatus getDrmTime(uint64_t &drmTime) override;
+    MediaKeyErrorStatus getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId) override;
+
+private:
+    MediaKeyErrorStatus replay(CdmOperation operation, int32_t keySessionId);
+
+private:
+    const std::shared_ptr<MediaKeysReplay> m_replay;
+};
+} // namespace firebolt::rialto::fake
+
+#endif // FIREBOLT_RIALTO_FAKE_REPLAY_MEDIA_KEYS_H_
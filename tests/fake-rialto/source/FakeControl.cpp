@@ -0,0 +1,45 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeControl.h"
+#include "FakeRialto.h"
+
+namespace firebolt::rialto
+{
+std::shared_ptr<IControlFactory> IControlFactory::createFactory()
+{
+    return std::make_shared<fake::FakeControlFactory>();
+}
+
+namespace fake
+{
+bool FakeControl::registerClient(std::weak_ptr<IControlClient> client, ApplicationState &appState)
+{
+    FakeRialto::instance().simulateCallLatency();
+    appState = FakeRialto::instance().registerControlClient(client);
+    return true;
+}
+
+std::shared_ptr<IControl> FakeControlFactory::createControl() const
+{
+    FakeRialto::instance().simulateConnectLatency();
+    return std::make_shared<FakeControl>();
+}
+} // namespace fake
+} // namespace firebolt::rialto
@@ -0,0 +1,304 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeMediaKeys.h"
+#include "FakeRialto.h"
+#include "ReplayMediaKeys.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+namespace
+{
+constexpr size_t kKeyIdSize{16};
+const std::string kLicenseServerUrl{"http://fake-rialto.local/license"};
+
+std::vector<std::vector<uint8_t>> getLicensedKeyIds(int32_t keySessionId, const std::vector<uint8_t> &responseData)
+{
+    std::vector<std::vector<uint8_t>> keyIds;
+    if (!responseData.empty() && 0 == responseData.size() % kKeyIdSize)
+    {
+        for (auto it = responseData.begin(); it != responseData.end(); it += kKeyIdSize)
+        {
+            keyIds.emplace_back(it, it + kKeyIdSize);
+        }
+        return keyIds;
+    }
+    std::vector<uint8_t> keyId(kKeyIdSize, 0);
+    for (size_t i = 0; i < sizeof(keySessionId); ++i)
+    {
+        keyId[kKeyIdSize - 1 - i] = static_cast<uint8_t>(keySessionId >> (8 * i));
+    }
+    keyIds.push_back(std::move(keyId));
+    return keyIds;
+}
+} // namespace
+
+namespace firebolt::rialto
+{
+std::shared_ptr<IMediaKeysFactory> IMediaKeysFactory::createFactory()
+{
+    return std::make_shared<fake::FakeMediaKeysFactory>();
+}
+
+namespace fake
+{
+FakeMediaKeys::FakeMediaKeys(const std::string &keySystem) : m_keySystem{keySystem} {}
+
+MediaKeyErrorStatus FakeMediaKeys::selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_sessions.find(keySessionId) != m_sessions.end() ? MediaKeyErrorStatus::OK
+                                                            : MediaKeyErrorStatus::BAD_SESSION_ID;
+}
+
+bool FakeMediaKeys::containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto sessionIter = m_sessions.find(keySessionId);
+    if (sessionIter == m_sessions.end())
+    {
+        return false;
+    }
+    const auto &kKeyIds{sessionIter->second.keyIds};
+    return std::find(kKeyIds.begin(), kKeyIds.end(), keyId) != kKeyIds.end();
+}
+
+MediaKeyErrorStatus FakeMediaKeys::createKeySession(KeySessionType sessionType, std::weak_ptr<IMediaKeysClient> client,
+                                                    bool isLDL, int32_t &keySessionId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    if (ApplicationState::RUNNING != FakeRialto::instance().applicationState())
+    {
+        return MediaKeyErrorStatus::INVALID_STATE;
+    }
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (isLDL)
+    {
+        const auto kLdlSessions{std::count_if(m_sessions.begin(), m_sessions.end(),
+                                              [](const auto &session) { return session.second.isLDL; })};
+        if (static_cast<uint32_t>(kLdlSessions) >= FakeRialto::instance().ldlSessionsLimit())
+        {
+            return MediaKeyErrorStatus::FAIL;
+        }
+    }
+    keySessionId = FakeRialto::instance().nextKeySessionId();
+    m_sessions.emplace(keySessionId, Session{sessionType, client, isLDL, {}});
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::generateRequest(int32_t keySessionId, InitDataType initDataType,
+                                                   const std::vector<uint8_t> &initData)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::weak_ptr<IMediaKeysClient> client;
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        auto sessionIter = m_sessions.find(keySessionId);
+        if (sessionIter == m_sessions.end())
+        {
+            return MediaKeyErrorStatus::BAD_SESSION_ID;
+        }
+        client = sessionIter->second.client;
+    }
+
+    const std::string kPrefix{"fake-challenge:" + m_keySystem + ":" + std::to_string(keySessionId) + ":"};
+    std::vector<unsigned char> challenge(kPrefix.begin(), kPrefix.end());
+    challenge.insert(challenge.end(), initData.begin(), initData.end());
+    FakeRialto::instance().post(FakeRialto::instance().licenseRequestLatency(),
+                                [client, keySessionId, challenge = std::move(challenge)]()
+                                {
+                                    std::shared_ptr<IMediaKeysClient> mediaKeysClient{client.lock()};
+                                    if (mediaKeysClient)
+                                    {
+                                        mediaKeysClient->onLicenseRequest(keySessionId, challenge, kLicenseServerUrl);
+                                    }
+                                });
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::loadSession(int32_t keySessionId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto sessionIter = m_sessions.find(keySessionId);
+    if (sessionIter == m_sessions.end())
+    {
+        return MediaKeyErrorStatus::BAD_SESSION_ID;
+    }
+    if (KeySessionType::PERSISTENT_LICENCE != sessionIter->second.type)
+    {
+        return MediaKeyErrorStatus::FAIL;
+    }
+    notifyKeyStatuses(keySessionId, sessionIter->second, KeyStatus::USABLE);
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::updateSession(int32_t keySessionId, const std::vector<uint8_t> &responseData)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto sessionIter = m_sessions.find(keySessionId);
+    if (sessionIter == m_sessions.end())
+    {
+        return MediaKeyErrorStatus::BAD_SESSION_ID;
+    }
+    sessionIter->second.keyIds = getLicensedKeyIds(keySessionId, responseData);
+    notifyKeyStatuses(keySessionId, sessionIter->second, KeyStatus::USABLE);
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::setDrmHeader(int32_t keySessionId, const std::vector<uint8_t> &requestData)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_sessions.find(keySessionId) != m_sessions.end() ? MediaKeyErrorStatus::OK
+                                                            : MediaKeyErrorStatus::BAD_SESSION_ID;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::closeKeySession(int32_t keySessionId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto sessionIter = m_sessions.find(keySessionId);
+    if (sessionIter == m_sessions.end())
+    {
+        return MediaKeyErrorStatus::BAD_SESSION_ID;
+    }
+    if (KeySessionType::PERSISTENT_LICENCE != sessionIter->second.type)
+    {
+        m_sessions.erase(sessionIter);
+    }
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::removeKeySession(int32_t keySessionId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    auto sessionIter = m_sessions.find(keySessionId);
+    if (sessionIter == m_sessions.end())
+    {
+        return MediaKeyErrorStatus::BAD_SESSION_ID;
+    }
+    notifyKeyStatuses(keySessionId, sessionIter->second, KeyStatus::RELEASED);
+    m_sessions.erase(sessionIter);
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::deleteDrmStore()
+{
+    FakeRialto::instance().simulateCallLatency();
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::deleteKeyStore()
+{
+    FakeRialto::instance().simulateCallLatency();
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getDrmStoreHash(std::vector<unsigned char> &drmStoreHash)
+{
+    FakeRialto::instance().simulateCallLatency();
+    drmStoreHash.assign(32, 0xd5);
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getKeyStoreHash(std::vector<unsigned char> &keyStoreHash)
+{
+    FakeRialto::instance().simulateCallLatency();
+    keyStoreHash.assign(32, 0x4b);
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getLdlSessionsLimit(uint32_t &ldlLimit)
+{
+    FakeRialto::instance().simulateCallLatency();
+    ldlLimit = FakeRialto::instance().ldlSessionsLimit();
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getLastDrmError(int32_t keySessionId, uint32_t &errorCode)
+{
+    FakeRialto::instance().simulateCallLatency();
+    errorCode = 0;
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getDrmTime(uint64_t &drmTime)
+{
+    FakeRialto::instance().simulateCallLatency();
+    drmTime = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    return MediaKeyErrorStatus::OK;
+}
+
+MediaKeyErrorStatus FakeMediaKeys::getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId)
+{
+    FakeRialto::instance().simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_sessions.find(keySessionId) == m_sessions.end())
+    {
+        return MediaKeyErrorStatus::BAD_SESSION_ID;
+    }
+    cdmKeySessionId = "fake-" + std::to_string(keySessionId);
+    return MediaKeyErrorStatus::OK;
+}
+
+void FakeMediaKeys::notifyKeyStatuses(int32_t keySessionId, const Session &session, KeyStatus status)
+{
+    KeyStatusVector keyStatuses;
+    for (const auto &keyId : session.keyIds)
+    {
+        keyStatuses.emplace_back(keyId, status);
+    }
+    std::weak_ptr<IMediaKeysClient> client{session.client};
+    FakeRialto::instance().post(FakeRialto::instance().keyStatusLatency(),
+                                [client, keySessionId, keyStatuses = std::move(keyStatuses)]()
+                                {
+                                    std::shared_ptr<IMediaKeysClient> mediaKeysClient{client.lock()};
+                                    if (mediaKeysClient)
+                                    {
+                                        mediaKeysClient->onKeyStatusesChanged(keySessionId, keyStatuses);
+                                    }
+                                });
+}
+
+std::unique_ptr<IMediaKeys>
+FakeMediaKeysFactory::createMediaKeys(const std::string &keySystem,
+                                      std::weak_ptr<client::IMediaKeysIpcFactory> mediaKeysIpcFactory) const
+{
+    std::shared_ptr<MediaKeysReplay> replay{FakeRialto::instance().replay()};
+    if (replay)
+    {
+        return replay->createMediaKeys() ? std::make_unique<ReplayMediaKeys>(replay) : nullptr;
+    }
+    FakeRialto::instance().simulateCallLatency();
+    if (!FakeRialto::instance().isKeySystemSupported(keySystem))
+    {
+        return nullptr;
+    }
+    return std::make_unique<FakeMediaKeys>(keySystem);
+}
+} // namespace fake
+} // namespace firebolt::rialto
@@ -0,0 +1,61 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeMediaKeysCapabilities.h"
+#include "FakeRialto.h"
+
+namespace firebolt::rialto
+{
+std::shared_ptr<IMediaKeysCapabilitiesFactory> IMediaKeysCapabilitiesFactory::createFactory()
+{
+    return std::make_shared<fake::FakeMediaKeysCapabilitiesFactory>();
+}
+
+namespace fake
+{
+std::vector<std::string> FakeMediaKeysCapabilities::getSupportedKeySystems()
+{
+    FakeRialto::instance().simulateCallLatency();
+    return FakeRialto::instance().config().supportedKeySystems;
+}
+
+bool FakeMediaKeysCapabilities::supportsKeySystem(const std::string &keySystem)
+{
+    FakeRialto::instance().simulateCallLatency();
+    return FakeRialto::instance().isKeySystemSupported(keySystem);
+}
+
+bool FakeMediaKeysCapabilities::getSupportedKeySystemVersion(const std::string &keySystem, std::string &version)
+{
+    FakeRialto::instance().simulateCallLatency();
+    if (!FakeRialto::instance().isKeySystemSupported(keySystem))
+    {
+        return false;
+    }
+    version = "1.0.0-fake";
+    return true;
+}
+
+std::shared_ptr<IMediaKeysCapabilities> FakeMediaKeysCapabilitiesFactory::getMediaKeysCapabilities() const
+{
+    FakeRialto::instance().simulateConnectLatency();
+    return std::make_shared<FakeMediaKeysCapabilities>();
+}
+} // namespace fake
+} // namespace firebolt::rialto
@@ -0,0 +1,294 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeRialto.h"
+#include "ReplayMediaKeys.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+std::chrono::microseconds getEnvMicroseconds(const char *name, std::chrono::microseconds defaultValue)
+{
+    const char *value = getenv(name);
+    if (value)
+    {
+        return std::chrono::microseconds{std::strtoll(value, nullptr, 10)};
+    }
+    return defaultValue;
+}
+
+bool parseApplicationState(const std::string &text, firebolt::rialto::ApplicationState &state)
+{
+    if ("RUNNING" == text)
+    {
+        state = firebolt::rialto::ApplicationState::RUNNING;
+        return true;
+    }
+    if ("INACTIVE" == text)
+    {
+        state = firebolt::rialto::ApplicationState::INACTIVE;
+        return true;
+    }
+    if ("UNKNOWN" == text)
+    {
+        state = firebolt::rialto::ApplicationState::UNKNOWN;
+        return true;
+    }
+    return false;
+}
+
+void parseApplicationStates(const char *value, firebolt::rialto::fake::FakeRialtoConfig &config)
+{
+    std::stringstream stream{value};
+    std::string entry;
+    while (std::getline(stream, entry, ','))
+    {
+        const size_t kSeparator{entry.find(':')};
+        firebolt::rialto::ApplicationState state{firebolt::rialto::ApplicationState::UNKNOWN};
+        if (std::string::npos == kSeparator)
+        {
+            if (parseApplicationState(entry, state))
+            {
+                config.initialApplicationState = state;
+            }
+        }
+        else if (parseApplicationState(entry.substr(kSeparator + 1), state))
+        {
+            config.applicationStateScript.push_back(
+                {std::chrono::milliseconds{std::strtoll(entry.substr(0, kSeparator).c_str(), nullptr, 10)}, state});
+        }
+    }
+}
+
+firebolt::rialto::fake::FakeRialtoConfig getConfigFromEnv()
+{
+    firebolt::rialto::fake::FakeRialtoConfig config;
+    config.callLatency = getEnvMicroseconds("RIALTO_FAKE_CALL_LATENCY_US", config.callLatency);
+    config.connectLatency = getEnvMicroseconds("RIALTO_FAKE_CONNECT_LATENCY_US", config.connectLatency);
+    config.licenseRequestLatency = getEnvMicroseconds("RIALTO_FAKE_LICENSE_LATENCY_US", config.licenseRequestLatency);
+    config.keyStatusLatency = getEnvMicroseconds("RIALTO_FAKE_KEY_STATUS_LATENCY_US", config.keyStatusLatency);
+    const char *ldlSessionsLimit = getenv("RIALTO_FAKE_LDL_SESSIONS_LIMIT");
+    if (ldlSessionsLimit)
+    {
+        config.ldlSessionsLimit = static_cast<uint32_t>(std::strtoul(ldlSessionsLimit, nullptr, 10));
+    }
+    const char *applicationStates = getenv("RIALTO_FAKE_APP_STATES");
+    if (applicationStates)
+    {
+        parseApplicationStates(applicationStates, config);
+    }
+    const char *replayPath = getenv("RIALTO_FAKE_REPLAY_PATH");
+    if (replayPath)
+    {
+        config.replayRecording = firebolt::rialto::fake::MediaKeysRecording::load(replayPath);
+    }
+    return config;
+}
+} // namespace
+
+namespace firebolt::rialto::fake
+{
+FakeRialto &FakeRialto::instance()
+{
+    static FakeRialto fakeRialto;
+    return fakeRialto;
+}
+
+FakeRialto::FakeRialto()
+    : m_config{getConfigFromEnv()}, m_applicationState{m_config.initialApplicationState}, m_isScriptPending{true},
+      m_lastKeySessionId{0}, m_isConnected{false}, m_isRunning{true}
+{
+    if (m_config.replayRecording)
+    {
+        m_replay = std::make_shared<MediaKeysReplay>(m_config.replayRecording);
+    }
+    m_eventThread = std::thread(&FakeRialto::eventLoop, this);
+}
+
+FakeRialto::~FakeRialto()
+{
+    {
+        std::unique_lock<std::mutex> lock{m_eventMutex};
+        m_isRunning = false;
+        m_eventCv.notify_one();
+    }
+    m_eventThread.join();
+}
+
+void FakeRialto::configure(const FakeRialtoConfig &config)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_config = config;
+    m_replay = config.replayRecording ? std::make_shared<MediaKeysReplay>(config.replayRecording) : nullptr;
+    m_applicationState = config.initialApplicationState;
+    m_isScriptPending = true;
+}
+
+FakeRialtoConfig FakeRialto::config() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_config;
+}
+
+std::chrono::microseconds FakeRialto::licenseRequestLatency() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_config.licenseRequestLatency;
+}
+
+std::chrono::microseconds FakeRialto::keyStatusLatency() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_config.keyStatusLatency;
+}
+
+uint32_t FakeRialto::ldlSessionsLimit() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_config.ldlSessionsLimit;
+}
+
+std::shared_ptr<MediaKeysReplay> FakeRialto::replay() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_replay;
+}
+
+ApplicationState FakeRialto::registerControlClient(const std::weak_ptr<IControlClient> &client)
+{
+    simulateCallLatency();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_controlClients.erase(std::remove_if(m_controlClients.begin(), m_controlClients.end(),
+                                          [](const auto &controlClient) { return controlClient.expired(); }),
+                           m_controlClients.end());
+    m_controlClients.push_back(client);
+    if (m_isScriptPending)
+    {
+        m_isScriptPending = false;
+        std::chrono::microseconds delay{0};
+        for (const auto &change : m_config.applicationStateScript)
+        {
+            delay += change.delay;
+            const ApplicationState kState{change.state};
+            post(delay, [this, kState]() { notifyApplicationState(kState); });
+        }
+    }
+    return m_applicationState;
+}
+
+void FakeRialto::setApplicationState(ApplicationState state)
+{
+    post(std::chrono::microseconds{0}, [this, state]() { notifyApplicationState(state); });
+}
+
+ApplicationState FakeRialto::applicationState() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return m_applicationState;
+}
+
+void FakeRialto::post(std::chrono::microseconds delay, std::function<void()> &&task)
+{
+    std::unique_lock<std::mutex> lock{m_eventMutex};
+    m_events.emplace(std::chrono::steady_clock::now() + delay, std::move(task));
+    m_eventCv.notify_one();
+}
+
+void FakeRialto::simulateCallLatency() const
+{
+    std::chrono::microseconds latency{0};
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        latency = m_config.callLatency;
+    }
+    if (latency.count() > 0)
+    {
+        std::this_thread::sleep_for(latency);
+    }
+}
+
+void FakeRialto::simulateConnectLatency()
+{
+    if (m_isConnected.exchange(true))
+    {
+        return;
+    }
+    std::chrono::microseconds latency{0};
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        latency = m_config.connectLatency;
+    }
+    if (latency.count() > 0)
+    {
+        std::this_thread::sleep_for(latency);
+    }
+}
+
+bool FakeRialto::isKeySystemSupported(const std::string &keySystem) const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    return std::find(m_config.supportedKeySystems.begin(), m_config.supportedKeySystems.end(), keySystem) !=
+           m_config.supportedKeySystems.end();
+}
+
+void FakeRialto::eventLoop()
+{
+    std::unique_lock<std::mutex> lock{m_eventMutex};
+    while (m_isRunning)
+    {
+        if (m_events.empty())
+        {
+            m_eventCv.wait(lock);
+            continue;
+        }
+        auto event = m_events.begin();
+        if (event->first > std::chrono::steady_clock::now())
+        {
+            m_eventCv.wait_until(lock, event->first);
+            continue;
+        }
+        std::function<void()> task{std::move(event->second)};
+        m_events.erase(event);
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void FakeRialto::notifyApplicationState(ApplicationState state)
+{
+    std::vector<std::weak_ptr<IControlClient>> clients;
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_applicationState = state;
+        clients = m_controlClients;
+    }
+    for (const auto &client : clients)
+    {
+        std::shared_ptr<IControlClient> controlClient{client.lock()};
+        if (controlClient)
+        {
+            controlClient->notifyApplicationState(state);
+        }
+    }
+}
+} // namespace firebolt::rialto::fake
@@ -0,0 +1,69 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MediaKeysRecording.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace firebolt::rialto::fake
+{
+std::shared_ptr<const MediaKeysRecording> MediaKeysRecording::load(const std::string &path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file.is_open())
+    {
+        return nullptr;
+    }
+    const std::vector<uint8_t> kData{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    mediakeysrecording::RecordingFileHeader header{};
+    if (kData.size() < sizeof(header))
+    {
+        return nullptr;
+    }
+    std::memcpy(&header, kData.data(), sizeof(header));
+    if (0 != std::memcmp(header.magic, mediakeysrecording::kMagic, sizeof(header.magic)) ||
+        mediakeysrecording::kVersion != header.version || header.headerSize < sizeof(header))
+    {
+        return nullptr;
+    }
+
+    auto recording{std::make_shared<MediaKeysRecording>()};
+    size_t offset{header.headerSize};
+    while (offset + sizeof(mediakeysrecording::Record) <= kData.size())
+    {
+        RecordedEvent event{};
+        std::memcpy(&event.record, kData.data() + offset, sizeof(event.record));
+        offset += sizeof(event.record);
+        if (offset + event.record.dataSize > kData.size())
+        {
+            break;
+        }
+        event.data.assign(kData.begin() + offset, kData.begin() + offset + event.record.dataSize);
+        offset += event.record.dataSize;
+        recording->events.push_back(std::move(event));
+    }
+    // Calls are recorded when they return, so they may follow notifications received while they were in progress
+    std::stable_sort(recording->events.begin(), recording->events.end(),
+                     [](const RecordedEvent &lhs, const RecordedEvent &rhs)
+                     { return lhs.record.timestampNs < rhs.record.timestampNs; });
+    return recording;
+}
+} // namespace firebolt::rialto::fake
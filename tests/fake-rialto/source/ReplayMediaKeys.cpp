@@ -0,0 +1,322 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReplayMediaKeys.h"
+#include "FakeRialto.h"
+#include <chrono>
+#include <thread>
+#include <utility>
+
+namespace
+{
+constexpr size_t kKeyIdSize{16};
+const std::string kLicenseServerUrl{"http://fake-rialto.local/license"};
+
+/**
+ * Key IDs are not recorded, so every recorded key gets an ID made of the recorded key session ID and its index.
+ */
+std::vector<unsigned char> getReplayKeyId(int32_t recordedKeySessionId, size_t index)
+{
+    std::vector<unsigned char> keyId(kKeyIdSize, 0);
+    for (size_t i = 0; i < sizeof(recordedKeySessionId); ++i)
+    {
+        keyId[i] = static_cast<unsigned char>(recordedKeySessionId >> (8 * (sizeof(recordedKeySessionId) - 1 - i)));
+        keyId[kKeyIdSize - 1 - i] = static_cast<unsigned char>(index >> (8 * i));
+    }
+    return keyId;
+}
+} // namespace
+
+namespace firebolt::rialto::fake
+{
+MediaKeysReplay::MediaKeysReplay(const std::shared_ptr<const MediaKeysRecording> &recording) : m_recording{recording}
+{
+    for (size_t i = 0; i < m_recording->events.size(); ++i)
+    {
+        const mediakeysrecording::Record &kRecord{m_recording->events[i].record};
+        if (mediakeysrecording::kCreateMediaKeys == kRecord.type)
+        {
+            m_createMediaKeysCalls.push_back(i);
+        }
+        else if (mediakeysrecording::kApplicationState == kRecord.type)
+        {
+            // Application state changes are driven by the replaying application
+            continue;
+        }
+        else if (kInvalidSessionId == kRecord.keySessionId)
+        {
+            if (mediakeysrecording::kCall == kRecord.type &&
+                static_cast<uint16_t>(CdmOperation::CREATE_KEY_SESSION) != kRecord.operation)
+            {
+                m_sessionlessCalls[kRecord.operation].push_back(i);
+            }
+        }
+        else
+        {
+            RecordedSession &session{m_recordedSessions[kRecord.keySessionId]};
+            if (mediakeysrecording::kCall == kRecord.type &&
+                static_cast<uint16_t>(CdmOperation::CREATE_KEY_SESSION) == kRecord.operation &&
+                static_cast<int32_t>(MediaKeyErrorStatus::OK) == kRecord.status)
+            {
+                m_unboundSessions.push_back(kRecord.keySessionId);
+            }
+            session.events.push_back(i);
+        }
+    }
+}
+
+bool MediaKeysReplay::createMediaKeys()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (m_createMediaKeysCalls.empty())
+    {
+        return true;
+    }
+    const size_t kCallIndex{m_createMediaKeysCalls.front()};
+    m_createMediaKeysCalls.pop_front();
+    return 0 != replayRecordedCall(kCallIndex, lock);
+}
+
+MediaKeyErrorStatus MediaKeysReplay::createKeySession(std::weak_ptr<IMediaKeysClient> client, int32_t &keySessionId)
+{
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        if (m_unboundSessions.empty())
+        {
+            return MediaKeyErrorStatus::FAIL;
+        }
+        keySessionId = FakeRialto::instance().nextKeySessionId();
+        m_boundSessions.emplace(keySessionId, BoundSession{m_unboundSessions.front(), client});
+        m_unboundSessions.pop_front();
+    }
+    return static_cast<MediaKeyErrorStatus>(replayCall(CdmOperation::CREATE_KEY_SESSION, keySessionId,
+                                                       static_cast<int32_t>(MediaKeyErrorStatus::OK)));
+}
+
+int32_t MediaKeysReplay::replayCall(CdmOperation operation, int32_t keySessionId, int32_t defaultStatus)
+{
+    const uint16_t kOperation{static_cast<uint16_t>(operation)};
+    std::unique_lock<std::mutex> lock{m_mutex};
+    if (kInvalidSessionId == keySessionId)
+    {
+        auto &calls{m_sessionlessCalls[kOperation]};
+        if (calls.empty())
+        {
+            return defaultStatus;
+        }
+        const size_t kCallIndex{calls.front()};
+        calls.pop_front();
+        return replayRecordedCall(kCallIndex, lock);
+    }
+
+    auto boundSessionIter{m_boundSessions.find(keySessionId)};
+    if (boundSessionIter == m_boundSessions.end())
+    {
+        return defaultStatus;
+    }
+    RecordedSession &session{m_recordedSessions[boundSessionIter->second.recordedKeySessionId]};
+    for (size_t i = session.nextEvent; i < session.events.size(); ++i)
+    {
+        const RecordedEvent &kRecordedCall{m_recording->events[session.events[i]]};
+        if (mediakeysrecording::kCall != kRecordedCall.record.type || kOperation != kRecordedCall.record.operation)
+        {
+            continue;
+        }
+        session.nextEvent = i + 1;
+        for (size_t j = i + 1; j < session.events.size(); ++j)
+        {
+            const RecordedEvent &kEvent{m_recording->events[session.events[j]]};
+            if (mediakeysrecording::kCall == kEvent.record.type)
+            {
+                break;
+            }
+            scheduleNotification(kEvent, kRecordedCall, keySessionId, boundSessionIter->second.client);
+        }
+        return replayRecordedCall(session.events[i], lock);
+    }
+    return defaultStatus;
+}
+
+int32_t MediaKeysReplay::replayRecordedCall(size_t callIndex, std::unique_lock<std::mutex> &lock)
+{
+    const mediakeysrecording::Record &kRecord{m_recording->events[callIndex].record};
+    lock.unlock();
+    if (kRecord.durationNs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds{kRecord.durationNs});
+    }
+    return kRecord.status;
+}
+
+void MediaKeysReplay::scheduleNotification(const RecordedEvent &event, const RecordedEvent &call, int32_t keySessionId,
+                                           const std::weak_ptr<IMediaKeysClient> &client) const
+{
+    const auto kDelay{std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::nanoseconds{event.record.timestampNs - call.record.timestampNs})};
+    const uint32_t kPayloadSize{event.record.payloadSize};
+    if (mediakeysrecording::kLicenseRequest == event.record.type)
+    {
+        FakeRialto::instance().post(kDelay,
+                                    [client, keySessionId, kPayloadSize]()
+                                    {
+                                        std::shared_ptr<IMediaKeysClient> mediaKeysClient{client.lock()};
+                                        if (mediaKeysClient)
+                                        {
+                                            mediaKeysClient->onLicenseRequest(keySessionId,
+                                                                              std::vector<unsigned char>(kPayloadSize),
+                                                                              kLicenseServerUrl);
+                                        }
+                                    });
+    }
+    else if (mediakeysrecording::kLicenseRenewal == event.record.type)
+    {
+        FakeRialto::instance().post(kDelay,
+                                    [client, keySessionId, kPayloadSize]()
+                                    {
+                                        std::shared_ptr<IMediaKeysClient> mediaKeysClient{client.lock()};
+                                        if (mediaKeysClient)
+                                        {
+                                            mediaKeysClient->onLicenseRenewal(keySessionId,
+                                                                              std::vector<unsigned char>(kPayloadSize));
+                                        }
+                                    });
+    }
+    else if (mediakeysrecording::kKeyStatusesChanged == event.record.type)
+    {
+        KeyStatusVector keyStatuses;
+        for (size_t i = 0; i < event.data.size(); ++i)
+        {
+            keyStatuses.emplace_back(getReplayKeyId(event.record.keySessionId, i),
+                                     static_cast<KeyStatus>(event.data[i]));
+        }
+        FakeRialto::instance().post(kDelay,
+                                    [client, keySessionId, keyStatuses = std::move(keyStatuses)]()
+                                    {
+                                        std::shared_ptr<IMediaKeysClient> mediaKeysClient{client.lock()};
+                                        if (mediaKeysClient)
+                                        {
+                                            mediaKeysClient->onKeyStatusesChanged(keySessionId, keyStatuses);
+                                        }
+                                    });
+    }
+}
+
+ReplayMediaKeys::ReplayMediaKeys(const std::shared_ptr<MediaKeysReplay> &replay) : m_replay{replay} {}
+
+MediaKeyErrorStatus ReplayMediaKeys::selectKeyId(int32_t keySessionId, const std::vector<uint8_t> &keyId)
+{
+    return replay(CdmOperation::SELECT_KEY_ID, keySessionId);
+}
+
+bool ReplayMediaKeys::containsKey(int32_t keySessionId, const std::vector<uint8_t> &keyId)
+{
+    return 0 != m_replay->replayCall(CdmOperation::CONTAINS_KEY, keySessionId, 1);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::createKeySession(KeySessionType sessionType,
+                                                      std::weak_ptr<IMediaKeysClient> client, bool isLDL,
+                                                      int32_t &keySessionId)
+{
+    return m_replay->createKeySession(client, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::generateRequest(int32_t keySessionId, InitDataType initDataType,
+                                                     const std::vector<uint8_t> &initData)
+{
+    return replay(CdmOperation::GENERATE_REQUEST, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::loadSession(int32_t keySessionId)
+{
+    return replay(CdmOperation::LOAD_SESSION, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::updateSession(int32_t keySessionId, const std::vector<uint8_t> &responseData)
+{
+    return replay(CdmOperation::UPDATE_SESSION, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::setDrmHeader(int32_t keySessionId, const std::vector<uint8_t> &requestData)
+{
+    return replay(CdmOperation::SET_DRM_HEADER, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::closeKeySession(int32_t keySessionId)
+{
+    return replay(CdmOperation::CLOSE_KEY_SESSION, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::removeKeySession(int32_t keySessionId)
+{
+    return replay(CdmOperation::REMOVE_KEY_SESSION, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::deleteDrmStore()
+{
+    return replay(CdmOperation::DELETE_DRM_STORE, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::deleteKeyStore()
+{
+    return replay(CdmOperation::DELETE_KEY_STORE, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getDrmStoreHash(std::vector<unsigned char> &drmStoreHash)
+{
+    drmStoreHash.assign(32, 0xd5);
+    return replay(CdmOperation::GET_DRM_STORE_HASH, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getKeyStoreHash(std::vector<unsigned char> &keyStoreHash)
+{
+    keyStoreHash.assign(32, 0x4b);
+    return replay(CdmOperation::GET_KEY_STORE_HASH, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getLdlSessionsLimit(uint32_t &ldlLimit)
+{
+    ldlLimit = FakeRialto::instance().ldlSessionsLimit();
+    return replay(CdmOperation::GET_LDL_SESSIONS_LIMIT, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getLastDrmError(int32_t keySessionId, uint32_t &errorCode)
+{
+    errorCode = 0;
+    return replay(CdmOperation::GET_LAST_DRM_ERROR, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getDrmTime(uint64_t &drmTime)
+{
+    drmTime = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    return replay(CdmOperation::GET_DRM_TIME, kInvalidSessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::getCdmKeySessionId(int32_t keySessionId, std::string &cdmKeySessionId)
+{
+    cdmKeySessionId = "replay-" + std::to_string(keySessionId);
+    return replay(CdmOperation::GET_CDM_KEY_SESSION_ID, keySessionId);
+}
+
+MediaKeyErrorStatus ReplayMediaKeys::replay(CdmOperation operation, int32_t keySessionId)
+{
+    return static_cast<MediaKeyErrorStatus>(
+        m_replay->replayCall(operation, keySessionId, static_cast<int32_t>(MediaKeyErrorStatus::OK)));
+}
+} // namespace firebolt::rialto::fake
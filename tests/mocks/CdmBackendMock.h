@@ -32,7 +32,16 @@ public:
     MOCK_METHOD(bool, selectKeyId, (int32_t keySessionId, const std::vector<uint8_t> &keyId), (override));
     MOCK_METHOD(bool, containsKey, (int32_t keySessionId, const std::vector<uint8_t> &keyId), (override));
     MOCK_METHOD(bool, createKeySession,
-                (firebolt::rialto::KeySessionType sessionType, bool isLDL, int32_t &keySessionId), (override));
+                (firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                 int32_t &keySessionId),
+                (override));
+    MOCK_METHOD(uint64_t, createKeySessionAsync,
+                (firebolt::rialto::KeySessionType sessionType, bool isLDL, SessionPriority priority,
+                 CreateKeySessionCallback callback),
+                (override));
+    MOCK_METHOD(void, setKeySessionPriority, (int32_t keySessionId, SessionPriority priority), (override));
+    MOCK_METHOD(bool, cancelKeySessionCreation, (uint64_t requestId), (override));
+    MOCK_METHOD(bool, admitLdlSession, (SessionPriority priority, std::chrono::milliseconds timeout), (override));
     MOCK_METHOD(bool, generateRequest,
                 (int32_t keySessionId, firebolt::rialto::InitDataType initDataType, const std::vector<uint8_t> &initData),
                 (override));
@@ -51,4 +60,17 @@ public:
     MOCK_METHOD(bool, getCdmKeySessionId, (int32_t keySessionId, std::string &cdmKeySessionId), (override));
 };
 
+/**
+ * Action for createKeySessionAsync, which completes the creation with the given result before returning.
+ */
+inline auto completeKeySessionCreation(bool isCreated, int32_t keySessionId)
+{
+    return [=](firebolt::rialto::KeySessionType, bool, SessionPriority,
+               const ICdmBackend::CreateKeySessionCallback &callback) -> uint64_t
+    {
+        callback(isCreated, keySessionId);
+        return 0;
+    };
+}
+
 #endif // CDM_BACKEND_MOCK_H_
@@ -17,17 +17,16 @@
  * limitations under the License.
  */
 
-#ifndef FIREBOLT_RIALTO_MEDIA_KEYS_CLIENT_MOCK_H_
-#define FIREBOLT_RIALTO_MEDIA_KEYS_CLIENT_MOCK_H_
+#ifndef MESSAGE_DISPATCHER_LISTENER_MOCK_H_
+#define MESSAGE_DISPATCHER_LISTENER_MOCK_H_
 
-#include "IMediaKeysClient.h"
+#include "IMessageDispatcher.h"
 #include <gmock/gmock.h>
+#include <map>
 #include <string>
 #include <vector>
 
-namespace firebolt::rialto
-{
-class MediaKeysClientMock : public IMediaKeysClient
+class MessageDispatcherListenerMock : public IMessageDispatcherListener
 {
 public:
     MOCK_METHOD(void, onLicenseRequest,
@@ -35,8 +34,9 @@ public:
                 (override));
     MOCK_METHOD(void, onLicenseRenewal, (int32_t keySessionId, const std::vector<unsigned char> &licenseRenewalMessage),
                 (override));
-    MOCK_METHOD(void, onKeyStatusesChanged, (int32_t keySessionId, const KeyStatusVector &keyStatuses), (override));
+    MOCK_METHOD(void, onKeyStatusesChanged,
+                (int32_t keySessionId, const firebolt::rialto::KeyStatusVector &keyStatuses), (override));
+    MOCK_METHOD(void, onKeySessionIdsChanged, ((const std::map<int32_t, int32_t> &newKeySessionIds)), (override));
 };
-} // namespace firebolt::rialto
 
-#endif // FIREBOLT_RIALTO_MEDIA_KEYS_CLIENT_MOCK_H_
+#endif // MESSAGE_DISPATCHER_LISTENER_MOCK_H_
@@ -27,7 +27,7 @@
 class MessageDispatcherMock : public IMessageDispatcher
 {
 public:
-    MOCK_METHOD(std::unique_ptr<IMessageDispatcherClient>, createClient, (firebolt::rialto::IMediaKeysClient * client),
+    MOCK_METHOD(std::unique_ptr<IMessageDispatcherClient>, createClient, (IMessageDispatcherListener * client),
                 (override));
 };
 
@@ -21,6 +21,7 @@
 #define OPENCDM_SESSION_MOCK_H_
 
 #include "OpenCDMSession.h"
+#include <chrono>
 #include <gmock/gmock.h>
 #include <string>
 #include <vector>
@@ -37,6 +38,9 @@ public:
     MOCK_METHOD(bool, loadSession, (), (override));
     MOCK_METHOD(bool, updateSession, (const std::vector<uint8_t> &license), (override));
     MOCK_METHOD(bool, getChallengeData, (std::vector<uint8_t> & challengeData), (override));
+    MOCK_METHOD(void, cancelChallengeData, (), (override));
+    MOCK_METHOD(void, startSpeculativeRequest, (), (override));
+    MOCK_METHOD(void, setPriority, (SessionPriority priority), (override));
     MOCK_METHOD(bool, containsKey, (const std::vector<uint8_t> &keyId), (override));
     MOCK_METHOD(bool, setDrmHeader, (const std::vector<uint8_t> &drmHeader), (override));
     MOCK_METHOD(bool, selectKeyId, (const std::vector<uint8_t> &keyId), (override));
@@ -47,9 +51,13 @@ public:
     MOCK_METHOD(bool, addProtectionMeta, (GstBuffer * buffer), (override));
     MOCK_METHOD(bool, closeSession, (), (override));
     MOCK_METHOD(bool, removeSession, (), (override));
-    MOCK_METHOD(KeyStatus, status, (const std::vector<uint8_t> &key), (const, override));
+    MOCK_METHOD(KeyStatus, status, (const uint8_t keyId[], uint8_t length), (const, override));
+    MOCK_METHOD(KeyStatus, waitForKey, (const uint8_t keyId[], uint8_t length, std::chrono::milliseconds timeout),
+                (override));
     MOCK_METHOD(const std::string &, getSessionId, (), (const, override));
     MOCK_METHOD(uint32_t, getLastDrmError, (), (const, override));
+    MOCK_METHOD(uint64_t, getDecryptCalls, (), (const, override));
+    MOCK_METHOD(SessionMemoryUsage, getMemoryUsage, (), (override));
 };
 
 #endif // OPENCDM_SESSION_MOCK_H_
@@ -32,7 +32,7 @@ public:
     MOCK_METHOD(const std::string &, metadata, (), (const, override));
     MOCK_METHOD(OpenCDMSession *, createSession,
                 (const LicenseType licenseType, OpenCDMSessionCallbacks *callbacks, void *userData,
-                 const std::string &initDataType, const std::vector<uint8_t> &initData),
+                 const std::string &initDataType, std::vector<uint8_t> initData),
                 (const, override));
     MOCK_METHOD(bool, getDrmTime, (uint64_t & drmTime), (const, override));
     MOCK_METHOD(bool, getLdlSessionsLimit, (uint32_t & ldlLimit), (const, override));
@@ -0,0 +1,306 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+#include "FakeRialto.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <gst/gst.h>
+#include <gst/gstprotection.h>
+#include <mutex>
+#include <opencdm/open_cdm.h>
+#include <opencdm/open_cdm_adapter.h>
+#include <opencdm/open_cdm_ext.h>
+#include <vector>
+
+namespace
+{
+constexpr size_t kIterations{1000};
+constexpr size_t kPayloadSize{4096};
+constexpr std::chrono::seconds kNotificationTimeout{5};
+constexpr std::array<uint8_t, 16> kKeyId{0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+                                         0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+constexpr std::array<uint8_t, 16> kIv{0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+                                      0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf};
+// Big endian (clear bytes: uint16, encrypted bytes: uint32) covering the payload
+constexpr std::array<uint8_t, 6> kSubSample{0x00, 0x10, 0x00, 0x00, 0x0f, 0xf0};
+
+enum class Expectation
+{
+    ALLOCATION_FREE,
+    REPORT_ONLY
+};
+
+struct SessionContext
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool hasLicenseRequest{false};
+    bool areKeysUpdated{false};
+
+    template <typename Predicate> bool waitFor(Predicate predicate)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        return cv.wait_for(lock, kNotificationTimeout, predicate);
+    }
+};
+
+void onProcessChallenge(OpenCDMSession *, void *userData, const char[], const uint8_t[], const uint16_t)
+{
+    SessionContext *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    context->hasLicenseRequest = true;
+    context->cv.notify_all();
+}
+
+void onKeyUpdate(OpenCDMSession *, void *, const uint8_t[], const uint8_t) {}
+void onErrorMessage(OpenCDMSession *, void *, const char[]) {}
+
+void onKeysUpdated(const OpenCDMSession *, void *userData)
+{
+    SessionContext *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    context->areKeysUpdated = true;
+    context->cv.notify_all();
+}
+
+OpenCDMSessionCallbacks gCallbacks{onProcessChallenge, onKeyUpdate, onErrorMessage, onKeysUpdated};
+
+GstBuffer *createBuffer(const uint8_t *data, size_t size)
+{
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+    gst_buffer_fill(buffer, 0, data, size);
+    return buffer;
+}
+
+/**
+ * Encrypted buffers as handed over by the demuxer, one per iteration (and one for the warm-up call), created before
+ * the measurement starts.
+ */
+class EncryptedBuffers
+{
+public:
+    explicit EncryptedBuffers(bool isProtectionInfoComplete) : m_buffers(kIterations + 1, nullptr)
+    {
+        for (auto &buffer : m_buffers)
+        {
+            buffer = gst_buffer_new_allocate(nullptr, kPayloadSize, nullptr);
+            GstStructure *info = gst_structure_new("application/x-cenc", "cipher-mode", G_TYPE_STRING, "cenc", NULL);
+            if (isProtectionInfoComplete)
+            {
+                GstBuffer *keyId = createBuffer(kKeyId.data(), kKeyId.size());
+                GstBuffer *iv = createBuffer(kIv.data(), kIv.size());
+                GstBuffer *subSamples = createBuffer(kSubSample.data(), kSubSample.size());
+                gst_structure_set(info, "kid", GST_TYPE_BUFFER, keyId, "iv", GST_TYPE_BUFFER, iv, "subsample_count",
+                                  G_TYPE_UINT, 1, "subsamples", GST_TYPE_BUFFER, subSamples, NULL);
+                gst_buffer_unref(keyId);
+                gst_buffer_unref(iv);
+                gst_buffer_unref(subSamples);
+            }
+            gst_buffer_add_protection_meta(buffer, info);
+        }
+    }
+
+    ~EncryptedBuffers()
+    {
+        for (GstBuffer *buffer : m_buffers)
+        {
+            gst_buffer_unref(buffer);
+        }
+    }
+
+    GstBuffer *next() { return m_buffers[m_next++]; }
+
+private:
+    std::vector<GstBuffer *> m_buffers;
+    size_t m_next{0};
+};
+
+/**
+ * Runs every API call once to warm up lazily initialised state, then kIterations times while counting the heap
+ * allocations of the calling thread. Work done on Rialto (fake) threads is not included.
+ */
+class AllocationReport
+{
+public:
+    AllocationReport()
+    {
+        std::printf("%-60s %12s %12s %8s\n", "API call", "allocs/call", "bytes/call", "result");
+    }
+
+    template <typename Call> void measure(const char *name, Expectation expectation, Call call)
+    {
+        call();
+        const uint64_t kAllocationsBefore{AllocationCounter::allocations()};
+        const uint64_t kBytesBefore{AllocationCounter::allocatedBytes()};
+        for (size_t i = 0; i < kIterations; ++i)
+        {
+            call();
+        }
+        const uint64_t kAllocations{AllocationCounter::allocations() - kAllocationsBefore};
+        const uint64_t kBytes{AllocationCounter::allocatedBytes() - kBytesBefore};
+
+        const char *result{"-"};
+        if (Expectation::ALLOCATION_FREE == expectation)
+        {
+            result = 0 == kAllocations ? "PASS" : "FAIL";
+            m_isPassed = m_isPassed && 0 == kAllocations;
+        }
+        std::printf("%-60s %12.2f %12.1f %8s\n", name, static_cast<double>(kAllocations) / kIterations,
+                    static_cast<double>(kBytes) / kIterations, result);
+    }
+
+    bool isPassed() const { return m_isPassed; }
+
+private:
+    bool m_isPassed{true};
+};
+
+/**
+ * Session with a license for kKeyId, i.e. in the state the decrypt and key status paths run in.
+ */
+class LicensedSession
+{
+public:
+    LicensedSession()
+    {
+        const std::vector<uint8_t> kInitData(64, 0);
+        m_system = opencdm_create_system("com.widevine.alpha");
+        opencdm_construct_session(m_system, Temporary, "cenc", kInitData.data(), kInitData.size(), nullptr, 0,
+                                  &gCallbacks, &m_context, &m_session);
+        m_isLicensed = m_session && m_context.waitFor([this]() { return m_context.hasLicenseRequest; }) &&
+                       ERROR_NONE == opencdm_session_update(m_session, kKeyId.data(), kKeyId.size()) &&
+                       m_context.waitFor([this]() { return m_context.areKeysUpdated; });
+    }
+
+    ~LicensedSession()
+    {
+        if (m_session)
+        {
+            opencdm_session_close(m_session);
+            opencdm_destruct_session(m_session);
+        }
+        opencdm_destruct_system(m_system);
+    }
+
+    bool isLicensed() const { return m_isLicensed; }
+    OpenCDMSystem *system() const { return m_system; }
+    OpenCDMSession *session() const { return m_session; }
+
+private:
+    SessionContext m_context;
+    OpenCDMSystem *m_system{nullptr};
+    OpenCDMSession *m_session{nullptr};
+    bool m_isLicensed{false};
+};
+
+void measureSessionCalls(AllocationReport &report, const LicensedSession &licensedSession)
+{
+    OpenCDMSession *session{licensedSession.session()};
+    report.measure("opencdm_session_status", Expectation::ALLOCATION_FREE,
+                   [&]() { opencdm_session_status(session, kKeyId.data(), kKeyId.size()); });
+    report.measure("opencdm_get_system_session + opencdm_destruct_session", Expectation::ALLOCATION_FREE,
+                   [&]()
+                   {
+                       OpenCDMSession *systemSession{
+                           opencdm_get_system_session(licensedSession.system(), kKeyId.data(), kKeyId.size(), 0)};
+                       opencdm_destruct_session(systemSession);
+                   });
+    report.measure("opencdm_session_has_key_id", Expectation::REPORT_ONLY,
+                   [&]() { opencdm_session_has_key_id(session, kKeyId.size(), kKeyId.data()); });
+    // Includes the copy of the license passed on to Rialto and the work done by the (fake) client on this thread
+    report.measure("opencdm_session_update", Expectation::REPORT_ONLY,
+                   [&]() { opencdm_session_update(session, kKeyId.data(), kKeyId.size()); });
+    report.measure("opencdm_session_select_key_id", Expectation::REPORT_ONLY,
+                   [&]() { opencdm_session_select_key_id(session, kKeyId.size(), kKeyId.data()); });
+}
+
+/**
+ * The protection meta structure attached to every buffer is inherent to the decrypt paths, so they are reported
+ * rather than asserted.
+ */
+void measureDecryptCalls(AllocationReport &report, const LicensedSession &licensedSession)
+{
+    OpenCDMSession *session{licensedSession.session()};
+    GstBuffer *subSamples = createBuffer(kSubSample.data(), kSubSample.size());
+    GstBuffer *iv = createBuffer(kIv.data(), kIv.size());
+    GstBuffer *keyId = createBuffer(kKeyId.data(), kKeyId.size());
+    GstBuffer *emptyKeyId = gst_buffer_new();
+    {
+        EncryptedBuffers buffers{false};
+        report.measure("opencdm_gstreamer_session_decrypt_ex", Expectation::REPORT_ONLY,
+                       [&]()
+                       {
+                           opencdm_gstreamer_session_decrypt_ex(session, buffers.next(), subSamples, 1, iv, keyId, 0,
+                                                                nullptr);
+                       });
+    }
+    {
+        // The demuxer passes an empty key ID and the session fills in the selected PlayReady key
+        opencdm_session_select_key_id(session, kKeyId.size(), kKeyId.data());
+        EncryptedBuffers buffers{false};
+        report.measure("opencdm_gstreamer_session_decrypt_ex (PlayReady key selected)", Expectation::REPORT_ONLY,
+                       [&]()
+                       {
+                           opencdm_gstreamer_session_decrypt_ex(session, buffers.next(), subSamples, 1, iv, emptyKeyId,
+                                                                0, nullptr);
+                       });
+    }
+#ifdef RIALTO_ENABLE_DECRYPT_BUFFER
+    {
+        EncryptedBuffers buffers{true};
+        report.measure("opencdm_gstreamer_session_decrypt_buffer", Expectation::REPORT_ONLY,
+                       [&]() { opencdm_gstreamer_session_decrypt_buffer(session, buffers.next(), nullptr); });
+    }
+#endif
+    gst_buffer_unref(emptyKeyId);
+    gst_buffer_unref(keyId);
+    gst_buffer_unref(iv);
+    gst_buffer_unref(subSamples);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // Older GLib versions serve GstStructures and GValues from their own slice allocator, bypassing malloc
+    setenv("G_SLICE", "always-malloc", 1);
+    gst_init(&argc, &argv);
+    firebolt::rialto::fake::FakeRialto::instance().configure(firebolt::rialto::fake::FakeRialtoConfig{});
+
+    LicensedSession licensedSession;
+    if (!licensedSession.isLicensed())
+    {
+        std::fprintf(stderr, "Failed to set up a licensed session\n");
+        return EXIT_FAILURE;
+    }
+
+    AllocationReport report;
+    measureSessionCalls(report, licensedSession);
+    measureDecryptCalls(report, licensedSession);
+    if (!report.isPassed())
+    {
+        std::fprintf(stderr, "Allocations found on paths expected to be allocation free\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
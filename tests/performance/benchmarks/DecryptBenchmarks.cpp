@@ -0,0 +1,262 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+#include "FakeRialto.h"
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <gst/gst.h>
+#include <gst/gstprotection.h>
+#include <opencdm/open_cdm.h>
+#include <opencdm/open_cdm_adapter.h>
+#include <opencdm/open_cdm_ext.h>
+#include <vector>
+
+namespace
+{
+constexpr size_t kBatchSize{1000};
+constexpr size_t kPayloadSize{4096};
+constexpr size_t kSubSampleEntrySize{6};
+constexpr std::array<uint8_t, 16> kKeyId{0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+                                         0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+constexpr std::array<uint8_t, 16> kIv{0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+                                      0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf};
+
+enum Scheme : int64_t
+{
+    CENC = 0,
+    CBCS = 1
+};
+
+void onProcessChallenge(OpenCDMSession *, void *, const char[], const uint8_t[], const uint16_t) {}
+void onKeyUpdate(OpenCDMSession *, void *, const uint8_t[], const uint8_t) {}
+void onErrorMessage(OpenCDMSession *, void *, const char[]) {}
+void onKeysUpdated(const OpenCDMSession *, void *) {}
+OpenCDMSessionCallbacks gCallbacks{onProcessChallenge, onKeyUpdate, onErrorMessage, onKeysUpdated};
+
+GstBuffer *createBuffer(const uint8_t *data, size_t size)
+{
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+    gst_buffer_fill(buffer, 0, data, size);
+    return buffer;
+}
+
+GstBuffer *createSubSamples(size_t subSampleCount)
+{
+    // Big endian (clear bytes: uint16, encrypted bytes: uint32) pairs covering the payload
+    std::vector<uint8_t> subSamples(subSampleCount * kSubSampleEntrySize, 0);
+    const uint32_t kEntryBytes{static_cast<uint32_t>(kPayloadSize / subSampleCount)};
+    const uint16_t kClearBytes{static_cast<uint16_t>(kEntryBytes < 16 ? kEntryBytes : 16)};
+    const uint32_t kEncryptedBytes{kEntryBytes - kClearBytes};
+    for (size_t i = 0; i < subSampleCount; ++i)
+    {
+        uint8_t *entry{&subSamples[i * kSubSampleEntrySize]};
+        entry[0] = static_cast<uint8_t>(kClearBytes >> 8);
+        entry[1] = static_cast<uint8_t>(kClearBytes);
+        entry[2] = static_cast<uint8_t>(kEncryptedBytes >> 24);
+        entry[3] = static_cast<uint8_t>(kEncryptedBytes >> 16);
+        entry[4] = static_cast<uint8_t>(kEncryptedBytes >> 8);
+        entry[5] = static_cast<uint8_t>(kEncryptedBytes);
+    }
+    return createBuffer(subSamples.data(), subSamples.size());
+}
+
+/**
+ * Protection metadata as attached by the demuxer: cipher mode (and pattern for CBCS) for the
+ * opencdm_gstreamer_session_decrypt_ex path, the full set of decryption parameters for the
+ * opencdm_gstreamer_session_decrypt_buffer path.
+ */
+GstStructure *createDemuxerProtectionInfo(Scheme scheme, size_t subSampleCount, bool isComplete)
+{
+    GstStructure *info = gst_structure_new("application/x-cenc", "cipher-mode", G_TYPE_STRING,
+                                           CBCS == scheme ? "cbcs" : "cenc", NULL);
+    if (CBCS == scheme)
+    {
+        gst_structure_set(info, "crypt_byte_block", G_TYPE_UINT, 1, "skip_byte_block", G_TYPE_UINT, 9, NULL);
+    }
+    if (isComplete)
+    {
+        GstBuffer *keyId = createBuffer(kKeyId.data(), kKeyId.size());
+        GstBuffer *iv = createBuffer(kIv.data(), kIv.size());
+        GstBuffer *subSamples = createSubSamples(subSampleCount);
+        gst_structure_set(info, "kid", GST_TYPE_BUFFER, keyId, "iv", GST_TYPE_BUFFER, iv, "subsample_count",
+                          G_TYPE_UINT, static_cast<guint>(subSampleCount), "subsamples", GST_TYPE_BUFFER, subSamples,
+                          NULL);
+        gst_buffer_unref(keyId);
+        gst_buffer_unref(iv);
+        gst_buffer_unref(subSamples);
+    }
+    return info;
+}
+
+class DecryptSession
+{
+public:
+    explicit DecryptSession(bool isPlayreadyKeySelected)
+    {
+        firebolt::rialto::fake::FakeRialto::instance().configure(firebolt::rialto::fake::FakeRialtoConfig{});
+        m_system = opencdm_create_system("com.microsoft.playready");
+        opencdm_construct_session(m_system, Temporary, "cenc", nullptr, 0, nullptr, 0, &gCallbacks, nullptr,
+                                  &m_session);
+        if (isPlayreadyKeySelected)
+        {
+            opencdm_session_select_key_id(m_session, kKeyId.size(), kKeyId.data());
+        }
+    }
+
+    ~DecryptSession()
+    {
+        opencdm_destruct_session(m_session);
+        opencdm_destruct_system(m_system);
+    }
+
+    OpenCDMSession *session() const { return m_session; }
+
+private:
+    OpenCDMSystem *m_system{nullptr};
+    OpenCDMSession *m_session{nullptr};
+};
+
+void reportCounters(benchmark::State &state, uint64_t allocations)
+{
+    const double kBuffers{static_cast<double>(state.iterations() * kBatchSize)};
+    state.SetItemsProcessed(static_cast<int64_t>(kBuffers));
+    state.counters["time/buffer"] =
+        benchmark::Counter(kBuffers, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["allocs/buffer"] = benchmark::Counter(static_cast<double>(allocations) / kBuffers);
+}
+
+/**
+ * opencdm_gstreamer_session_decrypt_ex -> OpenCDMSessionPrivate::addProtectionMeta(buffer, subSample, ...)
+ * Args: scheme, PlayReady key selected, subsample count
+ */
+void decryptEx(benchmark::State &state)
+{
+    const Scheme kScheme{static_cast<Scheme>(state.range(0))};
+    const bool kIsPlayreadyKeySelected{0 != state.range(1)};
+    const size_t kSubSampleCount{static_cast<size_t>(state.range(2))};
+
+    DecryptSession decryptSession{kIsPlayreadyKeySelected};
+    GstBuffer *subSamples = createSubSamples(kSubSampleCount);
+    GstBuffer *iv = createBuffer(kIv.data(), kIv.size());
+    // With a PlayReady key selected the demuxer passes an empty key ID and the session fills in its own
+    GstBuffer *keyId = kIsPlayreadyKeySelected ? gst_buffer_new() : createBuffer(kKeyId.data(), kKeyId.size());
+    std::vector<GstBuffer *> buffers(kBatchSize, nullptr);
+    uint64_t allocations{0};
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (auto &buffer : buffers)
+        {
+            buffer = gst_buffer_new_allocate(nullptr, kPayloadSize, nullptr);
+            gst_buffer_add_protection_meta(buffer, createDemuxerProtectionInfo(kScheme, kSubSampleCount, false));
+        }
+        const uint64_t kAllocationsBefore{AllocationCounter::allocations()};
+        state.ResumeTiming();
+
+        for (GstBuffer *buffer : buffers)
+        {
+            benchmark::DoNotOptimize(opencdm_gstreamer_session_decrypt_ex(decryptSession.session(), buffer, subSamples,
+                                                                          kSubSampleCount, iv, keyId, 0, nullptr));
+        }
+
+        state.PauseTiming();
+        allocations += AllocationCounter::allocations() - kAllocationsBefore;
+        for (GstBuffer *buffer : buffers)
+        {
+            gst_buffer_unref(buffer);
+        }
+        state.ResumeTiming();
+    }
+
+    reportCounters(state, allocations);
+    gst_buffer_unref(keyId);
+    gst_buffer_unref(iv);
+    gst_buffer_unref(subSamples);
+}
+
+#ifdef RIALTO_ENABLE_DECRYPT_BUFFER
+/**
+ * opencdm_gstreamer_session_decrypt_buffer -> OpenCDMSessionPrivate::addProtectionMeta(buffer)
+ * Args: scheme, PlayReady key selected, subsample count
+ */
+void decryptBuffer(benchmark::State &state)
+{
+    const Scheme kScheme{static_cast<Scheme>(state.range(0))};
+    const bool kIsPlayreadyKeySelected{0 != state.range(1)};
+    const size_t kSubSampleCount{static_cast<size_t>(state.range(2))};
+
+    DecryptSession decryptSession{kIsPlayreadyKeySelected};
+    std::vector<GstBuffer *> buffers(kBatchSize, nullptr);
+    uint64_t allocations{0};
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (auto &buffer : buffers)
+        {
+            buffer = gst_buffer_new_allocate(nullptr, kPayloadSize, nullptr);
+            gst_buffer_add_protection_meta(buffer, createDemuxerProtectionInfo(kScheme, kSubSampleCount, true));
+        }
+        const uint64_t kAllocationsBefore{AllocationCounter::allocations()};
+        state.ResumeTiming();
+
+        for (GstBuffer *buffer : buffers)
+        {
+            benchmark::DoNotOptimize(
+                opencdm_gstreamer_session_decrypt_buffer(decryptSession.session(), buffer, nullptr));
+        }
+
+        state.PauseTiming();
+        allocations += AllocationCounter::allocations() - kAllocationsBefore;
+        for (GstBuffer *buffer : buffers)
+        {
+            gst_buffer_unref(buffer);
+        }
+        state.ResumeTiming();
+    }
+
+    reportCounters(state, allocations);
+}
+#endif
+} // namespace
+
+BENCHMARK(decryptEx)
+    ->ArgNames({"cbcs", "playready", "subsamples"})
+    ->ArgsProduct({{CENC, CBCS}, {0, 1}, {1, 8, 64}});
+#ifdef RIALTO_ENABLE_DECRYPT_BUFFER
+BENCHMARK(decryptBuffer)
+    ->ArgNames({"cbcs", "playready", "subsamples"})
+    ->ArgsProduct({{CENC, CBCS}, {0, 1}, {1, 8, 64}});
+#endif
+
+int main(int argc, char **argv)
+{
+    gst_init(&argc, &argv);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
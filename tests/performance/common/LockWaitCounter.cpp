@@ -0,0 +1,126 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockWaitCounter.h"
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#ifndef RIALTO_ENABLE_TSAN
+namespace
+{
+constexpr size_t kMaxModules{16};
+
+struct ModuleEntry
+{
+    std::atomic<const void *> base{nullptr};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> contendedLocks{0};
+    std::atomic<uint64_t> waitTimeNs{0};
+};
+
+std::array<ModuleEntry, kMaxModules> gModules;
+
+uint64_t getTimeNs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void addWait(const void *caller, uint64_t waitTimeNs)
+{
+    static char unknownModule{0};
+    Dl_info info{};
+    if (0 == dladdr(caller, &info) || !info.dli_fbase)
+    {
+        info.dli_fbase = &unknownModule;
+        info.dli_fname = "(unknown)";
+    }
+    for (auto &entry : gModules)
+    {
+        const void *base{entry.base.load()};
+        if (!base)
+        {
+            const void *expected{nullptr};
+            if (entry.base.compare_exchange_strong(expected, info.dli_fbase))
+            {
+                entry.name = info.dli_fname;
+                base = info.dli_fbase;
+            }
+            else
+            {
+                base = expected;
+            }
+        }
+        if (base == info.dli_fbase)
+        {
+            ++entry.contendedLocks;
+            entry.waitTimeNs += waitTimeNs;
+            return;
+        }
+    }
+}
+} // namespace
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    using LockFunction = int (*)(pthread_mutex_t *);
+    static const LockFunction kRealLock{reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"))};
+    if (0 == pthread_mutex_trylock(mutex))
+    {
+        return 0;
+    }
+    const uint64_t kStartNs{getTimeNs()};
+    const int kResult{kRealLock(mutex)};
+    addWait(__builtin_return_address(0), getTimeNs() - kStartNs);
+    return kResult;
+}
+
+bool LockWaitCounter::isEnabled()
+{
+    return true;
+}
+
+std::vector<LockWaitCounter::ModuleWaits> LockWaitCounter::waits()
+{
+    std::vector<ModuleWaits> result;
+    for (const auto &entry : gModules)
+    {
+        const char *name{entry.name.load()};
+        if (name)
+        {
+            result.push_back(ModuleWaits{name, entry.contendedLocks.load(), entry.waitTimeNs.load()});
+        }
+    }
+    return result;
+}
+#else
+bool LockWaitCounter::isEnabled()
+{
+    return false;
+}
+
+std::vector<LockWaitCounter::ModuleWaits> LockWaitCounter::waits()
+{
+    return {};
+}
+#endif
@@ -0,0 +1,46 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCK_WAIT_COUNTER_H_
+#define LOCK_WAIT_COUNTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Measures time spent waiting for contended pthread mutexes (and so std::mutex), per shared object that took the
+ * lock. Linking LockWaitCounter.cpp into an executable interposes pthread_mutex_lock. Not available in TSan builds,
+ * which intercept the same function.
+ */
+class LockWaitCounter
+{
+public:
+    struct ModuleWaits
+    {
+        std::string module;
+        uint64_t contendedLocks;
+        uint64_t waitTimeNs;
+    };
+
+    static bool isEnabled();
+    static std::vector<ModuleWaits> waits();
+};
+
+#endif // LOCK_WAIT_COUNTER_H_
@@ -0,0 +1,545 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeRialto.h"
+#include "LatencyStats.h"
+#include "MediaKeysRecording.h"
+#include <MediaCommon.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <opencdm/open_cdm.h>
+#include <opencdm/open_cdm_ext.h>
+#include <string>
+#include <sys/prctl.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+constexpr std::chrono::seconds kCallbackTimeout{10};
+
+enum Action : size_t
+{
+    CONSTRUCT_SESSION,
+    GET_CHALLENGE_DATA,
+    SESSION_UPDATE,
+    SESSION_LOAD,
+    SET_DRM_HEADER,
+    HAS_KEY_ID,
+    SELECT_KEY_ID,
+    SESSION_REMOVE,
+    SESSION_CLOSE,
+    ACTION_COUNT
+};
+
+constexpr std::array<const char *, ACTION_COUNT> kActionNames{"opencdm_construct_session",
+                                                              "opencdm_session_get_challenge_data",
+                                                              "opencdm_session_update",
+                                                              "opencdm_session_load",
+                                                              "opencdm_session_set_drm_header",
+                                                              "opencdm_session_has_key_id",
+                                                              "opencdm_session_select_key_id",
+                                                              "opencdm_session_remove",
+                                                              "opencdm_session_close"};
+
+struct ScheduledAction
+{
+    uint64_t timestampNs;
+    Action action;
+    uint32_t payloadSize;
+};
+
+/**
+ * Application side of one recorded key session: the opencdm calls that caused the recorded IMediaKeys calls.
+ */
+struct RecordedSession
+{
+    int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+    LicenseType licenseType{Temporary};
+    bool isLDL{false};
+    std::string initDataType{"cenc"};
+    uint32_t initDataSize{0};
+    uint64_t createdNs{0};
+    uint64_t firstKeyStatusNs{0}; // Time from creation to the first key status notification, 0 when none
+    std::vector<ScheduledAction> actions;
+};
+
+struct ApplicationStateChange
+{
+    uint64_t timestampNs;
+    firebolt::rialto::ApplicationState state;
+};
+
+/**
+ * Application side of the recording. The Rialto side is replayed by the fake (MediaKeysReplay).
+ */
+struct ReplayScript
+{
+    std::string keySystem;
+    uint64_t durationNs{0};
+    std::vector<RecordedSession> sessions;
+    std::vector<ApplicationStateChange> applicationStates;
+};
+
+LicenseType toLicenseType(uint32_t sessionType)
+{
+    switch (static_cast<firebolt::rialto::KeySessionType>(sessionType))
+    {
+    case firebolt::rialto::KeySessionType::PERSISTENT_LICENCE:
+        return PersistentLicense;
+    case firebolt::rialto::KeySessionType::PERSISTENT_RELEASE_MESSAGE:
+        return PersistentUsageRecord;
+    default:
+        return Temporary;
+    }
+}
+
+const char *toInitDataType(uint32_t initDataType)
+{
+    switch (static_cast<firebolt::rialto::InitDataType>(initDataType))
+    {
+    case firebolt::rialto::InitDataType::WEBM:
+        return "webm";
+    case firebolt::rialto::InitDataType::DRMHEADER:
+        return "drmheader";
+    case firebolt::rialto::InitDataType::KEY_IDS:
+        return "keyids";
+    default:
+        return "cenc";
+    }
+}
+
+bool toAction(CdmOperation operation, Action &action)
+{
+    switch (operation)
+    {
+    case CdmOperation::UPDATE_SESSION:
+        action = SESSION_UPDATE;
+        return true;
+    case CdmOperation::LOAD_SESSION:
+        action = SESSION_LOAD;
+        return true;
+    case CdmOperation::SET_DRM_HEADER:
+        action = SET_DRM_HEADER;
+        return true;
+    case CdmOperation::CONTAINS_KEY:
+        action = HAS_KEY_ID;
+        return true;
+    case CdmOperation::SELECT_KEY_ID:
+        action = SELECT_KEY_ID;
+        return true;
+    case CdmOperation::REMOVE_KEY_SESSION:
+        action = SESSION_REMOVE;
+        return true;
+    case CdmOperation::CLOSE_KEY_SESSION:
+        action = SESSION_CLOSE;
+        return true;
+    default:
+        // Made by the library itself (e.g. getCdmKeySessionId) or covered by construct / get challenge data
+        return false;
+    }
+}
+
+ReplayScript createScript(const firebolt::rialto::fake::MediaKeysRecording &recording)
+{
+    ReplayScript script;
+    std::map<int32_t, size_t> sessionIndexes;
+    auto findSession = [&](int32_t keySessionId) -> RecordedSession *
+    {
+        auto sessionIndexIter{sessionIndexes.find(keySessionId)};
+        return sessionIndexIter != sessionIndexes.end() ? &script.sessions[sessionIndexIter->second] : nullptr;
+    };
+
+    for (const auto &event : recording.events)
+    {
+        const mediakeysrecording::Record &kRecord{event.record};
+        script.durationNs = std::max(script.durationNs, kRecord.timestampNs + kRecord.durationNs);
+        if (mediakeysrecording::kCreateMediaKeys == kRecord.type && script.keySystem.empty())
+        {
+            script.keySystem.assign(event.data.begin(), event.data.end());
+        }
+        else if (mediakeysrecording::kApplicationState == kRecord.type)
+        {
+            script.applicationStates.push_back(
+                {kRecord.timestampNs, static_cast<firebolt::rialto::ApplicationState>(kRecord.extra)});
+        }
+        else if (mediakeysrecording::kKeyStatusesChanged == kRecord.type)
+        {
+            RecordedSession *session{findSession(kRecord.keySessionId)};
+            if (session && 0 == session->firstKeyStatusNs)
+            {
+                session->firstKeyStatusNs = kRecord.timestampNs - session->createdNs;
+            }
+        }
+        else if (mediakeysrecording::kCall == kRecord.type &&
+                 firebolt::rialto::kInvalidSessionId != kRecord.keySessionId)
+        {
+            const CdmOperation kOperation{static_cast<CdmOperation>(kRecord.operation)};
+            if (CdmOperation::CREATE_KEY_SESSION == kOperation)
+            {
+                if (static_cast<int32_t>(firebolt::rialto::MediaKeyErrorStatus::OK) != kRecord.status)
+                {
+                    continue;
+                }
+                RecordedSession session;
+                session.keySessionId = kRecord.keySessionId;
+                session.licenseType = toLicenseType(kRecord.extra & ~mediakeysrecording::kLdlFlag);
+                session.isLDL = 0 != (kRecord.extra & mediakeysrecording::kLdlFlag);
+                session.createdNs = kRecord.timestampNs;
+                session.actions.push_back({kRecord.timestampNs, CONSTRUCT_SESSION, 0});
+                sessionIndexes[kRecord.keySessionId] = script.sessions.size();
+                script.sessions.push_back(std::move(session));
+                continue;
+            }
+            RecordedSession *session{findSession(kRecord.keySessionId)};
+            if (!session)
+            {
+                continue;
+            }
+            Action action{ACTION_COUNT};
+            if (CdmOperation::GENERATE_REQUEST == kOperation && 0 == session->initDataSize)
+            {
+                session->initDataType = toInitDataType(kRecord.extra);
+                session->initDataSize = kRecord.payloadSize;
+            }
+            else if (toAction(kOperation, action))
+            {
+                session->actions.push_back({kRecord.timestampNs, action, kRecord.payloadSize});
+            }
+        }
+    }
+    return script;
+}
+
+/**
+ * Callback state of one replayed session, passed to the library as user data.
+ */
+struct SessionContext
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool hasLicenseRequest{false};
+    std::chrono::steady_clock::time_point firstKeyStatus{};
+    std::vector<uint8_t> keyId;
+
+    template <typename Predicate> bool waitFor(Predicate predicate)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        return cv.wait_for(lock, kCallbackTimeout, predicate);
+    }
+};
+
+void onProcessChallenge(OpenCDMSession *, void *userData, const char[], const uint8_t[], const uint16_t)
+{
+    auto *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    context->hasLicenseRequest = true;
+    context->cv.notify_all();
+}
+
+void onKeyUpdate(OpenCDMSession *, void *userData, const uint8_t keyId[], const uint8_t length)
+{
+    auto *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    if (context->keyId.empty())
+    {
+        context->firstKeyStatus = std::chrono::steady_clock::now();
+        context->keyId.assign(keyId, keyId + length);
+    }
+    context->cv.notify_all();
+}
+
+void onErrorMessage(OpenCDMSession *, void *, const char[]) {}
+void onKeysUpdated(const OpenCDMSession *, void *) {}
+OpenCDMSessionCallbacks gCallbacks{onProcessChallenge, onKeyUpdate, onErrorMessage, onKeysUpdated};
+
+double percentileUs(std::vector<uint64_t> &samples, double fraction)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t kIndex{std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))};
+    return samples[kIndex] / 1000.0;
+}
+
+class Replay
+{
+public:
+    explicit Replay(const ReplayScript &script) : m_script{script} {}
+
+    void run()
+    {
+        const bool kIsPlayready{std::string::npos != m_script.keySystem.find("playready")};
+        OpenCDMSystem *system{opencdm_create_system(m_script.keySystem.c_str())};
+        if (!system)
+        {
+            std::printf("Failed to create the %s system\n", m_script.keySystem.c_str());
+            return;
+        }
+
+        const auto kStart{std::chrono::steady_clock::now()};
+        std::vector<std::thread> threads;
+        threads.emplace_back(
+            [this, kStart]()
+            {
+                for (const auto &change : m_script.applicationStates)
+                {
+                    std::this_thread::sleep_until(kStart + std::chrono::nanoseconds{change.timestampNs});
+                    firebolt::rialto::fake::FakeRialto::instance().setApplicationState(change.state);
+                }
+            });
+        for (const auto &session : m_script.sessions)
+        {
+            threads.emplace_back(&Replay::replaySession, this, system, kIsPlayready, std::cref(session), kStart);
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        const auto kDuration{std::chrono::steady_clock::now() - kStart};
+        opencdm_destruct_system(system);
+
+        print(std::chrono::duration_cast<std::chrono::nanoseconds>(kDuration).count());
+    }
+
+private:
+    void replaySession(OpenCDMSystem *system, bool isPlayready, const RecordedSession &recorded,
+                       std::chrono::steady_clock::time_point start)
+    {
+        SessionContext context;
+        OpenCDMSession *session{nullptr};
+        bool isClosed{false};
+        // Start of the call creating the Rialto key session
+        std::chrono::steady_clock::time_point sessionStart;
+        std::array<std::vector<uint64_t>, ACTION_COUNT> samples;
+        for (const auto &action : recorded.actions)
+        {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds{action.timestampNs});
+            if (CONSTRUCT_SESSION != action.action && !session)
+            {
+                break;
+            }
+            const std::vector<uint8_t> kPayload(action.payloadSize);
+            const auto kCallStart{std::chrono::steady_clock::now()};
+            OpenCDMError result{ERROR_NONE};
+            switch (action.action)
+            {
+            case CONSTRUCT_SESSION:
+            {
+                const std::vector<uint8_t> kInitData(recorded.initDataSize);
+                sessionStart = kCallStart;
+                result = opencdm_construct_session(system, recorded.licenseType, recorded.initDataType.c_str(),
+                                                   kInitData.data(), kInitData.size(), nullptr, 0, &gCallbacks,
+                                                   &context, &session);
+                if (ERROR_NONE == result && isPlayready)
+                {
+                    addSample(samples, CONSTRUCT_SESSION, kCallStart);
+                    const auto kChallengeStart{std::chrono::steady_clock::now()};
+                    sessionStart = kChallengeStart;
+                    uint32_t challengeSize{0};
+                    result = opencdm_session_get_challenge_data(session, nullptr, &challengeSize, recorded.isLDL);
+                    addSample(samples, GET_CHALLENGE_DATA, kChallengeStart);
+                    countResult(result);
+                    continue;
+                }
+                break;
+            }
+            case SESSION_UPDATE:
+                if (!context.waitFor([&]() { return context.hasLicenseRequest; }))
+                {
+                    ++m_failures;
+                }
+                result = opencdm_session_update(session, kPayload.data(),
+                                                static_cast<uint16_t>(std::min<size_t>(kPayload.size(), UINT16_MAX)));
+                break;
+            case SESSION_LOAD:
+                result = opencdm_session_load(session);
+                break;
+            case SET_DRM_HEADER:
+                result = opencdm_session_set_drm_header(session, kPayload.data(), kPayload.size());
+                break;
+            case HAS_KEY_ID:
+            {
+                const std::vector<uint8_t> kKeyId{keyIdOf(context)};
+                opencdm_session_has_key_id(session, kKeyId.size(), kKeyId.data());
+                break;
+            }
+            case SELECT_KEY_ID:
+            {
+                const std::vector<uint8_t> kKeyId{keyIdOf(context)};
+                result = opencdm_session_select_key_id(session, kKeyId.size(), kKeyId.data());
+                break;
+            }
+            case SESSION_REMOVE:
+                result = opencdm_session_remove(session);
+                break;
+            case SESSION_CLOSE:
+                result = opencdm_session_close(session);
+                isClosed = true;
+                break;
+            default:
+                break;
+            }
+            addSample(samples, action.action, kCallStart);
+            countResult(result);
+        }
+
+        if (session)
+        {
+            if (0 != recorded.firstKeyStatusNs && context.waitFor([&]() { return !context.keyId.empty(); }))
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_recordedFirstKeyStatus.push_back(recorded.firstKeyStatusNs);
+                m_replayedFirstKeyStatus.push_back(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(context.firstKeyStatus - sessionStart)
+                        .count()));
+            }
+            if (!isClosed)
+            {
+                opencdm_session_close(session);
+            }
+            opencdm_destruct_session(session);
+        }
+        else
+        {
+            ++m_failures;
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        for (size_t i = 0; i < ACTION_COUNT; ++i)
+        {
+            m_samples[i].insert(m_samples[i].end(), samples[i].begin(), samples[i].end());
+        }
+    }
+
+    static void addSample(std::array<std::vector<uint64_t>, ACTION_COUNT> &samples, Action action,
+                          std::chrono::steady_clock::time_point start)
+    {
+        samples[action].push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+
+    static std::vector<uint8_t> keyIdOf(SessionContext &context)
+    {
+        std::unique_lock<std::mutex> lock{context.mutex};
+        return context.keyId.empty() ? std::vector<uint8_t>(16, 0) : context.keyId;
+    }
+
+    void countResult(OpenCDMError result)
+    {
+        if (ERROR_NONE != result)
+        {
+            ++m_failures;
+        }
+    }
+
+    void print(uint64_t durationNs)
+    {
+        std::printf("\n%-36s %10s %10s %10s %10s\n", "API", "calls", "p50 us", "p99 us", "max us");
+        for (size_t i = 0; i < ACTION_COUNT; ++i)
+        {
+            auto &samples{m_samples[i]};
+            if (samples.empty())
+            {
+                continue;
+            }
+            std::printf("%-36s %10zu %10.1f %10.1f %10.1f\n", kActionNames[i], samples.size(),
+                        percentileUs(samples, 0.5), percentileUs(samples, 0.99), percentileUs(samples, 1.0));
+        }
+        std::printf("\n%-36s %10s %10s %10s\n", "session start to first key status", "sessions", "p50 ms", "p99 ms");
+        std::printf("%-36s %10zu %10.2f %10.2f\n", "recorded", m_recordedFirstKeyStatus.size(),
+                    percentileUs(m_recordedFirstKeyStatus, 0.5) / 1000.0,
+                    percentileUs(m_recordedFirstKeyStatus, 0.99) / 1000.0);
+        std::printf("%-36s %10zu %10.2f %10.2f\n", "replayed", m_replayedFirstKeyStatus.size(),
+                    percentileUs(m_replayedFirstKeyStatus, 0.5) / 1000.0,
+                    percentileUs(m_replayedFirstKeyStatus, 0.99) / 1000.0);
+        std::printf("\nrecorded duration: %.3f s, replayed duration: %.3f s, failed calls: %lu\n",
+                    m_script.durationNs / 1e9, durationNs / 1e9, m_failures.load());
+    }
+
+private:
+    const ReplayScript &m_script;
+    std::mutex m_mutex;
+    std::array<std::vector<uint64_t>, ACTION_COUNT> m_samples;
+    std::vector<uint64_t> m_recordedFirstKeyStatus;
+    std::vector<uint64_t> m_replayedFirstKeyStatus;
+    std::atomic<uint64_t> m_failures{0};
+};
+} // namespace
+
+/**
+ * Replays a MediaKeys traffic recording (RIALTO_RECORD_PATH) against the fake Rialto client: the opencdm calls of
+ * every recorded session are made at their recorded times, and the fake answers them with the recorded statuses,
+ * call durations and notifications.
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::printf("Usage: %s <recording> [--key-system=name]\n", argv[0]);
+        return 1;
+    }
+    std::shared_ptr<const firebolt::rialto::fake::MediaKeysRecording> recording{
+        firebolt::rialto::fake::MediaKeysRecording::load(argv[1])};
+    if (!recording)
+    {
+        std::printf("%s is not a MediaKeys recording\n", argv[1]);
+        return 1;
+    }
+    ReplayScript script{createScript(*recording)};
+    for (int i = 2; i < argc; ++i)
+    {
+        if (0 == std::strncmp(argv[i], "--key-system=", 13))
+        {
+            script.keySystem = argv[i] + 13;
+        }
+    }
+    if (script.keySystem.empty())
+    {
+        std::printf("The recording does not name the key system, use --key-system\n");
+        return 1;
+    }
+
+    // Recorded call durations are reproduced with sleeps, the default 50 us timer slack would add to every call.
+    // Threads created later inherit the setting.
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    firebolt::rialto::fake::FakeRialtoConfig config;
+    config.replayRecording = recording;
+    firebolt::rialto::fake::FakeRialto::instance().configure(config);
+
+    std::printf("Replaying %zu events: %zu %s sessions, %zu application state changes, %.3f s\n",
+                recording->events.size(), script.sessions.size(), script.keySystem.c_str(),
+                script.applicationStates.size(), script.durationNs / 1e9);
+    Replay replay{script};
+    replay.run();
+    return 0;
+}
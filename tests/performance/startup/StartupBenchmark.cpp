@@ -0,0 +1,295 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeRialto.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <opencdm/open_cdm.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "OpenCdmRialtoExt.h"
+
+namespace
+{
+/**
+ * Trace points of opencdm_create_system and opencdm_is_type_supported, in call order. Phases nested in an API call
+ * are indented in the report.
+ */
+struct Phase
+{
+    const char *name;
+    bool isApiCall;
+};
+
+constexpr std::array<Phase, 8> kPhases{{{"opencdm_create_system", true},
+                                        {"logCommitId", false},
+                                        {"createCdmBackend", false},
+                                        {"createControl", false},
+                                        {"registerClient", false},
+                                        {"createMediaKeys", false},
+                                        {"opencdm_is_type_supported", true},
+                                        {"createMediaKeysCapabilities", false}}};
+
+using PhaseDurations = std::array<std::vector<uint64_t>, kPhases.size()>;
+
+struct Options
+{
+    uint32_t coldRuns{10};
+    uint32_t warmRuns{100};
+    uint32_t callLatencyUs{100};
+    uint32_t connectLatencyUs{2000};
+    std::string keySystem{"com.widevine.alpha"};
+};
+
+std::string getTracePath()
+{
+    const char *kTmpDir{getenv("TMPDIR")};
+    return std::string{kTmpDir ? kTmpDir : "/tmp"} + "/rialto-ocdm-startup-" + std::to_string(getpid()) + ".json";
+}
+
+/**
+ * Extracts the durations of the startup phases from the complete ("X") events of a trace written by the library.
+ */
+void readPhaseDurations(const std::string &path, PhaseDurations &durations)
+{
+    std::ifstream file{path};
+    const std::string kTrace{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    const std::string kNameTag{"{\"name\":\""};
+    const std::string kDurationTag{"\"dur\":"};
+    for (size_t position = kTrace.find(kNameTag); std::string::npos != position;
+         position = kTrace.find(kNameTag, position + 1))
+    {
+        const size_t kNameStart{position + kNameTag.size()};
+        const size_t kNameEnd{kTrace.find('"', kNameStart)};
+        const size_t kEventEnd{kTrace.find("}}", kNameStart)};
+        const size_t kDuration{kTrace.find(kDurationTag, kNameStart)};
+        if (std::string::npos == kNameEnd || std::string::npos == kDuration || kDuration > kEventEnd)
+        {
+            continue;
+        }
+        const std::string kName{kTrace.substr(kNameStart, kNameEnd - kNameStart)};
+        auto phaseIter{std::find_if(kPhases.begin(), kPhases.end(),
+                                    [&](const Phase &phase) { return kName == phase.name; })};
+        if (phaseIter == kPhases.end())
+        {
+            continue;
+        }
+        // Microseconds with three decimals
+        char *end{nullptr};
+        const uint64_t kMicroseconds{std::strtoull(kTrace.c_str() + kDuration + kDurationTag.size(), &end, 10)};
+        const uint64_t kNanoseconds{'.' == *end ? std::strtoull(end + 1, nullptr, 10) : 0};
+        durations[static_cast<size_t>(phaseIter - kPhases.begin())].push_back(kMicroseconds * 1000 + kNanoseconds);
+    }
+}
+
+void configureFake(const Options &options)
+{
+    firebolt::rialto::fake::FakeRialtoConfig config;
+    config.callLatency = std::chrono::microseconds{options.callLatencyUs};
+    config.connectLatency = std::chrono::microseconds{options.connectLatencyUs};
+    firebolt::rialto::fake::FakeRialto::instance().configure(config);
+}
+
+/**
+ * Creates and destroys a system and checks key system support the given number of times, with tracing enabled.
+ */
+bool runStartup(const Options &options, uint32_t runs, PhaseDurations &durations)
+{
+    const std::string kTracePath{getTracePath()};
+    if (ERROR_NONE != opencdm_ext_start_tracing(kTracePath.c_str()))
+    {
+        return false;
+    }
+    bool result{true};
+    for (uint32_t i = 0; i < runs; ++i)
+    {
+        OpenCDMSystem *system{opencdm_create_system(options.keySystem.c_str())};
+        result = result && system && ERROR_NONE == opencdm_is_type_supported(options.keySystem.c_str(), "");
+        opencdm_destruct_system(system);
+    }
+    opencdm_ext_stop_tracing();
+    readPhaseDurations(kTracePath, durations);
+    std::remove(kTracePath.c_str());
+    return result;
+}
+
+/**
+ * Runs the first calls of a process in a forked child, so that the library and fake singletons are constructed
+ * from scratch. The library is already loaded and relocated, so the dynamic linking cost is not included. The
+ * durations are sent back through a pipe as (phase index, nanoseconds) pairs.
+ */
+bool runColdStartup(const Options &options, PhaseDurations &durations)
+{
+    int fds[2];
+    if (0 != pipe(fds))
+    {
+        return false;
+    }
+    const pid_t kPid{fork()};
+    if (kPid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (0 == kPid)
+    {
+        close(fds[0]);
+        configureFake(options);
+        PhaseDurations childDurations;
+        const bool kResult{runStartup(options, 1, childDurations)};
+        for (size_t i = 0; i < childDurations.size(); ++i)
+        {
+            for (uint64_t duration : childDurations[i])
+            {
+                const uint64_t kEntry[2]{i, duration};
+                if (sizeof(kEntry) != write(fds[1], kEntry, sizeof(kEntry)))
+                {
+                    _exit(EXIT_FAILURE);
+                }
+            }
+        }
+        close(fds[1]);
+        _exit(kResult ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    uint64_t entry[2];
+    while (sizeof(entry) == read(fds[0], entry, sizeof(entry)))
+    {
+        if (entry[0] < durations.size())
+        {
+            durations[entry[0]].push_back(entry[1]);
+        }
+    }
+    close(fds[0]);
+    int status{0};
+    return kPid == waitpid(kPid, &status, 0) && WIFEXITED(status) && EXIT_SUCCESS == WEXITSTATUS(status);
+}
+
+double percentileUs(std::vector<uint64_t> samples, double fraction)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t kIndex{std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))};
+    return samples[kIndex] / 1000.0;
+}
+
+void printReport(const PhaseDurations &cold, const PhaseDurations &warm)
+{
+    std::printf("\n%-32s %12s %12s %12s %12s %12s\n", "phase", "cold p50 us", "cold max us", "warm p50 us",
+                "warm p90 us", "warm max us");
+    for (size_t i = 0; i < kPhases.size(); ++i)
+    {
+        const std::string kName{std::string{kPhases[i].isApiCall ? "" : "  "} + kPhases[i].name};
+        std::printf("%-32s %12.1f %12.1f", kName.c_str(), percentileUs(cold[i], 0.5), percentileUs(cold[i], 1.0));
+        if (warm[i].empty())
+        {
+            std::printf(" %12s %12s %12s\n", "-", "-", "-");
+            continue;
+        }
+        std::printf(" %12.1f %12.1f %12.1f\n", percentileUs(warm[i], 0.5), percentileUs(warm[i], 0.9),
+                    percentileUs(warm[i], 1.0));
+    }
+}
+
+bool parseOption(const std::string &argument, const char *name, uint32_t &value)
+{
+    const std::string kPrefix{std::string("--") + name + "="};
+    if (0 != argument.compare(0, kPrefix.size(), kPrefix))
+    {
+        return false;
+    }
+    value = static_cast<uint32_t>(std::strtoul(argument.c_str() + kPrefix.size(), nullptr, 10));
+    return true;
+}
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string kArgument{argv[i]};
+        if (parseOption(kArgument, "cold-runs", options.coldRuns) ||
+            parseOption(kArgument, "warm-runs", options.warmRuns) ||
+            parseOption(kArgument, "call-latency-us", options.callLatencyUs) ||
+            parseOption(kArgument, "connect-latency-us", options.connectLatencyUs))
+        {
+            continue;
+        }
+        if (0 == kArgument.compare(0, 13, "--key-system="))
+        {
+            options.keySystem = kArgument.substr(13);
+            continue;
+        }
+        std::printf("Usage: %s [--cold-runs=N] [--warm-runs=M] [--call-latency-us=us] [--connect-latency-us=us]\n"
+                    "       [--key-system=name]\n",
+                    argv[0]);
+        return false;
+    }
+    return options.coldRuns > 0 || options.warmRuns > 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return EXIT_FAILURE;
+    }
+    std::printf("%s: %u cold runs, %u warm runs, call latency %u us, connect latency %u us\n",
+                options.keySystem.c_str(), options.coldRuns, options.warmRuns, options.callLatencyUs,
+                options.connectLatencyUs);
+
+    // Cold runs fork, so they go first - before this process starts any library or fake threads
+    PhaseDurations cold;
+    for (uint32_t i = 0; i < options.coldRuns; ++i)
+    {
+        if (!runColdStartup(options, cold))
+        {
+            std::fprintf(stderr, "Cold startup run %u failed\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Warm runs follow a first, untimed startup in this process
+    PhaseDurations warm;
+    PhaseDurations firstRun;
+    configureFake(options);
+    if (!runStartup(options, 1, firstRun) || !runStartup(options, options.warmRuns, warm))
+    {
+        std::fprintf(stderr, "Warm startup runs failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printReport(cold, warm);
+    return EXIT_SUCCESS;
+}
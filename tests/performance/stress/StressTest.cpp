@@ -0,0 +1,468 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeRialto.h"
+#include "LockWaitCounter.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <gst/gst.h>
+#include <memory>
+#include <mutex>
+#include <opencdm/open_cdm.h>
+#include <opencdm/open_cdm_adapter.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr size_t kKeyIdSize{16};
+constexpr size_t kPayloadSize{1024};
+constexpr std::chrono::seconds kCallbackTimeout{5};
+
+enum Api : size_t
+{
+    CREATE_SYSTEM,
+    CONSTRUCT_SESSION,
+    LICENSE_REQUEST,
+    SESSION_UPDATE,
+    KEY_USABLE,
+    SESSION_STATUS,
+    GET_SYSTEM_SESSION,
+    DECRYPT,
+    RELEASE_SESSION,
+    SESSION_CLOSE,
+    DESTRUCT_SESSION,
+    DESTRUCT_SYSTEM,
+    API_COUNT
+};
+
+constexpr std::array<const char *, API_COUNT> kApiNames{
+    "opencdm_create_system",      "opencdm_construct_session",   "onLicenseRequest (from construct)",
+    "opencdm_session_update",     "onKeyUpdate (from update)",   "opencdm_session_status",
+    "opencdm_get_system_session", "decrypt_ex",                  "opencdm_destruct_session (ref)",
+    "opencdm_session_close",      "opencdm_destruct_session",    "opencdm_destruct_system"};
+
+struct Options
+{
+    uint32_t systems{2};
+    uint32_t sessions{4};
+    uint32_t decryptThreads{4};
+    uint32_t durationS{10};
+    uint32_t sessionLifetimeMs{200};
+    uint32_t callLatencyUs{100};
+    uint32_t licenseLatencyUs{2000};
+    uint32_t keyStatusLatencyUs{500};
+    std::string keySystem{"com.widevine.alpha"};
+};
+
+/**
+ * Latencies measured by one thread, merged into the report when the thread finishes.
+ */
+class LatencySamples
+{
+public:
+    void add(Api api, std::chrono::steady_clock::time_point start)
+    {
+        m_samples[api].push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+
+    void mergeInto(std::array<std::vector<uint64_t>, API_COUNT> &samples) const
+    {
+        for (size_t i = 0; i < API_COUNT; ++i)
+        {
+            samples[i].insert(samples[i].end(), m_samples[i].begin(), m_samples[i].end());
+        }
+    }
+
+private:
+    std::array<std::vector<uint64_t>, API_COUNT> m_samples;
+};
+
+class Report
+{
+public:
+    void merge(const LatencySamples &samples)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        samples.mergeInto(m_samples);
+    }
+
+    void addFailure() { ++m_failures; }
+    void addMiss() { ++m_misses; }
+
+    void print(double durationS)
+    {
+        std::printf("\n%-36s %10s %12s %10s %10s %10s %10s\n", "API", "calls", "calls/s", "p50 us", "p99 us",
+                    "p999 us", "max us");
+        for (size_t i = 0; i < API_COUNT; ++i)
+        {
+            auto &samples{m_samples[i]};
+            if (samples.empty())
+            {
+                continue;
+            }
+            std::sort(samples.begin(), samples.end());
+            std::printf("%-36s %10zu %12.1f %10.1f %10.1f %10.1f %10.1f\n", kApiNames[i], samples.size(),
+                        samples.size() / durationS, percentile(samples, 0.5), percentile(samples, 0.99),
+                        percentile(samples, 0.999), samples.back() / 1000.0);
+        }
+        std::printf("\nfailed calls: %lu, decrypts without a usable session: %lu\n", m_failures.load(),
+                    m_misses.load());
+
+        if (!LockWaitCounter::isEnabled())
+        {
+            std::printf("lock wait time: not measured in this build\n");
+            return;
+        }
+        std::printf("\n%-60s %14s %14s\n", "lock wait by module", "contended", "wait ms");
+        for (const auto &waits : LockWaitCounter::waits())
+        {
+            std::printf("%-60s %14lu %14.3f\n", waits.module.c_str(), waits.contendedLocks, waits.waitTimeNs / 1e6);
+        }
+    }
+
+private:
+    static double percentile(const std::vector<uint64_t> &sortedSamples, double fraction)
+    {
+        const size_t kIndex{std::min(sortedSamples.size() - 1, static_cast<size_t>(fraction * sortedSamples.size()))};
+        return sortedSamples[kIndex] / 1000.0;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::array<std::vector<uint64_t>, API_COUNT> m_samples;
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_misses{0};
+};
+
+/**
+ * Callback state of one session, passed to the library as user data.
+ */
+struct SessionContext
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool hasLicenseRequest{false};
+    bool isKeyUsable{false};
+
+    template <typename Predicate> bool waitFor(Predicate predicate)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        return cv.wait_for(lock, kCallbackTimeout, predicate);
+    }
+};
+
+void onProcessChallenge(OpenCDMSession *, void *userData, const char[], const uint8_t[], const uint16_t)
+{
+    auto *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    context->hasLicenseRequest = true;
+    context->cv.notify_all();
+}
+
+void onKeyUpdate(OpenCDMSession *, void *userData, const uint8_t[], const uint8_t)
+{
+    auto *context{static_cast<SessionContext *>(userData)};
+    std::unique_lock<std::mutex> lock{context->mutex};
+    context->isKeyUsable = true;
+    context->cv.notify_all();
+}
+
+void onErrorMessage(OpenCDMSession *, void *, const char[]) {}
+void onKeysUpdated(const OpenCDMSession *, void *) {}
+OpenCDMSessionCallbacks gCallbacks{onProcessChallenge, onKeyUpdate, onErrorMessage, onKeysUpdated};
+
+std::array<uint8_t, kKeyIdSize> toKeyId(uint64_t value)
+{
+    std::array<uint8_t, kKeyIdSize> keyId{};
+    std::memcpy(keyId.data() + kKeyIdSize - sizeof(value), &value, sizeof(value));
+    return keyId;
+}
+
+/**
+ * Slots holding the key ID (as a counter value, 0 when empty) of every usable session of one system. Written by
+ * the session threads, read by the decrypt threads.
+ */
+struct SystemState
+{
+    OpenCDMSystem *system{nullptr};
+    std::vector<std::atomic<uint64_t>> usableKeys;
+};
+
+class StressTest
+{
+public:
+    explicit StressTest(const Options &options) : m_options{options}, m_systems(options.systems)
+    {
+        const std::array<uint8_t, 16> kIv{};
+        const std::array<uint8_t, 6> kSubSample{0x00, 0x10, 0x00, 0x00, 0x03, 0xf0};
+        m_iv = createBuffer(kIv.data(), kIv.size());
+        m_subSamples = createBuffer(kSubSample.data(), kSubSample.size());
+    }
+
+    ~StressTest()
+    {
+        gst_buffer_unref(m_iv);
+        gst_buffer_unref(m_subSamples);
+    }
+
+    void run()
+    {
+        LatencySamples mainSamples;
+        for (auto &systemState : m_systems)
+        {
+            const auto kStart{std::chrono::steady_clock::now()};
+            systemState.system = opencdm_create_system(m_options.keySystem.c_str());
+            mainSamples.add(CREATE_SYSTEM, kStart);
+            systemState.usableKeys = std::vector<std::atomic<uint64_t>>(m_options.sessions);
+        }
+
+        std::vector<std::thread> threads;
+        for (uint32_t system = 0; system < m_options.systems; ++system)
+        {
+            for (uint32_t session = 0; session < m_options.sessions; ++session)
+            {
+                threads.emplace_back(&StressTest::sessionLoop, this, std::ref(m_systems[system]), session);
+            }
+            for (uint32_t thread = 0; thread < m_options.decryptThreads; ++thread)
+            {
+                threads.emplace_back(&StressTest::decryptLoop, this, std::ref(m_systems[system]),
+                                     system * m_options.decryptThreads + thread);
+            }
+        }
+
+        const auto kStart{std::chrono::steady_clock::now()};
+        std::this_thread::sleep_for(std::chrono::seconds{m_options.durationS});
+        m_isRunning = false;
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        const double kDurationS{std::chrono::duration<double>(std::chrono::steady_clock::now() - kStart).count()};
+
+        for (auto &systemState : m_systems)
+        {
+            const auto kDestructStart{std::chrono::steady_clock::now()};
+            opencdm_destruct_system(systemState.system);
+            mainSamples.add(DESTRUCT_SYSTEM, kDestructStart);
+        }
+        m_report.merge(mainSamples);
+        m_report.print(kDurationS);
+    }
+
+private:
+    static GstBuffer *createBuffer(const uint8_t *data, size_t size)
+    {
+        GstBuffer *buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+        gst_buffer_fill(buffer, 0, data, size);
+        return buffer;
+    }
+
+    void sessionLoop(SystemState &systemState, uint32_t slot)
+    {
+        LatencySamples samples;
+        const std::vector<uint8_t> kInitData(64, static_cast<uint8_t>(slot));
+        while (m_isRunning)
+        {
+            const uint64_t kKeyValue{++m_lastKeyValue};
+            const auto kKeyId{toKeyId(kKeyValue)};
+            SessionContext context;
+            OpenCDMSession *session{nullptr};
+
+            auto start{std::chrono::steady_clock::now()};
+            if (ERROR_NONE != opencdm_construct_session(systemState.system, Temporary, "cenc", kInitData.data(),
+                                                        kInitData.size(), nullptr, 0, &gCallbacks, &context, &session))
+            {
+                m_report.addFailure();
+                std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                continue;
+            }
+            samples.add(CONSTRUCT_SESSION, start);
+            if (context.waitFor([&]() { return context.hasLicenseRequest; }))
+            {
+                samples.add(LICENSE_REQUEST, start);
+            }
+            else
+            {
+                m_report.addFailure();
+            }
+
+            start = std::chrono::steady_clock::now();
+            if (ERROR_NONE != opencdm_session_update(session, kKeyId.data(), kKeyId.size()))
+            {
+                m_report.addFailure();
+            }
+            samples.add(SESSION_UPDATE, start);
+            if (context.waitFor([&]() { return context.isKeyUsable; }))
+            {
+                samples.add(KEY_USABLE, start);
+            }
+            else
+            {
+                m_report.addFailure();
+            }
+
+            start = std::chrono::steady_clock::now();
+            if (Usable != opencdm_session_status(session, kKeyId.data(), kKeyId.size()))
+            {
+                m_report.addFailure();
+            }
+            samples.add(SESSION_STATUS, start);
+
+            systemState.usableKeys[slot] = kKeyValue;
+            std::this_thread::sleep_for(std::chrono::milliseconds{m_options.sessionLifetimeMs});
+            systemState.usableKeys[slot] = 0;
+
+            start = std::chrono::steady_clock::now();
+            opencdm_session_close(session);
+            samples.add(SESSION_CLOSE, start);
+            start = std::chrono::steady_clock::now();
+            opencdm_destruct_session(session);
+            samples.add(DESTRUCT_SESSION, start);
+        }
+        m_report.merge(samples);
+    }
+
+    void decryptLoop(SystemState &systemState, uint32_t seed)
+    {
+        LatencySamples samples;
+        std::minstd_rand random{seed};
+        GstBuffer *keyIdBuffer = gst_buffer_new();
+        while (m_isRunning)
+        {
+            const uint64_t kKeyValue{systemState.usableKeys[random() % systemState.usableKeys.size()]};
+            if (0 == kKeyValue)
+            {
+                m_report.addMiss();
+                std::this_thread::yield();
+                continue;
+            }
+            const auto kKeyId{toKeyId(kKeyValue)};
+
+            auto start{std::chrono::steady_clock::now()};
+            OpenCDMSession *session{opencdm_get_system_session(systemState.system, kKeyId.data(), kKeyId.size(), 0)};
+            samples.add(GET_SYSTEM_SESSION, start);
+            if (!session)
+            {
+                m_report.addMiss();
+                continue;
+            }
+
+            GstBuffer *buffer = gst_buffer_new_allocate(nullptr, kPayloadSize, nullptr);
+            start = std::chrono::steady_clock::now();
+            if (ERROR_NONE != opencdm_gstreamer_session_decrypt_ex(session, buffer, m_subSamples, 1, m_iv,
+                                                                   keyIdBuffer, 0, nullptr))
+            {
+                m_report.addFailure();
+            }
+            samples.add(DECRYPT, start);
+            gst_buffer_unref(buffer);
+
+            start = std::chrono::steady_clock::now();
+            opencdm_destruct_session(session);
+            samples.add(RELEASE_SESSION, start);
+        }
+        gst_buffer_unref(keyIdBuffer);
+        m_report.merge(samples);
+    }
+
+private:
+    const Options m_options;
+    std::vector<SystemState> m_systems;
+    std::atomic<bool> m_isRunning{true};
+    std::atomic<uint64_t> m_lastKeyValue{0};
+    GstBuffer *m_iv;
+    GstBuffer *m_subSamples;
+    Report m_report;
+};
+
+bool parseOption(const std::string &argument, const char *name, uint32_t &value)
+{
+    const std::string kPrefix{std::string("--") + name + "="};
+    if (0 != argument.compare(0, kPrefix.size(), kPrefix))
+    {
+        return false;
+    }
+    value = static_cast<uint32_t>(std::strtoul(argument.c_str() + kPrefix.size(), nullptr, 10));
+    return true;
+}
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string kArgument{argv[i]};
+        if (parseOption(kArgument, "systems", options.systems) ||
+            parseOption(kArgument, "sessions", options.sessions) ||
+            parseOption(kArgument, "decrypt-threads", options.decryptThreads) ||
+            parseOption(kArgument, "duration", options.durationS) ||
+            parseOption(kArgument, "session-lifetime-ms", options.sessionLifetimeMs) ||
+            parseOption(kArgument, "call-latency-us", options.callLatencyUs) ||
+            parseOption(kArgument, "license-latency-us", options.licenseLatencyUs) ||
+            parseOption(kArgument, "key-status-latency-us", options.keyStatusLatencyUs))
+        {
+            continue;
+        }
+        if (0 == kArgument.compare(0, 13, "--key-system="))
+        {
+            options.keySystem = kArgument.substr(13);
+            continue;
+        }
+        std::printf("Usage: %s [--systems=N] [--sessions=M] [--decrypt-threads=K] [--duration=seconds]\n"
+                    "       [--session-lifetime-ms=ms] [--call-latency-us=us] [--license-latency-us=us]\n"
+                    "       [--key-status-latency-us=us] [--key-system=name]\n",
+                    argv[0]);
+        return false;
+    }
+    return options.systems > 0 && options.sessions > 0;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+    gst_init(&argc, &argv);
+
+    firebolt::rialto::fake::FakeRialtoConfig config;
+    config.callLatency = std::chrono::microseconds{options.callLatencyUs};
+    config.licenseRequestLatency = std::chrono::microseconds{options.licenseLatencyUs};
+    config.keyStatusLatency = std::chrono::microseconds{options.keyStatusLatencyUs};
+    firebolt::rialto::fake::FakeRialto::instance().configure(config);
+
+    std::printf("%u systems x %u sessions x %u decrypt threads for %u s, call latency %u us, license latency %u us\n",
+                options.systems, options.sessions, options.decryptThreads, options.durationS, options.callLatencyUs,
+                options.licenseLatencyUs);
+    StressTest stressTest{options};
+    stressTest.run();
+    return 0;
+}
@@ -20,22 +20,30 @@
 #include "ActiveSessions.h"
 #include "CdmBackendMock.h"
 #include "MessageDispatcherMock.h"
+#include "Metrics.h"
 #include "OcdmSessionsCallbacksMock.h"
 #include "OpenCDMSessionPrivate.h"
 #include <MediaCommon.h>
+#include <MessageDispatcherClientMock.h>
 #include <gtest/gtest.h>
 
 using testing::_;
+using testing::Return;
+using testing::StrEq;
 using testing::StrictMock;
 
 namespace
 {
+const std::string kKeySystem{"com.microsoft.playready"};
 constexpr LicenseType kSessionType{LicenseType::Temporary};
 constexpr void *kContext{nullptr};
 const std::string kInitDataType{"drmheader"};
 const std::vector<uint8_t> kInitData{4, 3, 2, 1};
 const std::vector<uint8_t> kKeyId{1, 2, 3, 4};
 const firebolt::rialto::KeyStatusVector kKeyStatusVec{std::make_pair(kKeyId, firebolt::rialto::KeyStatus::USABLE)};
+constexpr int32_t kKeySessionId{5};
+const std::vector<uint8_t> kChallenge{7, 8, 9};
+const std::string kUrl{"http://license.server"};
 } // namespace
 
 class ActiveSessionsTests : public testing::Test
@@ -44,10 +52,43 @@ public:
     ActiveSessionsTests() = default;
     ~ActiveSessionsTests() override
     {
+        ActiveSessions::setSessionSharingEnabled(false);
         testing::Mock::VerifyAndClearExpectations(&OcdmSessionsCallbacksMock::instance());
     }
 
+    OpenCDMSession *createSharedSession(void *context)
+    {
+        return ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
+                                                 &m_callbacks, context, kInitDataType, kInitData);
+    }
+
+    OpenCDMSession *createSharedSessionWithRequest()
+    {
+        ActiveSessions::setSessionSharingEnabled(true);
+        OpenCDMSession *session{createSharedSession(&m_ownerContext)};
+        EXPECT_CALL(*m_cdmBackendMock,
+                    createKeySessionAsync(firebolt::rialto::KeySessionType::TEMPORARY, false, _, _))
+            .WillOnce(completeKeySessionCreation(true, kKeySessionId));
+        EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+            .WillOnce(
+                [this](IMessageDispatcherListener *listener)
+                {
+                    m_sharedSession = listener;
+                    return std::make_unique<StrictMock<MessageDispatcherClientMock>>();
+                });
+        EXPECT_CALL(*m_cdmBackendMock,
+                    generateRequest(kKeySessionId, firebolt::rialto::InitDataType::DRMHEADER, kInitData))
+            .WillOnce(Return(true));
+        EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+        EXPECT_TRUE(session->initialize());
+        EXPECT_TRUE(session->generateRequest(kInitDataType, kInitData, {}));
+        return session;
+    }
+
 protected:
+    int m_ownerContext{1};
+    int m_attachedContext{2};
+    IMessageDispatcherListener *m_sharedSession{nullptr};
     std::shared_ptr<StrictMock<CdmBackendMock>> m_cdmBackendMock{std::make_shared<StrictMock<CdmBackendMock>>()};
     std::shared_ptr<StrictMock<MessageDispatcherMock>> m_messageDispatcherMock{
         std::make_shared<StrictMock<MessageDispatcherMock>>()};
@@ -57,27 +98,29 @@ protected:
 
 TEST_F(ActiveSessionsTests, GetShouldReturnNullWhenSessionIsNotPresent)
 {
-    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId));
+    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId.data(), kKeyId.size()));
 }
 
 TEST_F(ActiveSessionsTests, ShouldCreateSessionGetShouldFailForUknownKey)
 {
-    OpenCDMSession *session = ActiveSessions::instance().create(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
-                                                                &m_callbacks, kContext, kInitDataType, kInitData);
-    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId));
+    OpenCDMSession *session = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                                kSessionType, &m_callbacks, kContext, kInitDataType,
+                                                                kInitData);
+    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId.data(), kKeyId.size()));
     ActiveSessions::instance().remove(session);
 }
 
 TEST_F(ActiveSessionsTests, ShouldCreateSessionGetShouldSucceed)
 {
-    OpenCDMSession *session = ActiveSessions::instance().create(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
-                                                                &m_callbacks, kContext, kInitDataType, kInitData);
+    OpenCDMSession *session = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                                kSessionType, &m_callbacks, kContext, kInitDataType,
+                                                                kInitData);
     OpenCDMSessionPrivate *sessionPriv = dynamic_cast<OpenCDMSessionPrivate *>(session);
     ASSERT_NE(nullptr, sessionPriv);
     EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keyUpdateCallback(session, kContext, _, kInitData.size()));
     EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keysUpdatedCallback(session, kContext));
     sessionPriv->onKeyStatusesChanged(firebolt::rialto::kInvalidSessionId, kKeyStatusVec);
-    auto *gotSession = ActiveSessions::instance().get(kKeyId);
+    auto *gotSession = ActiveSessions::instance().get(kKeyId.data(), kKeyId.size());
     EXPECT_EQ(session, gotSession);
     ActiveSessions::instance().remove(gotSession);
     ActiveSessions::instance().remove(session);
@@ -85,19 +128,188 @@ TEST_F(ActiveSessionsTests, ShouldCreateSessionGetShouldSucceed)
 
 TEST_F(ActiveSessionsTests, SessionShouldExistUntilLastInstanceIsRemoved)
 {
-    OpenCDMSession *session = ActiveSessions::instance().create(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
-                                                                &m_callbacks, kContext, kInitDataType, kInitData);
+    OpenCDMSession *session = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                                kSessionType, &m_callbacks, kContext, kInitDataType,
+                                                                kInitData);
     OpenCDMSessionPrivate *sessionPriv = dynamic_cast<OpenCDMSessionPrivate *>(session);
     ASSERT_NE(nullptr, sessionPriv);
     EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keyUpdateCallback(session, kContext, _, kInitData.size()));
     EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keysUpdatedCallback(session, kContext));
     sessionPriv->onKeyStatusesChanged(firebolt::rialto::kInvalidSessionId, kKeyStatusVec);
-    auto *gotSession = ActiveSessions::instance().get(kKeyId);
+    auto *gotSession = ActiveSessions::instance().get(kKeyId.data(), kKeyId.size());
     EXPECT_EQ(session, gotSession);
     ActiveSessions::instance().remove(session);
-    auto *gotSession2 = ActiveSessions::instance().get(kKeyId);
+    auto *gotSession2 = ActiveSessions::instance().get(kKeyId.data(), kKeyId.size());
     EXPECT_EQ(gotSession, gotSession2);
     ActiveSessions::instance().remove(gotSession);
     ActiveSessions::instance().remove(gotSession2);
-    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId));
+    EXPECT_EQ(nullptr, ActiveSessions::instance().get(kKeyId.data(), kKeyId.size()));
+}
+
+TEST_F(ActiveSessionsTests, GetShouldReturnSessionExpectingKeyFromInitData)
+{
+    OpenCDMSession *session = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                                kSessionType, &m_callbacks, kContext, "webm", kKeyId);
+    EXPECT_EQ(StatusPending, session->status(kKeyId.data(), kKeyId.size()));
+    auto *gotSession = ActiveSessions::instance().get(kKeyId.data(), kKeyId.size());
+    EXPECT_EQ(session, gotSession);
+    ActiveSessions::instance().remove(gotSession);
+    ActiveSessions::instance().remove(session);
+}
+
+TEST_F(ActiveSessionsTests, GetShouldPreferSessionWithLicenseForKey)
+{
+    OpenCDMSession *pendingSession = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock,
+                                                                       m_messageDispatcherMock, kSessionType,
+                                                                       &m_callbacks, kContext, "webm", kKeyId);
+    OpenCDMSession *session = ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                                kSessionType, &m_callbacks, kContext, "webm", kKeyId);
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keyUpdateCallback(session, kContext, _, kKeyId.size()));
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keysUpdatedCallback(session, kContext));
+    dynamic_cast<OpenCDMSessionPrivate *>(session)->onKeyStatusesChanged(firebolt::rialto::kInvalidSessionId,
+                                                                         kKeyStatusVec);
+    auto *gotSession = ActiveSessions::instance().get(kKeyId.data(), kKeyId.size());
+    EXPECT_EQ(session, gotSession);
+    ActiveSessions::instance().remove(gotSession);
+    ActiveSessions::instance().remove(session);
+    ActiveSessions::instance().remove(pendingSession);
+}
+
+TEST_F(ActiveSessionsTests, ShouldShareKeySessionOfSessionWithSameInitData)
+{
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    ASSERT_NE(nullptr, m_sharedSession);
+    const uint64_t kActiveSessions{Metrics::instance().get(MetricId::ACTIVE_SESSIONS)};
+    const uint64_t kAttaches{Metrics::instance().get(MetricId::SHARED_SESSION_ATTACHES)};
+
+    // No key session or request of its own
+    OpenCDMSession *attached{createSharedSession(&m_attachedContext)};
+    EXPECT_NE(owner, attached);
+    EXPECT_TRUE(attached->initialize());
+    EXPECT_TRUE(attached->generateRequest(kInitDataType, kInitData, {}));
+    EXPECT_EQ(kActiveSessions, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+    EXPECT_EQ(kAttaches + 1, Metrics::instance().get(MetricId::SHARED_SESSION_ATTACHES));
+
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keyUpdateCallback(owner, &m_ownerContext, _, kKeyId.size()));
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keysUpdatedCallback(owner, &m_ownerContext));
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(),
+                keyUpdateCallback(attached, &m_attachedContext, _, kKeyId.size()));
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(), keysUpdatedCallback(attached, &m_attachedContext));
+    m_sharedSession->onKeyStatusesChanged(kKeySessionId, kKeyStatusVec);
+    EXPECT_EQ(KeyStatus::Usable, attached->status(kKeyId.data(), kKeyId.size()));
+
+    // The key session is closed with the last session using it
+    EXPECT_TRUE(owner->closeSession());
+    ActiveSessions::instance().remove(owner);
+    EXPECT_CALL(*m_cdmBackendMock, closeKeySession(kKeySessionId)).WillOnce(Return(true));
+    EXPECT_TRUE(attached->closeSession());
+    ActiveSessions::instance().remove(attached);
+    EXPECT_EQ(kActiveSessions - 1, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+}
+
+TEST_F(ActiveSessionsTests, ShouldNotShareKeySessionOfSessionWithDifferentInitData)
+{
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    const uint64_t kActiveSessions{Metrics::instance().get(MetricId::ACTIVE_SESSIONS)};
+    const uint64_t kAttaches{Metrics::instance().get(MetricId::SHARED_SESSION_ATTACHES)};
+
+    // Same size, different bytes
+    const std::vector<uint8_t> kOtherInitData{4, 3, 2, 2};
+    OpenCDMSession *other{ActiveSessions::instance().create(kKeySystem, m_cdmBackendMock, m_messageDispatcherMock,
+                                                            kSessionType, &m_callbacks, &m_attachedContext,
+                                                            kInitDataType, kOtherInitData)};
+    EXPECT_EQ(kActiveSessions + 1, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+    EXPECT_EQ(kAttaches, Metrics::instance().get(MetricId::SHARED_SESSION_ATTACHES));
+
+    ActiveSessions::instance().remove(other);
+    ActiveSessions::instance().remove(owner);
+}
+
+TEST_F(ActiveSessionsTests, ShouldPassChallengeToAttachedSession)
+{
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    ASSERT_NE(nullptr, m_sharedSession);
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(),
+                processChallengeCallback(owner, &m_ownerContext, StrEq(kUrl), _, kChallenge.size()));
+    m_sharedSession->onLicenseRequest(kKeySessionId, kChallenge, kUrl);
+
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(),
+                processChallengeCallback(_, &m_attachedContext, StrEq(kUrl), _, kChallenge.size()));
+    OpenCDMSession *attached{createSharedSession(&m_attachedContext)};
+    std::vector<uint8_t> challengeData;
+    EXPECT_TRUE(attached->getChallengeData(challengeData));
+    EXPECT_EQ(kChallenge, challengeData);
+
+    ActiveSessions::instance().remove(attached);
+    ActiveSessions::instance().remove(owner);
+}
+
+TEST_F(ActiveSessionsTests, ShouldApplyLicenseOnceForSharedSessions)
+{
+    const std::vector<uint8_t> kLicense{5, 6, 7};
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    OpenCDMSession *attached{createSharedSession(&m_attachedContext)};
+
+    // Applied by the owner, the attached session's update is not passed on
+    EXPECT_TRUE(attached->updateSession(kLicense));
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kKeySessionId, kLicense)).WillOnce(Return(true));
+    EXPECT_TRUE(owner->updateSession(kLicense));
+
+    // Applied by the session left after the owner was closed
+    EXPECT_TRUE(owner->closeSession());
+    ActiveSessions::instance().remove(owner);
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kKeySessionId, kLicense)).WillOnce(Return(true));
+    EXPECT_TRUE(attached->updateSession(kLicense));
+
+    EXPECT_CALL(*m_cdmBackendMock, closeKeySession(kKeySessionId)).WillOnce(Return(true));
+    EXPECT_TRUE(attached->closeSession());
+    ActiveSessions::instance().remove(attached);
+}
+
+TEST_F(ActiveSessionsTests, ShouldRemoveLicenseOnlyForLastSharedSession)
+{
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    OpenCDMSession *attached{createSharedSession(&m_attachedContext)};
+    EXPECT_FALSE(owner->removeSession());
+    EXPECT_FALSE(attached->removeSession());
+
+    EXPECT_TRUE(owner->closeSession());
+    ActiveSessions::instance().remove(owner);
+    EXPECT_CALL(*m_cdmBackendMock, removeKeySession(kKeySessionId)).WillOnce(Return(true));
+    EXPECT_TRUE(attached->removeSession());
+
+    EXPECT_CALL(*m_cdmBackendMock, closeKeySession(kKeySessionId)).WillOnce(Return(true));
+    EXPECT_TRUE(attached->closeSession());
+    ActiveSessions::instance().remove(attached);
+}
+
+TEST_F(ActiveSessionsTests, ShouldWaitForChallengeInAttachedSessionAfterCancellation)
+{
+    const auto kDefaultTimeout{OpenCDMSessionPrivate::getChallengeTimeout()};
+    OpenCDMSessionPrivate::setChallengeTimeout(std::chrono::milliseconds{10});
+    OpenCDMSession *owner{createSharedSessionWithRequest()};
+    OpenCDMSession *attached{createSharedSession(&m_attachedContext)};
+    attached->cancelChallengeData();
+    const uint64_t kTimeouts{Metrics::instance().get(MetricId::CHALLENGE_TIMEOUTS)};
+
+    // The earlier cancellation does not end the wait
+    std::vector<uint8_t> challengeData;
+    EXPECT_FALSE(attached->getChallengeData(challengeData));
+    EXPECT_EQ(kTimeouts + 1, Metrics::instance().get(MetricId::CHALLENGE_TIMEOUTS));
+
+    ActiveSessions::instance().remove(attached);
+    ActiveSessions::instance().remove(owner);
+    OpenCDMSessionPrivate::setChallengeTimeout(kDefaultTimeout);
+}
+
+TEST_F(ActiveSessionsTests, ShouldNotShareSessionBeforeRequestIsGenerated)
+{
+    ActiveSessions::setSessionSharingEnabled(true);
+    const uint64_t kActiveSessions{Metrics::instance().get(MetricId::ACTIVE_SESSIONS)};
+    OpenCDMSession *first{createSharedSession(&m_ownerContext)};
+    OpenCDMSession *second{createSharedSession(&m_attachedContext)};
+    EXPECT_EQ(kActiveSessions + 2, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+    ActiveSessions::instance().remove(first);
+    ActiveSessions::instance().remove(second);
+    EXPECT_EQ(kActiveSessions, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
 }
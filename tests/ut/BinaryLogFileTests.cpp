@@ -0,0 +1,247 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinaryLogFile.h"
+#include "Logger.h"
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+const char *kRialtoDebugEnvVarName{"RIALTO_DEBUG"};
+const char *kRialtoConsoleLogEnvVarName{"RIALTO_CONSOLE_LOG"};
+const char *kRialtoLogPathEnvVarName{"RIALTO_LOG_PATH"};
+const char *kRialtoLogFormatEnvVarName{"RIALTO_LOG_FORMAT"};
+const char *kLogFilename{"test_binary.log"};
+
+struct DecodedEntry
+{
+    std::string component;
+    std::string format;
+    uint8_t severity;
+    std::vector<uint8_t> args;
+};
+
+struct DecodedLog
+{
+    bool isValid{false};
+    std::map<uint32_t, std::string> strings;
+    std::vector<DecodedEntry> entries;
+};
+
+DecodedLog readBinaryLogFile()
+{
+    DecodedLog result;
+    std::ifstream file{std::string(kLogFilename) + binarylog::kFileSuffix, std::ios::binary};
+    EXPECT_TRUE(file.is_open());
+    const std::vector<uint8_t> kData{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    binarylog::BinaryLogFileHeader fileHeader{};
+    if (kData.size() < sizeof(fileHeader))
+    {
+        return result;
+    }
+    std::memcpy(&fileHeader, kData.data(), sizeof(fileHeader));
+    result.isValid = 0 == std::memcmp(fileHeader.magic, binarylog::kMagic, sizeof(fileHeader.magic));
+
+    size_t offset{fileHeader.headerSize};
+    while (offset + sizeof(binarylog::BinaryLogRecordHeader) <= kData.size())
+    {
+        binarylog::BinaryLogRecordHeader header{};
+        std::memcpy(&header, kData.data() + offset, sizeof(header));
+        if (binarylog::kEnd == header.type)
+        {
+            break;
+        }
+        const uint8_t *body{kData.data() + offset + sizeof(header)};
+        const size_t kBodySize{header.size - sizeof(header)};
+        if (binarylog::kStringDefinition == header.type)
+        {
+            binarylog::StringDefinition definition{};
+            std::memcpy(&definition, body, sizeof(definition));
+            result.strings[definition.id] =
+                std::string(reinterpret_cast<const char *>(body + sizeof(definition)), definition.length);
+        }
+        else if (binarylog::kLogEntry == header.type)
+        {
+            binarylog::LogEntry entry{};
+            std::memcpy(&entry, body, sizeof(entry));
+            result.entries.push_back(DecodedEntry{result.strings[entry.componentId], result.strings[entry.formatId],
+                                                  entry.severity,
+                                                  std::vector<uint8_t>(body + sizeof(entry), body + kBodySize)});
+        }
+        offset += header.size;
+    }
+    return result;
+}
+} // namespace
+
+class BinaryLogFileTests : public testing::Test
+{
+public:
+    BinaryLogFileTests()
+    {
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        unsetenv(kRialtoConsoleLogEnvVarName);
+        setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+        setenv(kRialtoLogFormatEnvVarName, "binary", 1);
+        LogFile::instance().reset();
+        BinaryLogFile::instance().reset();
+    }
+
+    ~BinaryLogFileTests() override
+    {
+        // Restore default env var values
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        setenv(kRialtoConsoleLogEnvVarName, "1", 1);
+        unsetenv(kRialtoLogPathEnvVarName);
+        unsetenv(kRialtoLogFormatEnvVarName);
+        LogFile::instance().reset();
+        BinaryLogFile::instance().reset();
+    }
+
+    void closeLogFile()
+    {
+        unsetenv(kRialtoLogPathEnvVarName);
+        BinaryLogFile::instance().reset();
+    }
+};
+
+TEST_F(BinaryLogFileTests, ShouldBeEnabledOnlyInBinaryFormat)
+{
+    EXPECT_TRUE(BinaryLogFile::instance().isEnabled());
+    EXPECT_FALSE(LogFile::instance().isEnabled());
+
+    unsetenv(kRialtoLogFormatEnvVarName);
+    BinaryLogFile::instance().reset();
+    EXPECT_FALSE(BinaryLogFile::instance().isEnabled());
+}
+
+TEST_F(BinaryLogFileTests, ShouldWriteLogEntries)
+{
+    Logger log{"Test"};
+    log << error << RIALTO_LOG_LITERAL("error");
+    log << debug << RIALTO_LOG_LITERAL("debug");
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    EXPECT_TRUE(decodedLog.isValid);
+    ASSERT_EQ(decodedLog.entries.size(), 2u);
+    EXPECT_EQ(decodedLog.entries[0].component, "Test");
+    EXPECT_EQ(decodedLog.entries[0].format, "error");
+    EXPECT_EQ(decodedLog.entries[0].severity, Severity::error);
+    EXPECT_TRUE(decodedLog.entries[0].args.empty());
+    EXPECT_EQ(decodedLog.entries[1].format, "debug");
+    EXPECT_EQ(decodedLog.entries[1].severity, Severity::debug);
+}
+
+TEST_F(BinaryLogFileTests, ShouldNotWriteFilteredLogEntries)
+{
+    setenv(kRialtoDebugEnvVarName, "1", 1);
+    LogLevels::instance().reload();
+    Logger log{"Test"};
+    log << error << "error";
+    log << warn << "warn";
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    ASSERT_EQ(decodedLog.entries.size(), 1u);
+    EXPECT_EQ(decodedLog.entries[0].severity, Severity::error);
+}
+
+TEST_F(BinaryLogFileTests, ShouldStoreDynamicArgumentsRaw)
+{
+    Logger log{"Test"};
+    const std::string kText{"text"};
+    log << info << RIALTO_LOG_LITERAL("value: ") << 42 << RIALTO_LOG_LITERAL(", text: ") << kText;
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    ASSERT_EQ(decodedLog.entries.size(), 1u);
+    EXPECT_EQ(decodedLog.entries[0].format,
+              std::string("value: ") + binarylog::kPlaceholder + ", text: " + binarylog::kPlaceholder);
+
+    const std::vector<uint8_t> &kArgs{decodedLog.entries[0].args};
+    ASSERT_EQ(kArgs.size(), 1 + sizeof(int64_t) + 1 + sizeof(uint16_t) + kText.size());
+    EXPECT_EQ(kArgs[0], binarylog::kSigned);
+    int64_t value{0};
+    std::memcpy(&value, &kArgs[1], sizeof(value));
+    EXPECT_EQ(value, 42);
+    EXPECT_EQ(kArgs[1 + sizeof(int64_t)], binarylog::kString);
+    EXPECT_EQ(std::string(kArgs.end() - kText.size(), kArgs.end()), kText);
+}
+
+TEST_F(BinaryLogFileTests, ShouldCopyCharacterArrays)
+{
+    Logger log{"Test"};
+    char text[8]{};
+    for (const char *kValue : {"first", "second"})
+    {
+        std::strncpy(text, kValue, sizeof(text) - 1);
+        log << info << text;
+    }
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    ASSERT_EQ(decodedLog.entries.size(), 2u);
+    EXPECT_EQ(decodedLog.entries[0].format, std::string(1, binarylog::kPlaceholder));
+    const std::vector<uint8_t> &kFirstArgs{decodedLog.entries[0].args};
+    ASSERT_EQ(kFirstArgs.size(), 1 + sizeof(uint16_t) + std::strlen("first"));
+    EXPECT_EQ(kFirstArgs[0], binarylog::kString);
+    EXPECT_EQ(std::string(kFirstArgs.begin() + 1 + sizeof(uint16_t), kFirstArgs.end()), "first");
+    const std::vector<uint8_t> &kSecondArgs{decodedLog.entries[1].args};
+    EXPECT_EQ(std::string(kSecondArgs.begin() + 1 + sizeof(uint16_t), kSecondArgs.end()), "second");
+}
+
+TEST_F(BinaryLogFileTests, ShouldDefineFormatOncePerCallSite)
+{
+    Logger log{"Test"};
+    for (int i = 0; i < 3; ++i)
+    {
+        log << info << "iteration " << i;
+    }
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    EXPECT_EQ(decodedLog.entries.size(), 3u);
+    // One definition for the component name and one for the format
+    EXPECT_EQ(decodedLog.strings.size(), 2u);
+}
+
+TEST_F(BinaryLogFileTests, ShouldWriteFormattedLogEntries)
+{
+    Logger log{"Test"};
+    RIALTO_LOG_FMT(log, info, "value: {}, function: {}, braces: {{}}", 42, __func__);
+    closeLogFile();
+
+    DecodedLog decodedLog{readBinaryLogFile()};
+    ASSERT_EQ(decodedLog.entries.size(), 1u);
+    EXPECT_EQ(decodedLog.entries[0].format, std::string("value: ") + binarylog::kPlaceholder +
+                                                ", function: " + binarylog::kPlaceholder + ", braces: {}");
+    const std::vector<uint8_t> &kArgs{decodedLog.entries[0].args};
+    ASSERT_EQ(kArgs.size(), 1 + sizeof(int64_t) + 1 + sizeof(uint16_t) + std::strlen(__func__));
+    EXPECT_EQ(kArgs[0], binarylog::kSigned);
+    EXPECT_EQ(kArgs[1 + sizeof(int64_t)], binarylog::kString);
+}
@@ -18,14 +18,24 @@
  */
 
 #include "CdmBackend.h"
-#include "MediaKeysClientMock.h"
 #include "MediaKeysMock.h"
+#include "MessageDispatcherListenerMock.h"
+#include "Metrics.h"
+#include <map>
+#include <chrono>
+#include <future>
 #include <gtest/gtest.h>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using firebolt::rialto::MediaKeysFactoryMock;
 using testing::_;
 using testing::ByMove;
+using testing::DoAll;
+using testing::InvokeWithoutArgs;
 using testing::Return;
+using testing::SetArgReferee;
 using testing::StrictMock;
 
 namespace
@@ -35,7 +45,11 @@ const std::vector<uint8_t> kBytes{1, 2, 3, 4};
 constexpr int32_t kKeySessionId{17};
 constexpr firebolt::rialto::KeySessionType kSessionType{firebolt::rialto::KeySessionType::TEMPORARY};
 constexpr bool kIsLDL{true};
+constexpr SessionPriority kPriority{SessionPriority::FOREGROUND};
 constexpr firebolt::rialto::InitDataType kInitDataType{firebolt::rialto::InitDataType::DRMHEADER};
+constexpr std::chrono::seconds kPoolRefillWait{1};
+constexpr std::chrono::milliseconds kLdlAdmissionTimeout{50};
+constexpr uint32_t kLdlLimit{1};
 } // namespace
 
 class CdmBackendTests : public testing::Test
@@ -44,6 +58,26 @@ public:
     CdmBackendTests() = default;
     ~CdmBackendTests() override = default;
 
+    void createLdlSessionUpToLimit()
+    {
+        EXPECT_CALL(*m_mediaKeysMock, getLdlSessionsLimit(_))
+            .WillOnce(DoAll(SetArgReferee<0>(kLdlLimit), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+        EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+            .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+        changeStateToRunning();
+        int32_t keySessionId{0};
+        EXPECT_TRUE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+        EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
+    }
+
+    void waitForLdlAdmissionWaits(uint64_t waits)
+    {
+        while (Metrics::instance().get(MetricId::LDL_ADMISSION_WAITS) < waits)
+        {
+            std::this_thread::yield();
+        }
+    }
+
     void changeStateToRunning()
     {
         ASSERT_TRUE(m_mediaKeysFactoryMock);
@@ -51,11 +85,18 @@ public:
         EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
             .WillOnce(Return(ByMove(std::move(m_mediaKeysMock))));
         m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+        waitForRestore();
+    }
+
+    void waitForRestore()
+    {
+        // Returns once the restore thread has created MediaKeys
+        EXPECT_TRUE(m_sut.initialize(firebolt::rialto::ApplicationState::RUNNING));
     }
 
 protected:
-    std::shared_ptr<StrictMock<firebolt::rialto::MediaKeysClientMock>> m_mediaKeysClientMock{
-        std::make_shared<StrictMock<firebolt::rialto::MediaKeysClientMock>>()};
+    std::shared_ptr<StrictMock<MessageDispatcherListenerMock>> m_mediaKeysClientMock{
+        std::make_shared<StrictMock<MessageDispatcherListenerMock>>()};
     std::shared_ptr<StrictMock<MediaKeysFactoryMock>> m_mediaKeysFactoryMock{
         std::dynamic_pointer_cast<StrictMock<MediaKeysFactoryMock>>(firebolt::rialto::IMediaKeysFactory::createFactory())};
     std::unique_ptr<StrictMock<firebolt::rialto::MediaKeysMock>> m_mediaKeysMock{
@@ -86,6 +127,7 @@ TEST_F(CdmBackendTests, ShouldInitializeMediaKeysWhenSwitchedToRunningAgain)
     EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
         .WillOnce(Return(ByMove(std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>())));
     m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    waitForRestore();
 }
 
 TEST_F(CdmBackendTests, ShouldNotInitializeTwice)
@@ -163,7 +205,7 @@ TEST_F(CdmBackendTests, ShouldContainKey)
 TEST_F(CdmBackendTests, ShouldFailToCreateKeySessionWhenMediaKeysIsNotPresent)
 {
     int32_t keySessionId{0};
-    EXPECT_FALSE(m_sut.createKeySession(kSessionType, kIsLDL, keySessionId));
+    EXPECT_FALSE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
 }
 
 TEST_F(CdmBackendTests, ShouldFailToCreateKeySession)
@@ -172,7 +214,7 @@ TEST_F(CdmBackendTests, ShouldFailToCreateKeySession)
     EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
         .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::FAIL));
     changeStateToRunning();
-    EXPECT_FALSE(m_sut.createKeySession(kSessionType, kIsLDL, keySessionId));
+    EXPECT_FALSE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
 }
 
 TEST_F(CdmBackendTests, ShouldCreateKeySession)
@@ -181,7 +223,358 @@ TEST_F(CdmBackendTests, ShouldCreateKeySession)
     EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
         .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
     changeStateToRunning();
-    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, keySessionId));
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
+}
+
+TEST_F(CdmBackendTests, ShouldRecordKeySessionCallsWithItsPriority)
+{
+    const auto kGetCallCount{[](SessionPriority priority)
+                             {
+                                 LatencySnapshot lockWait;
+                                 LatencySnapshot callTime;
+                                 LatencyStats::instance().getStats(priority, lockWait, callTime);
+                                 return callTime.count;
+                             }};
+    const uint64_t kPrefetchCalls{kGetCallCount(SessionPriority::PREFETCH)};
+    const uint64_t kBackgroundCalls{kGetCallCount(SessionPriority::BACKGROUND)};
+    int32_t keySessionId{0};
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, loadSession(kKeySessionId))
+        .Times(2)
+        .WillRepeatedly(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, SessionPriority::PREFETCH, keySessionId));
+    EXPECT_TRUE(m_sut.loadSession(kKeySessionId));
+    EXPECT_EQ(kPrefetchCalls + 2, kGetCallCount(SessionPriority::PREFETCH));
+
+    m_sut.setKeySessionPriority(kKeySessionId, SessionPriority::BACKGROUND);
+    EXPECT_TRUE(m_sut.loadSession(kKeySessionId));
+    EXPECT_EQ(kPrefetchCalls + 2, kGetCallCount(SessionPriority::PREFETCH));
+    EXPECT_EQ(kBackgroundCalls + 1, kGetCallCount(SessionPriority::BACKGROUND));
+}
+
+TEST_F(CdmBackendTests, ShouldCreateKeySessionAsyncWhenRunning)
+{
+    std::vector<std::pair<bool, int32_t>> results;
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    changeStateToRunning();
+    m_sut.createKeySessionAsync(kSessionType, kIsLDL, kPriority, [&](bool isCreated, int32_t keySessionId)
+                                { results.emplace_back(isCreated, keySessionId); });
+    ASSERT_EQ(1u, results.size());
+    EXPECT_TRUE(results[0].first);
+    EXPECT_EQ(kKeySessionId, results[0].second);
+}
+
+TEST_F(CdmBackendTests, ShouldReplayDeferredKeySessionCreationsInOrderWhenRunning)
+{
+    constexpr int32_t kSecondKeySessionId{kKeySessionId + 1};
+    const uint64_t kPendingKeySessions{Metrics::instance().get(MetricId::PENDING_KEY_SESSIONS)};
+    std::vector<std::pair<bool, int32_t>> results;
+    const auto kCallback{[&](bool isCreated, int32_t keySessionId) { results.emplace_back(isCreated, keySessionId); }};
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+    m_sut.createKeySessionAsync(kSessionType, kIsLDL, kPriority, kCallback);
+    m_sut.createKeySessionAsync(kSessionType, !kIsLDL, kPriority, kCallback);
+    EXPECT_TRUE(results.empty());
+    EXPECT_EQ(kPendingKeySessions + 2, Metrics::instance().get(MetricId::PENDING_KEY_SESSIONS));
+
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, !kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kSecondKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    changeStateToRunning();
+    ASSERT_EQ(2u, results.size());
+    EXPECT_EQ(std::make_pair(true, kKeySessionId), results[0]);
+    EXPECT_EQ(std::make_pair(true, kSecondKeySessionId), results[1]);
+    EXPECT_EQ(kPendingKeySessions, Metrics::instance().get(MetricId::PENDING_KEY_SESSIONS));
+}
+
+TEST_F(CdmBackendTests, ShouldCancelDeferredKeySessionCreation)
+{
+    bool isCallbackCalled{false};
+    const uint64_t kRequestId{
+        m_sut.createKeySessionAsync(kSessionType, kIsLDL, kPriority, [&](bool, int32_t) { isCallbackCalled = true; })};
+    EXPECT_TRUE(m_sut.cancelKeySessionCreation(kRequestId));
+    EXPECT_FALSE(m_sut.cancelKeySessionCreation(kRequestId));
+    changeStateToRunning();
+    EXPECT_FALSE(isCallbackCalled);
+}
+
+TEST_F(CdmBackendTests, ShouldFailDeferredKeySessionCreationsOnDestruction)
+{
+    std::vector<std::pair<bool, int32_t>> results;
+    {
+        CdmBackend sut{kKeySystem, m_mediaKeysClientMock, m_mediaKeysFactoryMock};
+        sut.createKeySessionAsync(kSessionType, kIsLDL, kPriority, [&](bool isCreated, int32_t keySessionId)
+                                  { results.emplace_back(isCreated, keySessionId); });
+    }
+    ASSERT_EQ(1u, results.size());
+    EXPECT_EQ(std::make_pair(false, firebolt::rialto::kInvalidSessionId), results[0]);
+}
+
+TEST_F(CdmBackendTests, ShouldCreateKeySessionWhenRunningIsReachedWhileWaiting)
+{
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    int32_t keySessionId{0};
+    std::future<bool> result{
+        std::async(std::launch::async,
+                   [&]() { return m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId); })};
+    changeStateToRunning();
+    EXPECT_TRUE(result.get());
+    EXPECT_EQ(kKeySessionId, keySessionId);
+}
+
+TEST_F(CdmBackendTests, ShouldRestorePersistentKeySessionsWhenRunningAgain)
+{
+    constexpr int32_t kTemporaryKeySessionId{kKeySessionId + 1};
+    constexpr int32_t kRestoredKeySessionId{kKeySessionId + 2};
+    constexpr auto kPersistent{firebolt::rialto::KeySessionType::PERSISTENT_LICENCE};
+    const uint64_t kRestoredKeySessions{Metrics::instance().get(MetricId::RESTORED_KEY_SESSIONS)};
+    const uint64_t kLostKeySessions{Metrics::instance().get(MetricId::LOST_KEY_SESSIONS)};
+    int32_t keySessionId{0};
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kPersistent, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kTemporaryKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, updateSession(kKeySessionId, kBytes))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    EXPECT_TRUE(m_sut.createKeySession(kPersistent, kIsLDL, kPriority, keySessionId));
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
+    EXPECT_TRUE(m_sut.updateSession(kKeySessionId, kBytes));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+
+    auto newMediaKeysMock{std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>()};
+    EXPECT_CALL(*newMediaKeysMock, createKeySession(kPersistent, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kRestoredKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*newMediaKeysMock, loadSession(kRestoredKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(Return(ByMove(std::move(newMediaKeysMock))));
+    const std::map<int32_t, int32_t> kNewKeySessionIds{{kKeySessionId, kRestoredKeySessionId},
+                                                       {kTemporaryKeySessionId, firebolt::rialto::kInvalidSessionId}};
+    EXPECT_CALL(*m_mediaKeysClientMock, onKeySessionIdsChanged(kNewKeySessionIds));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    waitForRestore();
+    EXPECT_EQ(kRestoredKeySessions + 1, Metrics::instance().get(MetricId::RESTORED_KEY_SESSIONS));
+    EXPECT_EQ(kLostKeySessions + 1, Metrics::instance().get(MetricId::LOST_KEY_SESSIONS));
+}
+
+TEST_F(CdmBackendTests, ShouldNotRestoreClosedKeySessions)
+{
+    int32_t keySessionId{0};
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, closeKeySession(kKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
+    EXPECT_TRUE(m_sut.closeKeySession(kKeySessionId));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(Return(ByMove(std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>())));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    waitForRestore();
+}
+
+TEST_F(CdmBackendTests, ShouldNotBlockNotifyingThreadWhileMediaKeysIsCreated)
+{
+    std::promise<void> isCreationReleased;
+    std::shared_future<void> creationReleased{isCreationReleased.get_future()};
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(
+            [&](const std::string &, std::weak_ptr<firebolt::rialto::client::IMediaKeysIpcFactory>)
+            {
+                creationReleased.wait();
+                return std::move(m_mediaKeysMock);
+            });
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    isCreationReleased.set_value();
+    waitForRestore();
+}
+
+TEST_F(CdmBackendTests, ShouldDropMediaKeysCreatedAfterSwitchingToInactive)
+{
+    std::promise<void> isCreationReleased;
+    std::shared_future<void> creationReleased{isCreationReleased.get_future()};
+    std::promise<void> isCreationStarted;
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(
+            // Released after the test body has returned, so the future is kept by the action
+            [&, creationReleased](const std::string &, std::weak_ptr<firebolt::rialto::client::IMediaKeysIpcFactory>)
+            {
+                isCreationStarted.set_value();
+                creationReleased.wait();
+                return std::move(m_mediaKeysMock);
+            });
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    isCreationStarted.get_future().wait();
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+    isCreationReleased.set_value();
+    EXPECT_TRUE(m_sut.initialize(firebolt::rialto::ApplicationState::INACTIVE));
+    // Not restored, calls fail as they do while INACTIVE
+    EXPECT_FALSE(m_sut.selectKeyId(kKeySessionId, kBytes));
+}
+
+TEST_F(CdmBackendTests, ShouldAdmitLdlSessionsWithoutLimit)
+{
+    EXPECT_CALL(*m_mediaKeysMock, getLdlSessionsLimit(_))
+        .WillOnce(DoAll(SetArgReferee<0>(0), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    changeStateToRunning();
+    EXPECT_TRUE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+    EXPECT_TRUE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+}
+
+TEST_F(CdmBackendTests, ShouldFailLdlAdmissionWhenLimitIsReached)
+{
+    const uint64_t kAdmissionTimeouts{Metrics::instance().get(MetricId::LDL_ADMISSION_TIMEOUTS)};
+    createLdlSessionUpToLimit();
+    EXPECT_FALSE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+    EXPECT_EQ(kAdmissionTimeouts + 1, Metrics::instance().get(MetricId::LDL_ADMISSION_TIMEOUTS));
+}
+
+TEST_F(CdmBackendTests, ShouldAdmitWaitingLdlSessionWhenOneIsClosed)
+{
+    const uint64_t kAdmissionWaits{Metrics::instance().get(MetricId::LDL_ADMISSION_WAITS)};
+    EXPECT_CALL(*m_mediaKeysMock, closeKeySession(kKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    createLdlSessionUpToLimit();
+    std::future<bool> isAdmitted{std::async(std::launch::async, [this]()
+                                            { return m_sut.admitLdlSession(SessionPriority::FOREGROUND, {}); })};
+    waitForLdlAdmissionWaits(kAdmissionWaits + 1);
+    EXPECT_TRUE(m_sut.closeKeySession(kKeySessionId));
+    EXPECT_TRUE(isAdmitted.get());
+}
+
+TEST_F(CdmBackendTests, ShouldAdmitForegroundLdlSessionBeforePrefetch)
+{
+    const uint64_t kAdmissionWaits{Metrics::instance().get(MetricId::LDL_ADMISSION_WAITS)};
+    EXPECT_CALL(*m_mediaKeysMock, closeKeySession(kKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    createLdlSessionUpToLimit();
+    std::future<bool> isPrefetchAdmitted{
+        std::async(std::launch::async,
+                   [this]() { return m_sut.admitLdlSession(SessionPriority::PREFETCH, kLdlAdmissionTimeout * 4); })};
+    waitForLdlAdmissionWaits(kAdmissionWaits + 1);
+    std::future<bool> isForegroundAdmitted{
+        std::async(std::launch::async, [this]() { return m_sut.admitLdlSession(SessionPriority::FOREGROUND, {}); })};
+    waitForLdlAdmissionWaits(kAdmissionWaits + 2);
+    EXPECT_TRUE(m_sut.closeKeySession(kKeySessionId));
+    EXPECT_TRUE(isForegroundAdmitted.get());
+    EXPECT_FALSE(isPrefetchAdmitted.get());
+}
+
+TEST_F(CdmBackendTests, ShouldKeepLdlReservationWhenKeySessionsAreRestored)
+{
+    constexpr int32_t kRestoredKeySessionId{kKeySessionId + 1};
+    constexpr uint32_t kTwoLdlSessions{2};
+    constexpr auto kPersistent{firebolt::rialto::KeySessionType::PERSISTENT_LICENCE};
+    int32_t keySessionId{0};
+    EXPECT_CALL(*m_mediaKeysMock, getLdlSessionsLimit(_))
+        .WillOnce(DoAll(SetArgReferee<0>(kTwoLdlSessions), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kPersistent, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, updateSession(kKeySessionId, kBytes))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    EXPECT_TRUE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+    EXPECT_TRUE(m_sut.createKeySession(kPersistent, kIsLDL, kPriority, keySessionId));
+    EXPECT_TRUE(m_sut.updateSession(kKeySessionId, kBytes));
+    // Held by a session which has not created its key session yet
+    EXPECT_TRUE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+
+    auto newMediaKeysMock{std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>()};
+    EXPECT_CALL(*newMediaKeysMock, createKeySession(kPersistent, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kRestoredKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*newMediaKeysMock, loadSession(kRestoredKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    EXPECT_CALL(*newMediaKeysMock, getLdlSessionsLimit(_))
+        .WillOnce(DoAll(SetArgReferee<0>(kTwoLdlSessions), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(Return(ByMove(std::move(newMediaKeysMock))));
+    EXPECT_CALL(*m_mediaKeysClientMock, onKeySessionIdsChanged(std::map<int32_t, int32_t>{
+                                            {kKeySessionId, kRestoredKeySessionId}}));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    waitForRestore();
+    // The restored key session and the reservation take both LDL sessions
+    EXPECT_FALSE(m_sut.admitLdlSession(SessionPriority::FOREGROUND, kLdlAdmissionTimeout));
+}
+
+class CdmBackendKeySessionPoolTests : public CdmBackendTests
+{
+public:
+    CdmBackendKeySessionPoolTests() { CdmBackend::setKeySessionPoolSize(1); }
+    ~CdmBackendKeySessionPoolTests() override { CdmBackend::setKeySessionPoolSize(0); }
+
+    void fillPool(firebolt::rialto::MediaKeysMock &mediaKeysMock, int32_t keySessionId, std::promise<void> &isFilled)
+    {
+        EXPECT_CALL(mediaKeysMock, createKeySession(kSessionType, _, false, _))
+            .WillOnce(DoAll(SetArgReferee<3>(keySessionId), InvokeWithoutArgs([&]() { isFilled.set_value(); }),
+                            Return(firebolt::rialto::MediaKeyErrorStatus::OK)))
+            .RetiresOnSaturation();
+    }
+};
+
+TEST_F(CdmBackendKeySessionPoolTests, ShouldTakeTemporaryKeySessionFromPool)
+{
+    constexpr int32_t kRefilledKeySessionId{kKeySessionId + 1};
+    const uint64_t kPoolHits{Metrics::instance().get(MetricId::KEY_SESSION_POOL_HITS)};
+    std::promise<void> isFilled;
+    std::promise<void> isRefilled;
+    fillPool(*m_mediaKeysMock, kRefilledKeySessionId, isRefilled);
+    fillPool(*m_mediaKeysMock, kKeySessionId, isFilled);
+    EXPECT_CALL(*m_mediaKeysMock, closeKeySession(kRefilledKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    ASSERT_EQ(std::future_status::ready, isFilled.get_future().wait_for(kPoolRefillWait));
+
+    int32_t keySessionId{0};
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, false, kPriority, keySessionId));
+    EXPECT_EQ(kKeySessionId, keySessionId);
+    EXPECT_EQ(kPoolHits + 1, Metrics::instance().get(MetricId::KEY_SESSION_POOL_HITS));
+    EXPECT_EQ(std::future_status::ready, isRefilled.get_future().wait_for(kPoolRefillWait));
+}
+
+TEST_F(CdmBackendKeySessionPoolTests, ShouldNotTakeLdlKeySessionFromPool)
+{
+    constexpr int32_t kLdlKeySessionId{kKeySessionId + 1};
+    std::promise<void> isFilled;
+    fillPool(*m_mediaKeysMock, kKeySessionId, isFilled);
+    EXPECT_CALL(*m_mediaKeysMock, createKeySession(kSessionType, _, kIsLDL, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kLdlKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*m_mediaKeysMock, closeKeySession(kKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    changeStateToRunning();
+    ASSERT_EQ(std::future_status::ready, isFilled.get_future().wait_for(kPoolRefillWait));
+
+    int32_t keySessionId{0};
+    EXPECT_TRUE(m_sut.createKeySession(kSessionType, kIsLDL, kPriority, keySessionId));
+    EXPECT_EQ(kLdlKeySessionId, keySessionId);
+}
+
+TEST_F(CdmBackendKeySessionPoolTests, ShouldDropPooledKeySessionsWhenInactive)
+{
+    constexpr int32_t kRefilledKeySessionId{kKeySessionId + 1};
+    std::promise<void> isFilled;
+    std::promise<void> isRefilled;
+    fillPool(*m_mediaKeysMock, kKeySessionId, isFilled);
+    changeStateToRunning();
+    ASSERT_EQ(std::future_status::ready, isFilled.get_future().wait_for(kPoolRefillWait));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::INACTIVE);
+
+    // Not reported as a lost session, the pool is filled again by the new MediaKeys
+    auto newMediaKeysMock{std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>()};
+    fillPool(*newMediaKeysMock, kRefilledKeySessionId, isRefilled);
+    EXPECT_CALL(*newMediaKeysMock, closeKeySession(kRefilledKeySessionId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    EXPECT_CALL(*m_mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(Return(ByMove(std::move(newMediaKeysMock))));
+    m_sut.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    waitForRestore();
+    EXPECT_EQ(std::future_status::ready, isRefilled.get_future().wait_for(kPoolRefillWait));
 }
 
 TEST_F(CdmBackendTests, ShouldFailToGenerateRequestWhenMediaKeysIsNotPresent)
@@ -191,10 +584,12 @@ TEST_F(CdmBackendTests, ShouldFailToGenerateRequestWhenMediaKeysIsNotPresent)
 
 TEST_F(CdmBackendTests, ShouldFailToGenerateRequest)
 {
+    const uint64_t kIpcFailures{Metrics::instance().getIpcFailures(CdmOperation::GENERATE_REQUEST)};
     EXPECT_CALL(*m_mediaKeysMock, generateRequest(kKeySessionId, kInitDataType, kBytes))
         .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::FAIL));
     changeStateToRunning();
     EXPECT_FALSE(m_sut.generateRequest(kKeySessionId, kInitDataType, kBytes));
+    EXPECT_EQ(kIpcFailures + 1, Metrics::instance().getIpcFailures(CdmOperation::GENERATE_REQUEST));
 }
 
 TEST_F(CdmBackendTests, ShouldGenerateRequest)
@@ -0,0 +1,197 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InitDataParser.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+using KeyIds = std::vector<std::vector<uint8_t>>;
+
+const std::vector<uint8_t> kKeyId1{0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                   0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10};
+const std::vector<uint8_t> kKeyId2{0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+                                   0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20};
+// kKeyId1 and kKeyId2 as PlayReady GUIDs
+const std::string kPlayReadyKeyId1{"BAMCAQYFCAcJCgsMDQ4PEA=="};
+const std::string kPlayReadyKeyId2{"FBMSERYVGBcZGhscHR4fIA=="};
+const std::vector<uint8_t> kWidevineSystemId{0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce,
+                                             0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed};
+const std::vector<uint8_t> kPlayReadySystemId{0x9a, 0x04, 0xf0, 0x79, 0x98, 0x40, 0x42, 0x86,
+                                              0xab, 0x92, 0xe6, 0x5b, 0xe0, 0x88, 0x5f, 0x95};
+const std::vector<uint8_t> kClearKeySystemId{0x10, 0x77, 0xef, 0xec, 0xc0, 0xb2, 0x4d, 0x02,
+                                             0xac, 0xe3, 0x3c, 0x1e, 0x52, 0xe2, 0xfb, 0x4b};
+
+void appendBigEndian(std::vector<uint8_t> &data, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        data.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void appendLittleEndian(std::vector<uint8_t> &data, uint32_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::vector<uint8_t> createPsshBox(uint8_t version, const std::vector<uint8_t> &systemId, const KeyIds &keyIds,
+                                   const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> body{version, 0, 0, 0};
+    body.insert(body.end(), systemId.begin(), systemId.end());
+    if (version > 0)
+    {
+        appendBigEndian(body, keyIds.size());
+        for (const std::vector<uint8_t> &keyId : keyIds)
+        {
+            body.insert(body.end(), keyId.begin(), keyId.end());
+        }
+    }
+    appendBigEndian(body, data.size());
+    body.insert(body.end(), data.begin(), data.end());
+
+    std::vector<uint8_t> box;
+    appendBigEndian(box, body.size() + 8);
+    box.insert(box.end(), {'p', 's', 's', 'h'});
+    box.insert(box.end(), body.begin(), body.end());
+    return box;
+}
+
+std::vector<uint8_t> toUtf16(const std::string &text)
+{
+    std::vector<uint8_t> result;
+    for (char character : text)
+    {
+        result.push_back(static_cast<uint8_t>(character));
+        result.push_back(0);
+    }
+    return result;
+}
+
+std::vector<uint8_t> createPlayReadyObject(const std::vector<uint8_t> &wrmHeader)
+{
+    std::vector<uint8_t> object;
+    appendLittleEndian(object, wrmHeader.size() + 10, 4);
+    appendLittleEndian(object, 1, 2);
+    appendLittleEndian(object, 1, 2);
+    appendLittleEndian(object, wrmHeader.size(), 2);
+    object.insert(object.end(), wrmHeader.begin(), wrmHeader.end());
+    return object;
+}
+
+std::vector<uint8_t> createWidevinePsshData(const KeyIds &keyIds)
+{
+    // algorithm: AESCTR, key_id (repeated), provider: "provider"
+    std::vector<uint8_t> data{0x08, 0x01};
+    for (const std::vector<uint8_t> &keyId : keyIds)
+    {
+        data.push_back(0x12);
+        data.push_back(static_cast<uint8_t>(keyId.size()));
+        data.insert(data.end(), keyId.begin(), keyId.end());
+    }
+    const std::string kProvider{"provider"};
+    data.push_back(0x1a);
+    data.push_back(static_cast<uint8_t>(kProvider.size()));
+    data.insert(data.end(), kProvider.begin(), kProvider.end());
+    return data;
+}
+} // namespace
+
+TEST(InitDataParserTests, ShouldParseKeyIdsOfPsshBoxVersion1)
+{
+    const std::vector<uint8_t> kInitData{createPsshBox(1, kClearKeySystemId, {kKeyId1, kKeyId2}, {})};
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::CENC, kInitData), (KeyIds{kKeyId1, kKeyId2}));
+}
+
+TEST(InitDataParserTests, ShouldParseKeyIdsOfWidevinePsshBoxVersion0)
+{
+    const std::vector<uint8_t> kInitData{createPsshBox(0, kWidevineSystemId, {}, createWidevinePsshData({kKeyId1}))};
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::CENC, kInitData), (KeyIds{kKeyId1}));
+}
+
+TEST(InitDataParserTests, ShouldParseKeyIdsOfPlayReadyPsshBoxVersion0)
+{
+    const std::string kWrmHeader{"<WRMHEADER xmlns=\"http://schemas.microsoft.com/DRM/2007/03/PlayReadyHeader\" "
+                                 "version=\"4.0.0.0\"><DATA><KID>" +
+                                 kPlayReadyKeyId1 + "</KID><CHECKSUM>AAAAAAAAAAA=</CHECKSUM></DATA></WRMHEADER>"};
+    const std::vector<uint8_t> kInitData{
+        createPsshBox(0, kPlayReadySystemId, {}, createPlayReadyObject(toUtf16(kWrmHeader)))};
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::CENC, kInitData), (KeyIds{kKeyId1}));
+}
+
+TEST(InitDataParserTests, ShouldParseKeyIdsOfAllPsshBoxesOnce)
+{
+    std::vector<uint8_t> initData{createPsshBox(1, kClearKeySystemId, {kKeyId1}, {})};
+    const std::vector<uint8_t> kWidevineBox{
+        createPsshBox(0, kWidevineSystemId, {}, createWidevinePsshData({kKeyId1, kKeyId2}))};
+    initData.insert(initData.end(), kWidevineBox.begin(), kWidevineBox.end());
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::CENC, initData), (KeyIds{kKeyId1, kKeyId2}));
+}
+
+TEST(InitDataParserTests, ShouldIgnoreTruncatedPsshBox)
+{
+    std::vector<uint8_t> initData{createPsshBox(1, kClearKeySystemId, {kKeyId1, kKeyId2}, {})};
+    initData.resize(initData.size() - 8);
+    EXPECT_TRUE(parseKeyIds(firebolt::rialto::InitDataType::CENC, initData).empty());
+}
+
+TEST(InitDataParserTests, ShouldIgnoreKeyIdCountExceedingPsshBox)
+{
+    std::vector<uint8_t> initData{createPsshBox(1, kClearKeySystemId, {kKeyId1}, {})};
+    // KID count of the box
+    initData[31] = 0xff;
+    EXPECT_TRUE(parseKeyIds(firebolt::rialto::InitDataType::CENC, initData).empty());
+}
+
+TEST(InitDataParserTests, ShouldParseWebmKeyId)
+{
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::WEBM, kKeyId1), (KeyIds{kKeyId1}));
+}
+
+TEST(InitDataParserTests, ShouldParseKeyIdsOfPlayReadyHeaderVersion42)
+{
+    const std::string kWrmHeader{"<WRMHEADER version=\"4.2.0.0\"><DATA><PROTECTINFO><KIDS><KID ALGID=\"AESCTR\" "
+                                 "VALUE=\"" +
+                                 kPlayReadyKeyId1 + "\"></KID><KID ALGID=\"AESCTR\" VALUE=\"" + kPlayReadyKeyId2 +
+                                 "\"/></KIDS></PROTECTINFO></DATA></WRMHEADER>"};
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::DRMHEADER, toUtf16(kWrmHeader)),
+              (KeyIds{kKeyId1, kKeyId2}));
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::DRMHEADER, createPlayReadyObject(toUtf16(kWrmHeader))),
+              (KeyIds{kKeyId1, kKeyId2}));
+    EXPECT_EQ(parseKeyIds(firebolt::rialto::InitDataType::DRMHEADER,
+                          std::vector<uint8_t>(kWrmHeader.begin(), kWrmHeader.end())),
+              (KeyIds{kKeyId1, kKeyId2}));
+}
+
+TEST(InitDataParserTests, ShouldIgnoreInvalidPlayReadyKeyId)
+{
+    const std::string kWrmHeader{"<WRMHEADER><DATA><KID>BAMCAQ==</KID></DATA></WRMHEADER>"};
+    EXPECT_TRUE(parseKeyIds(firebolt::rialto::InitDataType::DRMHEADER, toUtf16(kWrmHeader)).empty());
+}
+
+TEST(InitDataParserTests, ShouldNotParseUnknownInitData)
+{
+    EXPECT_TRUE(parseKeyIds(firebolt::rialto::InitDataType::UNKNOWN, kKeyId1).empty());
+}
@@ -0,0 +1,144 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyStats.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+class LatencyStatsTests : public testing::Test
+{
+public:
+    LatencyStatsTests() { LatencyStats::instance().reset(); }
+    ~LatencyStatsTests() override { LatencyStats::instance().reset(); }
+};
+
+TEST_F(LatencyStatsTests, BucketsShouldCoverValuesWithBoundedRelativeError)
+{
+    size_t previousIndex{0};
+    for (uint64_t value = 1; value < (uint64_t{1} << LatencySnapshot::kMaxBits); value = value * 3 / 2 + 1)
+    {
+        const size_t kIndex{LatencySnapshot::bucketIndex(value)};
+        EXPECT_GE(kIndex, previousIndex);
+        ASSERT_LT(kIndex, LatencySnapshot::kBuckets);
+        const uint64_t kUpperBound{LatencySnapshot::bucketUpperBound(kIndex)};
+        EXPECT_GE(kUpperBound, value);
+        EXPECT_LE(kUpperBound - value, value / LatencySnapshot::kSubBuckets);
+        previousIndex = kIndex;
+    }
+}
+
+TEST_F(LatencyStatsTests, ShouldPutHugeValuesInLastBucket)
+{
+    EXPECT_EQ(LatencySnapshot::bucketIndex(UINT64_MAX), LatencySnapshot::kBuckets - 1);
+}
+
+TEST_F(LatencyStatsTests, ShouldCalculatePercentiles)
+{
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value)
+    {
+        histogram.record(value * 1000);
+    }
+    LatencySnapshot snapshot;
+    histogram.addTo(snapshot);
+
+    EXPECT_EQ(snapshot.count, 1000u);
+    EXPECT_EQ(snapshot.totalNs, 500500u * 1000);
+    EXPECT_EQ(snapshot.maxNs, 1000000u);
+    EXPECT_NEAR(snapshot.percentile(0.5), 500000, 500000 / LatencySnapshot::kSubBuckets);
+    EXPECT_NEAR(snapshot.percentile(0.99), 990000, 990000 / LatencySnapshot::kSubBuckets);
+    EXPECT_EQ(snapshot.percentile(1.0), 1000000u);
+}
+
+TEST_F(LatencyStatsTests, ShouldReturnZeroPercentileWhenEmpty)
+{
+    LatencySnapshot snapshot;
+    EXPECT_EQ(snapshot.percentile(0.5), 0u);
+}
+
+TEST_F(LatencyStatsTests, ShouldMergeStatsOfAllThreads)
+{
+    LatencyStats::instance().record(CdmOperation::GENERATE_REQUEST, SessionPriority::FOREGROUND, 10, 1000);
+    std::thread{[]()
+                {
+                    LatencyStats::instance().record(CdmOperation::GENERATE_REQUEST, SessionPriority::FOREGROUND, 20,
+                                                    3000);
+                }}
+        .join();
+
+    LatencySnapshot lockWait;
+    LatencySnapshot callTime;
+    LatencyStats::instance().getStats(CdmOperation::GENERATE_REQUEST, lockWait, callTime);
+    EXPECT_EQ(callTime.count, 2u);
+    EXPECT_EQ(callTime.totalNs, 4000u);
+    EXPECT_EQ(callTime.maxNs, 3000u);
+    EXPECT_EQ(lockWait.count, 2u);
+    EXPECT_EQ(lockWait.totalNs, 30u);
+
+    LatencyStats::instance().getStats(CdmOperation::UPDATE_SESSION, lockWait, callTime);
+    EXPECT_EQ(callTime.count, 0u);
+}
+
+TEST_F(LatencyStatsTests, TimerShouldSplitLockWaitFromCallTime)
+{
+    {
+        LatencyTimer timer{CdmOperation::UPDATE_SESSION};
+        std::this_thread::sleep_for(std::chrono::milliseconds{2});
+        timer.lockAcquired();
+    }
+    LatencySnapshot lockWait;
+    LatencySnapshot callTime;
+    LatencyStats::instance().getStats(CdmOperation::UPDATE_SESSION, lockWait, callTime);
+    ASSERT_EQ(lockWait.count, 1u);
+    EXPECT_GE(lockWait.totalNs, 2000000u);
+    EXPECT_LT(callTime.totalNs, lockWait.totalNs);
+}
+
+TEST_F(LatencyStatsTests, ShouldKeepStatsPerPriority)
+{
+    LatencyStats::instance().record(CdmOperation::UPDATE_SESSION, SessionPriority::FOREGROUND, 10, 1000);
+    LatencyStats::instance().record(CdmOperation::UPDATE_SESSION, SessionPriority::BACKGROUND, 50, 2000);
+    LatencyStats::instance().record(CdmOperation::GENERATE_REQUEST, SessionPriority::BACKGROUND, 70, 3000);
+
+    LatencySnapshot lockWait;
+    LatencySnapshot callTime;
+    LatencyStats::instance().getStats(SessionPriority::FOREGROUND, lockWait, callTime);
+    EXPECT_EQ(callTime.count, 1u);
+    EXPECT_EQ(lockWait.totalNs, 10u);
+    LatencyStats::instance().getStats(SessionPriority::BACKGROUND, lockWait, callTime);
+    EXPECT_EQ(callTime.count, 2u);
+    EXPECT_EQ(callTime.totalNs, 5000u);
+    EXPECT_EQ(lockWait.totalNs, 120u);
+    LatencyStats::instance().getStats(SessionPriority::PREFETCH, lockWait, callTime);
+    EXPECT_EQ(callTime.count, 0u);
+}
+
+TEST_F(LatencyStatsTests, ShouldDumpStatsToLog)
+{
+    LatencyStats::instance().record(CdmOperation::CREATE_KEY_SESSION, SessionPriority::FOREGROUND, 10, 1000);
+    LatencyStats::instance().dumpToLog();
+}
+
+TEST_F(LatencyStatsTests, ShouldNameEveryOperation)
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(CdmOperation::COUNT); ++i)
+    {
+        EXPECT_STRNE(toString(static_cast<CdmOperation>(i)), "unknown");
+    }
+}
@@ -0,0 +1,153 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockProfiler.h"
+#include "OpenCdmRialtoExt.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const char *kProfileFilename{"test_lock_profile.txt"};
+const std::string kLockName{"TestLock"};
+
+LockProfileSnapshot getSnapshot(const std::string &name)
+{
+    for (const LockProfileSnapshot &snapshot : LockProfiler::instance().getSnapshots())
+    {
+        if (snapshot.name == name)
+        {
+            return snapshot;
+        }
+    }
+    return LockProfileSnapshot{};
+}
+
+std::string readProfileFile()
+{
+    std::ifstream file{kProfileFilename};
+    return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+class LockProfilerTests : public testing::Test
+{
+public:
+    LockProfilerTests() { LockProfiler::instance().reset(); }
+    ~LockProfilerTests() override
+    {
+        LockProfiler::instance().reset();
+        std::remove(kProfileFilename);
+    }
+};
+
+TEST_F(LockProfilerTests, ShouldShareProfileBetweenLocksWithTheSameName)
+{
+    EXPECT_EQ(&LockProfiler::instance().getProfile(kLockName), &LockProfiler::instance().getProfile(kLockName));
+    EXPECT_NE(&LockProfiler::instance().getProfile(kLockName), &LockProfiler::instance().getProfile("OtherLock"));
+}
+
+TEST_F(LockProfilerTests, ShouldRecordWaitAndHoldTimes)
+{
+    LockProfile &profile{LockProfiler::instance().getProfile(kLockName)};
+    profile.recordAcquisition(0);
+    profile.recordRelease(100);
+    profile.recordAcquisition(500);
+    profile.recordRelease(300);
+    profile.recordAcquisition(200);
+    profile.recordRelease(200);
+
+    const LockProfileSnapshot kSnapshot{getSnapshot(kLockName)};
+    EXPECT_EQ(kSnapshot.acquisitions, 3u);
+    EXPECT_EQ(kSnapshot.contentions, 2u);
+    EXPECT_EQ(kSnapshot.totalWaitNs, 700u);
+    EXPECT_EQ(kSnapshot.maxWaitNs, 500u);
+    EXPECT_EQ(kSnapshot.totalHoldNs, 600u);
+    EXPECT_EQ(kSnapshot.maxHoldNs, 300u);
+}
+
+TEST_F(LockProfilerTests, ShouldResetCounters)
+{
+    LockProfile &profile{LockProfiler::instance().getProfile(kLockName)};
+    profile.recordAcquisition(500);
+    profile.recordRelease(300);
+    LockProfiler::instance().reset();
+
+    const LockProfileSnapshot kSnapshot{getSnapshot(kLockName)};
+    EXPECT_EQ(kSnapshot.name, kLockName);
+    EXPECT_EQ(kSnapshot.acquisitions, 0u);
+    EXPECT_EQ(kSnapshot.maxWaitNs, 0u);
+    EXPECT_EQ(kSnapshot.maxHoldNs, 0u);
+}
+
+TEST_F(LockProfilerTests, ShouldDumpReportToFile)
+{
+    LockProfile &profile{LockProfiler::instance().getProfile(kLockName)};
+    profile.recordAcquisition(1500000);
+    profile.recordRelease(2000);
+
+    EXPECT_TRUE(LockProfiler::instance().dump(kProfileFilename));
+    const std::string kReport{readProfileFile()};
+    EXPECT_EQ(kReport, LockProfiler::instance().report());
+    EXPECT_EQ(0u, kReport.find("lock "));
+    EXPECT_NE(std::string::npos, kReport.find(kLockName));
+    EXPECT_NE(std::string::npos, kReport.find("1.500"));
+}
+
+TEST_F(LockProfilerTests, ShouldFailToDumpToInvalidPath)
+{
+    EXPECT_FALSE(LockProfiler::instance().dump("/nonexistent/directory/profile.txt"));
+}
+
+#ifdef RIALTO_ENABLE_LOCK_PROFILING
+TEST_F(LockProfilerTests, ShouldProfileMutex)
+{
+    ProfiledMutex mutex{kLockName.c_str()};
+    std::thread thread;
+    {
+        ProfiledLock lock{mutex};
+        thread = std::thread([&]() { ProfiledLock otherLock{mutex}; });
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    thread.join();
+
+    const LockProfileSnapshot kSnapshot{getSnapshot(kLockName)};
+    EXPECT_EQ(kSnapshot.acquisitions, 2u);
+    EXPECT_EQ(kSnapshot.contentions, 1u);
+    EXPECT_GE(kSnapshot.maxWaitNs, 5000000u);
+    EXPECT_GE(kSnapshot.maxHoldNs, 10000000u);
+}
+
+TEST_F(LockProfilerTests, ShouldDumpOnDemand)
+{
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_dump_lock_profile(kProfileFilename));
+    EXPECT_FALSE(readProfileFile().empty());
+}
+#else
+TEST_F(LockProfilerTests, ShouldNotDumpOnDemandWhenNotEnabled)
+{
+    EXPECT_EQ(ERROR_METHOD_NOT_IMPLEMENTED, opencdm_ext_dump_lock_profile(kProfileFilename));
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+#include "LogFormat.h"
+#include "Logger.h"
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace
+{
+const char *kRialtoDebugEnvVarName{"RIALTO_DEBUG"};
+const char *kRialtoConsoleLogEnvVarName{"RIALTO_CONSOLE_LOG"};
+const char *kRialtoLogPathEnvVarName{"RIALTO_LOG_PATH"};
+const char *kLogFilename{"test_allocations.log"};
+
+size_t countLogLines()
+{
+    std::fstream file{std::string(kLogFilename) + ".ocdm", std::fstream::in};
+    EXPECT_TRUE(file.is_open());
+    size_t count{0};
+    std::string currentLine;
+    while (std::getline(file, currentLine))
+    {
+        ++count;
+    }
+    return count;
+}
+} // namespace
+
+class LogFormatAllocationTests : public testing::Test
+{
+public:
+    LogFormatAllocationTests()
+    {
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        unsetenv(kRialtoConsoleLogEnvVarName);
+        setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+        LogFile::instance().reset();
+    }
+
+    ~LogFormatAllocationTests() override
+    {
+        // Restore default env var values
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        setenv(kRialtoConsoleLogEnvVarName, "1", 1);
+        unsetenv(kRialtoLogPathEnvVarName);
+        LogFile::instance().reset();
+    }
+
+    void closeLogFile()
+    {
+        unsetenv(kRialtoLogPathEnvVarName);
+        LogFile::instance().reset();
+    }
+};
+
+TEST_F(LogFormatAllocationTests, ShouldNotAllocateWhenMessageIsFiltered)
+{
+    setenv(kRialtoDebugEnvVarName, "1", 1);
+    LogLevels::instance().reload();
+    Logger log{"Test"};
+    const std::string kText{"text that does not fit in the small string buffer"};
+    // The first message creates the log sinks
+    log << debug << "first line";
+
+    const uint64_t kAllocationsBefore{AllocationCounter::allocations()};
+    RIALTO_LOG_FMT(log, debug, "value: {}, text: {}", 42, kText);
+    log << debug << "value: " << 42 << ", text: " << kText;
+    log << RIALTO_LOG_RATE_LIMITED(debug) << "value: " << 42 << ", text: " << kText;
+    EXPECT_EQ(AllocationCounter::allocations() - kAllocationsBefore, 0u);
+}
+
+TEST_F(LogFormatAllocationTests, ShouldNotAllocateWhenFormattingToLogFile)
+{
+    Logger log{"Test"};
+    const std::string kText{"text that does not fit in the small string buffer"};
+    // The first line loads the time zone for the timestamp
+    RIALTO_LOG_FMT(log, info, "first line");
+
+    const uint64_t kAllocationsBefore{AllocationCounter::allocations()};
+    RIALTO_LOG_FMT(log, info, "value: {}, text: {}, pointer: {}", 42, kText, static_cast<const void *>(&log));
+    EXPECT_EQ(AllocationCounter::allocations() - kAllocationsBefore, 0u);
+    closeLogFile();
+
+    EXPECT_EQ(countLogLines(), 2u);
+}
@@ -0,0 +1,145 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LogFormat.h"
+#include "Logger.h"
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+const char *kRialtoDebugEnvVarName{"RIALTO_DEBUG"};
+const char *kRialtoConsoleLogEnvVarName{"RIALTO_CONSOLE_LOG"};
+const char *kRialtoLogPathEnvVarName{"RIALTO_LOG_PATH"};
+const char *kLogFilename{"test_format.log"};
+
+enum class TestEnum
+{
+    FIRST = 1,
+    SECOND = 2
+};
+
+std::vector<std::string> readLogLines()
+{
+    std::fstream file{std::string(kLogFilename) + ".ocdm", std::fstream::in};
+    EXPECT_TRUE(file.is_open());
+    std::vector<std::string> lines{};
+    std::string currentLine;
+    while (std::getline(file, currentLine))
+    {
+        lines.push_back(currentLine);
+    }
+    return lines;
+}
+
+std::string message(const std::string &line)
+{
+    const size_t kPrefixEnd{line.find("]: ")};
+    return kPrefixEnd == std::string::npos ? line : line.substr(kPrefixEnd + 3);
+}
+} // namespace
+
+class LogFormatTests : public testing::Test
+{
+public:
+    LogFormatTests()
+    {
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        unsetenv(kRialtoConsoleLogEnvVarName);
+        setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+        LogFile::instance().reset();
+    }
+
+    ~LogFormatTests() override
+    {
+        // Restore default env var values
+        setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
+        setenv(kRialtoConsoleLogEnvVarName, "1", 1);
+        unsetenv(kRialtoLogPathEnvVarName);
+        LogFile::instance().reset();
+    }
+
+    void closeLogFile()
+    {
+        unsetenv(kRialtoLogPathEnvVarName);
+        LogFile::instance().reset();
+    }
+};
+
+TEST_F(LogFormatTests, ShouldCountPlaceholdersAtCompileTime)
+{
+    static_assert(logformat::countPlaceholders("no placeholders") == 0);
+    static_assert(logformat::countPlaceholders("{} and {}") == 2);
+    static_assert(logformat::countPlaceholders("escaped {{}} and {}") == 1);
+    static_assert(logformat::countPlaceholders("unmatched {") == logformat::kInvalidFormat);
+    static_assert(logformat::countPlaceholders("unmatched }") == logformat::kInvalidFormat);
+    static_assert(logformat::countPlaceholders("{0}") == logformat::kInvalidFormat);
+}
+
+TEST_F(LogFormatTests, ShouldFormatArguments)
+{
+    Logger log{"Test"};
+    const std::string kText{"text"};
+    const char *kNullText{nullptr};
+    RIALTO_LOG_FMT(log, info, "no arguments {{escaped}}");
+    RIALTO_LOG_FMT(log, info, "{} {} {} {} {}", -42, 18446744073709551615ULL, 'c', true, 1.5);
+    RIALTO_LOG_FMT(log, info, "{}|{}|{}|{}", kText, std::string_view{"view"}, kNullText, TestEnum::SECOND);
+    RIALTO_LOG_FMT(log, info, "{}{}", "a", "b");
+    closeLogFile();
+
+    const auto kLines{readLogLines()};
+    ASSERT_EQ(kLines.size(), 4u);
+    EXPECT_NE(kLines[0].find("[Test][inf]: "), std::string::npos);
+    EXPECT_EQ(message(kLines[0]), "no arguments {escaped}");
+    EXPECT_EQ(message(kLines[1]), "-42 18446744073709551615 c true 1.5");
+    EXPECT_EQ(message(kLines[2]), "text|view|(null)|2");
+    EXPECT_EQ(message(kLines[3]), "ab");
+}
+
+TEST_F(LogFormatTests, ShouldTruncateLongMessages)
+{
+    Logger log{"Test"};
+    const std::string kLongText(2 * logformat::LogBuffer::kCapacity, 'x');
+    RIALTO_LOG_FMT(log, info, "{}", kLongText);
+    closeLogFile();
+
+    const auto kLines{readLogLines()};
+    ASSERT_EQ(kLines.size(), 1u);
+    EXPECT_EQ(kLines[0].size(), logformat::LogBuffer::kCapacity);
+    EXPECT_EQ(kLines[0].substr(kLines[0].size() - 3), "...");
+}
+
+TEST_F(LogFormatTests, ShouldNotEvaluateArgumentsOfFilteredMessages)
+{
+    setenv(kRialtoDebugEnvVarName, "1", 1);
+    LogLevels::instance().reload();
+    Logger log{"Test"};
+    int evaluations{0};
+    RIALTO_LOG_FMT(log, debug, "{}", ++evaluations);
+    EXPECT_EQ(evaluations, 0);
+    RIALTO_LOG_FMT(log, error, "{}", ++evaluations);
+    EXPECT_EQ(evaluations, 1);
+}
+
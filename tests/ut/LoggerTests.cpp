@@ -18,9 +18,14 @@
  */
 
 #include "Logger.h"
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace
 {
@@ -66,6 +71,33 @@ std::vector<Severity> readLogFile()
     file.close();
     return presentSeverities;
 }
+
+std::vector<std::string> readLogLines()
+{
+    std::string fileName = std::string(kLogFilename) + std::string(".ocdm");
+    std::fstream file{fileName, std::fstream::in};
+    EXPECT_TRUE(file.is_open());
+    std::vector<std::string> lines{};
+    std::string currentLine;
+    while (std::getline(file, currentLine))
+    {
+        lines.push_back(currentLine);
+    }
+    return lines;
+}
+
+size_t countLinesContaining(const std::vector<std::string> &lines, const std::string &text)
+{
+    size_t count{0};
+    for (const auto &line : lines)
+    {
+        if (line.find(text) != std::string::npos)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
 } // namespace
 
 class LoggerTests : public testing::Test
@@ -76,6 +108,7 @@ public:
     {
         // Restore default env var values
         setenv(kRialtoDebugEnvVarName, "5", 1);
+        LogLevels::instance().reload();
         setenv(kRialtoConsoleLogEnvVarName, "1", 1);
         unsetenv(kRialtoLogPathEnvVarName);
     }
@@ -95,6 +128,7 @@ public:
 TEST_F(LoggerTests, ShouldLogToJournald)
 {
     setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     unsetenv(kRialtoLogPathEnvVarName);
     Logger log{"Test"};
@@ -110,6 +144,7 @@ TEST_F(LoggerTests, ShouldLogToJournald)
 TEST_F(LoggerTests, ShouldLogFatalLogOnly)
 {
     setenv(kRialtoDebugEnvVarName, "0", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -128,6 +163,7 @@ TEST_F(LoggerTests, ShouldLogFatalLogOnly)
 TEST_F(LoggerTests, ShouldLogErrorLogOrBelow)
 {
     setenv(kRialtoDebugEnvVarName, "1", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -146,6 +182,7 @@ TEST_F(LoggerTests, ShouldLogErrorLogOrBelow)
 TEST_F(LoggerTests, ShouldLogWarningLogOrBelow)
 {
     setenv(kRialtoDebugEnvVarName, "2", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -164,6 +201,7 @@ TEST_F(LoggerTests, ShouldLogWarningLogOrBelow)
 TEST_F(LoggerTests, ShouldLogMilestoneLogOrBelow)
 {
     setenv(kRialtoDebugEnvVarName, "3", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -182,6 +220,7 @@ TEST_F(LoggerTests, ShouldLogMilestoneLogOrBelow)
 TEST_F(LoggerTests, ShouldLogInfoLogOrBelow)
 {
     setenv(kRialtoDebugEnvVarName, "4", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -200,6 +239,7 @@ TEST_F(LoggerTests, ShouldLogInfoLogOrBelow)
 TEST_F(LoggerTests, ShouldLogAllLogs)
 {
     setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -218,6 +258,7 @@ TEST_F(LoggerTests, ShouldLogAllLogs)
 TEST_F(LoggerTests, ShouldLogDefaultLogOrBelowWhenEnvVarIsUnset)
 {
     unsetenv(kRialtoDebugEnvVarName);
+    LogLevels::instance().reload();
     unsetenv(kRialtoConsoleLogEnvVarName);
     setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
     LogFile::instance().reset();
@@ -237,6 +278,7 @@ TEST_F(LoggerTests, ShouldLogDefaultLogOrBelowWhenEnvVarIsUnset)
 TEST_F(LoggerTests, ShouldLogAllSeveritiesToConsole)
 {
     setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
     setenv(kRialtoConsoleLogEnvVarName, "1", 1);
     unsetenv(kRialtoLogPathEnvVarName);
     Logger log{"Test"};
@@ -248,3 +290,261 @@ TEST_F(LoggerTests, ShouldLogAllSeveritiesToConsole)
     log << debug << "debug";
     log << static_cast<Severity>(6) << "???";
 }
+
+TEST_F(LoggerTests, ShouldRateLimitMessagesFromOneCallSite)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    for (int i = 0; i < 20; ++i)
+    {
+        log << RIALTO_LOG_RATE_LIMITED_WITH(error, 3, 1) << "limited";
+        log << error << "not limited";
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    const auto kLines{readLogLines()};
+    EXPECT_EQ(countLinesContaining(kLines, "[err]: limited"), 3u);
+    EXPECT_EQ(countLinesContaining(kLines, "[err]: not limited"), 20u);
+}
+
+TEST_F(LoggerTests, ShouldReportSuppressedMessagesWhenBucketRefills)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    for (int i = 0; i < 3; ++i)
+    {
+        if (2 == i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        }
+        for (int j = 0; j < 5; ++j)
+        {
+            log << RIALTO_LOG_RATE_LIMITED_WITH(warn, 1, 10) << "limited";
+        }
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    const auto kLines{readLogLines()};
+    EXPECT_EQ(countLinesContaining(kLines, "[wrn]: limited"), 2u);
+    EXPECT_EQ(countLinesContaining(kLines, "suppressed 9 messages"), 1u);
+}
+
+TEST_F(LoggerTests, ShouldReportSuppressedMessagesOfQuietCallSite)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    for (int i = 0; i < 7; ++i)
+    {
+        log << RIALTO_LOG_RATE_LIMITED_WITH(warn, 1, 10) << "limited";
+    }
+    log << warn << "before refill";
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    log << warn << "after refill";
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    // Other call sites of the test binary may report their suppressed messages as well
+    std::vector<std::string> lines{};
+    for (const auto &line : readLogLines())
+    {
+        if (line.find("Rate limiter suppressed") != std::string::npos &&
+            line.find("suppressed 6 messages") == std::string::npos)
+        {
+            continue;
+        }
+        lines.push_back(line);
+    }
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_NE(lines[0].find("[wrn]: limited"), std::string::npos);
+    EXPECT_NE(lines[1].find("[wrn]: before refill"), std::string::npos);
+    EXPECT_NE(lines[2].find("[wrn]: Rate limiter suppressed 6 messages"), std::string::npos);
+    EXPECT_NE(lines[3].find("[wrn]: after refill"), std::string::npos);
+}
+
+TEST_F(LoggerTests, ShouldNotConsumeRateLimitTokensForFilteredMessages)
+{
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    for (const char *level : {"0", "5"})
+    {
+        setenv(kRialtoDebugEnvVarName, level, 1);
+        LogLevels::instance().reload();
+        for (int i = 0; i < 5; ++i)
+        {
+            log << RIALTO_LOG_RATE_LIMITED_WITH(debug, 5, 1) << "limited";
+        }
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    const auto kLines{readLogLines()};
+    EXPECT_EQ(countLinesContaining(kLines, "[dbg]: limited"), 5u);
+    EXPECT_EQ(countLinesContaining(kLines, "suppressed"), 0u);
+}
+
+TEST_F(LoggerTests, ShouldUsePerComponentLogLevels)
+{
+    setenv(kRialtoDebugEnvVarName, "1,Verbose:5,Quiet:0", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger verboseLog{"Verbose"};
+    Logger quietLog{"Quiet"};
+    Logger defaultLog{"Default"};
+    for (const Logger *log : {&verboseLog, &quietLog, &defaultLog})
+    {
+        *log << fatal << "fatal";
+        *log << error << "error";
+        *log << debug << "debug";
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    const auto kLines{readLogLines()};
+    EXPECT_EQ(countLinesContaining(kLines, "[Verbose]"), 3u);
+    EXPECT_EQ(countLinesContaining(kLines, "[Quiet]"), 1u);
+    EXPECT_EQ(countLinesContaining(kLines, "[Default]"), 2u);
+}
+
+TEST_F(LoggerTests, ShouldApplyReloadedLogLevelsToExistingLoggers)
+{
+    setenv(kRialtoDebugEnvVarName, "0", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    log << debug << "debug";
+    setenv(kRialtoDebugEnvVarName, "Test:5", 1);
+    LogLevels::instance().reload();
+    log << debug << "debug";
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    EXPECT_EQ(countLinesContaining(readLogLines(), "[dbg]"), 1u);
+}
+
+TEST_F(LoggerTests, ShouldIgnoreInvalidLogLevelEntries)
+{
+    setenv(kRialtoDebugEnvVarName, "9,Test:x,:,Other", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    log << fatal << "fatal";
+    log << error << "error";
+    log << warn << "warn";
+    log << mil << "mil";
+    log << info << "info";
+    log << debug << "debug";
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    verifyLogFile(Severity::warn);
+}
+
+TEST_F(LoggerTests, ShouldRotateLogFileWhenSizeLimitIsReached)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    // Opening the file rotates it, so the LogFile is created and closed before the old files are removed
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    setenv("RIALTO_LOG_MAX_SIZE", "1024", 1);
+    setenv("RIALTO_LOG_MAX_FILES", "3", 1);
+    const std::string kFileName{std::string(kLogFilename) + ".ocdm"};
+    const std::vector<std::string> kFileNames{kFileName, kFileName + ".1", kFileName + ".2", kFileName + ".3"};
+    for (const auto &fileName : kFileNames)
+    {
+        std::remove(fileName.c_str());
+    }
+    LogFile::instance().reset();
+    EXPECT_FALSE(std::ifstream{kFileName + ".1"}.good());
+
+    Logger log{"Test"};
+    for (int i = 0; i < 100; ++i)
+    {
+        log << info << "Message number " << i << " that is long enough to fill the file quickly";
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    unsetenv("RIALTO_LOG_MAX_SIZE");
+    unsetenv("RIALTO_LOG_MAX_FILES");
+    LogFile::instance().reset();
+
+    size_t fileCount{0};
+    for (const auto &fileName : kFileNames)
+    {
+        std::ifstream file{fileName, std::ifstream::ate | std::ifstream::binary};
+        if (file.good())
+        {
+            ++fileCount;
+            EXPECT_LE(static_cast<size_t>(file.tellg()), 1024u);
+        }
+    }
+    EXPECT_TRUE(std::ifstream{kFileName + ".1"}.good());
+    EXPECT_EQ(fileCount, 3u);
+    EXPECT_EQ(countLinesContaining(readLogLines(), "Message number 99 "), 1u);
+}
+
+TEST_F(LoggerTests, ShouldWriteErrorLinesBeforeFlushInterval)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    log << info << "info";
+    RIALTO_LOG_FMT(log, error, "error {}", 1);
+
+    // Read before the file is closed, the writer thread only flushes info lines every 500 ms
+    std::vector<std::string> lines;
+    for (int i = 0; i < 40 && 0 == countLinesContaining(lines, "[err]: error 1"); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        lines = readLogLines();
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    LogFile::instance().reset();
+    EXPECT_EQ(countLinesContaining(lines, "[inf]: info"), 1u);
+    EXPECT_EQ(countLinesContaining(lines, "[err]: error 1"), 1u);
+}
+
+TEST_F(LoggerTests, ShouldKeepLogFileBelowSizeLimit)
+{
+    setenv(kRialtoDebugEnvVarName, "5", 1);
+    LogLevels::instance().reload();
+    unsetenv(kRialtoConsoleLogEnvVarName);
+    setenv(kRialtoLogPathEnvVarName, kLogFilename, 1);
+    setenv("RIALTO_LOG_MAX_SIZE", "4096", 1);
+    setenv("RIALTO_LOG_MAX_FILES", "2", 1);
+    LogFile::instance().reset();
+    Logger log{"Test"};
+    for (int i = 0; i < 1000; ++i)
+    {
+        log << info << "Message number " << i;
+    }
+    unsetenv(kRialtoLogPathEnvVarName);
+    unsetenv("RIALTO_LOG_MAX_SIZE");
+    unsetenv("RIALTO_LOG_MAX_FILES");
+    LogFile::instance().reset();
+
+    const std::string kFileName{std::string(kLogFilename) + ".ocdm"};
+    std::ifstream file{kFileName, std::ifstream::ate | std::ifstream::binary};
+    ASSERT_TRUE(file.good());
+    EXPECT_LE(static_cast<size_t>(file.tellg()), 4096u);
+    EXPECT_EQ(countLinesContaining(readLogLines(), "Message number 999"), 1u);
+}
@@ -0,0 +1,218 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CdmBackend.h"
+#include "MediaKeysMock.h"
+#include "MediaKeysRecorder.h"
+#include "MessageDispatcher.h"
+#include "MessageDispatcherListenerMock.h"
+#include "OpenCdmRialtoExt.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using firebolt::rialto::MediaKeysFactoryMock;
+using testing::_;
+using testing::ByMove;
+using testing::DoAll;
+using testing::Return;
+using testing::SetArgReferee;
+using testing::StrictMock;
+
+namespace
+{
+const char *kRecordingFilename{"test_recording.bin"};
+const std::string kKeySystem{"com.widevine.alpha"};
+constexpr int32_t kKeySessionId{12};
+const std::vector<uint8_t> kKeyId{1, 2, 3, 4};
+
+struct DecodedRecord
+{
+    mediakeysrecording::Record record;
+    std::string data;
+};
+
+struct DecodedRecording
+{
+    bool isValid{false};
+    std::vector<DecodedRecord> records;
+};
+
+DecodedRecording readRecordingFile()
+{
+    DecodedRecording result;
+    std::ifstream file{kRecordingFilename, std::ios::binary};
+    const std::string kData{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    mediakeysrecording::RecordingFileHeader fileHeader{};
+    if (kData.size() < sizeof(fileHeader))
+    {
+        return result;
+    }
+    std::memcpy(&fileHeader, kData.data(), sizeof(fileHeader));
+    result.isValid = 0 == std::memcmp(fileHeader.magic, mediakeysrecording::kMagic, sizeof(fileHeader.magic)) &&
+                     mediakeysrecording::kVersion == fileHeader.version;
+
+    size_t offset{fileHeader.headerSize};
+    while (offset + sizeof(mediakeysrecording::Record) <= kData.size())
+    {
+        DecodedRecord decoded{};
+        std::memcpy(&decoded.record, kData.data() + offset, sizeof(decoded.record));
+        offset += sizeof(decoded.record);
+        decoded.data = kData.substr(offset, decoded.record.dataSize);
+        offset += decoded.record.dataSize;
+        result.records.push_back(decoded);
+    }
+    return result;
+}
+} // namespace
+
+class MediaKeysRecorderTests : public testing::Test
+{
+public:
+    MediaKeysRecorderTests() { std::remove(kRecordingFilename); }
+    ~MediaKeysRecorderTests() override
+    {
+        MediaKeysRecorder::instance().reset();
+        std::remove(kRecordingFilename);
+    }
+};
+
+TEST_F(MediaKeysRecorderTests, ShouldBeDisabledByDefault)
+{
+    EXPECT_FALSE(MediaKeysRecorder::instance().isEnabled());
+    RecordedCall call{CdmOperation::LOAD_SESSION, kKeySessionId};
+    EXPECT_EQ(call.setStatus(firebolt::rialto::MediaKeyErrorStatus::FAIL), firebolt::rialto::MediaKeyErrorStatus::FAIL);
+    MediaKeysRecorder::instance().recordApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    EXPECT_FALSE(readRecordingFile().isValid);
+}
+
+TEST_F(MediaKeysRecorderTests, ShouldRecordCalls)
+{
+    ASSERT_TRUE(MediaKeysRecorder::instance().start(kRecordingFilename));
+    {
+        RecordedCall call{CdmOperation::UPDATE_SESSION, kKeySessionId, 1000};
+        EXPECT_EQ(call.setStatus(firebolt::rialto::MediaKeyErrorStatus::BAD_SESSION_ID),
+                  firebolt::rialto::MediaKeyErrorStatus::BAD_SESSION_ID);
+    }
+    {
+        RecordedCall call{CdmOperation::CONTAINS_KEY, kKeySessionId, kKeyId.size()};
+        EXPECT_TRUE(call.setStatus(true));
+    }
+    MediaKeysRecorder::instance().stop();
+
+    const DecodedRecording kRecording{readRecordingFile()};
+    EXPECT_TRUE(kRecording.isValid);
+    ASSERT_EQ(kRecording.records.size(), 2u);
+    const mediakeysrecording::Record &kUpdate{kRecording.records[0].record};
+    EXPECT_EQ(kUpdate.type, mediakeysrecording::kCall);
+    EXPECT_EQ(kUpdate.operation, static_cast<uint16_t>(CdmOperation::UPDATE_SESSION));
+    EXPECT_EQ(kUpdate.keySessionId, kKeySessionId);
+    EXPECT_EQ(kUpdate.payloadSize, 1000u);
+    EXPECT_EQ(kUpdate.status, static_cast<int32_t>(firebolt::rialto::MediaKeyErrorStatus::BAD_SESSION_ID));
+    const mediakeysrecording::Record &kContainsKey{kRecording.records[1].record};
+    EXPECT_EQ(kContainsKey.operation, static_cast<uint16_t>(CdmOperation::CONTAINS_KEY));
+    EXPECT_EQ(kContainsKey.payloadSize, kKeyId.size());
+    EXPECT_EQ(kContainsKey.status, 1);
+    EXPECT_GE(kContainsKey.timestampNs, kUpdate.timestampNs + kUpdate.durationNs);
+}
+
+TEST_F(MediaKeysRecorderTests, ShouldRecordNotificationsPassedThroughDispatcher)
+{
+    StrictMock<MessageDispatcherListenerMock> mediaKeysClientMock;
+    MessageDispatcher dispatcher;
+    auto client{dispatcher.createClient(&mediaKeysClientMock)};
+    const std::vector<unsigned char> kMessage(300, 'm');
+    const std::string kUrl{"http://license.url"};
+    const firebolt::rialto::KeyStatusVector kKeyStatuses{{kKeyId, firebolt::rialto::KeyStatus::USABLE},
+                                                         {kKeyId, firebolt::rialto::KeyStatus::EXPIRED}};
+    EXPECT_CALL(mediaKeysClientMock, onLicenseRequest(kKeySessionId, kMessage, kUrl));
+    EXPECT_CALL(mediaKeysClientMock, onLicenseRenewal(kKeySessionId, kMessage));
+    EXPECT_CALL(mediaKeysClientMock, onKeyStatusesChanged(kKeySessionId, kKeyStatuses));
+
+    ASSERT_TRUE(MediaKeysRecorder::instance().start(kRecordingFilename));
+    dispatcher.onLicenseRequest(kKeySessionId, kMessage, kUrl);
+    dispatcher.onLicenseRenewal(kKeySessionId, kMessage);
+    dispatcher.onKeyStatusesChanged(kKeySessionId, kKeyStatuses);
+    MediaKeysRecorder::instance().stop();
+
+    const DecodedRecording kRecording{readRecordingFile()};
+    ASSERT_EQ(kRecording.records.size(), 3u);
+    EXPECT_EQ(kRecording.records[0].record.type, mediakeysrecording::kLicenseRequest);
+    EXPECT_EQ(kRecording.records[0].record.payloadSize, kMessage.size());
+    EXPECT_EQ(kRecording.records[0].record.extra, kUrl.size());
+    EXPECT_EQ(kRecording.records[1].record.type, mediakeysrecording::kLicenseRenewal);
+    EXPECT_EQ(kRecording.records[1].record.payloadSize, kMessage.size());
+    EXPECT_EQ(kRecording.records[2].record.type, mediakeysrecording::kKeyStatusesChanged);
+    EXPECT_EQ(kRecording.records[2].record.keySessionId, kKeySessionId);
+    EXPECT_EQ(kRecording.records[2].record.payloadSize, 2u);
+    const std::string kExpectedStatuses{static_cast<char>(firebolt::rialto::KeyStatus::USABLE),
+                                        static_cast<char>(firebolt::rialto::KeyStatus::EXPIRED)};
+    EXPECT_EQ(kRecording.records[2].data, kExpectedStatuses);
+}
+
+TEST_F(MediaKeysRecorderTests, ShouldRecordCdmBackendTraffic)
+{
+    auto mediaKeysClientMock{std::make_shared<StrictMock<MessageDispatcherListenerMock>>()};
+    auto mediaKeysFactoryMock{
+        std::dynamic_pointer_cast<StrictMock<MediaKeysFactoryMock>>(firebolt::rialto::IMediaKeysFactory::createFactory())};
+    auto mediaKeysMock{std::make_unique<StrictMock<firebolt::rialto::MediaKeysMock>>()};
+    EXPECT_CALL(*mediaKeysMock, createKeySession(firebolt::rialto::KeySessionType::TEMPORARY, _, true, _))
+        .WillOnce(DoAll(SetArgReferee<3>(kKeySessionId), Return(firebolt::rialto::MediaKeyErrorStatus::OK)));
+    EXPECT_CALL(*mediaKeysMock, generateRequest(kKeySessionId, firebolt::rialto::InitDataType::CENC, kKeyId))
+        .WillOnce(Return(firebolt::rialto::MediaKeyErrorStatus::OK));
+    EXPECT_CALL(*mediaKeysFactoryMock, createMediaKeys(kKeySystem, _))
+        .WillOnce(Return(ByMove(std::move(mediaKeysMock))));
+
+    ASSERT_EQ(opencdm_ext_start_recording(kRecordingFilename), ERROR_NONE);
+    CdmBackend cdmBackend{kKeySystem, mediaKeysClientMock, mediaKeysFactoryMock};
+    cdmBackend.notifyApplicationState(firebolt::rialto::ApplicationState::RUNNING);
+    int32_t keySessionId{firebolt::rialto::kInvalidSessionId};
+    EXPECT_TRUE(cdmBackend.createKeySession(firebolt::rialto::KeySessionType::TEMPORARY, true,
+                                            SessionPriority::FOREGROUND, keySessionId));
+    EXPECT_TRUE(cdmBackend.generateRequest(keySessionId, firebolt::rialto::InitDataType::CENC, kKeyId));
+    EXPECT_EQ(opencdm_ext_stop_recording(), ERROR_NONE);
+
+    const DecodedRecording kRecording{readRecordingFile()};
+    ASSERT_EQ(kRecording.records.size(), 4u);
+    EXPECT_EQ(kRecording.records[0].record.type, mediakeysrecording::kApplicationState);
+    EXPECT_EQ(kRecording.records[0].record.extra, static_cast<uint32_t>(firebolt::rialto::ApplicationState::RUNNING));
+    EXPECT_EQ(kRecording.records[1].record.type, mediakeysrecording::kCreateMediaKeys);
+    EXPECT_EQ(kRecording.records[1].record.status, 1);
+    EXPECT_EQ(kRecording.records[1].data, kKeySystem);
+    const mediakeysrecording::Record &kCreate{kRecording.records[2].record};
+    EXPECT_EQ(kCreate.operation, static_cast<uint16_t>(CdmOperation::CREATE_KEY_SESSION));
+    EXPECT_EQ(kCreate.keySessionId, kKeySessionId);
+    EXPECT_EQ(kCreate.extra,
+              static_cast<uint32_t>(firebolt::rialto::KeySessionType::TEMPORARY) | mediakeysrecording::kLdlFlag);
+    const mediakeysrecording::Record &kGenerate{kRecording.records[3].record};
+    EXPECT_EQ(kGenerate.operation, static_cast<uint16_t>(CdmOperation::GENERATE_REQUEST));
+    EXPECT_EQ(kGenerate.payloadSize, kKeyId.size());
+    EXPECT_EQ(kGenerate.extra, static_cast<uint32_t>(firebolt::rialto::InitDataType::CENC));
+}
+
+TEST_F(MediaKeysRecorderTests, ShouldFailToStartRecordingWithInvalidPath)
+{
+    EXPECT_EQ(opencdm_ext_start_recording(nullptr), ERROR_INVALID_ARG);
+    EXPECT_EQ(opencdm_ext_start_recording("/nonexistent/recording.bin"), ERROR_FAIL);
+    EXPECT_FALSE(MediaKeysRecorder::instance().isEnabled());
+}
@@ -17,9 +17,10 @@
  * limitations under the License.
  */
 
-#include "MediaKeysClientMock.h"
+#include "MessageDispatcherListenerMock.h"
 #include "MessageDispatcher.h"
 #include <gtest/gtest.h>
+#include <map>
 
 using testing::StrictMock;
 
@@ -35,7 +36,7 @@ const firebolt::rialto::KeyStatusVector kKeyStatusVec{std::make_pair(kKeyId, fir
 class MessageDispatcherTests : public testing::Test
 {
 protected:
-    StrictMock<firebolt::rialto::MediaKeysClientMock> m_mediaKeysClientMock;
+    StrictMock<MessageDispatcherListenerMock> m_mediaKeysClientMock;
     MessageDispatcher m_sut{};
 };
 
@@ -63,6 +64,15 @@ TEST_F(MessageDispatcherTests, shouldForwardKeyStatusChange)
     client.reset();
 }
 
+TEST_F(MessageDispatcherTests, shouldForwardKeySessionIdsChange)
+{
+    const std::map<int32_t, int32_t> kNewKeySessionIds{{kKeySessionId, kKeySessionId + 1}};
+    auto client{m_sut.createClient(&m_mediaKeysClientMock)};
+    EXPECT_CALL(m_mediaKeysClientMock, onKeySessionIdsChanged(kNewKeySessionIds));
+    m_sut.onKeySessionIdsChanged(kNewKeySessionIds);
+    client.reset();
+}
+
 TEST_F(MessageDispatcherTests, shouldNotForwardMessagesWhenNoClientIsCreated)
 {
     m_sut.onLicenseRequest(kKeySessionId, kMessage, kUrl);
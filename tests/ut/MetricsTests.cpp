@@ -0,0 +1,153 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ActiveSessions.h"
+#include "CdmBackendMock.h"
+#include "MessageDispatcherMock.h"
+#include "Metrics.h"
+#include "OpenCdmRialtoExt.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+
+using testing::StrictMock;
+
+namespace
+{
+const char *kMetricsFilename{"test_metrics.prom"};
+
+std::string readMetricsFile()
+{
+    std::ifstream file{kMetricsFilename};
+    return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+class MetricsTests : public testing::Test
+{
+public:
+    MetricsTests() { Metrics::instance().reset(); }
+    ~MetricsTests() override
+    {
+        unsetenv("RIALTO_METRICS_PATH");
+        Metrics::instance().reset();
+        std::remove(kMetricsFilename);
+    }
+};
+
+TEST_F(MetricsTests, ShouldUpdateCountersAndGauges)
+{
+    Metrics::instance().add(MetricId::KEY_STATUS_UPDATES);
+    Metrics::instance().add(MetricId::CHALLENGE_WAIT_TIME_US, 250);
+    Metrics::instance().add(MetricId::DISPATCHER_CLIENTS, 2);
+    Metrics::instance().add(MetricId::DISPATCHER_CLIENTS, -1);
+    Metrics::instance().addIpcFailure(CdmOperation::UPDATE_SESSION);
+
+    EXPECT_EQ(1u, Metrics::instance().get(MetricId::KEY_STATUS_UPDATES));
+    EXPECT_EQ(250u, Metrics::instance().get(MetricId::CHALLENGE_WAIT_TIME_US));
+    EXPECT_EQ(1u, Metrics::instance().get(MetricId::DISPATCHER_CLIENTS));
+    EXPECT_EQ(1u, Metrics::instance().getIpcFailures(CdmOperation::UPDATE_SESSION));
+    EXPECT_EQ(0u, Metrics::instance().getIpcFailures(CdmOperation::CREATE_KEY_SESSION));
+}
+
+TEST_F(MetricsTests, ShouldCountActiveSessionsWithDecryptCalls)
+{
+    std::shared_ptr<StrictMock<CdmBackendMock>> cdmBackendMock{std::make_shared<StrictMock<CdmBackendMock>>()};
+    std::shared_ptr<StrictMock<MessageDispatcherMock>> messageDispatcherMock{
+        std::make_shared<StrictMock<MessageDispatcherMock>>()};
+    OpenCDMSession *session{ActiveSessions::instance().create("com.widevine.alpha", cdmBackendMock,
+                                                              messageDispatcherMock, Temporary, nullptr, nullptr,
+                                                              "cenc", {})};
+    EXPECT_EQ(1u, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+
+    char label[48];
+    std::snprintf(label, sizeof(label), "session=\"%p\"", static_cast<void *>(session));
+    bool isSessionListed{false};
+    for (const auto &sample : Metrics::instance().collect())
+    {
+        if (sample.labels == label)
+        {
+            EXPECT_STREQ("ocdm_session_decrypt_calls_total", sample.name);
+            EXPECT_EQ(0u, sample.value);
+            isSessionListed = true;
+        }
+    }
+    EXPECT_TRUE(isSessionListed);
+
+    ActiveSessions::instance().remove(session);
+    EXPECT_EQ(0u, Metrics::instance().get(MetricId::ACTIVE_SESSIONS));
+}
+
+TEST_F(MetricsTests, ShouldWritePrometheusFile)
+{
+    Metrics::instance().add(MetricId::APP_STATE_TRANSITIONS, 3);
+    Metrics::instance().addIpcFailure(CdmOperation::CREATE_KEY_SESSION);
+    ASSERT_TRUE(Metrics::instance().writePrometheus(kMetricsFilename));
+
+    const std::string kContent{readMetricsFile()};
+    EXPECT_NE(std::string::npos, kContent.find("# TYPE ocdm_active_sessions gauge\nocdm_active_sessions 0\n"));
+    EXPECT_NE(std::string::npos, kContent.find("# TYPE ocdm_app_state_transitions_total counter\n"
+                                               "ocdm_app_state_transitions_total 3\n"));
+    EXPECT_NE(std::string::npos, kContent.find("ocdm_ipc_failures_total{method=\"createKeySession\"} 1\n"));
+    // One header for all samples of a labelled metric
+    const size_t kHeader{kContent.find("# TYPE ocdm_ipc_failures_total counter\n")};
+    EXPECT_NE(std::string::npos, kHeader);
+    EXPECT_EQ(std::string::npos, kContent.find("# TYPE ocdm_ipc_failures_total", kHeader + 1));
+}
+
+TEST_F(MetricsTests, ShouldFailToWritePrometheusFileToInvalidPath)
+{
+    EXPECT_FALSE(Metrics::instance().writePrometheus("/nonexistent/metrics.prom"));
+}
+
+TEST_F(MetricsTests, ShouldWritePrometheusFilePeriodicallyWhenConfigured)
+{
+    setenv("RIALTO_METRICS_PATH", kMetricsFilename, 1);
+    Metrics::instance().reset();
+    unsetenv("RIALTO_METRICS_PATH");
+    // The writer writes a final snapshot when stopped
+    Metrics::instance().reset();
+    EXPECT_NE(std::string::npos, readMetricsFile().find("ocdm_active_sessions 0"));
+}
+
+TEST_F(MetricsTests, ShouldGetMetricsThroughExtApi)
+{
+    Metrics::instance().add(MetricId::DECRYPT_CALLS, 5);
+    uint32_t count{0};
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_get_metrics(nullptr, nullptr));
+    EXPECT_EQ(ERROR_BUFFER_TOO_SMALL, opencdm_ext_get_metrics(nullptr, &count));
+    ASSERT_GT(count, static_cast<uint32_t>(MetricId::COUNT));
+
+    std::vector<OpenCDMMetric> metrics(count);
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_get_metrics(metrics.data(), &count));
+    EXPECT_EQ(count, metrics.size());
+    EXPECT_STREQ("ocdm_decrypt_calls_total", metrics[static_cast<size_t>(MetricId::DECRYPT_CALLS)].name);
+    EXPECT_STREQ("", metrics[static_cast<size_t>(MetricId::DECRYPT_CALLS)].labels);
+    EXPECT_EQ(5u, metrics[static_cast<size_t>(MetricId::DECRYPT_CALLS)].value);
+    EXPECT_STREQ("method=\"selectKeyId\"", metrics[static_cast<size_t>(MetricId::COUNT)].labels);
+}
+
+TEST_F(MetricsTests, ShouldWriteMetricsThroughExtApi)
+{
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_write_metrics(nullptr));
+    EXPECT_EQ(ERROR_FAIL, opencdm_ext_write_metrics("/nonexistent/metrics.prom"));
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_write_metrics(kMetricsFilename));
+}
@@ -17,8 +17,13 @@
  * limitations under the License.
  */
 
+#include "ActiveSessions.h"
+#include "CdmBackend.h"
+#include "LatencyStats.h"
 #include "OpenCDMSessionMock.h"
+#include "OpenCDMSessionPrivate.h"
 #include "OpenCDMSystemMock.h"
+#include "OpenCdmRialtoExt.h"
 #include "opencdm/open_cdm_ext.h"
 #include <gtest/gtest.h>
 
@@ -252,11 +257,72 @@ TEST_F(OpenCdmExtTests, ShouldGetChallengeData)
     EXPECT_EQ(kBytes, resultChallenge);
 }
 
+TEST_F(OpenCdmExtTests, ShouldFailToCancelChallengeDataWhenSessionIsNull)
+{
+    EXPECT_EQ(ERROR_INVALID_SESSION, opencdm_session_cancel_challenge_data(nullptr));
+}
+
 TEST_F(OpenCdmExtTests, ShouldCancelChallengeData)
 {
+    EXPECT_CALL(m_openCdmSessionMock, cancelChallengeData());
     EXPECT_EQ(ERROR_NONE, opencdm_session_cancel_challenge_data(&m_openCdmSessionMock));
 }
 
+TEST_F(OpenCdmExtTests, ShouldSetChallengeTimeout)
+{
+    const auto kDefaultTimeout{OpenCDMSessionPrivate::getChallengeTimeout()};
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_challenge_timeout(250));
+    EXPECT_EQ(std::chrono::milliseconds{250}, OpenCDMSessionPrivate::getChallengeTimeout());
+    OpenCDMSessionPrivate::setChallengeTimeout(kDefaultTimeout);
+}
+
+TEST_F(OpenCdmExtTests, ShouldEnableSpeculativeChallenge)
+{
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_speculative_challenge(1));
+    EXPECT_TRUE(OpenCDMSessionPrivate::isSpeculativeChallengeEnabled());
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_speculative_challenge(0));
+    EXPECT_FALSE(OpenCDMSessionPrivate::isSpeculativeChallengeEnabled());
+}
+
+TEST_F(OpenCdmExtTests, ShouldEnableSessionSharing)
+{
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_session_sharing(1));
+    EXPECT_TRUE(ActiveSessions::isSessionSharingEnabled());
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_session_sharing(0));
+    EXPECT_FALSE(ActiveSessions::isSessionSharingEnabled());
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToSetPriorityWhenSessionIsNull)
+{
+    EXPECT_EQ(ERROR_INVALID_SESSION, opencdm_ext_session_set_priority(nullptr, OPENCDM_SESSION_PRIORITY_PREFETCH));
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToSetUnknownPriority)
+{
+    EXPECT_EQ(ERROR_INVALID_ARG,
+              opencdm_ext_session_set_priority(&m_openCdmSessionMock, static_cast<OpenCDMSessionPriority>(7)));
+}
+
+TEST_F(OpenCdmExtTests, ShouldSetPriority)
+{
+    EXPECT_CALL(m_openCdmSessionMock, setPriority(SessionPriority::PREFETCH));
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_session_set_priority(&m_openCdmSessionMock, OPENCDM_SESSION_PRIORITY_PREFETCH));
+    EXPECT_CALL(m_openCdmSessionMock, setPriority(SessionPriority::FOREGROUND));
+    EXPECT_EQ(ERROR_NONE,
+              opencdm_ext_session_set_priority(&m_openCdmSessionMock, OPENCDM_SESSION_PRIORITY_FOREGROUND));
+    EXPECT_CALL(m_openCdmSessionMock, setPriority(SessionPriority::BACKGROUND));
+    EXPECT_EQ(ERROR_NONE,
+              opencdm_ext_session_set_priority(&m_openCdmSessionMock, OPENCDM_SESSION_PRIORITY_BACKGROUND));
+}
+
+TEST_F(OpenCdmExtTests, ShouldSetKeySessionPoolSize)
+{
+    const uint32_t kDefaultPoolSize{CdmBackend::getKeySessionPoolSize()};
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_set_key_session_pool_size(3));
+    EXPECT_EQ(3u, CdmBackend::getKeySessionPoolSize());
+    CdmBackend::setKeySessionPoolSize(kDefaultPoolSize);
+}
+
 TEST_F(OpenCdmExtTests, ShouldFailToStoreLicenseDataWhenOneOfParamsIsNull)
 {
     uint8_t secureStopId{0};
@@ -320,3 +386,100 @@ TEST_F(OpenCdmExtTests, ShouldCleanDecryptContext)
     EXPECT_CALL(m_openCdmSessionMock, closeSession()).WillOnce(Return(true));
     EXPECT_EQ(ERROR_NONE, opencdm_session_clean_decrypt_context(&m_openCdmSessionMock));
 }
+
+TEST_F(OpenCdmExtTests, ShouldListLatencyOperations)
+{
+    EXPECT_STREQ("selectKeyId", opencdm_ext_get_latency_operation(0));
+    EXPECT_EQ(nullptr, opencdm_ext_get_latency_operation(static_cast<uint32_t>(CdmOperation::COUNT)));
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToGetLatencyStatsOfUnknownOperation)
+{
+    OpenCDMLatencyStats callTime{};
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_get_latency_stats(nullptr, &callTime, nullptr));
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_get_latency_stats("unknown", &callTime, nullptr));
+}
+
+TEST_F(OpenCdmExtTests, ShouldGetLatencyStats)
+{
+    LatencyStats::instance().reset();
+    LatencyStats::instance().record(CdmOperation::GET_DRM_TIME, SessionPriority::FOREGROUND, 100, 2000);
+
+    OpenCDMLatencyStats callTime{};
+    OpenCDMLatencyStats lockWait{};
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_get_latency_stats("getDrmTime", &callTime, &lockWait));
+    EXPECT_EQ(1u, callTime.count);
+    EXPECT_EQ(2000u, callTime.totalNs);
+    EXPECT_EQ(2000u, callTime.maxNs);
+    EXPECT_EQ(2000u, callTime.p50Ns);
+    EXPECT_EQ(100u, lockWait.totalNs);
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_get_latency_stats("getDrmTime", nullptr, nullptr));
+    LatencyStats::instance().reset();
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToGetLatencyStatsOfUnknownPriority)
+{
+    OpenCDMLatencyStats callTime{};
+    EXPECT_EQ(ERROR_INVALID_ARG,
+              opencdm_ext_get_priority_latency_stats(static_cast<OpenCDMSessionPriority>(7), &callTime, nullptr));
+}
+
+TEST_F(OpenCdmExtTests, ShouldGetPriorityLatencyStats)
+{
+    LatencyStats::instance().reset();
+    LatencyStats::instance().record(CdmOperation::LOAD_SESSION, SessionPriority::PREFETCH, 300, 1000);
+    LatencyStats::instance().record(CdmOperation::UPDATE_SESSION, SessionPriority::PREFETCH, 300, 3000);
+    LatencyStats::instance().record(CdmOperation::LOAD_SESSION, SessionPriority::FOREGROUND, 100, 2000);
+
+    OpenCDMLatencyStats callTime{};
+    OpenCDMLatencyStats lockWait{};
+    EXPECT_EQ(ERROR_NONE,
+              opencdm_ext_get_priority_latency_stats(OPENCDM_SESSION_PRIORITY_PREFETCH, &callTime, &lockWait));
+    EXPECT_EQ(2u, callTime.count);
+    EXPECT_EQ(4000u, callTime.totalNs);
+    EXPECT_EQ(600u, lockWait.totalNs);
+    EXPECT_EQ(ERROR_NONE,
+              opencdm_ext_get_priority_latency_stats(OPENCDM_SESSION_PRIORITY_BACKGROUND, &callTime, nullptr));
+    EXPECT_EQ(0u, callTime.count);
+    LatencyStats::instance().reset();
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToWaitForKeyWithInvalidParams)
+{
+    KeyStatus status{InternalError};
+    EXPECT_EQ(ERROR_INVALID_SESSION,
+              opencdm_ext_session_wait_for_key(nullptr, kBytes.data(), kBytes.size(), 0, &status));
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_session_wait_for_key(&m_openCdmSessionMock, nullptr, 0, 0, &status));
+    EXPECT_EQ(ERROR_INVALID_ARG,
+              opencdm_ext_session_wait_for_key(&m_openCdmSessionMock, kBytes.data(), kBytes.size(), 0, nullptr));
+}
+
+TEST_F(OpenCdmExtTests, ShouldWaitForKey)
+{
+    constexpr uint32_t kTimeoutMs{100};
+    KeyStatus status{InternalError};
+    EXPECT_CALL(m_openCdmSessionMock, waitForKey(kBytes.data(), kBytes.size(), std::chrono::milliseconds{kTimeoutMs}))
+        .WillOnce(Return(Usable));
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_session_wait_for_key(&m_openCdmSessionMock, kBytes.data(), kBytes.size(),
+                                                           kTimeoutMs, &status));
+    EXPECT_EQ(Usable, status);
+}
+
+TEST_F(OpenCdmExtTests, ShouldFailToGetSessionMemoryUsageWithInvalidParams)
+{
+    OpenCDMSessionMemoryUsage usage{};
+    EXPECT_EQ(ERROR_INVALID_SESSION, opencdm_ext_session_get_memory_usage(nullptr, &usage));
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_session_get_memory_usage(&m_openCdmSessionMock, nullptr));
+}
+
+TEST_F(OpenCdmExtTests, ShouldGetSessionMemoryUsage)
+{
+    const SessionMemoryUsage kUsage{100, 20, 30, 40};
+    OpenCDMSessionMemoryUsage usage{};
+    EXPECT_CALL(m_openCdmSessionMock, getMemoryUsage()).WillOnce(Return(kUsage));
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_session_get_memory_usage(&m_openCdmSessionMock, &usage));
+    EXPECT_EQ(usage.sessionBytes, kUsage.sessionBytes);
+    EXPECT_EQ(usage.initDataBytes, kUsage.initDataBytes);
+    EXPECT_EQ(usage.challengeBytes, kUsage.challengeBytes);
+    EXPECT_EQ(usage.keyIdBytes, kUsage.keyIdBytes);
+}
@@ -19,12 +19,16 @@
 
 #include "CdmBackendMock.h"
 #include "MessageDispatcherMock.h"
+#include "Metrics.h"
 #include "OcdmSessionsCallbacksMock.h"
 #include "OpenCDMSessionPrivate.h"
 #include "RialtoGStreamerEMEProtectionMetadata.h"
 #include <MessageDispatcherClientMock.h>
+#include <chrono>
+#include <future>
 #include <gst/gst.h>
 #include <gtest/gtest.h>
+#include <thread>
 
 using testing::_;
 using testing::ByMove;
@@ -86,8 +90,8 @@ protected:
 
     void initializeSut(const firebolt::rialto::KeySessionType &sessionType = kRialtoSessionType)
     {
-        EXPECT_CALL(*m_cdmBackendMock, createKeySession(sessionType, kIsLdl, _))
-            .WillOnce(DoAll(SetArgReferee<2>(kKeySessionId), Return(true)));
+        EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(sessionType, kIsLdl, _, _))
+            .WillOnce(completeKeySessionCreation(true, kKeySessionId));
         EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
             .WillOnce(Return(ByMove(std::make_unique<StrictMock<MessageDispatcherClientMock>>())));
         EXPECT_TRUE(m_sut->initialize());
@@ -186,11 +190,74 @@ TEST_F(OpenCdmSessionTests, ShouldNotInitializeWhenBackendOrDispatcherIsNull)
 TEST_F(OpenCdmSessionTests, ShouldNotInitializeWhenCreateKeySessionFails)
 {
     createSut();
-    EXPECT_CALL(*m_cdmBackendMock, createKeySession(kRialtoSessionType, kIsLdl, _)).WillOnce(Return(false));
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, kIsLdl, _, _))
+        .WillOnce(completeKeySessionCreation(false, firebolt::rialto::kInvalidSessionId));
     EXPECT_CALL(*m_cdmBackendMock, getLastDrmError(_, _)).WillOnce(Return(false));
     EXPECT_FALSE(m_sut->initialize());
 }
 
+TEST_F(OpenCdmSessionTests, ShouldInitializeWhenQueuedKeySessionIsCreated)
+{
+    createSut();
+    std::thread creatingThread;
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, kIsLdl, _, _))
+        .WillOnce(
+            [&](auto, auto, auto, const ICdmBackend::CreateKeySessionCallback &callback)
+            {
+                // Queued until Rialto is RUNNING, then created on another thread
+                creatingThread = std::thread{[callback]() { callback(true, kKeySessionId); }};
+                return 0;
+            });
+    EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+        .WillOnce(Return(ByMove(std::make_unique<StrictMock<MessageDispatcherClientMock>>())));
+    EXPECT_TRUE(m_sut->initialize());
+    creatingThread.join();
+    EXPECT_CALL(*m_cdmBackendMock, containsKey(kKeySessionId, kBytes2)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->containsKey(kBytes2));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldCancelQueuedKeySessionCreationOnTimeout)
+{
+    constexpr uint64_t kRequestId{3};
+    const auto kDefaultTimeout{OpenCDMSessionPrivate::getChallengeTimeout()};
+    OpenCDMSessionPrivate::setChallengeTimeout(std::chrono::milliseconds{10});
+    createSut();
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, kIsLdl, _, _))
+        .WillOnce(Return(kRequestId));
+    EXPECT_CALL(*m_cdmBackendMock, cancelKeySessionCreation(kRequestId)).WillOnce(Return(true));
+    EXPECT_FALSE(m_sut->initialize());
+    OpenCDMSessionPrivate::setChallengeTimeout(kDefaultTimeout);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldNotInitializeWhenLdlSessionIsNotAdmitted)
+{
+    createSut();
+    EXPECT_CALL(*m_cdmBackendMock, admitLdlSession(SessionPriority::FOREGROUND,
+                                                   OpenCDMSessionPrivate::getChallengeTimeout()))
+        .WillOnce(Return(false));
+    EXPECT_FALSE(m_sut->initialize(true));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldInitializeLdlSessionWithItsPriority)
+{
+    createSut();
+    m_sut->setPriority(SessionPriority::PREFETCH);
+    EXPECT_CALL(*m_cdmBackendMock, admitLdlSession(SessionPriority::PREFETCH, _)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, true, SessionPriority::PREFETCH, _))
+        .WillOnce(completeKeySessionCreation(true, kKeySessionId));
+    EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+        .WillOnce(Return(ByMove(std::make_unique<StrictMock<MessageDispatcherClientMock>>())));
+    EXPECT_TRUE(m_sut->initialize(true));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldPassPriorityChangeToKeySession)
+{
+    createSut();
+    initializeSut();
+    EXPECT_CALL(*m_cdmBackendMock, setKeySessionPriority(kKeySessionId, SessionPriority::BACKGROUND));
+    m_sut->setPriority(SessionPriority::BACKGROUND);
+}
+
 TEST_F(OpenCdmSessionTests, ShouldInitialize)
 {
     createSut();
@@ -252,6 +319,29 @@ TEST_F(OpenCdmSessionTests, ShouldGenerateRequest)
     EXPECT_TRUE(m_sut->generateRequest(kInitDataType, kBytes1, kBytes2));
 }
 
+TEST_F(OpenCdmSessionTests, ShouldGenerateRequestFromRetainedInitData)
+{
+    createSut();
+    initializeSut();
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(false));
+    EXPECT_TRUE(m_sut->generateRequest(kInitDataType, {}, kBytes2));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldKeepInitDataUntilLicenseIsApplied)
+{
+    createSut();
+    initializeSut();
+    EXPECT_EQ(m_sut->getMemoryUsage().initDataBytes, kBytes1.size());
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(false));
+    EXPECT_TRUE(m_sut->generateRequest(kInitDataType, kBytes1, kBytes2));
+    EXPECT_EQ(m_sut->getMemoryUsage().initDataBytes, kBytes1.size());
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kKeySessionId, kBytes2)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->updateSession(kBytes2));
+    EXPECT_EQ(m_sut->getMemoryUsage().initDataBytes, 0u);
+}
+
 TEST_F(OpenCdmSessionTests, ShouldGenerateRequestForAllInitDataTypes)
 {
     createSut();
@@ -325,6 +415,19 @@ TEST_F(OpenCdmSessionTests, ShouldUpdateSession)
     EXPECT_TRUE(m_sut->updateSession(kBytes1));
 }
 
+TEST_F(OpenCdmSessionTests, ShouldReleaseChallengeWhenLicenseIsApplied)
+{
+    createSut();
+    initializeSut();
+    requestLicense();
+    EXPECT_EQ(m_sut->getMemoryUsage().challengeBytes, kBytes1.size() + kUrl.size());
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kKeySessionId, kBytes2)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->updateSession(kBytes2));
+    const SessionMemoryUsage kUsage{m_sut->getMemoryUsage()};
+    EXPECT_EQ(kUsage.initDataBytes, 0u);
+    EXPECT_EQ(kUsage.challengeBytes, 0u);
+}
+
 TEST_F(OpenCdmSessionTests, ShouldNotGetChallengeDataWhenCdmBackendIsNull)
 {
     std::vector<uint8_t> challengeData{};
@@ -361,6 +464,165 @@ TEST_F(OpenCdmSessionTests, ShouldGetChallengeData)
     EXPECT_EQ(challengeData, kBytes1);
 }
 
+TEST_F(OpenCdmSessionTests, ShouldReturnSameChallengeDataWhenCalledAgain)
+{
+    std::vector<uint8_t> challengeData{};
+    createSut();
+    initializeSut();
+    requestLicense();
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->getChallengeData(challengeData));
+    EXPECT_EQ(challengeData, kBytes1);
+
+    // Apps ask for the size first and then for the data, no new request is generated for the second call
+    std::vector<uint8_t> repeatedChallengeData{};
+    EXPECT_TRUE(m_sut->getChallengeData(repeatedChallengeData));
+    EXPECT_EQ(repeatedChallengeData, kBytes1);
+    SessionMemoryUsage usage{m_sut->getMemoryUsage()};
+    EXPECT_EQ(usage.sessionBytes, sizeof(OpenCDMSessionPrivate));
+    EXPECT_EQ(usage.initDataBytes, kBytes1.size());
+    EXPECT_EQ(usage.challengeBytes, kBytes1.size() + kUrl.size());
+
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kKeySessionId, kBytes2)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->updateSession(kBytes2));
+    usage = m_sut->getMemoryUsage();
+    EXPECT_EQ(usage.initDataBytes, 0u);
+    EXPECT_EQ(usage.challengeBytes, 0u);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldNotGenerateRequestForSecondChallengeDataCall)
+{
+    std::vector<uint8_t> challengeData{};
+    createSut();
+    initializeSut();
+    requestLicense();
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->getChallengeData(challengeData));
+    testing::Mock::VerifyAndClearExpectations(m_cdmBackendMock.get());
+
+    // Any backend call fails the strict mock
+    std::vector<uint8_t> repeatedChallengeData{};
+    EXPECT_TRUE(m_sut->getChallengeData(repeatedChallengeData));
+    EXPECT_EQ(repeatedChallengeData, kBytes1);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldGetSpeculativelyGeneratedChallengeData)
+{
+    std::vector<uint8_t> challengeData{};
+    createSut();
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, false, _, _))
+        .WillOnce(completeKeySessionCreation(true, kKeySessionId));
+    EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+        .WillOnce(Return(ByMove(std::make_unique<StrictMock<MessageDispatcherClientMock>>())));
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    m_sut->startSpeculativeRequest();
+    EXPECT_TRUE(m_sut->initialize(false));
+    requestLicense();
+    EXPECT_TRUE(m_sut->getChallengeData(challengeData));
+    EXPECT_EQ(challengeData, kBytes1);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldWaitForSpeculativeRequestBeforeUsingKeySession)
+{
+    createSut();
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, false, _, _))
+        .WillOnce(completeKeySessionCreation(true, kKeySessionId));
+    EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+        .WillOnce(Return(ByMove(std::make_unique<StrictMock<MessageDispatcherClientMock>>())));
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, containsKey(kKeySessionId, kBytes2)).WillOnce(Return(true));
+    m_sut->startSpeculativeRequest();
+    EXPECT_TRUE(m_sut->containsKey(kBytes2));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldReplaceSpeculativelyCreatedSessionForLdl)
+{
+    constexpr int32_t kLdlKeySessionId{kKeySessionId + 1};
+    createSut();
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, false, _, _))
+        .WillOnce(completeKeySessionCreation(true, kKeySessionId));
+    EXPECT_CALL(*m_messageDispatcherMock, createClient(_))
+        .Times(2)
+        .WillRepeatedly([](auto) { return std::make_unique<StrictMock<MessageDispatcherClientMock>>(); });
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, closeKeySession(kKeySessionId)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, admitLdlSession(SessionPriority::FOREGROUND, _)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, createKeySessionAsync(kRialtoSessionType, true, _, _))
+        .WillOnce(completeKeySessionCreation(true, kLdlKeySessionId));
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kLdlKeySessionId, kRialtoInitDataType, kBytes1))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kLdlKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_CALL(OcdmSessionsCallbacksMock::instance(),
+                processChallengeCallback(m_sut.get(), &m_userData, kUrl.c_str(), kBytes1.data(), kBytes1.size()));
+    // All expectations are set before the speculative request runs on its own thread
+    m_sut->startSpeculativeRequest();
+    EXPECT_TRUE(m_sut->initialize(true));
+
+    std::vector<uint8_t> challengeData{};
+    m_sut->onLicenseRequest(kLdlKeySessionId, kBytes1, kUrl);
+    EXPECT_TRUE(m_sut->getChallengeData(challengeData));
+    EXPECT_EQ(challengeData, kBytes1);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldUseNewKeySessionIdAfterRestore)
+{
+    constexpr int32_t kRestoredKeySessionId{kKeySessionId + 1};
+    createSut();
+    initializeSut();
+    m_sut->onKeySessionIdsChanged({{kKeySessionId, kRestoredKeySessionId}, {kRestoredKeySessionId, kKeySessionId}});
+    EXPECT_CALL(*m_cdmBackendMock, updateSession(kRestoredKeySessionId, kBytes1)).WillOnce(Return(true));
+    EXPECT_TRUE(m_sut->updateSession(kBytes1));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldFailWhenKeySessionIsNotRestored)
+{
+    createSut();
+    initializeSut();
+    m_sut->onKeySessionIdsChanged({{kKeySessionId, firebolt::rialto::kInvalidSessionId}});
+    EXPECT_FALSE(m_sut->updateSession(kBytes1));
+}
+
+TEST_F(OpenCdmSessionTests, ShouldTimeOutWaitingForChallengeData)
+{
+    const auto kDefaultTimeout{OpenCDMSessionPrivate::getChallengeTimeout()};
+    OpenCDMSessionPrivate::setChallengeTimeout(std::chrono::milliseconds{10});
+    const uint64_t kTimeouts{Metrics::instance().get(MetricId::CHALLENGE_TIMEOUTS)};
+    std::vector<uint8_t> challengeData{};
+    createSut();
+    initializeSut();
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    EXPECT_FALSE(m_sut->getChallengeData(challengeData));
+    EXPECT_TRUE(challengeData.empty());
+    EXPECT_EQ(kTimeouts + 1, Metrics::instance().get(MetricId::CHALLENGE_TIMEOUTS));
+    // Kept for a retry
+    EXPECT_EQ(m_sut->getMemoryUsage().initDataBytes, kBytes1.size());
+    OpenCDMSessionPrivate::setChallengeTimeout(kDefaultTimeout);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldWakeUpChallengeDataWaitWhenCancelled)
+{
+    const uint64_t kCancellations{Metrics::instance().get(MetricId::CHALLENGE_CANCELLATIONS)};
+    std::vector<uint8_t> challengeData{};
+    createSut();
+    initializeSut();
+    EXPECT_CALL(*m_cdmBackendMock, generateRequest(kKeySessionId, kRialtoInitDataType, kBytes1)).WillOnce(Return(true));
+    EXPECT_CALL(*m_cdmBackendMock, getCdmKeySessionId(kKeySessionId, _)).WillOnce(Return(true));
+    std::future<bool> result{std::async(std::launch::async, [&]() { return m_sut->getChallengeData(challengeData); })};
+    // Cancelling before the wait has started has no effect, so keep cancelling until the waiter returns
+    while (std::future_status::ready != result.wait_for(std::chrono::milliseconds{1}))
+    {
+        m_sut->cancelChallengeData();
+    }
+    EXPECT_FALSE(result.get());
+    EXPECT_EQ(kCancellations + 1, Metrics::instance().get(MetricId::CHALLENGE_CANCELLATIONS));
+}
+
 TEST_F(OpenCdmSessionTests, ShouldAddBasicProtectionMeta)
 {
     fillBuffers();
@@ -599,24 +861,60 @@ TEST_F(OpenCdmSessionTests, ShouldProcessKeyStatusUpdates)
     createSut();
     initializeSut();
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::USABLE);
-    EXPECT_EQ(m_sut->status(kBytes1), Usable);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), Usable);
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::EXPIRED);
-    EXPECT_EQ(m_sut->status(kBytes1), Expired);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), Expired);
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::OUTPUT_RESTRICTED);
-    EXPECT_EQ(m_sut->status(kBytes1), OutputRestricted);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), OutputRestricted);
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::PENDING);
-    EXPECT_EQ(m_sut->status(kBytes1), StatusPending);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), StatusPending);
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::INTERNAL_ERROR);
-    EXPECT_EQ(m_sut->status(kBytes1), InternalError);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), InternalError);
     updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::RELEASED);
-    EXPECT_EQ(m_sut->status(kBytes1), Released);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), Released);
 }
 
 TEST_F(OpenCdmSessionTests, ShouldReturnInternalErrorForUnknownKey)
 {
     createSut();
     initializeSut();
-    EXPECT_EQ(m_sut->status(kBytes1), InternalError);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), InternalError);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldReportKeyIdsOfInitDataAsPending)
+{
+    m_sut = std::make_unique<OpenCDMSessionPrivate>(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
+                                                    &m_callbacks, &m_userData, "webm", kBytes1);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), StatusPending);
+    EXPECT_EQ(m_sut->status(kBytes2.data(), kBytes2.size()), InternalError);
+    initializeSut();
+    updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::USABLE);
+    EXPECT_EQ(m_sut->status(kBytes1.data(), kBytes1.size()), Usable);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldWaitForPendingKey)
+{
+    m_sut = std::make_unique<OpenCDMSessionPrivate>(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
+                                                    &m_callbacks, &m_userData, "webm", kBytes1);
+    initializeSut();
+    std::future<KeyStatus> result{
+        std::async(std::launch::async,
+                   [this]() { return m_sut->waitForKey(kBytes1.data(), kBytes1.size(), std::chrono::seconds{10}); })};
+    updateKeyStatus(kBytes1, firebolt::rialto::KeyStatus::USABLE);
+    EXPECT_EQ(result.get(), Usable);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldStopWaitingForKeyOnTimeout)
+{
+    m_sut = std::make_unique<OpenCDMSessionPrivate>(m_cdmBackendMock, m_messageDispatcherMock, kSessionType,
+                                                    &m_callbacks, &m_userData, "webm", kBytes1);
+    EXPECT_EQ(m_sut->waitForKey(kBytes1.data(), kBytes1.size(), std::chrono::milliseconds{1}), StatusPending);
+}
+
+TEST_F(OpenCdmSessionTests, ShouldNotWaitForUnknownKey)
+{
+    createSut();
+    EXPECT_EQ(m_sut->waitForKey(kBytes1.data(), kBytes1.size(), std::chrono::seconds{10}), InternalError);
 }
 
 TEST_F(OpenCdmSessionTests, ShouldReturnEmptySessionIdWhenNotInitialized)
@@ -21,6 +21,7 @@
 #include "MediaKeysCapabilitiesMock.h"
 #include "OcdmSessionsCallbacksMock.h"
 #include "OpenCDMSessionMock.h"
+#include "OpenCDMSessionPrivate.h"
 #include "OpenCDMSystemMock.h"
 #include "opencdm/open_cdm.h"
 #include <gtest/gtest.h>
@@ -31,6 +32,7 @@ using firebolt::rialto::MediaKeysCapabilitiesFactoryMock;
 using firebolt::rialto::MediaKeysCapabilitiesMock;
 using testing::_;
 using testing::DoAll;
+using testing::IsEmpty;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SetArgReferee;
@@ -194,6 +196,21 @@ TEST_F(OpenCdmTests, ShouldConstructPlayreadySession)
     EXPECT_EQ(&m_openCdmSessionMock, resultSession);
 }
 
+TEST_F(OpenCdmTests, ShouldStartSpeculativeRequestWhenConstructingPlayreadySession)
+{
+    OpenCDMSession *resultSession{nullptr};
+    OpenCDMSessionPrivate::setSpeculativeChallengeEnabled(true);
+    EXPECT_CALL(m_openCdmSystemMock, createSession(kLicenseType, &m_callbacks, &m_userData, kInitDataType, kInitData))
+        .WillOnce(Return(&m_openCdmSessionMock));
+    EXPECT_CALL(m_openCdmSystemMock, keySystem()).WillOnce(ReturnRef(kNetflixKeySystem));
+    EXPECT_CALL(m_openCdmSessionMock, startSpeculativeRequest());
+    EXPECT_EQ(ERROR_NONE, opencdm_construct_session(&m_openCdmSystemMock, kLicenseType, kInitDataType.c_str(),
+                                                    kInitData.data(), kInitData.size(), kCdmData.data(),
+                                                    kCdmData.size(), &m_callbacks, &m_userData, &resultSession));
+    EXPECT_EQ(&m_openCdmSessionMock, resultSession);
+    OpenCDMSessionPrivate::setSpeculativeChallengeEnabled(false);
+}
+
 TEST_F(OpenCdmTests, ShouldFailToConstructWidevineSessionWhenInitializationFails)
 {
     OpenCDMSession *resultSession{nullptr};
@@ -214,7 +231,7 @@ TEST_F(OpenCdmTests, ShouldFailToConstructWidevineSessionWhenGenerateRequestFail
         .WillOnce(Return(&m_openCdmSessionMock));
     EXPECT_CALL(m_openCdmSystemMock, keySystem()).WillOnce(ReturnRef(kWidevineKeySystem));
     EXPECT_CALL(m_openCdmSessionMock, initialize()).WillOnce(Return(true));
-    EXPECT_CALL(m_openCdmSessionMock, generateRequest(kInitDataType, kInitData, kCdmData)).WillOnce(Return(false));
+    EXPECT_CALL(m_openCdmSessionMock, generateRequest(kInitDataType, IsEmpty(), kCdmData)).WillOnce(Return(false));
     EXPECT_CALL(m_openCdmSessionMock, closeSession()).WillOnce(Return(true));
     EXPECT_EQ(ERROR_FAIL, opencdm_construct_session(&m_openCdmSystemMock, kLicenseType, kInitDataType.c_str(),
                                                     kInitData.data(), kInitData.size(), kCdmData.data(),
@@ -229,7 +246,7 @@ TEST_F(OpenCdmTests, ShouldConstructWidevineSession)
         .WillOnce(Return(&m_openCdmSessionMock));
     EXPECT_CALL(m_openCdmSystemMock, keySystem()).WillOnce(ReturnRef(kWidevineKeySystem));
     EXPECT_CALL(m_openCdmSessionMock, initialize()).WillOnce(Return(true));
-    EXPECT_CALL(m_openCdmSessionMock, generateRequest(kInitDataType, kInitData, kCdmData)).WillOnce(Return(true));
+    EXPECT_CALL(m_openCdmSessionMock, generateRequest(kInitDataType, IsEmpty(), kCdmData)).WillOnce(Return(true));
     EXPECT_EQ(ERROR_NONE, opencdm_construct_session(&m_openCdmSystemMock, kLicenseType, kInitDataType.c_str(),
                                                     kInitData.data(), kInitData.size(), kCdmData.data(),
                                                     kCdmData.size(), &m_callbacks, &m_userData, &resultSession));
@@ -309,7 +326,7 @@ TEST_F(OpenCdmTests, ShouldFailToCheckSessionStatusWhenSessionIsNull)
 TEST_F(OpenCdmTests, ShouldCheckSessionStatus)
 {
     constexpr KeyStatus kKeyStatus{Usable};
-    EXPECT_CALL(m_openCdmSessionMock, status(kInitData)).WillOnce(Return(kKeyStatus));
+    EXPECT_CALL(m_openCdmSessionMock, status(kInitData.data(), kInitData.size())).WillOnce(Return(kKeyStatus));
     EXPECT_EQ(kKeyStatus, opencdm_session_status(&m_openCdmSessionMock, kInitData.data(), kInitData.size()));
 }
 
@@ -0,0 +1,154 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Metrics.h"
+#include "PriorityScheduler.h"
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int32_t kKeySessionId{12};
+} // namespace
+
+class PrioritySchedulerTests : public testing::Test
+{
+public:
+    void waitForWaitingCount(size_t count)
+    {
+        while (m_sut.getWaitingCount() != count)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+protected:
+    PriorityScheduler m_sut;
+};
+
+TEST_F(PrioritySchedulerTests, ShouldNotWaitWhenIdle)
+{
+    m_sut.acquire(SessionPriority::BACKGROUND);
+    m_sut.release();
+    m_sut.acquire(SessionPriority::FOREGROUND);
+    m_sut.release();
+    EXPECT_EQ(0u, m_sut.getWaitingCount());
+}
+
+TEST_F(PrioritySchedulerTests, ShouldServeHigherPriorityFirst)
+{
+    std::mutex orderMutex;
+    std::vector<SessionPriority> order;
+    const auto kRunTurn{[&](SessionPriority priority)
+                        {
+                            m_sut.acquire(priority);
+                            {
+                                std::unique_lock<std::mutex> lock{orderMutex};
+                                order.push_back(priority);
+                            }
+                            m_sut.release();
+                        }};
+    m_sut.acquire(SessionPriority::FOREGROUND);
+    std::thread background{kRunTurn, SessionPriority::BACKGROUND};
+    waitForWaitingCount(1);
+    std::thread prefetch{kRunTurn, SessionPriority::PREFETCH};
+    waitForWaitingCount(2);
+    std::thread foreground{kRunTurn, SessionPriority::FOREGROUND};
+    waitForWaitingCount(3);
+    m_sut.release();
+    background.join();
+    prefetch.join();
+    foreground.join();
+
+    const std::vector<SessionPriority> kExpectedOrder{SessionPriority::FOREGROUND, SessionPriority::PREFETCH,
+                                                      SessionPriority::BACKGROUND};
+    EXPECT_EQ(kExpectedOrder, order);
+}
+
+TEST_F(PrioritySchedulerTests, ShouldServeLongestWaitingAfterMaxOvertakes)
+{
+    constexpr uint32_t kForegroundCount{PriorityScheduler::kMaxOvertakes + 1};
+    const uint64_t kStarvationGrants{Metrics::instance().get(MetricId::SCHEDULER_STARVATION_GRANTS)};
+    std::atomic<uint32_t> foregroundTurns{0};
+    uint32_t foregroundTurnsBeforeBackground{0};
+    m_sut.acquire(SessionPriority::FOREGROUND);
+    std::thread background{[&]()
+                           {
+                               m_sut.acquire(SessionPriority::BACKGROUND);
+                               foregroundTurnsBeforeBackground = foregroundTurns;
+                               m_sut.release();
+                           }};
+    waitForWaitingCount(1);
+
+    // Every foreground turn ends only after the next foreground operation is waiting
+    std::vector<std::promise<void>> releases(kForegroundCount);
+    std::vector<std::thread> foreground;
+    for (uint32_t i = 0; i < kForegroundCount; ++i)
+    {
+        foreground.emplace_back(
+            [&, i]()
+            {
+                m_sut.acquire(SessionPriority::FOREGROUND);
+                ++foregroundTurns;
+                releases[i].get_future().wait();
+                m_sut.release();
+            });
+        waitForWaitingCount(2);
+        if (0 == i)
+        {
+            m_sut.release();
+        }
+        else
+        {
+            releases[i - 1].set_value();
+        }
+    }
+    releases.back().set_value();
+    background.join();
+    for (std::thread &thread : foreground)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(PriorityScheduler::kMaxOvertakes, foregroundTurnsBeforeBackground);
+    EXPECT_EQ(kStarvationGrants + 1, Metrics::instance().get(MetricId::SCHEDULER_STARVATION_GRANTS));
+}
+
+TEST_F(PrioritySchedulerTests, ShouldKeepKeySessionPriorities)
+{
+    EXPECT_EQ(SessionPriority::FOREGROUND, m_sut.getPriority(kKeySessionId));
+    m_sut.setPriority(kKeySessionId, SessionPriority::PREFETCH);
+    EXPECT_EQ(SessionPriority::PREFETCH, m_sut.getPriority(kKeySessionId));
+    m_sut.removePriority(kKeySessionId);
+    EXPECT_EQ(SessionPriority::FOREGROUND, m_sut.getPriority(kKeySessionId));
+}
+
+TEST_F(PrioritySchedulerTests, ShouldReleaseTurnAndMutexOnUnlock)
+{
+    ProfiledMutex mutex{"PrioritySchedulerTests"};
+    ScheduledLock lock{m_sut, SessionPriority::PREFETCH, mutex};
+    lock.unlock();
+    m_sut.acquire(SessionPriority::BACKGROUND);
+    ProfiledLock otherLock{mutex};
+    m_sut.release();
+}
@@ -0,0 +1,128 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OpenCdmRialtoExt.h"
+#include "Tracer.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace
+{
+const char *kTraceFilename{"test_trace.json"};
+
+std::string readTraceFile()
+{
+    std::ifstream file{kTraceFilename};
+    return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+size_t countOccurrences(const std::string &text, const std::string &pattern)
+{
+    size_t count{0};
+    for (size_t position = text.find(pattern); std::string::npos != position;
+         position = text.find(pattern, position + 1))
+    {
+        ++count;
+    }
+    return count;
+}
+} // namespace
+
+class TracerTests : public testing::Test
+{
+public:
+    TracerTests() { std::remove(kTraceFilename); }
+    ~TracerTests() override
+    {
+        Tracer::instance().reset();
+        std::remove(kTraceFilename);
+    }
+};
+
+TEST_F(TracerTests, ShouldBeDisabledByDefault)
+{
+    EXPECT_FALSE(Tracer::instance().isEnabled());
+    {
+        TraceScope traceScope{"disabled"};
+    }
+    Tracer::instance().addInstantEvent("disabled", nullptr, -1);
+    EXPECT_TRUE(readTraceFile().empty());
+}
+
+TEST_F(TracerTests, ShouldWriteChromeTraceEvents)
+{
+    const int kSession{0};
+    ASSERT_TRUE(Tracer::instance().start(kTraceFilename));
+    EXPECT_TRUE(Tracer::instance().isEnabled());
+    {
+        TraceScope traceScope{"createKeySession"};
+        traceScope.setKeySessionId(7);
+    }
+    std::thread{[&]() { Tracer::instance().addInstantEvent("onLicenseRequest", &kSession, 7); }}.join();
+    Tracer::instance().stop();
+    EXPECT_FALSE(Tracer::instance().isEnabled());
+
+    const std::string kTrace{readTraceFile()};
+    EXPECT_EQ(0u, kTrace.find("[\n{"));
+    EXPECT_NE(std::string::npos, kTrace.find("\n]\n"));
+    EXPECT_EQ(2u, countOccurrences(kTrace, "\"cat\":\"ocdm\""));
+    EXPECT_NE(std::string::npos, kTrace.find("\"name\":\"createKeySession\",\"cat\":\"ocdm\",\"ph\":\"X\""));
+    EXPECT_NE(std::string::npos, kTrace.find("\"name\":\"onLicenseRequest\",\"cat\":\"ocdm\",\"ph\":\"i\""));
+    EXPECT_EQ(2u, countOccurrences(kTrace, "\"keySessionId\":7"));
+    EXPECT_EQ(2u, countOccurrences(kTrace, "\"dur\":") + countOccurrences(kTrace, "\"s\":\"t\""));
+}
+
+TEST_F(TracerTests, ShouldNotWriteEventsAfterStop)
+{
+    ASSERT_TRUE(Tracer::instance().start(kTraceFilename));
+    Tracer::instance().stop();
+    Tracer::instance().addInstantEvent("stopped", nullptr, -1);
+    ASSERT_TRUE(Tracer::instance().start(kTraceFilename));
+    Tracer::instance().stop();
+
+    EXPECT_EQ(readTraceFile(), "[\n\n]\n");
+}
+
+TEST_F(TracerTests, ShouldStartTracingFromEnvVar)
+{
+    setenv("RIALTO_TRACE_PATH", kTraceFilename, 1);
+    Tracer::instance().reset();
+    unsetenv("RIALTO_TRACE_PATH");
+    EXPECT_TRUE(Tracer::instance().isEnabled());
+}
+
+TEST_F(TracerTests, ShouldFailToStartTracingToInvalidPath)
+{
+    EXPECT_FALSE(Tracer::instance().start("/nonexistent/trace.json"));
+    EXPECT_FALSE(Tracer::instance().isEnabled());
+}
+
+TEST_F(TracerTests, ShouldStartAndStopTracingThroughExtApi)
+{
+    EXPECT_EQ(ERROR_INVALID_ARG, opencdm_ext_start_tracing(nullptr));
+    EXPECT_EQ(ERROR_FAIL, opencdm_ext_start_tracing("/nonexistent/trace.json"));
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_start_tracing(kTraceFilename));
+    EXPECT_TRUE(Tracer::instance().isEnabled());
+    EXPECT_EQ(ERROR_NONE, opencdm_ext_stop_tracing());
+    EXPECT_FALSE(Tracer::instance().isEnabled());
+}
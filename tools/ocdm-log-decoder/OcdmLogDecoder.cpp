@@ -0,0 +1,222 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2023 Sky UK
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinaryLogFormat.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+const char *toString(uint8_t severity)
+{
+    static const char *kNames[] = {"ftl", "err", "wrn", "mil", "inf", "dbg"};
+    if (severity < sizeof(kNames) / sizeof(kNames[0]))
+    {
+        return kNames[severity];
+    }
+    return "???";
+}
+
+std::string formatTimestamp(uint64_t timestampNs)
+{
+    const std::time_t kSeconds = static_cast<std::time_t>(timestampNs / 1000000000ULL);
+    std::tm localTime{};
+    localtime_r(&kSeconds, &localTime);
+    char buffer[32]{};
+    std::strftime(buffer, sizeof(buffer), "[%F %T]", &localTime);
+    return buffer;
+}
+
+template <typename T> bool readValue(const uint8_t *&position, const uint8_t *end, T &value)
+{
+    if (static_cast<size_t>(end - position) < sizeof(T))
+    {
+        return false;
+    }
+    std::memcpy(&value, position, sizeof(T));
+    position += sizeof(T);
+    return true;
+}
+
+bool readArg(const uint8_t *&position, const uint8_t *end, std::string &result)
+{
+    uint8_t type{0};
+    if (!readValue(position, end, type))
+    {
+        return false;
+    }
+    char buffer[32]{};
+    switch (type)
+    {
+    case binarylog::kSigned:
+    {
+        int64_t value{0};
+        if (!readValue(position, end, value))
+            return false;
+        std::snprintf(buffer, sizeof(buffer), "%" PRId64, value);
+        break;
+    }
+    case binarylog::kUnsigned:
+    {
+        uint64_t value{0};
+        if (!readValue(position, end, value))
+            return false;
+        std::snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+        break;
+    }
+    case binarylog::kDouble:
+    {
+        double value{0};
+        if (!readValue(position, end, value))
+            return false;
+        std::snprintf(buffer, sizeof(buffer), "%g", value);
+        break;
+    }
+    case binarylog::kPointer:
+    {
+        uint64_t value{0};
+        if (!readValue(position, end, value))
+            return false;
+        std::snprintf(buffer, sizeof(buffer), "0x%" PRIx64, value);
+        break;
+    }
+    case binarylog::kString:
+    {
+        uint16_t length{0};
+        if (!readValue(position, end, length) || static_cast<size_t>(end - position) < length)
+            return false;
+        result.assign(reinterpret_cast<const char *>(position), length);
+        position += length;
+        return true;
+    }
+    default:
+        return false;
+    }
+    result = buffer;
+    return true;
+}
+
+bool decode(const std::vector<uint8_t> &data, std::ostream &output)
+{
+    binarylog::BinaryLogFileHeader fileHeader{};
+    if (data.size() < sizeof(fileHeader))
+    {
+        std::cerr << "File too short" << std::endl;
+        return false;
+    }
+    std::memcpy(&fileHeader, data.data(), sizeof(fileHeader));
+    if (0 != std::memcmp(fileHeader.magic, binarylog::kMagic, sizeof(fileHeader.magic)) ||
+        binarylog::kVersion != fileHeader.version)
+    {
+        std::cerr << "Not an ocdm binary log or unsupported version" << std::endl;
+        return false;
+    }
+
+    std::unordered_map<uint32_t, std::string> strings;
+    size_t offset{fileHeader.headerSize};
+    while (offset + sizeof(binarylog::BinaryLogRecordHeader) <= data.size())
+    {
+        binarylog::BinaryLogRecordHeader header{};
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        if (binarylog::kEnd == header.type)
+        {
+            break;
+        }
+        if (header.size < sizeof(header) || offset + header.size > data.size())
+        {
+            std::cerr << "Truncated record at offset " << offset << std::endl;
+            return false;
+        }
+        const uint8_t *position{data.data() + offset + sizeof(header)};
+        const uint8_t *end{data.data() + offset + header.size};
+        offset += header.size;
+
+        if (binarylog::kStringDefinition == header.type)
+        {
+            binarylog::StringDefinition definition{};
+            if (readValue(position, end, definition) && static_cast<size_t>(end - position) >= definition.length)
+            {
+                strings[definition.id].assign(reinterpret_cast<const char *>(position), definition.length);
+            }
+        }
+        else if (binarylog::kLogEntry == header.type)
+        {
+            binarylog::LogEntry entry{};
+            if (!readValue(position, end, entry))
+            {
+                continue;
+            }
+            std::string message;
+            std::string arg;
+            uint8_t argsLeft{entry.argCount};
+            for (char c : strings[entry.formatId])
+            {
+                if (binarylog::kPlaceholder != c)
+                {
+                    message += c;
+                }
+                else if (argsLeft > 0 && readArg(position, end, arg))
+                {
+                    message += arg;
+                    --argsLeft;
+                }
+            }
+            output << formatTimestamp(entry.timestampNs) << "[" << strings[entry.componentId] << "]["
+                   << toString(entry.severity) << "]: " << message << "\n";
+        }
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <log.ocdm.bin> [output.ocdm]" << std::endl;
+        return 1;
+    }
+    std::ifstream input{argv[1], std::ios::binary};
+    if (!input.is_open())
+    {
+        std::cerr << "Unable to open " << argv[1] << std::endl;
+        return 1;
+    }
+    const std::vector<uint8_t> kData{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+
+    if (argc == 3)
+    {
+        std::ofstream output{argv[2]};
+        if (!output.is_open())
+        {
+            std::cerr << "Unable to open " << argv[2] << std::endl;
+            return 1;
+        }
+        return decode(kData, output) ? 0 : 1;
+    }
+    return decode(kData, std::cout) ? 0 : 1;
+}